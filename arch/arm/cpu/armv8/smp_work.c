@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running work items on secondary CPUs using PSCI
+ *
+ * Secondary CPUs are powered on with PSCI CPU_ON when there is work for
+ * them and turn themselves off again with CPU_OFF once the work queue is
+ * empty, so they are back in the state the OS expects when it boots.
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <smp_work.h>
+#include <time.h>
+#include <asm/cache.h>
+#include <asm/global_data.h>
+#include <asm/psci.h>
+#include <asm/ptrace.h>
+#include <asm/system.h>
+#include <asm/armv8/smp_work.h>
+#include <linux/bitops.h>
+#include <linux/delay.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define SMP_WORK_STACK_SIZE	SZ_32K
+#define SMP_WORK_BUSY_WARN_MS	10000
+#define SMP_WORK_OFF_TIMEOUT_MS	100
+#define MPIDR_HWID_MASK		0xff00ffffffUL
+
+static struct smp_work_cpu smp_work_cpu[CONFIG_SMP_WORK_MAX_CPUS - 1];
+static int smp_work_ncpus = -1;
+static u64 smp_work_boot_mpidr;
+
+static u64 read_mpidr_hwid(void)
+{
+	u64 val;
+
+	asm volatile("mrs %0, mpidr_el1" : "=r" (val));
+
+	return val & MPIDR_HWID_MASK;
+}
+
+static unsigned long smp_work_psci(unsigned long fn, unsigned long a1,
+				   unsigned long a2, unsigned long a3)
+{
+	struct pt_regs regs;
+
+	regs.regs[0] = fn;
+	regs.regs[1] = a1;
+	regs.regs[2] = a2;
+	regs.regs[3] = a3;
+	smc_call(&regs);
+
+	return regs.regs[0];
+}
+
+/* Find the other CPUs which PSCI can start, from the device tree */
+static void smp_work_find_cpus(void)
+{
+	ofnode cpus, node;
+	const fdt32_t *reg;
+	const char *method;
+	u64 mpidr;
+	int len;
+
+	smp_work_ncpus = 0;
+	smp_work_boot_mpidr = read_mpidr_hwid();
+	cpus = ofnode_path("/cpus");
+	if (!ofnode_valid(cpus))
+		return;
+
+	ofnode_for_each_subnode(node, cpus) {
+		if (smp_work_ncpus == ARRAY_SIZE(smp_work_cpu))
+			break;
+		if (!ofnode_is_available(node))
+			continue;
+		method = ofnode_read_string(node, "enable-method");
+		if (!method || strcmp(method, "psci"))
+			continue;
+		reg = ofnode_get_property(node, "reg", &len);
+		if (!reg)
+			continue;
+		if (len == sizeof(u64))
+			mpidr = ((u64)fdt32_to_cpu(reg[0]) << 32) |
+				fdt32_to_cpu(reg[1]);
+		else
+			mpidr = fdt32_to_cpu(reg[0]);
+		if (mpidr == smp_work_boot_mpidr)
+			continue;
+		smp_work_cpu[smp_work_ncpus++].mpidr = mpidr;
+	}
+	log_debug("%d secondary CPUs\n", smp_work_ncpus);
+}
+
+int arch_smp_work_cpus(void)
+{
+	if (smp_work_ncpus < 0)
+		smp_work_find_cpus();
+
+	return smp_work_ncpus;
+}
+
+static void smp_work_read_regs(struct smp_work_cpu *cpu)
+{
+	switch (current_el()) {
+	case 3:
+		asm volatile("mrs %0, ttbr0_el3" : "=r" (cpu->ttbr));
+		asm volatile("mrs %0, tcr_el3" : "=r" (cpu->tcr));
+		asm volatile("mrs %0, mair_el3" : "=r" (cpu->mair));
+		asm volatile("mrs %0, vbar_el3" : "=r" (cpu->vbar));
+		break;
+	case 2:
+		asm volatile("mrs %0, ttbr0_el2" : "=r" (cpu->ttbr));
+		asm volatile("mrs %0, tcr_el2" : "=r" (cpu->tcr));
+		asm volatile("mrs %0, mair_el2" : "=r" (cpu->mair));
+		asm volatile("mrs %0, vbar_el2" : "=r" (cpu->vbar));
+		break;
+	default:
+		asm volatile("mrs %0, ttbr0_el1" : "=r" (cpu->ttbr));
+		asm volatile("mrs %0, tcr_el1" : "=r" (cpu->tcr));
+		asm volatile("mrs %0, mair_el1" : "=r" (cpu->mair));
+		asm volatile("mrs %0, vbar_el1" : "=r" (cpu->vbar));
+		break;
+	}
+	cpu->sctlr = get_sctlr();
+}
+
+int arch_smp_work_start(int idx, void (*entry)(void *arg), void *arg)
+{
+	struct smp_work_cpu *cpu = &smp_work_cpu[idx];
+	ulong start = (ulong)smp_work_secondary_entry;
+	unsigned long ret;
+
+	/* Without the MMU the secondary would not see coherent memory */
+	if (!dcache_status())
+		return -ENOSYS;
+	if (!cpu->stack_base) {
+		cpu->stack_base = memalign(16, SMP_WORK_STACK_SIZE);
+		if (!cpu->stack_base)
+			return -ENOMEM;
+	}
+	cpu->stack = (ulong)cpu->stack_base + SMP_WORK_STACK_SIZE;
+	cpu->gd = (ulong)gd;
+	smp_work_read_regs(cpu);
+	cpu->entry = entry;
+	cpu->arg = arg;
+	cpu->done = 0;
+
+	/* The CPU reads these before its MMU and caches are on */
+	flush_dcache_range((ulong)cpu, (ulong)(cpu + 1));
+	flush_dcache_range(gd->arch.tlb_addr,
+			   gd->arch.tlb_addr + gd->arch.tlb_size);
+	flush_dcache_range(start & ~(ARCH_DMA_MINALIGN - 1),
+			   ALIGN(start + 0x100, ARCH_DMA_MINALIGN));
+
+	ret = smp_work_psci(ARM_PSCI_0_2_FN64_CPU_ON, cpu->mpidr, start,
+			    (ulong)cpu);
+	if (ret != ARM_PSCI_RET_SUCCESS) {
+		log_debug("CPU_ON %llx failed: %ld\n", cpu->mpidr, (long)ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int arch_smp_work_wait(int idx)
+{
+	struct smp_work_cpu *cpu = &smp_work_cpu[idx];
+	bool warned = false;
+	ulong start;
+
+	/* The CPU is still using the caller's memory, so keep waiting */
+	start = get_timer(0);
+	while (!__atomic_load_n(&cpu->done, __ATOMIC_ACQUIRE)) {
+		if (!warned && get_timer(start) > SMP_WORK_BUSY_WARN_MS) {
+			log_warning("CPU %llx is still busy\n", cpu->mpidr);
+			warned = true;
+		}
+	}
+
+	/* Wait until it is really off, so that it can be started again */
+	start = get_timer(0);
+	while (smp_work_psci(ARM_PSCI_0_2_FN64_AFFINITY_INFO, cpu->mpidr, 0,
+			     0) != PSCI_AFFINITY_LEVEL_OFF) {
+		if (get_timer(start) > SMP_WORK_OFF_TIMEOUT_MS)
+			return -ETIMEDOUT;
+		udelay(10);
+	}
+
+	return 0;
+}
+
+bool arch_smp_work_is_secondary(void)
+{
+	return read_mpidr_hwid() != smp_work_boot_mpidr;
+}
+
+void __noreturn smp_work_secondary_main(struct smp_work_cpu *cpu)
+{
+	cpu->entry(cpu->arg);
+	__atomic_store_n(&cpu->done, 1, __ATOMIC_RELEASE);
+
+	smp_work_psci(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+	while (1)
+		wfi();
+}
@@ -3,6 +3,9 @@
  * Copyright 2018 NXP
  */
 
+#ifndef _ASM_ARMV8_CPU_H_
+#define _ASM_ARMV8_CPU_H_
+
 #define MIDR_PARTNUM_CORTEX_A35	0xD04
 #define MIDR_PARTNUM_CORTEX_A53	0xD03
 #define MIDR_PARTNUM_CORTEX_A72	0xD08
@@ -24,3 +27,20 @@ static inline unsigned int read_midr(void)
 			 MIDR_PARTNUM_SHIFT) == MIDR_PARTNUM_CORTEX_A53)
 #define is_cortex_a72() (((read_midr() & MIDR_PARTNUM_MASK) >>\
 			 MIDR_PARTNUM_SHIFT) == MIDR_PARTNUM_CORTEX_A72)
+
+/* ID_AA64ISAR0_EL1 instruction set attribute fields */
+#define ID_AA64ISAR0_SHA1_SHIFT		8
+#define ID_AA64ISAR0_SHA2_SHIFT		12
+#define ID_AA64ISAR0_CRC32_SHIFT	16
+#define ID_AA64ISAR0_FIELD(val, shift)	(((val) >> (shift)) & 0xf)
+
+static inline unsigned long read_id_aa64isar0(void)
+{
+	unsigned long val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+
+	return val;
+}
+
+#endif /* _ASM_ARMV8_CPU_H_ */
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * ARMv8 CRC32 instruction helpers
+ */
+
+#ifndef _ASM_ARMV8_CRC32_H_
+#define _ASM_ARMV8_CRC32_H_
+
+#include <linux/types.h>
+#include <asm/armv8/cpu.h>
+
+/**
+ * crc32_armv8_le() - CRC-32 (polynomial 0x04c11db7) using crc32x/w/h/b
+ *
+ * Like crc32_no_comp(), no one's complement is applied.
+ *
+ * @crc:	Previous crc value
+ * @p:		Data bytes to checksum, need not be aligned
+ * @len:	Number of bytes to process
+ * @return updated crc value
+ */
+uint32_t crc32_armv8_le(uint32_t crc, const uint8_t *p, size_t len);
+
+/**
+ * crc32c_armv8_le() - CRC-32C (polynomial 0x1edc6f41) using crc32cx/w/h/b
+ *
+ * @crc:	Previous crc value
+ * @p:		Data bytes to checksum, need not be aligned
+ * @len:	Number of bytes to process
+ * @return updated crc value
+ */
+uint32_t crc32c_armv8_le(uint32_t crc, const uint8_t *p, size_t len);
+
+static inline bool crc32_armv8_available(void)
+{
+	return ID_AA64ISAR0_FIELD(read_id_aa64isar0(),
+				  ID_AA64ISAR0_CRC32_SHIFT) != 0;
+}
+
+#endif /* _ASM_ARMV8_CRC32_H_ */
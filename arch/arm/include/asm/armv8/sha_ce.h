@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * ARMv8 Cryptography Extension SHA-1/SHA-256 block functions
+ */
+
+#ifndef _ASM_ARMV8_SHA_CE_H_
+#define _ASM_ARMV8_SHA_CE_H_
+
+#include <linux/types.h>
+#include <asm/armv8/cpu.h>
+
+/**
+ * sha1_ce_transform() - Process SHA-1 blocks using the crypto extension
+ *
+ * @state:	SHA-1 state words (5 entries), updated in place
+ * @data:	Input data, need not be aligned
+ * @blocks:	Number of 64-byte blocks to process, must be non-zero
+ */
+void sha1_ce_transform(uint32_t *state, const uint8_t *data, uint32_t blocks);
+
+/**
+ * sha256_ce_transform() - Process SHA-256 blocks using the crypto extension
+ *
+ * @state:	SHA-256 state words (8 entries), updated in place
+ * @data:	Input data, need not be aligned
+ * @blocks:	Number of 64-byte blocks to process, must be non-zero
+ */
+void sha256_ce_transform(uint32_t *state, const uint8_t *data,
+			 uint32_t blocks);
+
+static inline bool sha1_ce_available(void)
+{
+	return ID_AA64ISAR0_FIELD(read_id_aa64isar0(),
+				  ID_AA64ISAR0_SHA1_SHIFT) != 0;
+}
+
+static inline bool sha256_ce_available(void)
+{
+	return ID_AA64ISAR0_FIELD(read_id_aa64isar0(),
+				  ID_AA64ISAR0_SHA2_SHIFT) != 0;
+}
+
+#endif /* _ASM_ARMV8_SHA_CE_H_ */
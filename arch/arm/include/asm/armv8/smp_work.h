@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Secondary CPU start-up for running work items, see include/smp_work.h
+ */
+
+#ifndef _ASM_ARMV8_SMP_WORK_H_
+#define _ASM_ARMV8_SMP_WORK_H_
+
+/* Offsets into struct smp_work_cpu, used by smp_work_entry.S */
+#define SMP_WORK_CPU_STACK	0
+#define SMP_WORK_CPU_GD		8
+#define SMP_WORK_CPU_TTBR	16
+#define SMP_WORK_CPU_TCR	24
+#define SMP_WORK_CPU_MAIR	32
+#define SMP_WORK_CPU_VBAR	40
+#define SMP_WORK_CPU_SCTLR	48
+
+#ifndef __ASSEMBLY__
+#include <linux/types.h>
+
+/**
+ * struct smp_work_cpu - State for starting one secondary CPU
+ *
+ * The first fields are read by smp_work_entry.S with the MMU off, so this
+ * must be cleaned to the point of coherency before the CPU is started.
+ *
+ * @stack:	Initial stack pointer
+ * @gd:		Global data pointer of the boot CPU
+ * @ttbr:	Translation table base of the boot CPU
+ * @tcr:	Translation control register of the boot CPU
+ * @mair:	Memory attribute register of the boot CPU
+ * @vbar:	Exception vector base of the boot CPU
+ * @sctlr:	System control register of the boot CPU (MMU and caches on)
+ * @mpidr:	Affinity of this CPU, as passed to PSCI
+ * @entry:	Function to run
+ * @arg:	Argument for @entry
+ * @done:	Set by the CPU when @entry has returned
+ * @stack_base:	Allocated stack
+ */
+struct smp_work_cpu {
+	u64 stack;
+	u64 gd;
+	u64 ttbr;
+	u64 tcr;
+	u64 mair;
+	u64 vbar;
+	u64 sctlr;
+	u64 mpidr;
+	void (*entry)(void *arg);
+	void *arg;
+	u32 done;
+	void *stack_base;
+};
+
+void smp_work_secondary_entry(void);
+void __noreturn smp_work_secondary_main(struct smp_work_cpu *cpu);
+#endif
+
+#endif /* _ASM_ARMV8_SMP_WORK_H_ */
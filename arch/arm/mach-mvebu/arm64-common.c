@@ -17,6 +17,7 @@
 #include <asm/arch/cpu.h>
 #include <asm/arch/soc.h>
 #include <asm/armv8/mmu.h>
+#include <dm/probe-queue.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -101,11 +102,15 @@ int arch_early_init_r(void)
 	}
 
 	/* Cause the SATA device to do its early init */
-	uclass_first_device(UCLASS_AHCI, &dev);
+	if (!dm_probe_deferred(UCLASS_AHCI))
+		uclass_first_device(UCLASS_AHCI, &dev);
 
 #ifdef CONFIG_DM_PCI
-	/* Trigger PCIe devices detection */
-	pci_init();
+	/*
+	 * Trigger PCIe devices detection. The links train in the background
+	 * and the buses are scanned once the probe queue is flushed
+	 */
+	dm_probe_uclass(UCLASS_PCI);
 #endif
 
 	return 0;
@@ -12,6 +12,7 @@
 #include <linux/delay.h>
 #include <linux/libfdt.h>
 #include <os.h>
+#include <smp_work.h>
 #include <asm/io.h>
 #include <asm/malloc.h>
 #include <asm/setjmp.h>
@@ -344,3 +345,28 @@ ulong timer_get_boot_us(void)
 
 	return (count - base_count) / 1000;
 }
+
+#if CONFIG_IS_ENABLED(SMP_WORK)
+/* Number of emulated CPUs, each backed by a host thread */
+#define SANDBOX_SMP_CPUS	4
+
+int arch_smp_work_cpus(void)
+{
+	return SANDBOX_SMP_CPUS - 1;
+}
+
+int arch_smp_work_start(int idx, void (*entry)(void *arg), void *arg)
+{
+	return os_thread_start(idx, entry, arg);
+}
+
+int arch_smp_work_wait(int idx)
+{
+	return os_thread_join(idx);
+}
+
+bool arch_smp_work_is_secondary(void)
+{
+	return os_thread_is_secondary();
+}
+#endif
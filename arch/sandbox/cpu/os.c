@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -814,3 +815,55 @@ void *os_find_text_base(void)
 
 	return base;
 }
+
+/* Host threads standing in for secondary CPUs */
+#define OS_MAX_THREADS	64
+
+struct os_thread {
+	pthread_t thread;
+	void (*func)(void *arg);
+	void *arg;
+};
+
+static struct os_thread os_threads[OS_MAX_THREADS];
+static __thread bool os_thread_secondary;
+
+static void *os_thread_entry(void *arg)
+{
+	struct os_thread *thr = arg;
+
+	os_thread_secondary = true;
+	thr->func(thr->arg);
+
+	return NULL;
+}
+
+int os_thread_start(int idx, void (*func)(void *arg), void *arg)
+{
+	struct os_thread *thr;
+
+	if (idx < 0 || idx >= OS_MAX_THREADS)
+		return -EINVAL;
+	thr = &os_threads[idx];
+	thr->func = func;
+	thr->arg = arg;
+	if (pthread_create(&thr->thread, NULL, os_thread_entry, thr))
+		return -EAGAIN;
+
+	return 0;
+}
+
+int os_thread_join(int idx)
+{
+	if (idx < 0 || idx >= OS_MAX_THREADS)
+		return -EINVAL;
+	if (pthread_join(os_threads[idx].thread, NULL))
+		return -ESRCH;
+
+	return 0;
+}
+
+bool os_thread_is_secondary(void)
+{
+	return os_thread_secondary;
+}
@@ -18,32 +18,46 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "evictions: %u\n"
+	       "read-aheads: %u\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "entries/set: %u\n"
+	       "memory: %lu of %lu bytes\n",
+	       stats.hits, stats.misses, stats.evictions, stats.readaheads,
+	       stats.entries, stats.max_blocks_per_entry, stats.max_entries,
+	       stats.ways, stats.bytes, stats.max_bytes);
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
+	struct block_cache_stats stats;
 	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	ulong max_bytes;
+
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
+	blkcache_stats(&stats);
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	max_bytes = stats.max_bytes;
+	if (argc == 4)
+		max_bytes = simple_strtoul(argv[3], 0, 0);
+	blkcache_configure_size(blocks_per_entry, max_entries, max_bytes);
+
+	blkcache_stats(&stats);
+	printf("changed to max of %u entries of %u blocks each, %lu bytes\n",
+	       stats.max_entries, stats.max_blocks_per_entry, stats.max_bytes);
 	return 0;
 }
 
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -80,8 +94,8 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"blkcache configure blocks entries [bytes]\n"
 );
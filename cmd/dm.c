@@ -40,6 +40,14 @@ static int do_dm_dump_devres(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int do_dm_dump_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	dm_dump_stats();
+
+	return 0;
+}
+
 static int do_dm_dump_drivers(struct cmd_tbl *cmdtp, int flag, int argc,
 			      char *const argv[])
 {
@@ -71,6 +79,7 @@ static struct cmd_tbl test_commands[] = {
 	U_BOOT_CMD_MKENT(drivers, 1, 1, do_dm_dump_drivers, "", ""),
 	U_BOOT_CMD_MKENT(compat, 1, 1, do_dm_dump_driver_compat, "", ""),
 	U_BOOT_CMD_MKENT(static, 1, 1, do_dm_dump_static_driver_info, "", ""),
+	U_BOOT_CMD_MKENT(stats, 1, 1, do_dm_dump_stats, "", ""),
 };
 
 static __maybe_unused void dm_reloc(void)
@@ -114,5 +123,6 @@ U_BOOT_CMD(
 	"dm devres        Dump list of device resources for each device\n"
 	"dm drivers       Dump list of drivers with uclass and instances\n"
 	"dm compat        Dump list of drivers with compatibility strings\n"
-	"dm static        Dump list of drivers with static platform data"
+	"dm static        Dump list of drivers with static platform data\n"
+	"dm stats         Dump lookup statistics of the uclass indexes"
 );
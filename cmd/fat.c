@@ -9,6 +9,7 @@
  */
 #include <common.h>
 #include <command.h>
+#include <env.h>
 #include <mapmem.h>
 #include <fat.h>
 #include <fs.h>
@@ -68,9 +69,10 @@ static int do_fat_fsinfo(struct cmd_tbl *cmdtp, int flag, int argc,
 	int dev, part;
 	struct blk_desc *dev_desc;
 	struct disk_partition info;
+	int ret;
 
 	if (argc < 2) {
-		printf("usage: fatinfo <interface> [<dev[:part]>]\n");
+		printf("usage: fatinfo <interface> [<dev[:part]> [<filename>]]\n");
 		return 0;
 	}
 
@@ -84,14 +86,27 @@ static int do_fat_fsinfo(struct cmd_tbl *cmdtp, int flag, int argc,
 			argv[1], dev, part);
 		return 1;
 	}
-	return file_fat_detectfs();
+	if (argc < 4)
+		return file_fat_detectfs();
+
+	ret = fat_extents(argv[3]);
+	if (ret < 0) {
+		printf("** Unable to map \"%s\" **\n", argv[3]);
+		return 1;
+	}
+	printf("%d extent(s)\n", ret);
+	env_set_ulong("fileextents", ret);
+
+	return 0;
 }
 
 U_BOOT_CMD(
-	fatinfo,	3,	1,	do_fat_fsinfo,
+	fatinfo,	4,	1,	do_fat_fsinfo,
 	"print information about filesystem",
-	"<interface> [<dev[:part]>]\n"
-	"    - print information about filesystem from 'dev' on 'interface'"
+	"<interface> [<dev[:part]> [<filename>]]\n"
+	"    - print information about filesystem from 'dev' on 'interface'\n"
+	"      or, given 'filename', list its runs of consecutive clusters\n"
+	"      and store their number in 'fileextents'"
 );
 
 #ifdef CONFIG_FAT_WRITE
@@ -13,6 +13,7 @@
 #include <command.h>
 #include <hash.h>
 #include <linux/ctype.h>
+#include <linux/sizes.h>
 
 static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 		   char *const argv[])
@@ -20,6 +21,17 @@ static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 	char *s;
 	int flags = HASH_FLAG_ENV;
 
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		ulong size = SZ_1M;
+
+		if (argc > 2)
+			size = simple_strtoul(argv[2], NULL, 16);
+		if (!size)
+			return CMD_RET_USAGE;
+
+		return hash_bench(size) ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+	}
+
 #ifdef CONFIG_HASH_VERIFY
 	if (argc < 4)
 		return CMD_RET_USAGE;
@@ -47,7 +59,10 @@ U_BOOT_CMD(
 	hash,	HARGS,	1,	do_hash,
 	"compute hash message digest",
 	"algorithm address count [[*]hash_dest]\n"
-		"    - compute message digest [save to env var / *address]"
+		"    - compute message digest [save to env var / *address]\n"
+	"hash bench [size]\n"
+		"    - report the throughput of each algorithm over a buffer\n"
+		"      of 'size' bytes (hex, default 100000)"
 #ifdef CONFIG_HASH_VERIFY
 	"\nhash -v algorithm address count [*]hash\n"
 		"    - verify message digest of memory area to immediate value, \n"
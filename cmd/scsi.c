@@ -10,6 +10,7 @@
 #include <common.h>
 #include <blk.h>
 #include <command.h>
+#include <dm.h>
 #include <scsi.h>
 
 static int scsi_curr_dev; /* current device */
@@ -48,6 +49,20 @@ static int do_scsi(struct cmd_tbl *cmdtp, int flag, int argc,
 				return CMD_RET_FAILURE;
 			return ret;
 		}
+#ifdef CONFIG_DM_SCSI
+		if (strncmp(argv[1], "inf", 3) == 0) {
+			struct udevice *bus;
+			struct uclass *uc;
+
+			ret = blk_common_cmd(argc, argv, IF_TYPE_SCSI,
+					     &scsi_curr_dev);
+			uclass_id_foreach_dev(UCLASS_SCSI, bus, uc) {
+				if (device_active(bus))
+					scsi_show_stats(bus);
+			}
+			return ret;
+		}
+#endif
 	}
 
 	return blk_common_cmd(argc, argv, IF_TYPE_SCSI, &scsi_curr_dev);
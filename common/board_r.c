@@ -64,6 +64,7 @@
 #include <asm/mmu.h>
 #endif
 #include <asm/sections.h>
+#include <dm/probe-queue.h>
 #include <dm/root.h>
 #include <linux/compiler.h>
 #include <linux/err.h>
@@ -243,7 +244,7 @@ static int initr_pci_ep(void)
 #ifdef CONFIG_PCI
 static int initr_pci(void)
 {
-	if (IS_ENABLED(CONFIG_PCI_INIT_R))
+	if (IS_ENABLED(CONFIG_PCI_INIT_R) && !dm_probe_deferred(UCLASS_PCI))
 		pci_init();
 
 	return 0;
@@ -659,6 +660,19 @@ int initr_mem(void)
 }
 #endif
 
+#ifdef CONFIG_DM_PROBE_QUEUE
+static int initr_probe_queue(void)
+{
+	/*
+	 * Finish probing the devices which were started in the background,
+	 * before anything looks for the devices found through them
+	 */
+	dm_probe_queue_flush();
+
+	return 0;
+}
+#endif
+
 static int run_main_loop(void)
 {
 #ifdef CONFIG_SANDBOX
@@ -804,6 +818,9 @@ static init_fnc_t init_sequence_r[] = {
 	 * Do pci configuration
 	 */
 	initr_pci,
+#endif
+#ifdef CONFIG_DM_PROBE_QUEUE
+	initr_probe_queue,
 #endif
 	stdio_add_devices,
 	initr_jumptable,
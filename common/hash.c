@@ -12,6 +12,7 @@
 #ifndef USE_HOSTCC
 #include <common.h>
 #include <command.h>
+#include <console.h>
 #include <env.h>
 #include <log.h>
 #include <malloc.h>
@@ -19,6 +20,8 @@
 #include <hw_sha.h>
 #include <asm/cache.h>
 #include <asm/io.h>
+#include <div64.h>
+#include <time.h>
 #include <linux/errno.h>
 #include <u-boot/crc.h>
 #else
@@ -615,4 +618,53 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 	return 0;
 }
 #endif /* CONFIG_CMD_HASH || CONFIG_CMD_SHA1SUM || CONFIG_CMD_CRC32) */
+
+#ifdef CONFIG_CMD_HASH
+/* Keep each algorithm running for at least this long to get stable figures */
+#define HASH_BENCH_MIN_US	200000
+
+int hash_bench(ulong size)
+{
+	uint8_t output[HASH_MAX_DIGEST_SIZE];
+	unsigned long start, elapsed;
+	u64 bytes;
+	uint8_t *buf;
+	int i;
+
+	reloc_update();
+
+	buf = malloc(size);
+	if (!buf) {
+		printf("Cannot allocate %#lx bytes\n", size);
+		return -ENOMEM;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	printf("%-12s %10s %10s %10s\n", "algorithm", "bytes", "time (us)",
+	       "KiB/s");
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		struct hash_algo *algo = &hash_algo[i];
+
+		start = timer_get_us();
+		bytes = 0;
+		for (;;) {
+			algo->hash_func_ws(buf, size, output, algo->chunk_size);
+			bytes += size;
+			elapsed = timer_get_us() - start;
+			if (elapsed >= HASH_BENCH_MIN_US)
+				break;
+			if (ctrlc()) {
+				free(buf);
+				return -EINTR;
+			}
+		}
+		printf("%-12s %10llu %10lu %10llu\n", algo->name, bytes,
+		       elapsed, lldiv(bytes * 1000000 / 1024, elapsed ? : 1));
+	}
+	free(buf);
+
+	return 0;
+}
+#endif /* CONFIG_CMD_HASH */
 #endif /* !USE_HOSTCC */
@@ -0,0 +1,503 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompressing images on several CPUs
+ *
+ * Some compressed formats are made of pieces which can be decoded without
+ * reference to each other and whose uncompressed size (and so their place in
+ * the output) is known up front. Such images are split into those pieces and
+ * decoded with smp_work_run(). Anything else is left for the serial code in
+ * image_decomp().
+ */
+
+#include <common.h>
+#include <image.h>
+#include <log.h>
+#include <lz4.h>
+#include <malloc.h>
+#include <smp_work.h>
+#include <u-boot/zlib.h>
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
+
+/* Number of jobs to create for each CPU, to even out the load */
+#define DECOMP_JOBS_PER_CPU	3
+
+/* Scratch memory for inflate: its state and a 32KB window */
+#define DECOMP_INFLATE_SCRATCH	SZ_64K
+
+#define LZ4F_BLOCKUNCOMPRESSED_FLAG	0x80000000U
+
+/* gzip header flags */
+#define GZ_FTEXT	0x01
+#define GZ_FEXTRA	0x04
+#define GZ_HDR_LEN	10
+#define GZ_TRAILER_LEN	8
+
+/**
+ * struct decomp_chunk - An independently decodable piece of an image
+ *
+ * @src:	Compressed data (raw block contents, without any header)
+ * @src_len:	Length of compressed data
+ * @dst:	Place to write the uncompressed data
+ * @dst_len:	Expected (LZ4: maximum) length of uncompressed data
+ * @out_len:	Number of bytes actually produced
+ * @stored:	true if @src is stored uncompressed (LZ4 only)
+ */
+struct decomp_chunk {
+	const void *src;
+	size_t src_len;
+	void *dst;
+	size_t dst_len;
+	size_t out_len;
+	bool stored;
+};
+
+/**
+ * struct decomp_scratch - Scratch memory for one decompressor
+ *
+ * There is one of these for each CPU, since no more jobs than that run at
+ * the same time.
+ *
+ * @buf:	Scratch memory
+ * @size:	Size of @buf
+ * @used:	Bytes of @buf handed out so far (gzip only)
+ * @busy:	true while a job is using this scratch
+ */
+struct decomp_scratch {
+	void *buf;
+	size_t size;
+	size_t used;
+	bool busy;
+};
+
+/**
+ * struct decomp_job - A run of chunks handled by one work item
+ *
+ * @comp:	Compression type (IH_COMP_...)
+ * @chunk:	First chunk to decode
+ * @count:	Number of chunks
+ * @pool:	Scratch memory shared by all jobs, one per CPU
+ * @pool_size:	Number of entries in @pool
+ * @scratch:	Entry of @pool claimed by this job while it runs
+ */
+struct decomp_job {
+	int comp;
+	struct decomp_chunk *chunk;
+	int count;
+	struct decomp_scratch *pool;
+	int pool_size;
+	struct decomp_scratch *scratch;
+};
+
+/*
+ * Each splitter fills in @chunk (if not NULL) and returns the number of
+ * chunks, or -ENOSYS if the image cannot be split
+ */
+
+#ifdef CONFIG_LZ4
+static int decomp_split_lz4(const u8 *buf, ulong len, u8 *dst, ulong unc_len,
+			    struct decomp_chunk *chunk)
+{
+	const u8 *end = buf + len;
+	const u8 *in = buf;
+	bool has_block_checksum;
+	size_t block_max;
+	u8 flags, bd;
+	int count;
+
+	if (len < 7 || get_unaligned_le32(in) != LZ4F_MAGIC)
+		return -ENOSYS;
+	flags = in[4];
+	bd = in[5];
+	/* Version 1 with independent blocks only */
+	if ((flags >> 6) != 1 || !(flags & 0x20) || (flags & 0x03) ||
+	    (bd & 0x8f))
+		return -ENOSYS;
+	has_block_checksum = flags & 0x10;
+	block_max = 1UL << (((bd >> 4) & 7) * 2 + 8);
+	in += 7;
+	if (flags & 0x08)
+		in += sizeof(u64);
+
+	for (count = 0;; count++) {
+		u32 header, size;
+
+		if (in + sizeof(u32) > end)
+			return -ENOSYS;
+		header = get_unaligned_le32(in);
+		in += sizeof(u32);
+		size = header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		if (!size)
+			break;
+		if (size > end - in || count * block_max >= unc_len)
+			return -ENOSYS;
+		if (chunk) {
+			chunk[count].src = in;
+			chunk[count].src_len = size;
+			chunk[count].dst = dst + count * block_max;
+			chunk[count].dst_len = min(block_max,
+						   unc_len - count * block_max);
+			chunk[count].stored = header &
+				LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		}
+		in += size;
+		if (has_block_checksum)
+			in += sizeof(u32);
+	}
+
+	return count;
+}
+#endif /* CONFIG_LZ4 */
+
+#ifdef CONFIG_ZSTD
+static int decomp_split_zstd(const u8 *buf, ulong len, u8 *dst, ulong unc_len,
+			     struct decomp_chunk *chunk)
+{
+	unsigned long long size;
+	ulong out = 0;
+	size_t frame;
+	int count;
+
+	for (count = 0; len; count++) {
+		frame = ZSTD_findFrameCompressedSize(buf, len);
+		if (ZSTD_isError(frame) || frame > len)
+			return -ENOSYS;
+		size = ZSTD_getFrameContentSize(buf, len);
+		if (size == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    size == ZSTD_CONTENTSIZE_ERROR || size > unc_len - out)
+			return -ENOSYS;
+		if (chunk) {
+			chunk[count].src = buf;
+			chunk[count].src_len = frame;
+			chunk[count].dst = dst + out;
+			chunk[count].dst_len = size;
+		}
+		buf += frame;
+		len -= frame;
+		out += size;
+	}
+
+	return count;
+}
+#endif /* CONFIG_ZSTD */
+
+#ifdef CONFIG_GZIP
+/*
+ * Only gzip members carrying their own length in a 'BC' extra subfield (as
+ * in BGZF) can be found without inflating everything before them
+ */
+static int decomp_split_gzip(const u8 *buf, ulong len, u8 *dst, ulong unc_len,
+			     struct decomp_chunk *chunk)
+{
+	ulong out = 0;
+	int count;
+
+	for (count = 0; len; count++) {
+		const u8 *extra, *extra_end;
+		ulong member = 0;
+		u32 size;
+
+		if (len < GZ_HDR_LEN + 2 || buf[0] != 0x1f || buf[1] != 0x8b ||
+		    buf[2] != Z_DEFLATED ||
+		    (buf[3] & ~GZ_FTEXT) != GZ_FEXTRA)
+			return -ENOSYS;
+		extra = buf + GZ_HDR_LEN + 2;
+		extra_end = extra + get_unaligned_le16(buf + GZ_HDR_LEN);
+		if (extra_end > buf + len)
+			return -ENOSYS;
+		while (extra + 4 <= extra_end) {
+			u16 slen = get_unaligned_le16(extra + 2);
+
+			if (extra[0] == 'B' && extra[1] == 'C' && slen == 2 &&
+			    extra + 6 <= extra_end) {
+				member = get_unaligned_le16(extra + 4) + 1;
+				break;
+			}
+			extra += 4 + slen;
+		}
+		if (member > len ||
+		    member < extra_end - buf + GZ_TRAILER_LEN)
+			return -ENOSYS;
+		size = get_unaligned_le32(buf + member - sizeof(u32));
+		if (size > unc_len - out)
+			return -ENOSYS;
+		if (chunk) {
+			chunk[count].src = extra_end;
+			chunk[count].src_len = buf + member - GZ_TRAILER_LEN -
+				extra_end;
+			chunk[count].dst = dst + out;
+			chunk[count].dst_len = size;
+		}
+		buf += member;
+		len -= member;
+		out += size;
+	}
+
+	return count;
+}
+
+static void *decomp_zalloc(void *opaque, unsigned int items,
+			   unsigned int size)
+{
+	struct decomp_scratch *scratch = opaque;
+	size_t bytes = ALIGN((size_t)items * size, sizeof(long));
+	void *ptr;
+
+	if (bytes > scratch->size - scratch->used)
+		return NULL;
+	ptr = scratch->buf + scratch->used;
+	scratch->used += bytes;
+
+	return ptr;
+}
+
+static void decomp_zfree(void *opaque, void *ptr, unsigned int nb)
+{
+}
+
+static int decomp_chunk_gzip(struct decomp_job *job, struct decomp_chunk *chunk)
+{
+	z_stream s;
+	int ret;
+
+	memset(&s, '\0', sizeof(s));
+	job->scratch->used = 0;
+	s.zalloc = decomp_zalloc;
+	s.zfree = decomp_zfree;
+	s.opaque = job->scratch;
+	ret = inflateInit2(&s, -MAX_WBITS);
+	if (ret != Z_OK)
+		return -ENOMEM;
+	s.next_in = (void *)chunk->src;
+	s.avail_in = chunk->src_len;
+	s.next_out = chunk->dst;
+	s.avail_out = chunk->dst_len;
+	ret = inflate(&s, Z_FINISH);
+	chunk->out_len = s.total_out;
+	inflateEnd(&s);
+
+	return ret == Z_STREAM_END ? 0 : -EIO;
+}
+#endif /* CONFIG_GZIP */
+
+static int decomp_chunk(struct decomp_job *job, struct decomp_chunk *chunk)
+{
+	switch (job->comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return decomp_chunk_gzip(job, chunk);
+#endif
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4: {
+		int len;
+
+		if (chunk->stored) {
+			if (chunk->src_len > chunk->dst_len)
+				return -ENOBUFS;
+			memcpy(chunk->dst, chunk->src, chunk->src_len);
+			chunk->out_len = chunk->src_len;
+			return 0;
+		}
+		len = ulz4_decompress_block(chunk->src, chunk->src_len,
+					    chunk->dst, chunk->dst_len);
+		if (len < 0)
+			return len;
+		chunk->out_len = len;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD: {
+		ZSTD_DCtx *dctx;
+		size_t ret;
+
+		dctx = ZSTD_initDCtx(job->scratch->buf, job->scratch->size);
+		if (!dctx)
+			return -ENOMEM;
+		ret = ZSTD_decompressDCtx(dctx, chunk->dst, chunk->dst_len,
+					  chunk->src, chunk->src_len);
+		if (ZSTD_isError(ret))
+			return -EIO;
+		chunk->out_len = ret;
+		return 0;
+	}
+#endif
+	}
+
+	return -ENOSYS;
+}
+
+/* Claim a free scratch; one is always free as each CPU runs one job */
+static struct decomp_scratch *decomp_get_scratch(struct decomp_job *job)
+{
+	int i;
+
+	for (i = 0; i < job->pool_size; i++) {
+		if (!__atomic_exchange_n(&job->pool[i].busy, true,
+					 __ATOMIC_ACQUIRE))
+			return &job->pool[i];
+	}
+
+	return NULL;
+}
+
+static int decomp_job_run(void *arg)
+{
+	struct decomp_job *job = arg;
+	int ret = 0;
+	int i;
+
+	job->scratch = decomp_get_scratch(job);
+	if (!job->scratch)
+		return -ENOMEM;
+	for (i = 0; i < job->count; i++) {
+		ret = decomp_chunk(job, &job->chunk[i]);
+		if (ret)
+			break;
+		if (job->chunk[i].out_len != job->chunk[i].dst_len &&
+		    job->comp != IH_COMP_LZ4) {
+			ret = -EIO;
+			break;
+		}
+	}
+	__atomic_store_n(&job->scratch->busy, false, __ATOMIC_RELEASE);
+
+	return ret;
+}
+
+static int decomp_split(int comp, const void *buf, ulong len, void *dst,
+			ulong unc_len, struct decomp_chunk *chunk)
+{
+	switch (comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return decomp_split_gzip(buf, len, dst, unc_len, chunk);
+#endif
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+		return decomp_split_lz4(buf, len, dst, unc_len, chunk);
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+		return decomp_split_zstd(buf, len, dst, unc_len, chunk);
+#endif
+	}
+
+	return -ENOSYS;
+}
+
+static size_t decomp_scratch_size(int comp)
+{
+	switch (comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return DECOMP_INFLATE_SCRATCH;
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+		return ZSTD_DCtxWorkspaceBound();
+#endif
+	}
+
+	return 0;
+}
+
+int image_decomp_parallel(int comp, void *load_buf, const void *image_buf,
+			  ulong image_len, ulong unc_len, ulong *out_len)
+{
+	struct decomp_chunk *chunk, *last;
+	struct decomp_scratch *pool;
+	struct decomp_job *job;
+	struct smp_work *work;
+	size_t scratch_size;
+	ulong size;
+	int count, njobs, cpus;
+	int ret, i;
+
+	cpus = smp_work_cpus();
+	if (cpus < 2)
+		return -ENOSYS;
+	count = decomp_split(comp, image_buf, image_len, load_buf, unc_len,
+			     NULL);
+	if (count < 2)
+		return -ENOSYS;
+
+	njobs = min(count, cpus * DECOMP_JOBS_PER_CPU);
+	cpus = min(cpus, njobs);
+	scratch_size = decomp_scratch_size(comp);
+	chunk = calloc(count, sizeof(*chunk));
+	job = calloc(njobs, sizeof(*job));
+	work = calloc(njobs, sizeof(*work));
+	pool = calloc(cpus, sizeof(*pool));
+	if (!chunk || !job || !work || !pool) {
+		ret = -ENOSYS;
+		goto out;
+	}
+	decomp_split(comp, image_buf, image_len, load_buf, unc_len, chunk);
+
+	/* In-place decompression needs the serial decoder */
+	last = &chunk[count - 1];
+	if (load_buf < image_buf + image_len &&
+	    image_buf < last->dst + last->dst_len) {
+		ret = -ENOSYS;
+		goto out;
+	}
+
+	for (i = 0; scratch_size && i < cpus; i++) {
+		pool[i].buf = malloc(scratch_size);
+		if (!pool[i].buf) {
+			ret = -ENOSYS;
+			goto out;
+		}
+		pool[i].size = scratch_size;
+	}
+
+	for (i = 0; i < njobs; i++) {
+		int first = i * count / njobs;
+
+		job[i].comp = comp;
+		job[i].chunk = &chunk[first];
+		job[i].count = (i + 1) * count / njobs - first;
+		job[i].pool = pool;
+		job[i].pool_size = cpus;
+		work[i].func = decomp_job_run;
+		work[i].arg = &job[i];
+	}
+
+	/*
+	 * Nothing has been changed outside the output buffer, so on any error
+	 * the serial decompressor can start again and report it properly
+	 */
+	ret = smp_work_run(work, njobs);
+	if (ret) {
+		log_debug("Parallel decompression failed: %d\n", ret);
+		ret = -ENOSYS;
+		goto out;
+	}
+
+	/* LZ4 blocks are placed assuming all but the last are full */
+	size = 0;
+	for (i = 0; i < count; i++) {
+		if (i != count - 1 && chunk[i].out_len != chunk[i].dst_len) {
+			ret = -ENOSYS;
+			goto out;
+		}
+		size += chunk[i].out_len;
+	}
+	*out_len = size;
+	log_debug("%d chunks in %d jobs, %lx bytes\n", count, njobs, size);
+
+out:
+	if (pool) {
+		for (i = 0; i < cpus; i++)
+			free(pool[i].buf);
+	}
+	free(pool);
+	free(work);
+	free(job);
+	free(chunk);
+
+	return ret;
+}
@@ -22,6 +22,7 @@
 #include <mapmem.h>
 #include <asm/io.h>
 #include <malloc.h>
+#include <watchdog.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
@@ -1225,8 +1226,135 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+#if defined(USE_HOSTCC)
+#define FIT_STREAM_HASH		0
+#elif defined(CONFIG_SPL_BUILD)
+#define FIT_STREAM_HASH		CONFIG_IS_ENABLED(HASH_SUPPORT)
+#else
+#define FIT_STREAM_HASH		IS_ENABLED(CONFIG_HASH)
+#endif
+
+int fit_image_hash_start(struct fit_hash_stream *st, const void *fit,
+			 int image_noffset, size_t size)
+{
+#if FIT_STREAM_HASH
+	int noffset, ignore, ret;
+	char *algo;
+
+	memset(st, '\0', sizeof(*st));
+	st->total = size;
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+		typeof(st->hash[0]) *hash = &st->hash[st->count];
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (st->count == FIT_MAX_STREAM_HASHES) {
+			ret = -ENOSYS;
+			goto err;
+		}
+		hash->noffset = noffset;
+		st->count++;
+
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore) {
+				hash->ignore = true;
+				continue;
+			}
+		}
+		if (fit_image_hash_get_algo(fit, noffset, &algo)) {
+			ret = -EINVAL;
+			goto err;
+		}
+		if (hash_progressive_lookup_algo(algo, &hash->algo)) {
+			ret = -ENOSYS;
+			goto err;
+		}
+		ret = hash->algo->hash_init(hash->algo, &hash->ctx);
+		if (ret) {
+			hash->ctx = NULL;
+			goto err;
+		}
+	}
+
+	return 0;
+err:
+	fit_image_hash_finish(st);
+	st->count = 0;
+
+	return ret;
+#else
+	return -ENOSYS;
+#endif
+}
+
+int fit_image_hash_update(struct fit_hash_stream *st, const void *data,
+			  size_t size)
+{
+#if FIT_STREAM_HASH
+	int i, ret;
+
+	while (size) {
+		size_t chunk = min_t(size_t, size, CHUNKSZ);
+		int is_last = st->size + chunk >= st->total;
+
+		for (i = 0; i < st->count; i++) {
+			struct hash_algo *algo = st->hash[i].algo;
+
+			if (!st->hash[i].ctx)
+				continue;
+			ret = algo->hash_update(algo, st->hash[i].ctx, data,
+						chunk, is_last);
+			if (ret)
+				return ret;
+		}
+		WATCHDOG_RESET();
+		data += chunk;
+		size -= chunk;
+		st->size += chunk;
+	}
+
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+int fit_image_hash_finish(struct fit_hash_stream *st)
+{
+#if FIT_STREAM_HASH
+	int i, ret = 0;
+
+	for (i = 0; i < st->count; i++) {
+		typeof(st->hash[0]) *hash = &st->hash[i];
+
+		if (!hash->ctx)
+			continue;
+		/* this frees the context, even on error */
+		if (hash->algo->hash_finish(hash->algo, hash->ctx, hash->value,
+					    sizeof(hash->value)))
+			ret = -EINVAL;
+		hash->ctx = NULL;
+		hash->value_len = hash->algo->digest_size;
+		/* match calculate_hash(), which stores CRCs big-endian */
+		if (!strcmp(hash->algo->name, "crc32"))
+			*(uint32_t *)hash->value =
+				cpu_to_uimage(*(uint32_t *)hash->value);
+	}
+	if (st->size != st->total)
+		ret = -EIO;
+
+	return ret;
+#else
+	return -ENOSYS;
+#endif
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, struct fit_hash_stream *st,
+				char **err_msgp)
 {
 	uint8_t value[FIT_MAX_HASH_LEN];
 	int value_len;
@@ -1234,6 +1362,7 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	uint8_t *fit_value;
 	int fit_value_len;
 	int ignore;
+	int i;
 
 	*err_msgp = NULL;
 
@@ -1257,7 +1386,18 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (st) {
+		for (i = 0; i < st->count; i++) {
+			if (st->hash[i].noffset == noffset)
+				break;
+		}
+		if (i == st->count || !st->hash[i].value_len) {
+			*err_msgp = "Hash value not calculated";
+			return -1;
+		}
+		memcpy(value, st->hash[i].value, st->hash[i].value_len);
+		value_len = st->hash[i].value_len;
+	} else if (calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1275,6 +1415,13 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 
 int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *data, size_t size)
+{
+	return fit_image_verify_streamed(fit, image_noffset, data, size, NULL);
+}
+
+int fit_image_verify_streamed(const void *fit, int image_noffset,
+			      const void *data, size_t size,
+			      struct fit_hash_stream *st)
 {
 	int		noffset = 0;
 	char		*err_msg = "";
@@ -1300,7 +1447,7 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		 */
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
-			if (fit_image_check_hash(fit, noffset, data, size,
+			if (fit_image_check_hash(fit, noffset, data, size, st,
 						 &err_msg))
 				goto error;
 			puts("+ ");
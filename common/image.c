@@ -446,6 +446,20 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 	*load_end = load;
 	print_decomp_msg(comp, type, load == image_start);
 
+#ifndef USE_HOSTCC
+	if (CONFIG_IS_ENABLED(IMAGE_DECOMP_PARALLEL) && comp != IH_COMP_NONE) {
+		ulong size;
+
+		ret = image_decomp_parallel(comp, load_buf, image_buf,
+					    image_len, unc_len, &size);
+		if (!ret) {
+			*load_end = load + size;
+			return 0;
+		}
+		ret = 0;
+	}
+#endif
+
 	/*
 	 * Load the image to the right place, decompressing if needed. After
 	 * this, image_len will be set to the number of uncompressed bytes
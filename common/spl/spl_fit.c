@@ -5,8 +5,10 @@
  */
 
 #include <common.h>
+#include <div64.h>
 #include <errno.h>
 #include <board.h>
+#include <bootstage.h>
 #include <fpga.h>
 #include <gzip.h>
 #include <image.h>
@@ -26,6 +28,9 @@ DECLARE_GLOBAL_DATA_PTR;
 #define CONFIG_SYS_BOOTM_LEN	(64 << 20)
 #endif
 
+/* Amount of image data read at once when it is hashed while loading */
+#define SPL_FIT_HASH_CHUNK	(64 * 1024)
+
 __weak void board_spl_fit_post_load(ulong load_addr, size_t length)
 {
 }
@@ -219,6 +224,66 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+/**
+ * spl_fit_read_data() - read the external data of an image
+ *
+ * If @st is not NULL the data is read in pieces of SPL_FIT_HASH_CHUNK, and
+ * each piece is hashed straight after it is read, while it is still in the
+ * cache, so that the hashes are ready as soon as the last byte arrives.
+ *
+ * @info:	Device to read from
+ * @sector:	First sector to read
+ * @nr_sectors:	Number of sectors to read
+ * @buf:	Buffer to read into
+ * @overhead:	Offset of the image data in @buf
+ * @length:	Size of the image data
+ * @st:		Hashes to update, or NULL
+ * Return:	0 on success or a negative error number.
+ */
+static int spl_fit_read_data(struct spl_load_info *info, ulong sector,
+			     int nr_sectors, void *buf, ulong overhead,
+			     size_t length, struct fit_hash_stream *st)
+{
+	ulong unit = info->filename ? 1 : info->bl_len;
+	ulong chunk = nr_sectors, done = 0;
+	ulong read_us = 0, hash_us = 0;
+	size_t hashed = 0, avail;
+	int ret;
+
+	if (st)
+		chunk = max(SPL_FIT_HASH_CHUNK / unit, 1UL);
+
+	while (done < nr_sectors) {
+		ulong count = min(chunk, nr_sectors - done);
+
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_READ, "fit_read");
+		if (info->read(info, sector + done, count,
+			       buf + done * unit) != count)
+			return -EIO;
+		read_us += bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_READ);
+		done += count;
+		if (!st || done * unit <= overhead)
+			continue;
+
+		avail = min_t(size_t, done * unit - overhead, length);
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_HASH, "fit_hash");
+		ret = fit_image_hash_update(st, buf + overhead + hashed,
+					    avail - hashed);
+		hash_us += bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_HASH);
+		if (ret)
+			return ret;
+		hashed = avail;
+	}
+	if (read_us)
+		debug("Read %lu bytes at %llu bytes/s\n", done * unit,
+		      lldiv((u64)done * unit * 1000000, read_us));
+	if (hash_us)
+		debug("Hashed %lu bytes at %llu bytes/s\n", (ulong)hashed,
+		      lldiv((u64)hashed * 1000000, hash_us));
+
+	return 0;
+}
+
 /**
  * spl_load_fit_image(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -252,6 +317,8 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	uint8_t image_comp = -1, type = -1;
 	const void *data;
 	bool external_data = false;
+	struct fit_hash_stream stream, *st = NULL;
+	int ret;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA_SUPPORT) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && IS_ENABLED(CONFIG_SPL_GZIP))) {
@@ -287,10 +354,18 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		overhead = get_aligned_image_overhead(info, offset);
 		nr_sectors = get_aligned_image_size(info, length, offset);
 
-		if (info->read(info,
-			       sector + get_aligned_image_offset(info, offset),
-			       nr_sectors, (void *)load_ptr) != nr_sectors)
-			return -EIO;
+		if (IS_ENABLED(CONFIG_SPL_FIT_SIGNATURE) &&
+		    !fit_image_hash_start(&stream, fit, node, length))
+			st = &stream;
+		ret = spl_fit_read_data(info,
+					sector + get_aligned_image_offset(info,
+									  offset),
+					nr_sectors, (void *)load_ptr, overhead,
+					length, st);
+		if (st && fit_image_hash_finish(st) && !ret)
+			ret = -EIO;
+		if (ret)
+			return ret;
 
 		debug("External data: dst=%lx, offset=%x, size=%lx\n",
 		      load_ptr, offset, (unsigned long)length);
@@ -309,8 +384,7 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 #ifdef CONFIG_SPL_FIT_SIGNATURE
 	printf("## Checking hash(es) for Image %s ... ",
 	       fit_get_name(fit, node, NULL));
-	if (!fit_image_verify_with_data(fit, node,
-					 src, length))
+	if (!fit_image_verify_streamed(fit, node, src, length, st))
 		return -EPERM;
 	puts("OK\n");
 #endif
@@ -26,7 +26,9 @@
 #include <pci.h>
 #include <scsi.h>
 #include <libata.h>
+#include <time.h>
 #include <linux/ctype.h>
+#include <linux/math64.h>
 #include <ahci.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -60,6 +62,12 @@ struct ahci_uc_priv *probe_ent = NULL;
 #define WAIT_MS_LINKUP	200
 
 #define AHCI_CAP_S64A BIT(31)
+#define AHCI_CAP_SNCQ BIT(30)
+#define AHCI_CAP_NCS(cap) ((((cap) >> 8) & 0x1f) + 1)
+
+/* Scatter-gather entries in the command table of each queued command */
+#define AHCI_NCQ_SG		8
+#define AHCI_NCQ_TBL_SZ		(AHCI_CMD_TBL_HDR + AHCI_NCQ_SG * 16)
 
 __weak void __iomem *ahci_port_base(void __iomem *base, u32 port)
 {
@@ -499,16 +507,14 @@ static int ahci_init_one(struct ahci_uc_priv *uc_priv, pci_dev_t dev)
 
 #define MAX_DATA_BYTE_COUNT  (4*1024*1024)
 
-static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
-			unsigned char *buf, int buf_len)
+static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, struct ahci_sg *ahci_sg,
+			int max_sg, unsigned char *buf, int buf_len)
 {
-	struct ahci_ioports *pp = &(uc_priv->port[port]);
-	struct ahci_sg *ahci_sg = pp->cmd_tbl_sg;
 	u32 sg_count;
 	int i;
 
 	sg_count = ((buf_len - 1) / MAX_DATA_BYTE_COUNT) + 1;
-	if (sg_count > AHCI_MAX_SG) {
+	if (sg_count > max_sg) {
 		printf("Error:Too much sg!\n");
 		return -1;
 	}
@@ -535,17 +541,22 @@ static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
 }
 
 
-static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+static void ahci_fill_cmd_hdr(struct ahci_cmd_hdr *cmd_hdr, ulong tbl,
+			      u32 opts)
 {
-	pp->cmd_slot->opts = cpu_to_le32(opts);
-	pp->cmd_slot->status = 0;
-	pp->cmd_slot->tbl_addr = cpu_to_le32((u32)pp->cmd_tbl & 0xffffffff);
+	cmd_hdr->opts = cpu_to_le32(opts);
+	cmd_hdr->status = 0;
+	cmd_hdr->tbl_addr = cpu_to_le32((u32)tbl & 0xffffffff);
 #ifdef CONFIG_PHYS_64BIT
-	pp->cmd_slot->tbl_addr_hi =
-	    cpu_to_le32((u32)(((pp->cmd_tbl) >> 16) >> 16));
+	cmd_hdr->tbl_addr_hi = cpu_to_le32((u32)((tbl >> 16) >> 16));
 #endif
 }
 
+static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+{
+	ahci_fill_cmd_hdr(pp->cmd_slot, pp->cmd_tbl, opts);
+}
+
 static int wait_spinup(void __iomem *port_mmio)
 {
 	ulong start;
@@ -684,7 +695,8 @@ static int ahci_device_data_io(struct ahci_uc_priv *uc_priv, u8 port, u8 *fis,
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(uc_priv, port, buf, buf_len);
+	sg_count = ahci_fill_sg(uc_priv, pp->cmd_tbl_sg, AHCI_MAX_SG, buf,
+				buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
 	ahci_fill_cmd_slot(pp, opts);
 
@@ -706,6 +718,194 @@ static int ahci_device_data_io(struct ahci_uc_priv *uc_priv, u8 port, u8 *fis,
 	return 0;
 }
 
+/*
+ * Set up native command queuing on a port if both the controller and the
+ * device support it. The command tables of the queued commands are allocated
+ * once and reused for every request.
+ */
+static void ahci_ncq_init(struct ahci_uc_priv *uc_priv, u8 port)
+{
+	struct ahci_ioports *pp = &(uc_priv->port[port]);
+	u16 *id = uc_priv->ataid[port];
+	u32 depth;
+
+	if (!(uc_priv->cap & AHCI_CAP_SNCQ) || !ata_id_has_ncq(id))
+		return;
+
+	depth = min_t(u32, ata_id_queue_depth(id), AHCI_CAP_NCS(uc_priv->cap));
+	if (depth < 2)
+		return;
+
+	if (!pp->ncq_tbl) {
+		pp->ncq_tbl = memalign(128, AHCI_MAX_CMD_SLOT * AHCI_NCQ_TBL_SZ);
+		if (!pp->ncq_tbl)
+			return;
+		memset(pp->ncq_tbl, 0, AHCI_MAX_CMD_SLOT * AHCI_NCQ_TBL_SZ);
+	}
+
+	pp->ncq_depth = depth;
+	debug("scsi_ahci: port %d queues %u commands\n", port, depth);
+}
+
+static int ahci_ncq_issue(struct ahci_uc_priv *uc_priv, u8 port, int tag,
+			  lbaint_t lba, u32 blocks, u8 *buf, u8 is_write)
+{
+	struct ahci_ioports *pp = &(uc_priv->port[port]);
+	void __iomem *port_mmio = pp->port_mmio;
+	ulong tbl = (ulong)pp->ncq_tbl + tag * AHCI_NCQ_TBL_SZ;
+	u8 *fis = (u8 *)tbl;
+	int sg_count;
+
+	memset(fis, 0, 20);
+	fis[0] = 0x27;		 /* Host to device FIS. */
+	fis[1] = 1 << 7;	 /* Command FIS. */
+	fis[2] = is_write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+	fis[3] = (blocks >> 0) & 0xff;	/* features: sector count */
+	fis[4] = (lba >> 0) & 0xff;
+	fis[5] = (lba >> 8) & 0xff;
+	fis[6] = (lba >> 16) & 0xff;
+	fis[7] = 1 << 6; /* device reg: set LBA mode */
+	fis[8] = ((lba >> 24) & 0xff);
+#ifdef CONFIG_SYS_64BIT_LBA
+	fis[9] = ((lba >> 32) & 0xff);
+	fis[10] = ((lba >> 40) & 0xff);
+#endif
+	fis[11] = (blocks >> 8) & 0xff;
+	fis[12] = tag << 3;	/* sector count: command tag */
+
+	sg_count = ahci_fill_sg(uc_priv,
+				(struct ahci_sg *)(tbl + AHCI_CMD_TBL_HDR),
+				AHCI_NCQ_SG, buf, blocks * ATA_SECT_SIZE);
+	if (sg_count < 0)
+		return -EIO;
+
+	ahci_fill_cmd_hdr(&pp->cmd_slot[tag], tbl,
+			  5 | (sg_count << 16) | (is_write << 6));
+
+	ahci_dcache_flush_range(tbl, AHCI_NCQ_TBL_SZ);
+	ahci_dcache_flush_range((unsigned long)pp->cmd_slot,
+				AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT);
+
+	writel(1 << tag, port_mmio + PORT_SCR_ACT);
+	writel_with_flush(1 << tag, port_mmio + PORT_CMD_ISSUE);
+
+	return 0;
+}
+
+/*
+ * Read or write using queued commands, keeping every slot busy until the
+ * whole request is issued.
+ */
+static int ahci_ncq_read_write(struct ahci_uc_priv *uc_priv, u8 port,
+			       lbaint_t lba, u32 blocks, u8 *buf, u8 is_write)
+{
+	struct ahci_ioports *pp = &(uc_priv->port[port]);
+	void __iomem *port_mmio = pp->port_mmio;
+	u32 len = blocks * ATA_SECT_SIZE;
+	u32 issued = 0, busy, now_blocks, queued;
+	u8 *user_buffer = buf;
+	ulong start;
+	int tag;
+
+	ahci_dcache_flush_range((unsigned long)buf, len);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	start = get_timer(0);
+	while (blocks || issued) {
+		for (tag = 0; blocks && tag < pp->ncq_depth; tag++) {
+			if (issued & (1 << tag))
+				continue;
+
+			now_blocks = min_t(u32, MAX_SATA_BLOCKS_READ_WRITE,
+					   blocks);
+			now_blocks = min_t(u32, now_blocks,
+					   AHCI_NCQ_SG * MAX_DATA_BYTE_COUNT /
+					   ATA_SECT_SIZE);
+			if (ahci_ncq_issue(uc_priv, port, tag, lba, now_blocks,
+					   user_buffer, is_write))
+				return -EIO;
+
+			issued |= 1 << tag;
+			user_buffer += now_blocks * ATA_SECT_SIZE;
+			blocks -= now_blocks;
+			lba += now_blocks;
+		}
+
+		queued = hweight32(issued);
+		if (queued > pp->max_queued)
+			pp->max_queued = queued;
+
+		if (readl(port_mmio + PORT_IRQ_STAT) & (PORT_IRQ_FATAL)) {
+			debug("scsi_ahci: queued command failed, TFD %x\n",
+			      readl(port_mmio + PORT_TFDATA));
+			return -EIO;
+		}
+
+		/* Commands are done once neither issued nor active */
+		busy = readl(port_mmio + PORT_SCR_ACT) |
+		       readl(port_mmio + PORT_CMD_ISSUE);
+		if (issued & ~busy) {
+			issued &= busy;
+			start = get_timer(0);
+		} else if (get_timer(start) > WAIT_MS_DATAIO) {
+			printf("timeout exit!\n");
+			return -EIO;
+		}
+	}
+
+	ahci_dcache_invalidate_range((unsigned long)buf, len);
+
+	return 0;
+}
+
+/*
+ * After a failed queued command the device only accepts READ LOG EXT of the
+ * NCQ error log. Restart the port, read the log and stop queuing commands.
+ */
+static void ahci_ncq_recover(struct ahci_uc_priv *uc_priv, u8 port)
+{
+	struct ahci_ioports *pp = &(uc_priv->port[port]);
+	void __iomem *port_mmio = pp->port_mmio;
+	ALLOC_CACHE_ALIGN_BUFFER(u8, log, ATA_SECT_SIZE);
+	u32 cmd, tf_data;
+	ulong start;
+	u8 fis[20];
+
+	pp->ncq_depth = 0;
+
+	/* Stopping the port clears the issued and active commands */
+	cmd = readl(port_mmio + PORT_CMD);
+	writel_with_flush(cmd & ~PORT_CMD_START, port_mmio + PORT_CMD);
+	waiting_for_cmd_completed(port_mmio + PORT_CMD, 500, PORT_CMD_LIST_ON);
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	/* The device must be idle before the port is started again */
+	start = get_timer(0);
+	do {
+		tf_data = readl(port_mmio + PORT_TFDATA);
+	} while ((tf_data & (ATA_BUSY | ATA_DRQ)) &&
+		 get_timer(start) < WAIT_MS_DATAIO);
+	writel_with_flush(cmd | PORT_CMD_START, port_mmio + PORT_CMD);
+	if (tf_data & (ATA_BUSY | ATA_DRQ)) {
+		debug("scsi_ahci: port %d still busy after NCQ error\n", port);
+		return;
+	}
+
+	memset(fis, 0, sizeof(fis));
+	fis[0] = 0x27;		 /* Host to device FIS. */
+	fis[1] = 1 << 7;	 /* Command FIS. */
+	fis[2] = ATA_CMD_READ_LOG_EXT;
+	fis[4] = ATA_LOG_SATA_NCQ;
+	fis[7] = 1 << 6;
+	fis[12] = 1;		/* one sector */
+
+	if (ahci_device_data_io(uc_priv, port, fis, sizeof(fis), log,
+				ATA_SECT_SIZE, 0))
+		debug("scsi_ahci: cannot read NCQ error log on port %d\n",
+		      port);
+}
+
 
 static char *ata_id_strcpy(u16 *target, u16 *src, int len)
 {
@@ -768,6 +968,8 @@ static int ata_scsiop_inquiry(struct ahci_uc_priv *uc_priv,
 
 	memcpy(idbuf, tmpid, ATA_ID_WORDS * 2);
 	ata_swap_buf_le16(idbuf, ATA_ID_WORDS);
+	if (IS_ENABLED(CONFIG_AHCI_NCQ))
+		ahci_ncq_init(uc_priv, port);
 
 	memcpy(&pccb->pdata[8], "ATA     ", 8);
 	ata_id_strcpy((u16 *)&pccb->pdata[16], &idbuf[ATA_ID_PROD], 16);
@@ -786,11 +988,13 @@ static int ata_scsiop_inquiry(struct ahci_uc_priv *uc_priv,
 static int ata_scsiop_read_write(struct ahci_uc_priv *uc_priv,
 				 struct scsi_cmd *pccb, u8 is_write)
 {
+	struct ahci_ioports *pp = &(uc_priv->port[pccb->target]);
 	lbaint_t lba = 0;
 	u16 blocks = 0;
 	u8 fis[20];
 	u8 *user_buffer = pccb->pdata;
 	u32 user_buffer_size = pccb->datalen;
+	ulong start_us = timer_get_us();
 
 	/* Retrieve the base LBA number from the ccb structure. */
 	if (pccb->cmd[0] == SCSI_READ16) {
@@ -821,6 +1025,21 @@ static int ata_scsiop_read_write(struct ahci_uc_priv *uc_priv,
 	debug("scsi_ahci: %s %u blocks starting from lba 0x" LBAFU "\n",
 	      is_write ?  "write" : "read", blocks, lba);
 
+	pp->xfer_cmds++;
+	if (IS_ENABLED(CONFIG_AHCI_NCQ) && pp->ncq_depth && blocks &&
+	    ATA_SECT_SIZE * blocks <= user_buffer_size) {
+		if (!ahci_ncq_read_write(uc_priv, pccb->target, lba, blocks,
+					 user_buffer, is_write)) {
+			if (is_write && ata_io_flush(uc_priv, pccb->target))
+				return -EIO;
+			goto done;
+		}
+
+		printf("scsi_ahci: NCQ %s failed on port %d, disabling NCQ\n",
+		       is_write ? "write" : "read", pccb->target);
+		ahci_ncq_recover(uc_priv, pccb->target);
+	}
+
 	/* Preset the FIS */
 	memset(fis, 0, sizeof(fis));
 	fis[0] = 0x27;		 /* Host to device FIS. */
@@ -888,6 +1107,10 @@ static int ata_scsiop_read_write(struct ahci_uc_priv *uc_priv,
 		lba += now_blocks;
 	}
 
+done:
+	pp->xfer_bytes += pccb->datalen;
+	pp->xfer_us += timer_get_us() - start_us;
+
 	return 0;
 }
 
@@ -1174,6 +1397,31 @@ static int ahci_scsi_bus_reset(struct udevice *dev)
 }
 
 #ifdef CONFIG_DM_SCSI
+static void ahci_scsi_show_stats(struct udevice *dev)
+{
+	struct ahci_uc_priv *uc_priv = dev_get_uclass_priv(dev->parent);
+	struct ahci_ioports *pp;
+	int i;
+
+	for (i = 0; i < uc_priv->n_ports; i++) {
+		pp = &uc_priv->port[i];
+		if (!pp->xfer_cmds)
+			continue;
+
+		printf("SATA port %d: %u requests, %llu KiB in %llu ms",
+		       i, pp->xfer_cmds, pp->xfer_bytes >> 10,
+		       div_u64(pp->xfer_us, 1000));
+		if (pp->xfer_us)
+			printf(" (%llu KiB/s)",
+			       div64_u64(pp->xfer_bytes * 1000000 >> 10,
+					 pp->xfer_us));
+		if (pp->ncq_depth)
+			printf(", NCQ depth %u, up to %u queued",
+			       pp->ncq_depth, pp->max_queued);
+		printf("\n");
+	}
+}
+
 int ahci_bind_scsi(struct udevice *ahci_dev, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -1254,6 +1502,7 @@ int ahci_probe_scsi_pci(struct udevice *ahci_dev)
 struct scsi_ops scsi_ops = {
 	.exec		= ahci_scsi_exec,
 	.bus_reset	= ahci_scsi_bus_reset,
+	.show_stats	= ahci_scsi_show_stats,
 };
 
 U_BOOT_DRIVER(ahci_scsi) = {
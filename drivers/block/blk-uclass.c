@@ -10,6 +10,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
+#include <time.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -438,6 +439,8 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
+	lbaint_t ra;
+	void *ra_buf;
 
 	if (!ops->read)
 		return -ENOSYS;
@@ -445,6 +448,20 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
+	ra = blkcache_readahead(block_dev->if_type, block_dev->devnum, start,
+				blkcnt, block_dev->blksz, block_dev->lba,
+				&ra_buf);
+	if (ra) {
+		blks_read = ops->read(dev, start, blkcnt + ra, ra_buf);
+		if (blks_read == blkcnt + ra) {
+			blkcache_fill(block_dev->if_type, block_dev->devnum,
+				      start, blkcnt + ra, block_dev->blksz,
+				      ra_buf);
+			memcpy(buffer, ra_buf, blkcnt * block_dev->blksz);
+			return blkcnt;
+		}
+		/* fall back to reading just what was asked for */
+	}
 	blks_read = ops->read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
@@ -479,6 +496,99 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	return ops->erase(dev, start, blkcnt);
 }
 
+lbaint_t blk_req_blkcnt(const struct blk_req *req)
+{
+	lbaint_t blkcnt = 0;
+	int i;
+
+	for (i = 0; i < req->sg_count; i++)
+		blkcnt += req->sg[i].blkcnt;
+
+	return blkcnt;
+}
+
+void blk_req_finish(struct blk_req *req, long result)
+{
+	req->result = result;
+	req->done = true;
+	if (req->complete)
+		req->complete(req);
+}
+
+/* Carry out a request with the synchronous read() and write() methods */
+static long blk_req_sync(struct blk_desc *desc, struct blk_req *req)
+{
+	lbaint_t start = req->start;
+	ulong done = 0, ret;
+	int i;
+
+	for (i = 0; i < req->sg_count; i++) {
+		struct blk_sg *sg = &req->sg[i];
+
+		if (req->op == BLK_REQ_WRITE)
+			ret = blk_dwrite(desc, start, sg->blkcnt, sg->buf);
+		else
+			ret = blk_dread(desc, start, sg->blkcnt, sg->buf);
+		if (IS_ERR_VALUE(ret))
+			return done ? done : (long)ret;
+		done += ret;
+		if (ret != sg->blkcnt)
+			break;
+		start += ret;
+	}
+
+	return done;
+}
+
+int blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (req->op != BLK_REQ_READ && req->op != BLK_REQ_WRITE)
+		return -EINVAL;
+	if (req->start + blk_req_blkcnt(req) > desc->lba)
+		return -EINVAL;
+
+	req->result = 0;
+	req->done = false;
+	if (!ops->submit) {
+		blk_req_finish(req, blk_req_sync(desc, req));
+		return 0;
+	}
+
+	if (req->op == BLK_REQ_WRITE)
+		blkcache_invalidate(desc->if_type, desc->devnum);
+
+	return ops->submit(dev, req);
+}
+
+int blk_poll(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+long blk_wait(struct udevice *dev, struct blk_req *req, ulong timeout_ms)
+{
+	ulong start = get_timer(0);
+	int ret;
+
+	while (!req->done) {
+		ret = blk_poll(dev);
+		if (ret < 0)
+			return ret;
+		if (!req->done && get_timer(start) > timeout_ms)
+			return -ETIMEDOUT;
+	}
+
+	return req->result;
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
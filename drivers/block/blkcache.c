@@ -8,74 +8,275 @@
 #include <blk.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 DECLARE_GLOBAL_DATA_PTR;
 #endif
 
+/*
+ * The cache is made of lines of max_blocks_per_entry blocks, each aligned
+ * to a multiple of its size on the device. Lines are grouped in sets of
+ * up to CONFIG_BLOCK_CACHE_WAYS entries, and the set a line lives in is
+ * picked by hashing (iftype, devnum, line), so that a lookup only has to
+ * look at a handful of entries. Each set is kept in MRU order and the
+ * least recently used line of a set is the one which gets evicted when the
+ * set is full. All lines are also kept on a global MRU list, so that when
+ * the memory budget runs out the least recently used line of the whole
+ * cache goes, whichever set it is in.
+ *
+ * A line does not have to be complete: the blocks it holds are tracked in
+ * a bitmap, so single-block metadata reads can be cached as well.
+ */
+#define BLKCACHE_MAX_LINE_BLOCKS	64
+
+/* Number of sequential readers tracked for read-ahead */
+#define BLKCACHE_STREAMS		4
+
 struct block_cache_node {
 	struct list_head lh;
+	struct list_head lru;	/* on block_cache_lru */
+	struct block_cache_set *set;
 	int iftype;
 	int devnum;
 	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
+	u64 valid;	/* bit n set if block start + n is present */
 	char *cache;
 };
 
-static LIST_HEAD(block_cache);
+struct block_cache_set {
+	struct list_head lru;
+	unsigned count;
+};
+
+struct block_cache_stream {
+	int iftype;
+	int devnum;
+	lbaint_t next;		/* block following the previous read */
+	bool used;
+	bool sequential;	/* last read started at next */
+};
+
+static struct block_cache_set *block_cache;
+static unsigned block_cache_sets;
+static LIST_HEAD(block_cache_lru);
+
+static struct block_cache_stream streams[BLKCACHE_STREAMS];
+static struct block_cache_stream *last_stream;
+static unsigned next_stream;
+
+static char *ra_buf;
+static ulong ra_buf_size;
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_entries = 256,
+	.max_bytes = CONFIG_BLOCK_CACHE_SIZE,
+	.ways = CONFIG_BLOCK_CACHE_WAYS,
 };
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 int blkcache_init(void)
 {
-	struct list_head *head = &block_cache;
-
-	head->next = (uintptr_t)head->next + gd->reloc_off;
-	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+	/* Anything set up before relocation points to the old copy */
+	block_cache = NULL;
+	block_cache_sets = 0;
+	INIT_LIST_HEAD(&block_cache_lru);
+	last_stream = NULL;
+	ra_buf = NULL;
+	ra_buf_size = 0;
+	_stats.entries = 0;
+	_stats.bytes = 0;
 
 	return 0;
 }
 #endif
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static unsigned line_shift(void)
+{
+	return ilog2(_stats.max_blocks_per_entry);
+}
+
+static u64 line_mask(unsigned first, unsigned count)
+{
+	if (count >= 64)
+		return ~0ULL;
+
+	return ((1ULL << count) - 1) << first;
+}
+
+static struct block_cache_set *cache_set(int iftype, int devnum,
+					 lbaint_t start)
+{
+	u64 key;
+
+	key = ((u64)start >> line_shift()) ^ ((u64)iftype << 56) ^
+	      ((u64)devnum << 48);
+	key *= 0x9e3779b97f4a7c15ULL;
+
+	return &block_cache[(u32)(key >> 32) % block_cache_sets];
+}
+
+/* Allocate the sets on first use, so an unused cache costs nothing */
+static int cache_setup(void)
+{
+	unsigned i;
+
+	if (block_cache)
+		return 0;
+
+	block_cache_sets = DIV_ROUND_UP(_stats.max_entries, _stats.ways);
+	block_cache = malloc(block_cache_sets * sizeof(*block_cache));
+	if (!block_cache) {
+		block_cache_sets = 0;
+		return -ENOMEM;
+	}
+	for (i = 0; i < block_cache_sets; i++) {
+		INIT_LIST_HEAD(&block_cache[i].lru);
+		block_cache[i].count = 0;
+	}
+
+	return 0;
+}
+
+static struct block_cache_node *cache_find(struct block_cache_set *set,
+					   int iftype, int devnum,
+					   lbaint_t start, unsigned long blksz)
 {
 	struct block_cache_node *node;
 
-	list_for_each_entry(node, &block_cache, lh)
+	list_for_each_entry(node, &set->lru, lh)
 		if ((node->iftype == iftype) &&
 		    (node->devnum == devnum) &&
 		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
+		    (node->start == start)) {
+			/* maintain MRU ordering */
+			list_move(&node->lh, &set->lru);
+			list_move(&node->lru, &block_cache_lru);
 			return node;
 		}
-	return 0;
+	return NULL;
+}
+
+static void cache_drop(struct block_cache_node *node)
+{
+	list_del(&node->lh);
+	list_del(&node->lru);
+	node->set->count--;
+	_stats.entries--;
+	_stats.bytes -= node->blksz << line_shift();
+	free(node->cache);
+	free(node);
+}
+
+static struct block_cache_node *cache_alloc(struct block_cache_set *set,
+					    unsigned long blksz)
+{
+	ulong bytes = blksz << line_shift();
+	struct block_cache_node *node;
+
+	if (bytes > _stats.max_bytes)
+		return NULL;
+
+	/* pop LRU entries until there is room in the set and the budget */
+	while (set->count >= _stats.ways ||
+	       _stats.bytes + bytes > _stats.max_bytes) {
+		if (set->count >= _stats.ways)
+			node = list_last_entry(&set->lru,
+					       struct block_cache_node, lh);
+		else
+			node = list_last_entry(&block_cache_lru,
+					       struct block_cache_node, lru);
+		debug("drop: start " LBAF "\n", node->start);
+		cache_drop(node);
+		_stats.evictions++;
+	}
+
+	node = malloc(sizeof(*node));
+	if (!node)
+		return NULL;
+	node->cache = malloc(bytes);
+	if (!node->cache) {
+		free(node);
+		return NULL;
+	}
+	list_add(&node->lh, &set->lru);
+	list_add(&node->lru, &block_cache_lru);
+	node->set = set;
+	set->count++;
+	_stats.entries++;
+	_stats.bytes += bytes;
+
+	return node;
+}
+
+static struct block_cache_stream *stream_find(int iftype, int devnum)
+{
+	struct block_cache_stream *stream;
+	int i;
+
+	for (i = 0; i < BLKCACHE_STREAMS; i++) {
+		stream = &streams[i];
+		if (stream->used && stream->iftype == iftype &&
+		    stream->devnum == devnum)
+			return stream;
+	}
+	stream = &streams[next_stream++ % BLKCACHE_STREAMS];
+	stream->iftype = iftype;
+	stream->devnum = devnum;
+	stream->used = true;
+	stream->next = (lbaint_t)-1;
+
+	return stream;
+}
+
+static bool cache_lookup(int iftype, int devnum, lbaint_t start,
+			 lbaint_t blkcnt, unsigned long blksz, char *buffer)
+{
+	unsigned mask = _stats.max_blocks_per_entry - 1;
+	struct block_cache_node *node;
+
+	while (blkcnt) {
+		lbaint_t line = start & ~(lbaint_t)mask;
+		unsigned first = start & mask;
+		unsigned count = min_t(lbaint_t, blkcnt,
+				       _stats.max_blocks_per_entry - first);
+		u64 want = line_mask(first, count);
+
+		node = cache_find(cache_set(iftype, devnum, line), iftype,
+				  devnum, line, blksz);
+		if (!node || (node->valid & want) != want)
+			return false;
+		if (buffer) {
+			memcpy(buffer, node->cache + first * blksz,
+			       count * blksz);
+			buffer += count * blksz;
+		}
+		start += count;
+		blkcnt -= count;
+	}
+
+	return true;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
+	struct block_cache_stream *stream;
+
+	stream = stream_find(iftype, devnum);
+	stream->sequential = stream->next == start;
+	stream->next = start + blkcnt;
+	last_stream = stream;
+
+	if (block_cache && blkcnt <= _stats.max_blocks_per_entry &&
+	    cache_lookup(iftype, devnum, start, blkcnt, blksz, buffer)) {
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
 		++_stats.hits;
@@ -88,97 +289,162 @@ int blkcache_read(int iftype, int devnum,
 	return 0;
 }
 
+lbaint_t blkcache_readahead(int iftype, int devnum,
+			    lbaint_t start, lbaint_t blkcnt,
+			    unsigned long blksz, lbaint_t lba, void **bufp)
+{
+	unsigned mask = _stats.max_blocks_per_entry - 1;
+	lbaint_t end, ra;
+	ulong bytes;
+
+	if (!CONFIG_BLOCK_CACHE_READAHEAD || !_stats.max_entries ||
+	    blkcnt > _stats.max_blocks_per_entry)
+		return 0;
+
+	/* only read ahead for the reader blkcache_read() just missed on */
+	if (!last_stream || !last_stream->sequential ||
+	    last_stream->iftype != iftype || last_stream->devnum != devnum)
+		return 0;
+
+	/* read up to the end of a line, so the next miss starts a new one */
+	end = (start + CONFIG_BLOCK_CACHE_READAHEAD + mask) &
+	      ~(lbaint_t)mask;
+	if (end > lba)
+		end = lba;
+	if (end <= start + blkcnt)
+		return 0;
+	ra = end - start - blkcnt;
+
+	/* nothing to gain if the next block is already there */
+	if (block_cache &&
+	    cache_lookup(iftype, devnum, start + blkcnt, 1, blksz, NULL))
+		return 0;
+
+	bytes = (blkcnt + ra) * blksz;
+	if (bytes > ra_buf_size) {
+		free(ra_buf);
+		ra_buf_size = 0;
+		ra_buf = malloc_cache_aligned(bytes);
+		if (!ra_buf)
+			return 0;
+		ra_buf_size = bytes;
+	}
+	debug("read-ahead: start " LBAF ", count " LBAFU " + " LBAFU "\n",
+	      start, blkcnt, ra);
+	++_stats.readaheads;
+	*bufp = ra_buf;
+
+	return ra;
+}
+
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
+	unsigned mask = _stats.max_blocks_per_entry - 1;
 	struct block_cache_node *node;
+	struct block_cache_set *set;
+	const char *src = buffer;
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	/* don't cache big stuff, unless it is our own read-ahead */
+	if (blkcnt > _stats.max_blocks_per_entry && buffer != ra_buf)
 		return;
 
-	if (_stats.max_entries == 0)
+	if (_stats.max_entries == 0 || cache_setup())
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
+	debug("fill: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
+	while (blkcnt) {
+		lbaint_t line = start & ~(lbaint_t)mask;
+		unsigned first = start & mask;
+		unsigned count = min_t(lbaint_t, blkcnt,
+				       _stats.max_blocks_per_entry - first);
+
+		set = cache_set(iftype, devnum, line);
+		node = cache_find(set, iftype, devnum, line, blksz);
+		if (!node) {
+			node = cache_alloc(set, blksz);
+			if (!node)
+				return;
+			node->iftype = iftype;
+			node->devnum = devnum;
+			node->start = line;
+			node->blksz = blksz;
+			node->valid = 0;
 		}
+		memcpy(node->cache + first * blksz, src, count * blksz);
+		node->valid |= line_mask(first, count);
+
+		src += count * blksz;
+		start += count;
+		blkcnt -= count;
 	}
+}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+static void cache_clear(void)
+{
+	struct block_cache_node *node, *n;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	list_for_each_entry_safe(node, n, &block_cache_lru, lru)
+		cache_drop(node);
+	free(block_cache);
+	block_cache = NULL;
+	block_cache_sets = 0;
+	free(ra_buf);
+	ra_buf = NULL;
+	ra_buf_size = 0;
+	memset(streams, '\0', sizeof(streams));
+	last_stream = NULL;
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_node *node, *n;
+	unsigned i;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
+	list_for_each_entry_safe(node, n, &block_cache_lru, lru) {
+		if ((node->iftype == iftype) && (node->devnum == devnum))
+			cache_drop(node);
+	}
+	for (i = 0; i < BLKCACHE_STREAMS; i++) {
+		if (streams[i].iftype == iftype && streams[i].devnum == devnum)
+			streams[i].used = false;
 	}
 }
 
 void blkcache_configure(unsigned blocks, unsigned entries)
 {
-	struct block_cache_node *node;
+	blkcache_configure_size(blocks, entries, _stats.max_bytes);
+}
+
+void blkcache_configure_size(unsigned blocks, unsigned entries,
+			     ulong max_bytes)
+{
+	/* lines are aligned, so their size must be a power of two */
+	if (blocks > BLKCACHE_MAX_LINE_BLOCKS)
+		blocks = BLKCACHE_MAX_LINE_BLOCKS;
+	else if (blocks)
+		blocks = rounddown_pow_of_two(blocks);
+	else
+		entries = 0;
+
 	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
+	    (entries != _stats.max_entries) ||
+	    (max_bytes != _stats.max_bytes)) {
 		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+		cache_clear();
 	}
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
+	_stats.max_bytes = max_bytes;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
+	_stats.readaheads = 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -186,4 +452,6 @@ void blkcache_stats(struct block_cache_stats *stats)
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
+	_stats.readaheads = 0;
 }
@@ -11,6 +11,7 @@
 #include <os.h>
 #include <malloc.h>
 #include <sandboxblockdev.h>
+#include <time.h>
 #include <dm/device_compat.h>
 #include <linux/errno.h>
 #include <dm/device-internal.h>
@@ -219,15 +220,106 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 }
 
 #ifdef CONFIG_BLK
+void sandbox_host_set_latency(struct udevice *dev, ulong latency_us,
+			      ulong block_ns)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	host_dev->latency_us = latency_us;
+	host_dev->block_ns = block_ns;
+}
+
+static int host_block_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	u64 start = timer_get_us() + host_dev->latency_us;
+
+	start = max(start, host_dev->busy_until);
+	host_dev->busy_until = start + (u64)blk_req_blkcnt(req) *
+			       host_dev->block_ns / 1000;
+	req->drv_data = host_dev->busy_until;
+	list_add_tail(&req->node, &host_dev->queue);
+
+	return 0;
+}
+
+static long host_block_do_req(struct udevice *dev, struct blk_req *req)
+{
+	lbaint_t start = req->start;
+	ulong done = 0, ret;
+	int i;
+
+	for (i = 0; i < req->sg_count; i++) {
+		struct blk_sg *sg = &req->sg[i];
+
+		if (req->op == BLK_REQ_WRITE)
+			ret = host_block_write(dev, start, sg->blkcnt, sg->buf);
+		else
+			ret = host_block_read(dev, start, sg->blkcnt, sg->buf);
+		if (IS_ERR_VALUE(ret))
+			return done ? done : -EIO;
+		done += ret;
+		if (ret != sg->blkcnt)
+			break;
+		start += ret;
+	}
+
+	return done;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_req *req, *next;
+	u64 now = timer_get_us();
+	int count = 0;
+
+	list_for_each_entry_safe(req, next, &host_dev->queue, node) {
+		if (req->drv_data > now)
+			break;
+		list_del(&req->node);
+		blk_req_finish(req, host_block_do_req(dev, req));
+		count++;
+	}
+
+	return count;
+}
+
+static int host_block_probe(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	INIT_LIST_HEAD(&host_dev->queue);
+
+	return 0;
+}
+
+static int host_block_remove(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_req *req, *next;
+
+	list_for_each_entry_safe(req, next, &host_dev->queue, node) {
+		list_del(&req->node);
+		blk_req_finish(req, -ENODEV);
+	}
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.probe		= host_block_probe,
+	.remove		= host_block_remove,
 	.platdata_auto_alloc_size = sizeof(struct host_block_dev),
 };
 #else
@@ -172,6 +172,11 @@ int device_remove(struct udevice *dev, uint flags)
 	drv = dev->driver;
 	assert(drv);
 
+	/* The uclass has not seen a device which is still probing */
+	if (dev->flags & DM_FLAG_PROBE_PENDING)
+		return flags_remove(flags, drv->flags) ?
+			device_probe_cancel(dev) : 0;
+
 	ret = uclass_pre_remove_device(dev);
 	if (ret)
 		return ret;
@@ -207,6 +212,7 @@ int device_remove(struct udevice *dev, uint flags)
 	if (flags_remove(flags, drv->flags)) {
 		device_free(dev);
 
+		uclass_index_del(dev, UCLASS_INDEX_SEQ);
 		dev->seq = -1;
 		dev->flags &= ~DM_FLAG_ACTIVATED;
 	}
@@ -23,6 +23,7 @@
 #include <dm/of_access.h>
 #include <dm/pinctrl.h>
 #include <dm/platdata.h>
+#include <dm/probe-queue.h>
 #include <dm/read.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
@@ -402,7 +403,86 @@ fail:
 	return ret;
 }
 
-int device_probe(struct udevice *dev)
+/* Undo the work of a probe which failed, once nothing else needs doing */
+static int device_probe_fail(struct udevice *dev, int ret)
+{
+	dev->flags &= ~(DM_FLAG_ACTIVATED | DM_FLAG_PROBE_PENDING);
+
+	uclass_index_del(dev, UCLASS_INDEX_SEQ);
+	dev->seq = -1;
+	device_free(dev);
+
+	return ret;
+}
+
+/* Finish probing a device once its driver is done with it */
+static int device_probe_post(struct udevice *dev)
+{
+	int ret;
+
+	ret = uclass_post_probe_device(dev);
+	if (ret) {
+		if (device_remove(dev, DM_REMOVE_NORMAL)) {
+			dm_warn("%s: Device '%s' failed to remove on error path\n",
+				__func__, dev->name);
+		}
+		return device_probe_fail(dev, ret);
+	}
+
+	if (dev->parent && device_get_uclass_id(dev) == UCLASS_PINCTRL)
+		pinctrl_select_state(dev, "default");
+
+	return 0;
+}
+
+int device_probe_poll(struct udevice *dev)
+{
+	int ret;
+
+	if (!(dev->flags & DM_FLAG_PROBE_PENDING))
+		return device_active(dev) ? 0 : -ENODEV;
+
+	ret = dev->driver->probe_poll(dev);
+	if (ret == -EINPROGRESS)
+		return ret;
+
+	dm_probe_queue_del(dev);
+	dev->flags &= ~DM_FLAG_PROBE_PENDING;
+	if (ret)
+		return device_probe_fail(dev, ret);
+
+	return device_probe_post(dev);
+}
+
+/* Wait for a device to finish probing, moving the probe queue on meanwhile */
+static int device_probe_wait(struct udevice *dev)
+{
+	int ret;
+
+	dm_probe_queue_del(dev);
+	while ((ret = device_probe_poll(dev)) == -EINPROGRESS)
+		dm_probe_queue_poll();
+
+	return ret;
+}
+
+int device_probe_cancel(struct udevice *dev)
+{
+	const struct driver *drv = dev->driver;
+	int ret = 0;
+
+	if (!(dev->flags & DM_FLAG_PROBE_PENDING))
+		return 0;
+
+	dm_probe_queue_del(dev);
+	if (drv->remove)
+		ret = drv->remove(dev);
+	device_probe_fail(dev, 0);
+
+	return ret;
+}
+
+static int __device_probe(struct udevice *dev, bool wait)
 {
 	const struct driver *drv;
 	int ret;
@@ -411,6 +491,9 @@ int device_probe(struct udevice *dev)
 	if (!dev)
 		return -EINVAL;
 
+	if (dev->flags & DM_FLAG_PROBE_PENDING)
+		return wait ? device_probe_wait(dev) : 0;
+
 	if (dev->flags & DM_FLAG_ACTIVATED)
 		return 0;
 
@@ -443,6 +526,7 @@ int device_probe(struct udevice *dev)
 		goto fail;
 	}
 	dev->seq = seq;
+	uclass_index_add(dev, UCLASS_INDEX_SEQ);
 
 	dev->flags |= DM_FLAG_ACTIVATED;
 
@@ -486,30 +570,35 @@ int device_probe(struct udevice *dev)
 
 	if (drv->probe) {
 		ret = drv->probe(dev);
+		if (ret == -EINPROGRESS && drv->probe_poll) {
+			/*
+			 * The driver is waiting for the hardware. Leave it to
+			 * the probe queue unless the caller needs the device
+			 * now, or there is no room for it.
+			 */
+			dev->flags |= DM_FLAG_PROBE_PENDING;
+			if (wait || dm_probe_queue_add(dev))
+				return device_probe_wait(dev);
+
+			return 0;
+		}
 		if (ret)
 			goto fail;
 	}
 
-	ret = uclass_post_probe_device(dev);
-	if (ret)
-		goto fail_uclass;
-
-	if (dev->parent && device_get_uclass_id(dev) == UCLASS_PINCTRL)
-		pinctrl_select_state(dev, "default");
-
-	return 0;
-fail_uclass:
-	if (device_remove(dev, DM_REMOVE_NORMAL)) {
-		dm_warn("%s: Device '%s' failed to remove on error path\n",
-			__func__, dev->name);
-	}
+	return device_probe_post(dev);
 fail:
-	dev->flags &= ~DM_FLAG_ACTIVATED;
+	return device_probe_fail(dev, ret);
+}
 
-	dev->seq = -1;
-	device_free(dev);
+int device_probe(struct udevice *dev)
+{
+	return __device_probe(dev, true);
+}
 
-	return ret;
+int device_probe_start(struct udevice *dev)
+{
+	return __device_probe(dev, false);
 }
 
 void *dev_get_platdata(const struct udevice *dev)
@@ -956,12 +1045,21 @@ int device_set_name(struct udevice *dev, const char *name)
 	name = strdup(name);
 	if (!name)
 		return -ENOMEM;
+	uclass_index_del(dev, UCLASS_INDEX_NAME);
 	dev->name = name;
+	uclass_index_add(dev, UCLASS_INDEX_NAME);
 	device_set_name_alloced(dev);
 
 	return 0;
 }
 
+void dev_set_ofnode(struct udevice *dev, ofnode node)
+{
+	uclass_index_del(dev, UCLASS_INDEX_OFNODE);
+	dev->node = node;
+	uclass_index_add(dev, UCLASS_INDEX_OFNODE);
+}
+
 #if CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)
 bool device_is_compatible(const struct udevice *dev, const char *compat)
 {
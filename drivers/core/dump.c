@@ -97,6 +97,56 @@ void dm_dump_uclass(void)
 	}
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+void dm_dump_stats(void)
+{
+	struct uclass_index_table *tbl;
+	ulong lookups[UCLASS_INDEX_COUNT] = { };
+	ulong probes[UCLASS_INDEX_COUNT] = { };
+	struct uclass *uc;
+	ulong avg, used;
+	int id, i;
+
+	puts("Lookups in the uclass indexes, with the average number of devices checked\n");
+	printf("%-16s %7s %9s %5s %9s %5s %9s %5s\n", "Uclass", "Devices",
+	       "By name", "avg", "By node", "avg", "By seq", "avg");
+	for (id = 0; id <= UCLASS_COUNT; id++) {
+		if (id < UCLASS_COUNT) {
+			uc = uclass_find(id);
+			if (!uc || !uc->index)
+				continue;
+			for (i = 0, used = 0; i < UCLASS_INDEX_COUNT; i++)
+				used |= uc->index->table[i].lookups;
+			if (!used)
+				continue;
+			printf("%-16.16s %7d", uc->uc_drv->name,
+			       list_count_items(&uc->dev_head));
+		} else {
+			printf("%-16s %7s", "(total)", "");
+		}
+		for (i = 0; i < UCLASS_INDEX_COUNT; i++) {
+			if (id < UCLASS_COUNT) {
+				tbl = &uc->index->table[i];
+				lookups[i] += tbl->lookups;
+				probes[i] += tbl->probes;
+				used = tbl->lookups;
+				avg = used ? tbl->probes * 100 / used : 0;
+			} else {
+				used = lookups[i];
+				avg = used ? probes[i] * 100 / used : 0;
+			}
+			printf(" %9lu %2lu.%02lu", used, avg / 100, avg % 100);
+		}
+		puts("\n");
+	}
+}
+#else
+void dm_dump_stats(void)
+{
+	puts("Uclass indexes are not enabled\n");
+}
+#endif
+
 void dm_dump_driver_compat(void)
 {
 	struct driver *d = ll_entry_start(struct driver, driver);
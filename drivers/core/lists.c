@@ -18,7 +18,145 @@
 #include <dm/uclass.h>
 #include <dm/util.h>
 #include <fdtdec.h>
+#include <malloc.h>
+#include <asm/global_data.h>
 #include <linux/compiler.h>
+#include <linux/log2.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#if CONFIG_IS_ENABLED(DM_DRIVER_INDEX)
+/**
+ * struct driver_index_ent - an entry in a hash table of drivers
+ *
+ * @key:	Driver name or compatible string, NULL if the entry is free
+ * @drv:	Driver
+ * @id:		Entry of @key in the driver's of_match list, NULL for names
+ */
+struct driver_index_ent {
+	const char *key;
+	struct driver *drv;
+	const struct udevice_id *id;
+};
+
+/**
+ * struct driver_index - a hash table of drivers, using linear probing
+ *
+ * @ent:	Entries, NULL if the table is not built
+ * @mask:	Number of entries minus one (a power of two minus one)
+ */
+struct driver_index {
+	struct driver_index_ent *ent;
+	uint mask;
+};
+
+/*
+ * The tables point into the linker lists, so they are only built after
+ * relocation, once the drivers have their final addresses.
+ */
+static struct driver_index drv_by_name, drv_by_compat;
+static struct uclass_driver **uc_by_id;
+static bool lists_indexed;
+
+static uint driver_index_hash(const char *key)
+{
+	uint hash = 2166136261u;
+
+	while (*key)
+		hash = (hash ^ (u8)*key++) * 16777619;
+
+	return hash;
+}
+
+static struct driver_index_ent *driver_index_slot(struct driver_index *idx,
+						  const char *key)
+{
+	uint i = driver_index_hash(key) & idx->mask;
+
+	while (idx->ent[i].key && strcmp(idx->ent[i].key, key))
+		i = (i + 1) & idx->mask;
+
+	return &idx->ent[i];
+}
+
+/* Add a driver unless an earlier one already has @key, as a scan would */
+static void driver_index_add(struct driver_index *idx, const char *key,
+			     struct driver *drv, const struct udevice_id *id)
+{
+	struct driver_index_ent *ent = driver_index_slot(idx, key);
+
+	if (ent->key)
+		return;
+	ent->key = key;
+	ent->drv = drv;
+	ent->id = id;
+}
+
+static int driver_index_init(struct driver_index *idx, uint count)
+{
+	uint size = roundup_pow_of_two(max(count * 2, 16U));
+
+	idx->ent = calloc(size, sizeof(*idx->ent));
+	if (!idx->ent)
+		return -ENOMEM;
+	idx->mask = size - 1;
+
+	return 0;
+}
+
+static void lists_build_index(void)
+{
+	struct driver *drv = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct uclass_driver *uclass =
+		ll_entry_start(struct uclass_driver, uclass);
+	const int n_uc = ll_entry_count(struct uclass_driver, uclass);
+	const struct udevice_id *id;
+	struct uclass_driver *uc;
+	struct driver *entry;
+	uint n_compat = 0;
+
+	for (entry = drv; entry != drv + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++)
+			n_compat++;
+	}
+
+	if (driver_index_init(&drv_by_name, n_ents) ||
+	    driver_index_init(&drv_by_compat, n_compat)) {
+		free(drv_by_name.ent);
+		drv_by_name.ent = NULL;
+		return;
+	}
+
+	for (entry = drv; entry != drv + n_ents; entry++) {
+		driver_index_add(&drv_by_name, entry->name, entry, NULL);
+		for (id = entry->of_match; id && id->compatible; id++)
+			driver_index_add(&drv_by_compat, id->compatible, entry,
+					 id);
+	}
+
+	uc_by_id = calloc(UCLASS_COUNT, sizeof(*uc_by_id));
+	if (!uc_by_id)
+		return;
+	for (uc = uclass; uc != uclass + n_uc; uc++) {
+		if (uc->id >= 0 && uc->id < UCLASS_COUNT && !uc_by_id[uc->id])
+			uc_by_id[uc->id] = uc;
+	}
+}
+
+/* Return true if the indexes may be used, building them if needed */
+static bool lists_index_ready(void)
+{
+	if (!(gd->flags & GD_FLG_RELOC))
+		return false;
+	if (!lists_indexed) {
+		lists_indexed = true;
+		lists_build_index();
+	}
+
+	return true;
+}
+#endif
 
 struct driver *lists_driver_lookup_name(const char *name)
 {
@@ -27,6 +165,11 @@ struct driver *lists_driver_lookup_name(const char *name)
 	const int n_ents = ll_entry_count(struct driver, driver);
 	struct driver *entry;
 
+#if CONFIG_IS_ENABLED(DM_DRIVER_INDEX)
+	if (lists_index_ready() && drv_by_name.ent)
+		return driver_index_slot(&drv_by_name, name)->drv;
+#endif
+
 	for (entry = drv; entry != drv + n_ents; entry++) {
 		if (!strcmp(name, entry->name))
 			return entry;
@@ -43,6 +186,11 @@ struct uclass_driver *lists_uclass_lookup(enum uclass_id id)
 	const int n_ents = ll_entry_count(struct uclass_driver, uclass);
 	struct uclass_driver *entry;
 
+#if CONFIG_IS_ENABLED(DM_DRIVER_INDEX)
+	if (lists_index_ready() && uc_by_id && id >= 0 && id < UCLASS_COUNT)
+		return uc_by_id[id];
+#endif
+
 	for (entry = uclass; entry != uclass + n_ents; entry++) {
 		if (entry->id == id)
 			return entry;
@@ -125,11 +273,35 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
-		   bool pre_reloc_only)
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **idp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+#if CONFIG_IS_ENABLED(DM_DRIVER_INDEX)
+	if (lists_index_ready() && drv_by_compat.ent) {
+		struct driver_index_ent *ent;
+
+		ent = driver_index_slot(&drv_by_compat, compat);
+		*idp = ent->id;
+
+		return ent->drv;
+	}
+#endif
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (!driver_check_compatible(entry->of_match, idp, compat))
+			return entry;
+	}
+
+	return NULL;
+}
+
+int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
+		   bool pre_reloc_only)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
@@ -166,14 +338,11 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		log_debug("   - attempt to match compatible string '%s'\n",
 			  compat);
 
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
-		}
-		if (entry == driver + n_ents)
+		entry = lists_driver_lookup_compat(compat, &id);
+		if (!entry) {
+			ret = -ENOENT;
 			continue;
+		}
 
 		if (pre_reloc_only) {
 			if (!ofnode_pre_reloc(node) &&
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Deferred and background probing of devices
+ *
+ * Some devices spend most of their probe time waiting for the hardware, e.g.
+ * for a PCIe link to train. Drivers for these can start the hardware in
+ * probe() and finish in probe_poll(), leaving the device in the probe queue in
+ * between. Queued devices are polled whenever something waits for one of
+ * them, so several of them wait for their hardware at the same time.
+ */
+
+#define LOG_CATEGORY LOGC_DM
+
+#include <common.h>
+#include <dm.h>
+#include <log.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/probe-queue.h>
+#include <dm/uclass-internal.h>
+#include <dm/util.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#if CONFIG_IS_ENABLED(DM_PROBE_QUEUE)
+static struct udevice *probe_queue[DM_PROBE_QUEUE_LEN];
+static int probe_queue_len;
+static bool probe_queue_busy;
+
+/* Check whether a uclass name is in a list of names separated by spaces */
+static bool name_in_list(const char *list, const char *name)
+{
+	int len = strlen(name);
+	const char *p;
+
+	for (p = list; (p = strstr(p, name)); p += len) {
+		if ((p == list || p[-1] == ' ') && (!p[len] || p[len] == ' '))
+			return true;
+	}
+
+	return false;
+}
+
+bool dm_probe_deferred(enum uclass_id id)
+{
+	struct uclass_driver *uc_drv = lists_uclass_lookup(id);
+	ofnode node = ofnode_path("/config");
+
+	if (!uc_drv)
+		return false;
+
+	if (ofnode_read_prop(node, "u-boot,defer-probe", NULL))
+		return ofnode_stringlist_search(node, "u-boot,defer-probe",
+						uc_drv->name) >= 0;
+
+	return name_in_list(CONFIG_DM_DEFER_PROBE_UCLASSES, uc_drv->name);
+}
+
+int dm_probe_queue_add(struct udevice *dev)
+{
+	/* The queue only lives in the relocated image */
+	if (!(gd->flags & GD_FLG_RELOC))
+		return -EPERM;
+	if (probe_queue_len == DM_PROBE_QUEUE_LEN)
+		return -ENOSPC;
+	probe_queue[probe_queue_len++] = dev;
+
+	return 0;
+}
+
+void dm_probe_queue_del(struct udevice *dev)
+{
+	int i;
+
+	for (i = 0; i < probe_queue_len; i++) {
+		if (probe_queue[i] == dev) {
+			memmove(&probe_queue[i], &probe_queue[i + 1],
+				(--probe_queue_len - i) * sizeof(dev));
+			return;
+		}
+	}
+}
+
+int dm_probe_queue_poll(void)
+{
+	struct udevice *dev;
+	int ret, i;
+
+	/* A device finishing its probe may wait for another one */
+	if (probe_queue_busy)
+		return probe_queue_len;
+	probe_queue_busy = true;
+
+	/* Devices which are done remove themselves from the queue */
+	for (i = 0; i < probe_queue_len;) {
+		dev = probe_queue[i];
+		ret = device_probe_poll(dev);
+		if (ret == -EINPROGRESS)
+			i++;
+		else if (ret)
+			log_warning("Device '%s' failed to probe (err=%d)\n",
+				    dev->name, ret);
+	}
+	probe_queue_busy = false;
+
+	return probe_queue_len;
+}
+
+int dm_probe_queue_flush(void)
+{
+	int ret, err = 0;
+
+	while (probe_queue_len) {
+		ret = device_probe(probe_queue[0]);
+		if (ret)
+			err = ret;
+	}
+
+	return err;
+}
+#endif
+
+int dm_probe_uclass(enum uclass_id id)
+{
+	struct udevice *dev;
+	int ret, err = 0;
+
+	if (dm_probe_deferred(id))
+		return 0;
+
+	for (uclass_find_first_device(id, &dev); dev;
+	     uclass_find_next_device(&dev)) {
+		ret = device_probe_start(dev);
+		if (ret) {
+			log_debug("Device '%s' failed to probe (err=%d)\n",
+				  dev->name, ret);
+			err = ret;
+		}
+	}
+
+	return err;
+}
@@ -41,6 +41,301 @@ struct uclass *uclass_find(enum uclass_id key)
 	return NULL;
 }
 
+/* The key of a device in one of the lookup indexes */
+union uclass_index_key {
+	const char *name;
+	ofnode node;
+	int seq;
+};
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+
+static bool uclass_index_dev_key(struct udevice *dev,
+				 enum uclass_index_type type,
+				 union uclass_index_key *key)
+{
+	switch (type) {
+	case UCLASS_INDEX_NAME:
+		key->name = dev->name;
+		return true;
+	case UCLASS_INDEX_OFNODE:
+		key->node = dev_ofnode(dev);
+		return ofnode_valid(key->node);
+	case UCLASS_INDEX_SEQ:
+		key->seq = dev->seq;
+		return key->seq != -1;
+	default:
+		return false;
+	}
+}
+
+static uint uclass_index_hash(enum uclass_index_type type,
+			      union uclass_index_key key)
+{
+	const char *p;
+	uint hash;
+
+	switch (type) {
+	case UCLASS_INDEX_NAME:
+		hash = 2166136261u;
+		for (p = key.name; *p; p++)
+			hash = (hash ^ (u8)*p) * 16777619;
+		return hash;
+	case UCLASS_INDEX_OFNODE:
+		/* Both offsets and node pointers are multiples of four */
+		hash = (ulong)key.node.of_offset >> 2;
+		break;
+	default:
+		hash = key.seq;
+		break;
+	}
+
+	/* Mix the bits, since only the low ones select the entry */
+	hash = (hash ^ (hash >> 16)) * 0x45d9f3b;
+
+	return hash ^ (hash >> 16);
+}
+
+static bool uclass_index_match(struct udevice *dev,
+			       enum uclass_index_type type,
+			       union uclass_index_key key)
+{
+	switch (type) {
+	case UCLASS_INDEX_NAME:
+		return !strcmp(dev->name, key.name);
+	case UCLASS_INDEX_OFNODE:
+		return ofnode_equal(dev_ofnode(dev), key.node);
+	default:
+		return dev->seq == key.seq;
+	}
+}
+
+static uint uclass_index_dev_hash(struct udevice *dev,
+				  enum uclass_index_type type)
+{
+	union uclass_index_key key;
+
+	uclass_index_dev_key(dev, type, &key);
+
+	return uclass_index_hash(type, key);
+}
+
+static void uclass_index_clear(struct uclass_index *index)
+{
+	struct uclass_index_table *tbl;
+
+	for (tbl = index->table; tbl < index->table + UCLASS_INDEX_COUNT;
+	     tbl++) {
+		free(tbl->ent);
+		tbl->ent = NULL;
+		tbl->size = 0;
+		tbl->count = 0;
+	}
+}
+
+/* Drop the indexes of a uclass, so that its devices are looked up by a scan */
+static void uclass_index_free(struct uclass *uc)
+{
+	if (!uc->index)
+		return;
+	uclass_index_clear(uc->index);
+	free(uc->index);
+	uc->index = NULL;
+}
+
+static void uclass_index_insert(struct uclass_index_table *tbl,
+				struct udevice *dev, uint hash)
+{
+	uint mask = tbl->size - 1;
+	uint i;
+
+	for (i = hash & mask; tbl->ent[i]; i = (i + 1) & mask)
+		;
+	tbl->ent[i] = dev;
+	tbl->count++;
+}
+
+static int uclass_index_grow(struct uclass_index_table *tbl,
+			     enum uclass_index_type type)
+{
+	struct udevice **old = tbl->ent;
+	uint old_size = tbl->size;
+	uint i;
+
+	tbl->size = old_size ? old_size * 2 : 16;
+	tbl->ent = calloc(tbl->size, sizeof(*tbl->ent));
+	if (!tbl->ent) {
+		tbl->ent = old;
+		tbl->size = old_size;
+		return -ENOMEM;
+	}
+	tbl->count = 0;
+	for (i = 0; i < old_size; i++) {
+		if (old[i])
+			uclass_index_insert(tbl, old[i],
+					    uclass_index_dev_hash(old[i], type));
+	}
+	free(old);
+
+	return 0;
+}
+
+/* Return the indexes of a device's uclass, or NULL if it is not bound */
+static struct uclass_index *dev_uclass_index(struct udevice *dev)
+{
+	if (list_empty(&dev->uclass_node))
+		return NULL;
+
+	return dev->uclass->index;
+}
+
+void uclass_index_add(struct udevice *dev, enum uclass_index_type type)
+{
+	struct uclass_index *index = dev_uclass_index(dev);
+	struct uclass_index_table *tbl;
+	union uclass_index_key key;
+
+	if (!index || !uclass_index_dev_key(dev, type, &key))
+		return;
+	tbl = &index->table[type];
+	if ((tbl->count + 1) * 2 > tbl->size &&
+	    uclass_index_grow(tbl, type)) {
+		/* Without the device the index is wrong, so stop using it */
+		uclass_index_free(dev->uclass);
+		return;
+	}
+	uclass_index_insert(tbl, dev, uclass_index_hash(type, key));
+}
+
+void uclass_index_del(struct udevice *dev, enum uclass_index_type type)
+{
+	struct uclass_index *index = dev_uclass_index(dev);
+	struct uclass_index_table *tbl;
+	union uclass_index_key key;
+	uint i, j, home, mask;
+
+	if (!index || !uclass_index_dev_key(dev, type, &key))
+		return;
+	tbl = &index->table[type];
+	if (!tbl->size)
+		return;
+	mask = tbl->size - 1;
+	for (i = uclass_index_hash(type, key) & mask; tbl->ent[i] != dev;
+	     i = (i + 1) & mask) {
+		if (!tbl->ent[i])
+			return;
+	}
+
+	/* Move back later entries which can no longer be reached */
+	for (j = (i + 1) & mask; tbl->ent[j]; j = (j + 1) & mask) {
+		home = uclass_index_dev_hash(tbl->ent[j], type) & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			tbl->ent[i] = tbl->ent[j];
+			i = j;
+		}
+	}
+	tbl->ent[i] = NULL;
+	tbl->count--;
+}
+
+static void uclass_index_add_all(struct udevice *dev)
+{
+	struct uclass_index *index = dev->uclass->index;
+	int type;
+
+	for (type = 0; type < UCLASS_INDEX_COUNT; type++) {
+		/*
+		 * Allocate all tables with the first device, so that probing
+		 * and removing devices does not normally allocate memory
+		 */
+		if (index && !index->table[type].size &&
+		    uclass_index_grow(&index->table[type], type)) {
+			uclass_index_free(dev->uclass);
+			return;
+		}
+		uclass_index_add(dev, type);
+	}
+}
+
+static void uclass_index_del_all(struct udevice *dev)
+{
+	int type;
+
+	for (type = 0; type < UCLASS_INDEX_COUNT; type++)
+		uclass_index_del(dev, type);
+}
+
+/**
+ * uclass_index_find() - look up a device in one of the indexes of a uclass
+ *
+ * @uc:		Uclass to search
+ * @type:	Index to use
+ * @key:	Key to look for
+ * @devp:	Returns the first device in the uclass with @key, or NULL
+ * @return 0 if the lookup was done, -ENOENT if the uclass has no index
+ */
+static int uclass_index_find(struct uclass *uc, enum uclass_index_type type,
+			     union uclass_index_key key, struct udevice **devp)
+{
+	struct uclass_index_table *tbl;
+	struct udevice *dev, *found = NULL;
+	bool dups = false;
+	uint i, mask;
+
+	*devp = NULL;
+	if (!uc->index)
+		return -ENOENT;
+	tbl = &uc->index->table[type];
+	tbl->lookups++;
+	if (!tbl->size)
+		return 0;
+
+	mask = tbl->size - 1;
+	for (i = uclass_index_hash(type, key) & mask; tbl->ent[i];
+	     i = (i + 1) & mask) {
+		tbl->probes++;
+		if (uclass_index_match(tbl->ent[i], type, key)) {
+			if (found)
+				dups = true;
+			found = tbl->ent[i];
+		}
+	}
+
+	/* A scan would find the device which was bound first */
+	if (dups) {
+		uclass_foreach_dev(dev, uc) {
+			if (uclass_index_match(dev, type, key)) {
+				found = dev;
+				break;
+			}
+		}
+	}
+	*devp = found;
+
+	return 0;
+}
+#else
+static inline void uclass_index_free(struct uclass *uc)
+{
+}
+
+static inline void uclass_index_add_all(struct udevice *dev)
+{
+}
+
+static inline void uclass_index_del_all(struct udevice *dev)
+{
+}
+
+static inline int uclass_index_find(struct uclass *uc,
+				    enum uclass_index_type type,
+				    union uclass_index_key key,
+				    struct udevice **devp)
+{
+	return -ENOENT;
+}
+#endif
+
 /**
  * uclass_add() - Create new uclass in list
  * @id: Id number to create
@@ -78,6 +373,11 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 			goto fail_mem;
 		}
 	}
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	/* Memory is short before relocation and devices are few */
+	if (gd->flags & GD_FLG_RELOC)
+		uc->index = calloc(1, sizeof(*uc->index));
+#endif
 	uc->uc_drv = uc_drv;
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
@@ -99,6 +399,7 @@ fail:
 	}
 	list_del(&uc->sibling_node);
 fail_mem:
+	uclass_index_free(uc);
 	free(uc);
 
 	return ret;
@@ -133,6 +434,7 @@ int uclass_destroy(struct uclass *uc)
 	list_del(&uc->sibling_node);
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
+	uclass_index_free(uc);
 	free(uc);
 
 	return 0;
@@ -251,6 +553,7 @@ int uclass_find_next_device(struct udevice **devp)
 int uclass_find_device_by_name(enum uclass_id id, const char *name,
 			       struct udevice **devp)
 {
+	union uclass_index_key key;
 	struct uclass *uc;
 	struct udevice *dev;
 	int ret;
@@ -262,6 +565,9 @@ int uclass_find_device_by_name(enum uclass_id id, const char *name,
 	if (ret)
 		return ret;
 
+	key.name = name;
+	if (!uclass_index_find(uc, UCLASS_INDEX_NAME, key, devp))
+		return *devp ? 0 : -ENODEV;
 	uclass_foreach_dev(dev, uc) {
 		if (!strcmp(dev->name, name)) {
 			*devp = dev;
@@ -297,6 +603,7 @@ int uclass_find_next_free_req_seq(enum uclass_id id)
 int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 			      bool find_req_seq, struct udevice **devp)
 {
+	union uclass_index_key key;
 	struct uclass *uc;
 	struct udevice *dev;
 	int ret;
@@ -309,6 +616,10 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	if (ret)
 		return ret;
 
+	key.seq = seq_or_req_seq;
+	if (!find_req_seq &&
+	    !uclass_index_find(uc, UCLASS_INDEX_SEQ, key, devp))
+		return *devp ? 0 : -ENODEV;
 	uclass_foreach_dev(dev, uc) {
 		log_debug("   - %d %d '%s'\n",
 			  dev->req_seq, dev->seq, dev->name);
@@ -351,6 +662,7 @@ int uclass_find_device_by_of_offset(enum uclass_id id, int node,
 int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 				 struct udevice **devp)
 {
+	union uclass_index_key key;
 	struct uclass *uc;
 	struct udevice *dev;
 	int ret;
@@ -363,6 +675,12 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	if (ret)
 		return ret;
 
+	key.node = node;
+	if (!uclass_index_find(uc, UCLASS_INDEX_OFNODE, key, devp)) {
+		if (!*devp)
+			ret = -ENODEV;
+		goto done;
+	}
 	uclass_foreach_dev(dev, uc) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
 		    dev->name);
@@ -650,6 +968,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_index_add_all(dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -664,7 +983,8 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
-	list_del(&dev->uclass_node);
+	uclass_index_del_all(dev);
+	list_del_init(&dev->uclass_node);
 
 	return ret;
 }
@@ -682,7 +1002,12 @@ int uclass_unbind_device(struct udevice *dev)
 			return ret;
 	}
 
-	list_del(&dev->uclass_node);
+	uclass_index_del_all(dev);
+	list_del_init(&dev->uclass_node);
+
+	/* Free the tables with the last device, they are allocated again */
+	if (uc->index && list_empty(&uc->dev_head))
+		uclass_index_clear(uc->index);
 	return 0;
 }
 #endif
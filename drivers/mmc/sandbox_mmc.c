@@ -59,9 +59,12 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		break;
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
-		memset(data->dest, '\0', data->blocksize);
-		break;
 	case MMC_CMD_READ_MULTIPLE_BLOCK:
+		/*
+		 * Every read starts with the same string, whatever command
+		 * is used, so that the block cache may merge reads
+		 */
+		memset(data->dest, '\0', data->blocks * data->blocksize);
 		strcpy(data->dest, "this is a test");
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
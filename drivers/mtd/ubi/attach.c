@@ -86,6 +86,7 @@
 #include <linux/math64.h>
 
 #include <ubi_uboot.h>
+#include <bootstage.h>
 #include "ubi.h"
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
@@ -832,6 +833,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_read_hdrs(ubi, pnum);
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1237,6 +1239,8 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!ech)
 		return err;
 
+	bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_SCAN, "ubi_scan");
+
 	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
 	if (!vidh)
 		goto out_ech;
@@ -1289,6 +1293,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_SCAN);
 
 	return 0;
 
@@ -1296,6 +1301,7 @@ out_vidh:
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_SCAN);
 	return err;
 }
 
@@ -1340,6 +1346,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	int err, pnum, fm_anchor = -1;
 	unsigned long long max_sqnum = 0;
 
+	bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_FASTMAP, "ubi_fastmap");
 	err = -ENOMEM;
 
 	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
@@ -1369,26 +1376,43 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
 
-	if (fm_anchor < 0)
-		return UBI_NO_FASTMAP;
+	if (fm_anchor < 0) {
+		err = UBI_NO_FASTMAP;
+		goto out;
+	}
 
 	destroy_ai(*ai);
 	*ai = alloc_ai();
-	if (!*ai)
-		return -ENOMEM;
+	if (!*ai) {
+		err = -ENOMEM;
+		goto out;
+	}
 
-	return ubi_scan_fastmap(ubi, *ai, fm_anchor);
+	err = ubi_scan_fastmap(ubi, *ai, fm_anchor);
+	goto out;
 
 out_vidh:
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
 out:
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_FASTMAP);
 	return err;
 }
 
 #endif
 
+/*
+ * Drop the headers read by ubi_io_read_hdrs(), which must not be used any more
+ * once the flash starts to change
+ */
+static void free_hdrs_buf(struct ubi_device *ubi)
+{
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
+	ubi->hdrs_pnum = -1;
+}
+
 /**
  * ubi_attach - attach an MTD device.
  * @ubi: UBI device descriptor
@@ -1406,6 +1430,13 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (!ai)
 		return -ENOMEM;
 
+	/*
+	 * Scanning reads both headers of each PEB at once, see
+	 * ubi_io_read_hdrs(). It does without if there is no memory for that.
+	 */
+	ubi->hdrs_buf = kmalloc(ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize,
+				GFP_KERNEL);
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	/* On small flash devices we disable fastmap in any case. */
 	if ((int)mtd_div_by_eb(ubi->mtd->size, ubi->mtd) <= UBI_FM_MAX_START) {
@@ -1421,8 +1452,10 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 			if (err != UBI_NO_FASTMAP) {
 				destroy_ai(ai);
 				ai = alloc_ai();
-				if (!ai)
+				if (!ai) {
+					free_hdrs_buf(ubi);
 					return -ENOMEM;
+				}
 
 				err = scan_all(ubi, ai, 0);
 			} else {
@@ -1433,6 +1466,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #else
 	err = scan_all(ubi, ai, 0);
 #endif
+	free_hdrs_buf(ubi);
 	if (err)
 		goto out_ai;
 
@@ -16,6 +16,7 @@
 #include <div64.h>
 #include <malloc.h>
 #include <ubi_uboot.h>
+#include <bootstage.h>
 #include <linux/bug.h>
 #endif
 
@@ -498,6 +499,7 @@ static int scan_pool(struct ubi_device *ubi, struct ubi_attach_info *ai,
 			goto out;
 		}
 
+		ubi_io_read_hdrs(ubi, pnum);
 		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 		if (err && err != UBI_IO_BITFLIPS) {
 			ubi_err(ubi, "unable to read EC header! PEB:%i err:%i",
@@ -815,11 +817,12 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 		}
 	}
 
+	bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_POOL, "ubi_pool");
 	ret = scan_pool(ubi, ai, fmpl->pebs, pool_size, &max_sqnum, &free);
-	if (ret)
-		goto fail;
-
-	ret = scan_pool(ubi, ai, fmpl_wl->pebs, wl_pool_size, &max_sqnum, &free);
+	if (!ret)
+		ret = scan_pool(ubi, ai, fmpl_wl->pebs, wl_pool_size,
+				&max_sqnum, &free);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_POOL);
 	if (ret)
 		goto fail;
 
@@ -703,6 +703,35 @@ bad:
 	return 1;
 }
 
+/**
+ * ubi_io_read_hdrs - read both headers of a physical eraseblock at once.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock to read from
+ *
+ * While attaching, UBI reads the EC and the VID header of nearly every
+ * physical eraseblock. This function reads both of them with one MTD call,
+ * so that the driver can stream the pages holding them (e.g. with a NAND
+ * cache read) rather than being asked for each separately. The following
+ * 'ubi_io_read_ec_hdr()' and 'ubi_io_read_vid_hdr()' calls for @pnum then
+ * take the headers from @ubi->hdrs_buf.
+ *
+ * Nothing is kept unless the read fully succeeded: the headers are then read
+ * one at a time as usual, so that bit-flips and ECC errors are put down to
+ * the right header. This must only be used while nothing writes to the
+ * flash, as the kept headers are not updated.
+ */
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	ubi->hdrs_pnum = -1;
+	if (!ubi->hdrs_buf)
+		return;
+
+	dbg_io("read EC and VID headers from PEB %d", pnum);
+	if (!ubi_io_read(ubi, ubi->hdrs_buf, pnum, 0,
+			 ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize))
+		ubi->hdrs_pnum = pnum;
+}
+
 /**
  * ubi_io_read_ec_hdr - read and check an erase counter header.
  * @ubi: UBI device description object
@@ -734,7 +763,12 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
 
-	read_err = ubi_io_read(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
+	if (pnum == ubi->hdrs_pnum) {
+		memcpy(ec_hdr, ubi->hdrs_buf, UBI_EC_HDR_SIZE);
+		read_err = 0;
+	} else {
+		read_err = ubi_io_read(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
+	}
 	if (read_err) {
 		if (read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 			return read_err;
@@ -1009,8 +1043,14 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	ubi_assert(pnum >= 0 &&  pnum < ubi->peb_count);
 
 	p = (char *)vid_hdr - ubi->vid_hdr_shift;
-	read_err = ubi_io_read(ubi, p, pnum, ubi->vid_hdr_aloffset,
-			  ubi->vid_hdr_alsize);
+	if (pnum == ubi->hdrs_pnum) {
+		memcpy(p, ubi->hdrs_buf + ubi->vid_hdr_aloffset,
+		       ubi->vid_hdr_alsize);
+		read_err = 0;
+	} else {
+		read_err = ubi_io_read(ubi, p, pnum, ubi->vid_hdr_aloffset,
+				       ubi->vid_hdr_alsize);
+	}
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
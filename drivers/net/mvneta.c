@@ -283,6 +283,8 @@ struct mvneta_port {
 	int init;
 	int phyaddr;
 	struct phy_device *phydev;
+	/* A received buffer is with the network stack until free_pkt() */
+	bool rx_pending;
 #if CONFIG_IS_ENABLED(DM_GPIO)
 	struct gpio_desc phy_reset_gpio;
 #endif
@@ -1675,15 +1677,35 @@ static int mvneta_recv(struct udevice *dev, int flags, uchar **packetp)
 		*packetp = data;
 
 		/*
-		 * Only mark one descriptor as free
-		 * since only one was processed
+		 * The descriptor is handed back to the hardware in
+		 * mvneta_free_pkt(), so the stack can read the payload
+		 * straight from the RX buffer
 		 */
-		mvneta_rxq_desc_num_update(pp, rxq, 1, 1);
+		pp->rx_pending = true;
 	}
 
 	return rx_bytes;
 }
 
+static int mvneta_free_pkt(struct udevice *dev, uchar *packet, int length)
+{
+	struct mvneta_port *pp = dev_get_priv(dev);
+	struct mvneta_rx_queue *rxq;
+
+	if (!pp->rx_pending)
+		return 0;
+
+	/*
+	 * Only mark one descriptor as free
+	 * since only one was processed
+	 */
+	rxq = mvneta_rxq_handle_get(pp, rxq_def);
+	mvneta_rxq_desc_num_update(pp, rxq, 1, 1);
+	pp->rx_pending = false;
+
+	return 0;
+}
+
 static int mvneta_probe(struct udevice *dev)
 {
 	struct eth_pdata *pdata = dev_get_platdata(dev);
@@ -1787,6 +1809,7 @@ static const struct eth_ops mvneta_ops = {
 	.start		= mvneta_start,
 	.send		= mvneta_send,
 	.recv		= mvneta_recv,
+	.free_pkt	= mvneta_free_pkt,
 	.stop		= mvneta_stop,
 	.write_hwaddr	= mvneta_write_hwaddr,
 };
@@ -978,6 +978,11 @@ struct mvpp2_port {
 	struct mvpp2_bm_pool *pool_long;
 	struct mvpp2_bm_pool *pool_short;
 
+	/* Buffer handed to the network stack, returned in free_pkt() */
+	bool rx_pending;
+	u32 rx_bm;
+	dma_addr_t rx_dma_addr;
+
 	/* Index of first port's physical RXQ */
 	u8 first_rxq;
 
@@ -5117,14 +5122,33 @@ static int mvpp2_init(struct udevice *dev, struct mvpp2 *priv)
 	return 0;
 }
 
+/* Give a received buffer back to the BM pool and the descriptor to the RXQ */
+static int mvpp2_rx_done(struct mvpp2_port *port, u32 bm, dma_addr_t dma_addr)
+{
+	struct mvpp2_bm_pool *bm_pool;
+	int err;
+
+	bm_pool = &port->priv->bm_pools[mvpp2_bm_cookie_pool_get(bm)];
+	err = mvpp2_rx_refill(port, bm_pool, bm, dma_addr);
+	if (err) {
+		netdev_err(port->dev, "failed to refill BM pools\n");
+		return err;
+	}
+
+	/* Update Rx queue management counters */
+	mb();
+	mvpp2_rxq_status_update(port, port->rxqs[0]->id, 1, 1);
+
+	return 0;
+}
+
 static int mvpp2_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct mvpp2_port *port = dev_get_priv(dev);
 	struct mvpp2_rx_desc *rx_desc;
-	struct mvpp2_bm_pool *bm_pool;
 	dma_addr_t dma_addr;
 	u32 bm, rx_status;
-	int pool, rx_bytes, err;
+	int rx_bytes;
 	int rx_received;
 	struct mvpp2_rx_queue *rxq;
 	u8 *data;
@@ -5150,8 +5174,6 @@ static int mvpp2_recv(struct udevice *dev, int flags, uchar **packetp)
 	dma_addr = mvpp2_rxdesc_dma_addr_get(port, rx_desc);
 
 	bm = mvpp2_bm_cookie_build(port, rx_desc);
-	pool = mvpp2_bm_cookie_pool_get(bm);
-	bm_pool = &port->priv->bm_pools[pool];
 
 	/* In case of an error, release the requested buffer pointer
 	 * to the Buffer Manager. This request process is controlled
@@ -5165,31 +5187,39 @@ static int mvpp2_recv(struct udevice *dev, int flags, uchar **packetp)
 		return 0;
 	}
 
-	err = mvpp2_rx_refill(port, bm_pool, bm, dma_addr);
-	if (err) {
-		netdev_err(port->dev, "failed to refill BM pools\n");
+	if (rx_bytes <= 0) {
+		mvpp2_rx_done(port, bm, dma_addr);
 		return 0;
 	}
 
-	/* Update Rx queue management counters */
-	mb();
-	mvpp2_rxq_status_update(port, rxq->id, 1, 1);
-
 	/* give packet to stack - skip on first n bytes */
 	data = (u8 *)dma_addr + 2 + 32;
 
-	if (rx_bytes <= 0)
-		return 0;
-
 	/*
 	 * No cache invalidation needed here, since the rx_buffer's are
-	 * located in a uncached memory region
+	 * located in a uncached memory region. The buffer stays with the
+	 * stack, which reads the payload from it directly, until
+	 * mvpp2_free_pkt() hands it back to the hardware.
 	 */
+	port->rx_pending = true;
+	port->rx_bm = bm;
+	port->rx_dma_addr = dma_addr;
 	*packetp = data;
 
 	return rx_bytes;
 }
 
+static int mvpp2_free_pkt(struct udevice *dev, uchar *packet, int length)
+{
+	struct mvpp2_port *port = dev_get_priv(dev);
+
+	if (!port->rx_pending)
+		return 0;
+	port->rx_pending = false;
+
+	return mvpp2_rx_done(port, port->rx_bm, port->rx_dma_addr);
+}
+
 static int mvpp2_send(struct udevice *dev, void *packet, int length)
 {
 	struct mvpp2_port *port = dev_get_priv(dev);
@@ -5470,6 +5500,7 @@ static const struct eth_ops mvpp2_ops = {
 	.start		= mvpp2_start,
 	.send		= mvpp2_send,
 	.recv		= mvpp2_recv,
+	.free_pkt	= mvpp2_free_pkt,
 	.stop		= mvpp2_stop,
 	.write_hwaddr	= mvpp2_write_hwaddr
 };
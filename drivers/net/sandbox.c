@@ -41,13 +41,26 @@ void sandbox_eth_disable_response(int index, bool disable)
 /*
  * sandbox_eth_skip_timeout()
  *
- * When the first packet read is attempted, fast-forward time
+ * When a packet read next finds nothing waiting, fast-forward time
  */
 void sandbox_eth_skip_timeout(void)
 {
 	skip_timeout = true;
 }
 
+/*
+ * sb_eth_recv_slot()
+ *
+ * Packets are queued in a ring, so that received packets stay where they are
+ * until the network stack has finished with them
+ *
+ * returns the index of the buffer to use for the next injected packet
+ */
+static int sb_eth_recv_slot(struct eth_sandbox_priv *priv)
+{
+	return (priv->recv_packet_first + priv->recv_packets) % PKTBUFSRX;
+}
+
 /*
  * sandbox_eth_arp_req_to_reply()
  *
@@ -80,7 +93,7 @@ int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
 	priv->fake_host_ipaddr = net_read_ip(&arp->ar_tpa);
 
 	/* Formulate a fake response */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	eth_recv = (void *)priv->recv_packet_buffer[sb_eth_recv_slot(priv)];
 	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
 	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
 	eth_recv->et_protlen = htons(PROT_ARP);
@@ -96,7 +109,7 @@ int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
 	memcpy(&arp_recv->ar_tha, &arp->ar_sha, ARP_HLEN);
 	net_copy_ip(&arp_recv->ar_tpa, &arp->ar_spa);
 
-	priv->recv_packet_length[priv->recv_packets] =
+	priv->recv_packet_length[sb_eth_recv_slot(priv)] =
 		ETHER_HDR_SIZE + ARP_HDR_SIZE;
 	++priv->recv_packets;
 
@@ -139,7 +152,7 @@ int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
 		return 0;
 
 	/* reply to the ping */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	eth_recv = (void *)priv->recv_packet_buffer[sb_eth_recv_slot(priv)];
 	memcpy(eth_recv, packet, len);
 	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
 	icmpr = (struct icmp_hdr *)&ipr->udp_src;
@@ -155,7 +168,7 @@ int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
 	icmpr->checksum = 0;
 	icmpr->checksum = compute_ip_checksum(icmpr, ICMP_HDR_SIZE);
 
-	priv->recv_packet_length[priv->recv_packets] = len;
+	priv->recv_packet_length[sb_eth_recv_slot(priv)] = len;
 	++priv->recv_packets;
 
 	return 0;
@@ -179,7 +192,7 @@ int sandbox_eth_recv_arp_req(struct udevice *dev)
 		return -EOVERFLOW;
 
 	/* Formulate a fake request */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	eth_recv = (void *)priv->recv_packet_buffer[sb_eth_recv_slot(priv)];
 	memcpy(eth_recv->et_dest, net_bcast_ethaddr, ARP_HLEN);
 	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
 	eth_recv->et_protlen = htons(PROT_ARP);
@@ -195,7 +208,7 @@ int sandbox_eth_recv_arp_req(struct udevice *dev)
 	memcpy(&arp_recv->ar_tha, net_null_ethaddr, ARP_HLEN);
 	net_write_ip(&arp_recv->ar_tpa, net_ip);
 
-	priv->recv_packet_length[priv->recv_packets] =
+	priv->recv_packet_length[sb_eth_recv_slot(priv)] =
 		ETHER_HDR_SIZE + ARP_HDR_SIZE;
 	++priv->recv_packets;
 
@@ -221,7 +234,7 @@ int sandbox_eth_recv_ping_req(struct udevice *dev)
 		return -EOVERFLOW;
 
 	/* Formulate a fake ping */
-	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	eth_recv = (void *)priv->recv_packet_buffer[sb_eth_recv_slot(priv)];
 
 	memcpy(eth_recv->et_dest, net_ethaddr, ARP_HLEN);
 	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
@@ -246,7 +259,7 @@ int sandbox_eth_recv_ping_req(struct udevice *dev)
 	icmpr->un.echo.sequence = htons(1);
 	icmpr->checksum = compute_ip_checksum(icmpr, ICMP_HDR_SIZE);
 
-	priv->recv_packet_length[priv->recv_packets] =
+	priv->recv_packet_length[sb_eth_recv_slot(priv)] =
 		ETHER_HDR_SIZE + IP_ICMP_HDR_SIZE;
 	++priv->recv_packets;
 
@@ -326,6 +339,7 @@ static int sb_eth_start(struct udevice *dev)
 	debug("eth_sandbox: Start\n");
 
 	priv->recv_packets = 0;
+	priv->recv_packet_first = 0;
 	for (int i = 0; i < PKTBUFSRX; i++) {
 		priv->recv_packet_buffer[i] = net_rx_packets[i];
 		priv->recv_packet_length[i] = 0;
@@ -350,38 +364,41 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
 
-	if (skip_timeout) {
+	if (skip_timeout && !priv->recv_packets) {
 		timer_test_add_offset(11000UL);
 		skip_timeout = false;
 	}
 
 	if (priv->recv_packets) {
-		int lcl_recv_packet_length = priv->recv_packet_length[0];
+		int first = priv->recv_packet_first;
+		int lcl_recv_packet_length = priv->recv_packet_length[first];
 
 		debug("eth_sandbox: received packet[%d], %d waiting\n",
 		      lcl_recv_packet_length, priv->recv_packets - 1);
-		*packetp = priv->recv_packet_buffer[0];
+		*packetp = priv->recv_packet_buffer[first];
 		return lcl_recv_packet_length;
 	}
 	return 0;
 }
 
+/* Like a DMA ring, the buffer is only reused once the stack gives it back */
 static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
-	int i;
+	int first = priv->recv_packet_first;
 
 	if (!priv->recv_packets)
 		return 0;
 
-	--priv->recv_packets;
-	for (i = 0; i < priv->recv_packets; i++) {
-		priv->recv_packet_length[i] = priv->recv_packet_length[i + 1];
-		memcpy(priv->recv_packet_buffer[i],
-		       priv->recv_packet_buffer[i + 1],
-		       priv->recv_packet_length[i + 1]);
+	if (packet != priv->recv_packet_buffer[first]) {
+		printf("eth_sandbox: Freeing packet %p, expected %p\n", packet,
+		       priv->recv_packet_buffer[first]);
+		return -EINVAL;
 	}
-	priv->recv_packet_length[priv->recv_packets] = 0;
+
+	priv->recv_packet_length[first] = 0;
+	priv->recv_packet_first = (first + 1) % PKTBUFSRX;
+	--priv->recv_packets;
 
 	return 0;
 }
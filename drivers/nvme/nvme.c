@@ -18,13 +18,12 @@
 #include <linux/compat.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
 
 enum nvme_queue_id {
 	NVME_ADMIN_Q,
@@ -71,16 +70,31 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
+/**
+ * nvme_setup_prps() - build the PRP entries for a transfer
+ *
+ * The first page of the transfer is always described by PRP1. If the rest
+ * fits in one more page, PRP2 points to it directly, otherwise PRP2 points
+ * to a list of PRP entries which is built in @prp_list. This must have room
+ * for dev->prp_entry_num entries, which covers the largest transfer the
+ * controller accepts.
+ *
+ * @dev:	NVMe device
+ * @prp_list:	Page-aligned memory for the PRP list
+ * @prp2:	Returns the value for PRP2
+ * @total_len:	Length of the transfer in bytes
+ * @dma_addr:	Start address of the transfer
+ * @return 0 if OK, -EINVAL if the transfer is too large
+ */
+static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp_list, u64 *prp2,
 			   int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
+	u64 *prp_pool = prp_list;
 	int length = total_len;
 	int i, nprps;
 	u32 prps_per_page = (page_size >> 3) - 1;
-	u32 num_pages;
 
 	length -= (page_size - offset);
 
@@ -98,39 +112,28 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
-	num_pages = DIV_ROUND_UP(nprps, prps_per_page);
-
 	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		/*
-		 * Always increase in increments of pages.  It doesn't waste
-		 * much memory and reduces the number of allocations.
-		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = prps_per_page * num_pages;
+		printf("Error: %d PRP entries needed, only %u available\n",
+		       nprps, dev->prp_entry_num);
+		return -EINVAL;
 	}
 
-	prp_pool = dev->prp_pool;
 	i = 0;
 	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
+		/* the last entry of a page points to the next one */
+		if (i == prps_per_page && nprps > 1) {
 			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
 					page_size);
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += page_size >> 3;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	*prp2 = (ulong)prp_list;
 
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
-			   dev->prp_entry_num * sizeof(u64));
+	flush_dcache_range((ulong)prp_list, (ulong)(prp_pool + i));
 
 	return 0;
 }
@@ -153,12 +156,12 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 }
 
 /**
- * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
  *
  * @nvmeq:	The queue to use
  * @cmd:	The command to send
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -168,22 +171,48 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
 }
 
-static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
-				struct nvme_command *cmd,
-				u32 *result, unsigned timeout)
+/**
+ * nvme_ring_sq() - tell the controller about the commands queued so far
+ *
+ * @nvmeq:	The queue to use
+ */
+static void nvme_ring_sq(struct nvme_queue *nvmeq)
+{
+	writel(nvmeq->sq_tail, nvmeq->q_db);
+}
+
+/**
+ * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	nvme_ring_sq(nvmeq);
+}
+
+/**
+ * nvme_wait_cmd() - wait for the next completion on a queue
+ *
+ * @nvmeq:	The queue to use
+ * @cmdid:	Returns the command_id of the completed command, if not NULL
+ * @result:	Returns the command specific result, if not NULL
+ * @timeout_us:	Time to wait in microseconds, 0 to wait forever
+ * @return 0 if the command completed successfully, -EIO if it failed,
+ * -ETIMEDOUT if no command completed in time
+ */
+static int nvme_wait_cmd(struct nvme_queue *nvmeq, u16 *cmdid, u32 *result,
+			 ulong timeout_us)
 {
 	u16 head = nvmeq->cq_head;
 	u16 phase = nvmeq->cq_phase;
 	u16 status;
 	ulong start_time;
-	ulong timeout_us = timeout * 100000;
-
-	cmd->common.command_id = nvme_get_cmd_id();
-	nvme_submit_cmd(nvmeq, cmd);
 
 	start_time = timer_get_us();
 
@@ -196,23 +225,14 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 			return -ETIMEDOUT;
 	}
 
+	if (cmdid)
+		*cmdid = readw(&(nvmeq->cqes[head].command_id));
+
 	status >>= 1;
-	if (status) {
+	if (status)
 		printf("ERROR: status = %x, phase = %d, head = %d\n",
 		       status, phase, head);
-		status = 0;
-		if (++head == nvmeq->q_depth) {
-			head = 0;
-			phase = !phase;
-		}
-		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
-		nvmeq->cq_head = head;
-		nvmeq->cq_phase = phase;
-
-		return -EIO;
-	}
-
-	if (result)
+	else if (result)
 		*result = le32_to_cpu(readl(&(nvmeq->cqes[head].result)));
 
 	if (++head == nvmeq->q_depth) {
@@ -223,7 +243,17 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	nvmeq->cq_head = head;
 	nvmeq->cq_phase = phase;
 
-	return status;
+	return status ? -EIO : 0;
+}
+
+static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
+				struct nvme_command *cmd,
+				u32 *result, unsigned timeout)
+{
+	cmd->common.command_id = nvme_get_cmd_id();
+	nvme_submit_cmd(nvmeq, cmd);
+
+	return nvme_wait_cmd(nvmeq, NULL, result, timeout * 100000);
 }
 
 static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
@@ -541,6 +571,31 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 	return result;
 }
 
+/**
+ * nvme_reset_io_queue() - abandon the commands outstanding on the I/O queue
+ *
+ * The controller aborts or finishes every command in a submission queue
+ * before it reports the queue deleted, so once this returns nothing can
+ * still access the buffers or PRP lists of those commands. The queues are
+ * then created afresh.
+ *
+ * @dev:	NVMe device
+ * @return 0 if OK, -ve on error
+ */
+static int nvme_reset_io_queue(struct nvme_dev *dev)
+{
+	int ret;
+
+	ret = nvme_delete_sq(dev, NVME_IO_Q);
+	if (!ret)
+		ret = nvme_delete_cq(dev, NVME_IO_Q);
+	if (ret)
+		return ret;
+	dev->online_queues--;
+
+	return nvme_create_queue(dev->queues[NVME_IO_Q], NVME_IO_Q);
+}
+
 static int nvme_set_queue_count(struct nvme_dev *dev, int count)
 {
 	int status;
@@ -639,6 +694,47 @@ static int nvme_get_info_from_identify(struct nvme_dev *dev)
 	return 0;
 }
 
+/*
+ * Each I/O queue entry which may be in use gets its own PRP list, big enough
+ * for the largest transfer, so that several commands can be outstanding
+ * without allocating anything per request.
+ */
+static int nvme_alloc_prp_pool(struct nvme_dev *dev)
+{
+	u32 page_size = dev->page_size;
+	u32 prps_per_page = (page_size >> 3) - 1;
+	u32 pages;
+
+	/*
+	 * Very large transfers would need a lot of PRP lists for little
+	 * gain, so split commands at 1MB
+	 */
+	if (dev->max_transfer_shift > 20)
+		dev->max_transfer_shift = 20;
+
+	/* an unaligned buffer can touch one more page */
+	pages = DIV_ROUND_UP((1 << dev->max_transfer_shift) / page_size + 1,
+			     prps_per_page);
+	dev->prp_entry_num = prps_per_page * pages;
+	dev->prp_slot_size = page_size * pages;
+	dev->io_slots = dev->q_depth - 1;
+	dev->io_next_slot = 0;
+
+	dev->prp_pool = memalign(page_size,
+				 dev->io_slots * dev->prp_slot_size);
+	if (!dev->prp_pool)
+		return -ENOMEM;
+	dev->io_chunk = malloc(dev->io_slots * sizeof(*dev->io_chunk));
+	if (!dev->io_chunk) {
+		free(dev->prp_pool);
+		dev->prp_pool = NULL;
+		return -ENOMEM;
+	}
+	memset(dev->io_chunk, 0xff, dev->io_slots * sizeof(*dev->io_chunk));
+
+	return 0;
+}
+
 int nvme_get_namespace_id(struct udevice *udev, u32 *ns_id, u8 *eui64)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
@@ -718,59 +814,143 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
 	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct nvme_io_stats *stats = &ns->stats;
 	struct nvme_command c;
 	struct blk_desc *desc = dev_get_uclass_platdata(udev);
-	int status;
-	u64 prp2;
 	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
+	u32 chunk_shift = dev->max_transfer_shift - ns->lba_shift;
+	u32 nchunks = (blkcnt + (1 << chunk_shift) - 1) >> chunk_shift;
+	u32 next = 0, failed = nchunks, chunk;
+	u32 inflight = 0, queued;
+	ulong start_us;
+	u16 cmdid;
+	u64 prp2;
+	int ret;
 
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
+	if (dev->io_dead) {
+		printf("Error: %s: I/O queue is not usable\n", udev->name);
+		return 0;
+	}
 
 	flush_dcache_range((unsigned long)buffer,
 			   (unsigned long)buffer + total_len);
 
+	memset(&c, 0, sizeof(c));
 	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
 	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+
+	start_us = timer_get_us();
+
+	/*
+	 * Split the transfer into chunks of the maximum transfer size and
+	 * keep as many of them outstanding as the I/O queue allows. Each
+	 * outstanding command uses the command slot (and its PRP list) given
+	 * by its command_id. After an error no more chunks are started and
+	 * the ones in flight are reaped before returning.
+	 */
+	while (inflight || (failed == nchunks && next < nchunks)) {
+		queued = 0;
+		while (failed == nchunks && next < nchunks &&
+		       inflight < dev->io_slots) {
+			lbaint_t lba = (lbaint_t)next << chunk_shift;
+			u32 lbas = min_t(lbaint_t, blkcnt - lba,
+					 1 << chunk_shift);
+			void *addr = buffer +
+				((ulong)next << dev->max_transfer_shift);
+			u16 slot = dev->io_next_slot;
+
+			while (dev->io_chunk[slot] != NVME_SLOT_FREE)
+				slot = (slot + 1) % dev->io_slots;
+			dev->io_next_slot = (slot + 1) % dev->io_slots;
+
+			if (nvme_setup_prps(dev, nvme_slot_prps(dev, slot),
+					    &prp2, lbas << ns->lba_shift,
+					    (ulong)addr)) {
+				failed = next;
+				break;
+			}
+			c.rw.command_id = cpu_to_le16(slot);
+			c.rw.slba = cpu_to_le64(blknr + lba);
+			c.rw.length = cpu_to_le16(lbas - 1);
+			c.rw.prp1 = cpu_to_le64((ulong)addr);
+			c.rw.prp2 = cpu_to_le64(prp2);
+			nvme_queue_cmd(nvmeq, &c);
+
+			dev->io_chunk[slot] = next++;
+			inflight++;
+			queued++;
 		}
+		if (queued)
+			nvme_ring_sq(nvmeq);
+		if (inflight > stats->max_inflight)
+			stats->max_inflight = inflight;
+		if (!inflight)
+			break;
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, (ulong)buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64((ulong)buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
+		ret = nvme_wait_cmd(nvmeq, &cmdid, NULL, IO_TIMEOUT * 100000);
+		if (ret == -ETIMEDOUT) {
+			printf("Error: %s: I/O timeout\n", udev->name);
+			/* nothing can be trusted any more */
+			for (chunk = 0; chunk < dev->io_slots; chunk++) {
+				if (dev->io_chunk[chunk] != NVME_SLOT_FREE &&
+				    dev->io_chunk[chunk] < failed)
+					failed = dev->io_chunk[chunk];
+			}
+			stats->errors++;
+
+			/*
+			 * The controller may still be working on the commands,
+			 * so their slots can only be reused once it has let go
+			 * of them. Failing that, stop it altogether and leave
+			 * the slots taken.
+			 */
+			if (nvme_reset_io_queue(dev)) {
+				printf("Error: %s: cannot reset I/O queue\n",
+				       udev->name);
+				nvme_disable_ctrl(dev);
+				dev->io_dead = true;
+				break;
+			}
+			memset(dev->io_chunk, 0xff,
+			       dev->io_slots * sizeof(*dev->io_chunk));
 			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		buffer += lbas << ns->lba_shift;
+		}
+
+		cmdid = le16_to_cpu(cmdid);
+		if (cmdid >= dev->io_slots ||
+		    dev->io_chunk[cmdid] == NVME_SLOT_FREE) {
+			printf("Error: %s: unexpected completion %u\n",
+			       udev->name, cmdid);
+			continue;
+		}
+		chunk = dev->io_chunk[cmdid];
+		dev->io_chunk[cmdid] = NVME_SLOT_FREE;
+		inflight--;
+		if (ret) {
+			stats->errors++;
+			if (chunk < failed)
+				failed = chunk;
+		}
 	}
 
 	if (read)
 		invalidate_dcache_range((unsigned long)buffer,
 					(unsigned long)buffer + total_len);
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	if (failed < nchunks)
+		blkcnt = (lbaint_t)failed << chunk_shift;
+	if (read) {
+		stats->read_bytes += (u64)blkcnt << ns->lba_shift;
+		stats->read_us += timer_get_us() - start_us;
+		stats->read_cmds += next;
+	} else {
+		stats->write_bytes += (u64)blkcnt << ns->lba_shift;
+		stats->write_us += timer_get_us() - start_us;
+		stats->write_cmds += next;
+	}
+
+	return blkcnt;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -841,21 +1021,19 @@ static int nvme_probe(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ret = nvme_setup_io_queues(ndev);
 	if (ret)
 		goto free_queue;
 
 	nvme_get_info_from_identify(ndev);
 
+	/* Allocate after the page size and maximum transfer are known */
+	ret = nvme_alloc_prp_pool(ndev);
+	if (ret) {
+		printf("Error: %s: Out of memory!\n", udev->name);
+		goto free_queue;
+	}
+
 	return 0;
 
 free_queue:
@@ -624,11 +624,35 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
-	u64 *prp_pool;
-	u32 prp_entry_num;
+	u64 *prp_pool;		/* PRP lists, one per I/O command slot */
+	u32 prp_entry_num;	/* PRP entries in each list */
+	u32 prp_slot_size;	/* bytes used by each list */
+	u32 *io_chunk;		/* chunk using each slot, or NVME_SLOT_FREE */
+	u32 io_slots;		/* I/O commands which can be outstanding */
+	u32 io_next_slot;
+	bool io_dead;		/* I/O queue given up on after a timeout */
 	u32 nn;
 };
 
+#define NVME_SLOT_FREE	(~0U)
+
+static inline u64 *nvme_slot_prps(struct nvme_dev *dev, u32 slot)
+{
+	return dev->prp_pool + slot * (dev->prp_slot_size >> 3);
+}
+
+/* I/O statistics of a namespace, shown by 'nvme detail' */
+struct nvme_io_stats {
+	u64 read_bytes;
+	u64 write_bytes;
+	u64 read_us;
+	u64 write_us;
+	u32 read_cmds;
+	u32 write_cmds;
+	u32 max_inflight;
+	u32 errors;
+};
+
 /*
  * An NVM Express namespace is equivalent to a SCSI LUN.
  * Each namespace is operated as an independent "device".
@@ -643,6 +667,7 @@ struct nvme_ns {
 	u8 flbas;
 	u64 mode_select_num_blocks;
 	u32 mode_select_block_len;
+	struct nvme_io_stats stats;
 };
 
 #endif /* __DRIVER_NVME_H__ */
@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <memalign.h>
 #include <nvme.h>
+#include <linux/math64.h>
 #include "nvme.h"
 
 static void print_optional_admin_cmd(u16 oacs, int devnum)
@@ -102,6 +103,30 @@ static void print_metadata_cap(u8 mc, int devnum)
 	       mc & 0x01 ? "yes" : "No");
 }
 
+static void print_rate(const char *name, u64 bytes, u64 us, u32 cmds)
+{
+	printf("\t%s: %llu bytes in %u commands", name, bytes, cmds);
+	if (us)
+		printf(", %llu KiB/s", div64_u64(bytes * 1000000 / 1024, us));
+	printf("\n");
+}
+
+static void print_io_stats(struct nvme_ns *ns)
+{
+	struct nvme_io_stats *stats = &ns->stats;
+
+	printf("Blk device %d: I/O statistics:\n", ns->devnum);
+	printf("\tQueue depth: %d, most commands in flight: %u\n",
+	       ns->dev->q_depth, stats->max_inflight);
+	printf("\tMaximum transfer size: %u bytes\n",
+	       1 << ns->dev->max_transfer_shift);
+	print_rate("Read", stats->read_bytes, stats->read_us,
+		   stats->read_cmds);
+	print_rate("Write", stats->write_bytes, stats->write_us,
+		   stats->write_cmds);
+	printf("\tErrors: %u\n", stats->errors);
+}
+
 int nvme_print_info(struct udevice *udev)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
@@ -124,6 +149,7 @@ int nvme_print_info(struct udevice *udev)
 	print_formats(id, ns);
 	print_data_protect_cap(id->dpc, ns->devnum);
 	print_metadata_cap(id->mc, ns->devnum);
+	print_io_stats(ns);
 
 	return 0;
 }
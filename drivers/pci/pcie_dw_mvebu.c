@@ -73,6 +73,7 @@ DECLARE_GLOBAL_DATA_PTR;
 #define PCIE_ROOT_COMPLEX_MODE_MASK	(0xF << 4)
 
 #define PCIE_LINK_UP_TIMEOUT_MS		100
+#define PCIE_RESET_DELAY_MS		200
 
 #define PCIE_GLOBAL_CONTROL		0x8000
 #define PCIE_APP_LTSSM_EN		(1 << 2)
@@ -106,6 +107,9 @@ DECLARE_GLOBAL_DATA_PTR;
  *               first_busno stores the bus number of the PCIe root-port
  *               number which may vary depending on the PCIe setup
  *               (PEX switches etc).
+ * @state: What the probe is waiting for
+ * @start: Time (in ms) at which the current probe state was entered
+ * @reset_gpio: GPIO resetting the add-in card, if any
  */
 struct pcie_dw_mvebu {
 	void *ctrl_base;
@@ -117,6 +121,16 @@ struct pcie_dw_mvebu {
 	int region_count;
 	struct pci_region io;
 	struct pci_region mem;
+
+	enum {
+		PCIE_DW_CARD_RESET,
+		PCIE_DW_CARD_RELEASE,
+		PCIE_DW_LINK_TRAINING,
+	} state;
+	ulong start;
+#if CONFIG_IS_ENABLED(DM_GPIO)
+	struct gpio_desc reset_gpio;
+#endif
 };
 
 static int pcie_dw_get_link_speed(const void *regs_base)
@@ -365,37 +379,16 @@ static int is_link_up(const void *regs_base)
 }
 
 /**
- * wait_link_up() - Wait for the link to come up
- *
- * @regs_base: A pointer to the PCIe controller registers
- *
- * Return: 1 (true) for active line and 0 (false) for no link (timeout)
- */
-static int wait_link_up(const void *regs_base)
-{
-	unsigned long timeout;
-
-	timeout = get_timer(0) + PCIE_LINK_UP_TIMEOUT_MS;
-	while (!is_link_up(regs_base)) {
-		if (get_timer(0) > timeout)
-			return 0;
-	};
-
-	return 1;
-}
-
-/**
- * pcie_dw_mvebu_pcie_link_up() - Configure the PCIe root port
+ * pcie_dw_mvebu_link_start() - Configure the PCIe root port
  *
  * @regs_base: A pointer to the PCIe controller registers
  * @cap_speed: The capabilities and speed to configure
  *
  * Configure the PCIe controller root complex depending on the
- * requested link capabilities and speed.
- *
- * Return: 1 (true) for active line and 0 (false) for no link
+ * requested link capabilities and speed, and start link training.
+ * is_link_up() tells when the link has been established.
  */
-static int pcie_dw_mvebu_pcie_link_up(const void *regs_base, u32 cap_speed)
+static void pcie_dw_mvebu_link_start(const void *regs_base, u32 cap_speed)
 {
 	if (!is_link_up(regs_base)) {
 		/* Disable LTSSM state machine to enable configuration */
@@ -419,18 +412,6 @@ static int pcie_dw_mvebu_pcie_link_up(const void *regs_base, u32 cap_speed)
 		setbits_le32(regs_base + PCIE_GLOBAL_CONTROL,
 			     PCIE_APP_LTSSM_EN);
 	}
-
-	/* Check that link was established */
-	if (!wait_link_up(regs_base))
-		return 0;
-
-	/*
-	 * Link can be established in Gen 1. still need to wait
-	 * till MAC nagaotiation is completed
-	 */
-	udelay(100);
-
-	return 1;
 }
 
 /**
@@ -466,25 +447,34 @@ static void pcie_dw_set_host_bars(const void *regs_base)
 	writel(size, regs_base + RESIZABLE_BAR_CTL0);
 }
 
+/* Move on to the next probe state */
+static void pcie_dw_mvebu_set_state(struct pcie_dw_mvebu *pcie, int state)
+{
+	pcie->state = state;
+	pcie->start = get_timer(0);
+
+	if (state == PCIE_DW_LINK_TRAINING)
+		pcie_dw_mvebu_link_start(pcie->ctrl_base, LINK_SPEED_GEN_3);
+}
+
 /**
- * pcie_dw_mvebu_probe() - Probe the PCIe bus for active link
+ * pcie_dw_mvebu_probe() - Start probing the PCIe bus for active link
  *
  * @dev: A pointer to the device being operated on
  *
- * Probe for an active link on the PCIe bus and configure the controller
- * to enable this port.
+ * Reset the add-in card and start link training. pcie_dw_mvebu_probe_poll()
+ * waits for these to complete.
  *
- * Return: 0 on success, else -ENODEV
+ * Return: -EINPROGRESS
  */
 static int pcie_dw_mvebu_probe(struct udevice *dev)
 {
 	struct pcie_dw_mvebu *pcie = dev_get_priv(dev);
-	struct udevice *ctlr = pci_get_controller(dev);
-	struct pci_controller *hose = dev_get_uclass_priv(ctlr);
-#if CONFIG_IS_ENABLED(DM_GPIO)
-	struct gpio_desc reset_gpio;
 
-	gpio_request_by_name(dev, "marvell,reset-gpio", 0, &reset_gpio,
+	pcie->first_busno = dev->seq;
+
+#if CONFIG_IS_ENABLED(DM_GPIO)
+	gpio_request_by_name(dev, "marvell,reset-gpio", 0, &pcie->reset_gpio,
 			     GPIOD_IS_OUT);
 	/*
 	 * Issue reset to add-in card trough the dedicated GPIO.
@@ -493,22 +483,69 @@ static int pcie_dw_mvebu_probe(struct udevice *dev)
 	 * In the last case we have to release a reset of the addon card
 	 * using this GPIO.
 	 */
-	if (dm_gpio_is_valid(&reset_gpio)) {
-		dm_gpio_set_value(&reset_gpio, 1); /* assert */
-		mdelay(200);
-		dm_gpio_set_value(&reset_gpio, 0); /* de-assert */
-		mdelay(200);
+	if (dm_gpio_is_valid(&pcie->reset_gpio)) {
+		dm_gpio_set_value(&pcie->reset_gpio, 1); /* assert */
+		pcie_dw_mvebu_set_state(pcie, PCIE_DW_CARD_RESET);
+
+		return -EINPROGRESS;
 	}
 #else
 	debug("PCIE Reset on GPIO support is missing\n");
 #endif /* DM_GPIO */
 
-	pcie->first_busno = dev->seq;
+	pcie_dw_mvebu_set_state(pcie, PCIE_DW_LINK_TRAINING);
+
+	return -EINPROGRESS;
+}
+
+/**
+ * pcie_dw_mvebu_probe_poll() - Finish probing the PCIe bus for active link
+ *
+ * @dev: A pointer to the device being operated on
+ *
+ * Once the link is up, or has failed to come up in time, configure the
+ * controller to enable this port.
+ *
+ * Return: -EINPROGRESS while waiting, else 0
+ */
+static int pcie_dw_mvebu_probe_poll(struct udevice *dev)
+{
+	struct pcie_dw_mvebu *pcie = dev_get_priv(dev);
+	struct udevice *ctlr = pci_get_controller(dev);
+	struct pci_controller *hose = dev_get_uclass_priv(ctlr);
+	ulong elapsed = get_timer(pcie->start);
+
+	switch (pcie->state) {
+#if CONFIG_IS_ENABLED(DM_GPIO)
+	case PCIE_DW_CARD_RESET:
+		if (elapsed < PCIE_RESET_DELAY_MS)
+			return -EINPROGRESS;
+		dm_gpio_set_value(&pcie->reset_gpio, 0); /* de-assert */
+		pcie_dw_mvebu_set_state(pcie, PCIE_DW_CARD_RELEASE);
+		return -EINPROGRESS;
+	case PCIE_DW_CARD_RELEASE:
+		if (elapsed < PCIE_RESET_DELAY_MS)
+			return -EINPROGRESS;
+		pcie_dw_mvebu_set_state(pcie, PCIE_DW_LINK_TRAINING);
+		return -EINPROGRESS;
+#endif
+	default:
+		if (!is_link_up(pcie->ctrl_base) &&
+		    elapsed <= PCIE_LINK_UP_TIMEOUT_MS)
+			return -EINPROGRESS;
+		break;
+	}
 
 	/* Don't register host if link is down */
-	if (!pcie_dw_mvebu_pcie_link_up(pcie->ctrl_base, LINK_SPEED_GEN_3)) {
+	if (!is_link_up(pcie->ctrl_base)) {
 		printf("PCIE-%d: Link down\n", dev->seq);
 	} else {
+		/*
+		 * Link can be established in Gen 1. still need to wait
+		 * till MAC nagaotiation is completed
+		 */
+		udelay(100);
+
 		printf("PCIE-%d: Link up (Gen%d-x%d, Bus%d)\n", dev->seq,
 		       pcie_dw_get_link_speed(pcie->ctrl_base),
 		       pcie_dw_get_link_width(pcie->ctrl_base),
@@ -593,5 +630,6 @@ U_BOOT_DRIVER(pcie_dw_mvebu) = {
 	.ops			= &pcie_dw_mvebu_ops,
 	.ofdata_to_platdata	= pcie_dw_mvebu_ofdata_to_platdata,
 	.probe			= pcie_dw_mvebu_probe,
+	.probe_poll		= pcie_dw_mvebu_probe_poll,
 	.priv_auto_alloc_size	= sizeof(struct pcie_dw_mvebu),
 };
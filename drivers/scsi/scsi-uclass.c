@@ -32,6 +32,18 @@ int scsi_bus_reset(struct udevice *dev)
 	return ops->bus_reset(dev);
 }
 
+int scsi_show_stats(struct udevice *dev)
+{
+	struct scsi_ops *ops = scsi_get_ops(dev);
+
+	if (!ops->show_stats)
+		return -ENOSYS;
+
+	ops->show_stats(dev);
+
+	return 0;
+}
+
 UCLASS_DRIVER(scsi) = {
 	.id		= UCLASS_SCSI,
 	.name		= "scsi",
@@ -605,8 +605,11 @@ static int xhci_set_configuration(struct usb_device *udev)
 		ep_index = xhci_get_ep_index(endpt_desc);
 		ep_ctx[ep_index] = xhci_get_ep_ctx(ctrl, in_ctx, ep_index);
 
-		/* Allocate the ep rings */
-		virt_dev->eps[ep_index].ring = xhci_ring_alloc(1, true);
+		/* Allocate the ep rings, larger ones for bulk transfers */
+		virt_dev->eps[ep_index].ring =
+			xhci_ring_alloc(usb_endpoint_xfer_bulk(endpt_desc) ?
+					CONFIG_USB_XHCI_BULK_RING_SEGMENTS : 1,
+					true);
 		if (!virt_dev->eps[ep_index].ring)
 			return -ENOMEM;
 
@@ -1517,13 +1520,16 @@ static int xhci_update_hub_device(struct udevice *dev, struct usb_device *udev)
 static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
 {
 	/*
-	 * xHCD allocates one segment which includes 64 TRBs for each endpoint
-	 * and the last TRB in this segment is configured as a link TRB to form
-	 * a TRB ring. Each TRB can transfer up to 64K bytes, however data
-	 * buffers referenced by transfer TRBs shall not span 64KB boundaries.
-	 * Hence the maximum number of TRBs we can use in one transfer is 62.
+	 * xHCD allocates CONFIG_USB_XHCI_BULK_RING_SEGMENTS segments of 64 TRBs
+	 * for each bulk endpoint and the last TRB in each segment is
+	 * configured as a link TRB to form a TRB ring. Each TRB can transfer
+	 * up to 64K bytes, however data buffers referenced by transfer TRBs
+	 * shall not span 64KB boundaries, so a buffer which is not 64K aligned
+	 * needs one more TRB. Hence with one segment the maximum number of
+	 * TRBs we can use in one transfer is 62.
 	 */
-	*size = (TRBS_PER_SEGMENT - 2) * TRB_MAX_BUFF_SIZE;
+	*size = (CONFIG_USB_XHCI_BULK_RING_SEGMENTS * (TRBS_PER_SEGMENT - 1) - 1) *
+		TRB_MAX_BUFF_SIZE;
 
 	return 0;
 }
@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <hang.h>
 #include <log.h>
+#include <smp_work.h>
 #include <time.h>
 #include <wdt.h>
 #include <dm/device-internal.h>
@@ -125,6 +126,10 @@ void watchdog_reset(void)
 	if (!gd || !(gd->flags & GD_FLG_WDT_READY))
 		return;
 
+	/* Only the boot CPU may use driver model */
+	if (smp_work_is_secondary())
+		return;
+
 	/* Do not reset the watchdog too often */
 	now = get_timer(0);
 	if (time_after(now, next_reset)) {
@@ -12,6 +12,7 @@
 #include <dm.h>
 #include <env.h>
 #include <env_internal.h>
+#include <env_log.h>
 #include <flash.h>
 #include <malloc.h>
 #include <spi.h>
@@ -27,7 +28,7 @@
 #define INITENV
 #endif
 
-#ifdef CONFIG_ENV_OFFSET_REDUND
+#if defined(CONFIG_ENV_OFFSET_REDUND) && !defined(CONFIG_ENV_SF_LOG)
 static ulong env_offset		= CONFIG_ENV_OFFSET;
 static ulong env_new_offset	= CONFIG_ENV_OFFSET_REDUND;
 #endif /* CONFIG_ENV_OFFSET_REDUND */
@@ -87,7 +88,400 @@ extern void board_get_env_spi_bus_cs(int *bus, int *cs);
 	return 0;
 }
 
-#if defined(CONFIG_ENV_OFFSET_REDUND)
+#if defined(CONFIG_ENV_SF_LOG)
+/*
+ * The environment is kept as a log (see env_log.h), so that saveenv only has
+ * to write the variables which changed since the environment was last loaded
+ * or saved. The area is erased only once the log fills it up.
+ */
+#ifdef CONFIG_ENV_OFFSET_REDUND
+#define ENV_LOG_AREAS		2
+#else
+#define ENV_LOG_AREAS		1
+#endif
+
+/* Largest environment which fits in an area as a single record */
+#define ENV_LOG_DATA_MAX	(CONFIG_ENV_SIZE - sizeof(struct env_log_hdr) - \
+				 sizeof(struct env_log_rec))
+
+static u32 env_log_gen;		/* Generation of the current log */
+static u32 env_log_len;		/* Length of the current log */
+static bool env_log_dirty;	/* Log must be rewritten before appending */
+static char *env_log_saved;	/* Environment as it is in flash, or NULL */
+
+static ulong env_log_area(int redund)
+{
+#ifdef CONFIG_ENV_OFFSET_REDUND
+	if (redund)
+		return CONFIG_ENV_OFFSET_REDUND;
+#endif
+#if defined(CONFIG_ARCH_CN10K)
+extern void board_get_env_offset(int *offset, const char *property);
+	int env_offset;
+
+	board_get_env_offset(&env_offset, "u-boot,env-offset");
+	if (env_offset != -1)
+		return env_offset;
+#endif
+	return CONFIG_ENV_OFFSET;
+}
+
+/* Export the environment sorted by name, returning the length of the data */
+static int env_log_export(char *data)
+{
+	char *p;
+
+	if (hexport_r(&env_htab, '\0', 0, &data, ENV_LOG_DATA_MAX, 0,
+		      NULL) < 0) {
+		pr_err("Cannot export environment: errno = %d\n", errno);
+		return -EIO;
+	}
+	for (p = data; *p; p += strlen(p) + 1)
+		;
+
+	return p + 1 - data;
+}
+
+/* Compare the names of two "name=value" strings */
+static int env_log_cmp(const char *a, const char *b)
+{
+	int alen = strchrnul(a, '=') - a;
+	int blen = strchrnul(b, '=') - b;
+	int ret = memcmp(a, b, min(alen, blen));
+
+	return ret ? ret : alen - blen;
+}
+
+/*
+ * Put the changes between two exported environments into @data, as the data
+ * of a log record. Both are sorted by name, so they are walked side by side.
+ * Returns the length of the data, 1 if nothing changed or -ENOSPC if it does
+ * not fit in @size bytes.
+ */
+static int env_log_diff(const char *old, const char *new, char *data,
+			int size)
+{
+	const char *var;
+	char *p = data;
+	int cmp, len;
+
+	while (*old || *new) {
+		if (!*old)
+			cmp = 1;
+		else if (!*new)
+			cmp = -1;
+		else
+			cmp = env_log_cmp(old, new);
+
+		/* Deleted variables are written as just their name */
+		len = 0;
+		if (cmp < 0) {
+			var = old;
+			len = strchrnul(old, '=') - old;
+		} else if (cmp > 0 || strcmp(old, new)) {
+			var = new;
+			len = strlen(new);
+		}
+		if (len) {
+			if (p + len + 2 > data + size)
+				return -ENOSPC;
+			memcpy(p, var, len);
+			p[len] = '\0';
+			p += len + 1;
+		}
+
+		if (cmp <= 0)
+			old += strlen(old) + 1;
+		if (cmp >= 0)
+			new += strlen(new) + 1;
+	}
+	*p++ = '\0';
+
+	return p - data;
+}
+
+/*
+ * Check the log read from an area. Returns the length of its valid part, or
+ * 0 if it does not hold an environment. Anything but erased flash after the
+ * valid part, e.g. a record cut short by a power failure, means the log has
+ * to be rewritten before anything can be appended to it.
+ */
+static u32 env_log_check(const char *buf, u32 *genp, bool *dirtyp)
+{
+	const struct env_log_hdr *hdr = (const struct env_log_hdr *)buf;
+	const struct env_log_rec *rec;
+	u32 pos, len;
+
+	if (le32_to_cpu(hdr->magic) != ENV_LOG_MAGIC ||
+	    le32_to_cpu(hdr->crc) != crc32(0, (const u8 *)hdr,
+					   offsetof(struct env_log_hdr, crc)))
+		return 0;
+
+	for (pos = sizeof(*hdr); pos + sizeof(*rec) <= CONFIG_ENV_SIZE;
+	     pos += ENV_LOG_REC_SIZE(len)) {
+		rec = (const struct env_log_rec *)(buf + pos);
+		len = le32_to_cpu(rec->len);
+		if (len > CONFIG_ENV_SIZE - pos - sizeof(*rec) ||
+		    le32_to_cpu(rec->crc) != crc32(0, (const u8 *)(rec + 1),
+						   len))
+			break;
+	}
+
+	/* The first record holds the whole environment */
+	if (pos == sizeof(*hdr))
+		return 0;
+
+	*genp = le32_to_cpu(hdr->gen);
+	*dirtyp = false;
+	for (len = pos; len < CONFIG_ENV_SIZE; len++) {
+		if (buf[len] != (char)0xff) {
+			*dirtyp = true;
+			break;
+		}
+	}
+
+	return pos;
+}
+
+/* Import the environment, then each change made to it in turn */
+static int env_log_import(const char *buf, u32 end, int flags)
+{
+	const struct env_log_rec *rec;
+	u32 pos, len;
+
+	for (pos = sizeof(struct env_log_hdr); pos < end;
+	     pos += ENV_LOG_REC_SIZE(len)) {
+		rec = (const struct env_log_rec *)(buf + pos);
+		len = le32_to_cpu(rec->len);
+		if (!himport_r(&env_htab, (const char *)(rec + 1), len, '\0',
+			       flags, 0, 0, NULL)) {
+			pr_err("Cannot import environment: errno = %d\n",
+			       errno);
+			env_set_default("import failed", 0);
+			return -EIO;
+		}
+		flags |= H_NOCLEAR;
+	}
+	gd->flags |= GD_FLG_ENV_READY;
+
+	return 0;
+}
+
+/* Append a record, whose data is already in place after @rec, to the log */
+static int env_log_append(struct env_log_rec *rec, u32 len)
+{
+	ulong offset = env_log_area(gd->env_valid == ENV_REDUND);
+	int ret;
+
+	rec->len = cpu_to_le32(len);
+	rec->crc = cpu_to_le32(crc32(0, (u8 *)(rec + 1), len));
+
+	puts("Writing to SPI flash...");
+	ret = spi_flash_write(env_flash, offset + env_log_len,
+			      sizeof(*rec) + len, rec);
+	if (ret)
+		return ret;
+	env_log_len += ENV_LOG_REC_SIZE(len);
+
+	return 0;
+}
+
+/*
+ * Start a new log holding the whole environment, whose data is already in
+ * place in @buf after the log and record headers
+ */
+static int env_log_rewrite(char *buf, u32 len)
+{
+	struct env_log_hdr *hdr = (struct env_log_hdr *)buf;
+	struct env_log_rec *rec = (struct env_log_rec *)(hdr + 1);
+	u32 saved_size, saved_offset, sector;
+	char *saved_buffer = NULL;
+	int redund = 0;
+	ulong offset;
+	int ret;
+
+#ifdef CONFIG_ENV_OFFSET_REDUND
+	/* Keep the current log until the new one is complete */
+	redund = gd->env_valid != ENV_REDUND;
+#endif
+	offset = env_log_area(redund);
+
+	/* Is the sector larger than the env (i.e. embedded) */
+	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
+		saved_size = CONFIG_ENV_SECT_SIZE - CONFIG_ENV_SIZE;
+		saved_offset = offset + CONFIG_ENV_SIZE;
+		saved_buffer = memalign(ARCH_DMA_MINALIGN, saved_size);
+		if (!saved_buffer)
+			return -ENOMEM;
+
+		ret = spi_flash_read(env_flash, saved_offset,
+				     saved_size, saved_buffer);
+		if (ret)
+			goto done;
+	}
+
+	sector = DIV_ROUND_UP(CONFIG_ENV_SIZE, CONFIG_ENV_SECT_SIZE);
+
+	puts("Erasing SPI flash...");
+	ret = spi_flash_erase(env_flash, offset,
+			      sector * CONFIG_ENV_SECT_SIZE);
+	if (ret)
+		goto done;
+
+	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
+		ret = spi_flash_write(env_flash, saved_offset,
+				      saved_size, saved_buffer);
+		if (ret)
+			goto done;
+	}
+
+	puts("Writing to SPI flash...");
+	rec->len = cpu_to_le32(len);
+	rec->crc = cpu_to_le32(crc32(0, (u8 *)(rec + 1), len));
+	ret = spi_flash_write(env_flash, offset + sizeof(*hdr),
+			      sizeof(*rec) + len, rec);
+	if (ret)
+		goto done;
+
+	/* Write the header last, so that a partly written log is not used */
+	hdr->magic = cpu_to_le32(ENV_LOG_MAGIC);
+	hdr->gen = cpu_to_le32(env_log_gen + 1);
+	hdr->crc = cpu_to_le32(crc32(0, (u8 *)hdr,
+				     offsetof(struct env_log_hdr, crc)));
+	ret = spi_flash_write(env_flash, offset, sizeof(*hdr), hdr);
+	if (ret)
+		goto done;
+
+	env_log_gen++;
+	env_log_len = sizeof(*hdr) + ENV_LOG_REC_SIZE(len);
+	env_log_dirty = false;
+	gd->env_valid = redund ? ENV_REDUND : ENV_VALID;
+
+done:
+	free(saved_buffer);
+
+	return ret;
+}
+
+static int env_sf_save(void)
+{
+	struct env_log_rec *rec;
+	char *buf, *diff, *data;
+	int len, size, ret;
+
+	buf = memalign(ARCH_DMA_MINALIGN, CONFIG_ENV_SIZE);
+	diff = memalign(ARCH_DMA_MINALIGN, CONFIG_ENV_SIZE);
+	if (!buf || !diff) {
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	ret = setup_flash_device();
+	if (ret)
+		goto done;
+
+	data = buf + sizeof(struct env_log_hdr) + sizeof(*rec);
+	len = env_log_export(data);
+	if (len < 0) {
+		ret = len;
+		goto done;
+	}
+
+	ret = -ENOSPC;
+	size = CONFIG_ENV_SIZE - env_log_len - (int)sizeof(*rec);
+	if (env_log_saved && !env_log_dirty && size > 1) {
+		rec = (struct env_log_rec *)diff;
+		ret = env_log_diff(env_log_saved, data, (char *)(rec + 1),
+				   size);
+		if (ret == 1) {
+			puts("unchanged\n");
+			ret = 0;
+			goto done;
+		}
+		if (ret > 0)
+			ret = env_log_append(rec, ret);
+	}
+	if (ret == -ENOSPC)
+		ret = env_log_rewrite(buf, len);
+	if (ret)
+		goto done;
+
+	if (!env_log_saved)
+		env_log_saved = malloc(CONFIG_ENV_SIZE);
+	if (env_log_saved)
+		memcpy(env_log_saved, data, len);
+	puts("done\n");
+
+done:
+	free(buf);
+	free(diff);
+
+	return ret;
+}
+
+static int env_sf_load(void)
+{
+	char *buf[ENV_LOG_AREAS] = { NULL };
+	u32 end[ENV_LOG_AREAS], gen[ENV_LOG_AREAS];
+	bool dirty[ENV_LOG_AREAS];
+	int ret, i, cur = -1;
+
+	/* Until a log is loaded, saveenv has to start a new one */
+	env_log_dirty = true;
+
+	for (i = 0; i < ENV_LOG_AREAS; i++) {
+		buf[i] = memalign(ARCH_DMA_MINALIGN, CONFIG_ENV_SIZE);
+		if (!buf[i]) {
+			env_set_default("malloc() failed", 0);
+			ret = -EIO;
+			goto out;
+		}
+	}
+
+	ret = setup_flash_device();
+	if (ret)
+		goto out;
+
+	/* Use the area with the newest log */
+	for (i = 0; i < ENV_LOG_AREAS; i++) {
+		end[i] = 0;
+		if (!spi_flash_read(env_flash, env_log_area(i),
+				    CONFIG_ENV_SIZE, buf[i]))
+			end[i] = env_log_check(buf[i], &gen[i], &dirty[i]);
+		if (end[i] && (cur < 0 || (s32)(gen[i] - gen[cur]) > 0))
+			cur = i;
+	}
+	if (cur < 0) {
+		env_set_default("bad CRC", 0);
+		ret = -ENOMSG; /* needed for env_load() */
+		goto err_read;
+	}
+
+	ret = env_log_import(buf[cur], end[cur], H_EXTERNAL);
+	if (ret)
+		goto err_read;
+
+	gd->env_valid = cur ? ENV_REDUND : ENV_VALID;
+	env_log_gen = gen[cur];
+	env_log_len = end[cur];
+	env_log_dirty = dirty[cur];
+
+	/* Keep what is in flash, to find out what saveenv has to write */
+	if (!env_log_saved)
+		env_log_saved = malloc(CONFIG_ENV_SIZE);
+	if (!env_log_saved || env_log_export(env_log_saved) < 0)
+		env_log_dirty = true;
+
+err_read:
+	spi_flash_free(env_flash);
+	env_flash = NULL;
+out:
+	for (i = 0; i < ENV_LOG_AREAS; i++)
+		free(buf[i]);
+
+	return ret;
+}
+#elif defined(CONFIG_ENV_OFFSET_REDUND)
 static int env_sf_save(void)
 {
 	env_t	env_new;
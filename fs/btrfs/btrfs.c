@@ -211,6 +211,7 @@ int btrfs_read(const char *file, void *buf, loff_t offset, loff_t len,
 
 void btrfs_close(void)
 {
+	btrfs_extent_cache_exit();
 	btrfs_chunk_map_exit();
 }
 
@@ -11,6 +11,41 @@
 #include <linux/rbtree.h>
 #include "conv-funcs.h"
 
+/*
+ * File extent resolved to where its data lies on the device. Extents which are
+ * neither inline nor compressed have physical pointing at the first byte of
+ * the file data they hold. Compressed extents need disk_len bytes read from
+ * physical and decompressed to ram_bytes, the file data starting at offset in
+ * the result. A physical of 0 marks a hole.
+ */
+struct btrfs_extent_map {
+	u64 start;
+	u64 len;
+	u64 physical;
+	u64 disk_len;
+	u64 offset;
+	u64 ram_bytes;
+	u8 compression;
+	char *inline_data;
+};
+
+/*
+ * Extent maps of the last file read, and the buffers compressed extents are
+ * read and decompressed into, kept until the filesystem is closed.
+ */
+struct btrfs_extent_cache {
+	u64 root;
+	u64 inr;
+	int count;
+	int size;
+	struct btrfs_extent_map *maps;
+
+	char *cbuf;
+	u64 cbuf_len;
+	char *dbuf;
+	u64 dbuf_len;
+};
+
 struct btrfs_info {
 	struct btrfs_super_block sb;
 
@@ -19,6 +54,8 @@ struct btrfs_info {
 	struct btrfs_root chunk_root;
 
 	struct rb_root chunks_root;
+
+	struct btrfs_extent_cache extent_cache;
 };
 
 extern struct btrfs_info btrfs_info;
@@ -78,10 +115,9 @@ u64 btrfs_file_read(const struct btrfs_root *, u64, u64, u64, char *);
 u64 btrfs_get_default_subvol_objectid(void);
 
 /* extent-io.c */
-u64 btrfs_read_extent_inline(struct btrfs_path *,
-			      struct btrfs_file_extent_item *, u64, u64,
-			      char *);
-u64 btrfs_read_extent_reg(struct btrfs_path *, struct btrfs_file_extent_item *,
-			   u64, u64, char *);
+struct btrfs_extent_cache *btrfs_map_file_extents(const struct btrfs_root *,
+						  u64);
+u64 btrfs_read_extents(struct btrfs_extent_cache *, u64, u64, char *);
+void btrfs_extent_cache_exit(void);
 
 #endif /* !__BTRFS_BTRFS_H__ */
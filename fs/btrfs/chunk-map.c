@@ -16,6 +16,9 @@ struct chunk_map_item {
 	u64 physical;
 };
 
+/* Chunk the last address was mapped in, tried first on the next lookup */
+static struct chunk_map_item *last_item;
+
 static int add_chunk_mapping(struct btrfs_key *key, struct btrfs_chunk *chunk)
 {
 	struct btrfs_stripe *stripe;
@@ -72,17 +75,23 @@ u64 btrfs_map_logical_to_physical(u64 logical)
 {
 	struct rb_node *node = btrfs_info.chunks_root.rb_node;
 
+	if (last_item && logical >= last_item->logical &&
+	    logical < last_item->logical + last_item->length)
+		return last_item->physical + logical - last_item->logical;
+
 	while (node) {
 		struct chunk_map_item *item;
 
 		item = rb_entry(node, struct chunk_map_item, node);
 
-		if (item->logical > logical)
+		if (item->logical > logical) {
 			node = node->rb_left;
-		else if (logical >= item->logical + item->length)
+		} else if (logical >= item->logical + item->length) {
 			node = node->rb_right;
-		else
+		} else {
+			last_item = item;
 			return item->physical + logical - item->logical;
+		}
 	}
 
 	printf("%s: Cannot map logical address %llu to physical\n", __func__,
@@ -96,6 +105,7 @@ void btrfs_chunk_map_exit(void)
 	struct rb_node *now, *next;
 	struct chunk_map_item *item;
 
+	last_item = NULL;
 	for (now = rb_first_postorder(&btrfs_info.chunks_root); now; now = next)
 	{
 		item = rb_entry(now, struct chunk_map_item, node);
@@ -114,6 +124,7 @@ int btrfs_chunk_map_init(void)
 	struct btrfs_chunk *chunk;
 
 	btrfs_info.chunks_root = RB_ROOT;
+	last_item = NULL;
 
 	memcpy(sys_chunk_array_copy, btrfs_info.sb.sys_chunk_array,
 	       sizeof(sys_chunk_array_copy));
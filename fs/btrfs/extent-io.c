@@ -9,118 +9,261 @@
 #include <malloc.h>
 #include <memalign.h>
 
-u64 btrfs_read_extent_inline(struct btrfs_path *path,
-			     struct btrfs_file_extent_item *extent, u64 offset,
-			     u64 size, char *out)
+static void free_extent_maps(struct btrfs_extent_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+		free(cache->maps[i].inline_data);
+	free(cache->maps);
+
+	cache->maps = NULL;
+	cache->count = 0;
+	cache->size = 0;
+	cache->inr = 0;
+}
+
+static int add_extent_map(struct btrfs_extent_cache *cache, u64 start,
+			  struct btrfs_path *path,
+			  struct btrfs_file_extent_item *extent)
 {
-	u32 clen, dlen, orig_size = size, res;
-	const char *cbuf;
-	char *dbuf;
 	const int data_off = offsetof(struct btrfs_file_extent_item,
 				      disk_bytenr);
+	struct btrfs_extent_map *em;
 
-	clen = btrfs_path_item_size(path) - data_off;
-	cbuf = (const char *) extent + data_off;
-	dlen = extent->ram_bytes;
+	if (cache->count == cache->size) {
+		em = realloc(cache->maps,
+			     (cache->size * 2 + 16) * sizeof(*em));
+		if (!em)
+			return -1;
 
-	if (offset > dlen)
-		return -1ULL;
+		cache->maps = em;
+		cache->size = cache->size * 2 + 16;
+	}
+
+	em = &cache->maps[cache->count];
+	memset(em, 0, sizeof(*em));
+	em->start = start;
 
-	if (size > dlen - offset)
-		size = dlen - offset;
+	if (extent->type == BTRFS_FILE_EXTENT_INLINE) {
+		btrfs_file_extent_item_to_cpu_inl(extent);
+		em->disk_len = btrfs_path_item_size(path) - data_off;
+		em->inline_data = malloc(em->disk_len);
+		if (!em->inline_data)
+			return -1;
 
-	if (extent->compression == BTRFS_COMPRESS_NONE) {
-		memcpy(out, cbuf + offset, size);
-		return size;
+		memcpy(em->inline_data, (char *) extent + data_off,
+		       em->disk_len);
+		em->len = extent->ram_bytes;
+		em->ram_bytes = extent->ram_bytes;
+		em->compression = extent->compression;
+		if (em->compression == BTRFS_COMPRESS_NONE &&
+		    em->len > em->disk_len)
+			em->len = em->disk_len;
+		cache->count++;
+		return 0;
 	}
 
-	if (dlen > orig_size) {
-		dbuf = malloc(dlen);
-		if (!dbuf)
-			return -1ULL;
+	btrfs_file_extent_item_to_cpu(extent);
+	em->len = extent->num_bytes;
+	em->compression = extent->compression;
+	cache->count++;
+
+	/* sparse and preallocated extents read as zeroes */
+	if (extent->disk_bytenr == 0 ||
+	    extent->type == BTRFS_FILE_EXTENT_PREALLOC)
+		return 0;
+
+	em->physical = btrfs_map_logical_to_physical(extent->disk_bytenr);
+	if (em->physical == -1ULL)
+		return -1;
+
+	if (em->compression == BTRFS_COMPRESS_NONE) {
+		em->physical += extent->offset;
 	} else {
-		dbuf = out;
+		em->disk_len = extent->disk_num_bytes;
+		em->offset = extent->offset;
+		em->ram_bytes = extent->ram_bytes;
 	}
 
-	res = btrfs_decompress(extent->compression, cbuf, clen, dbuf, dlen);
-	if (res == -1 || res != dlen)
-		goto err;
+	return 0;
+}
 
-	if (dlen > orig_size) {
-		memcpy(out, dbuf + offset, size);
-		free(dbuf);
-	} else if (offset) {
-		memmove(out, dbuf + offset, size);
+struct btrfs_extent_cache *btrfs_map_file_extents(const struct btrfs_root *root,
+						  u64 inr)
+{
+	struct btrfs_extent_cache *cache = &btrfs_info.extent_cache;
+	struct btrfs_file_extent_item *extent;
+	struct btrfs_path path;
+	struct btrfs_key key, *found_key;
+	int res;
+
+	if (cache->inr == inr && cache->root == root->objectid)
+		return cache;
+
+	free_extent_maps(cache);
+
+	key.objectid = inr;
+	key.type = BTRFS_EXTENT_DATA_KEY;
+	key.offset = 0;
+
+	if (btrfs_search_tree(root, &key, &path))
+		return NULL;
+
+	do {
+		found_key = btrfs_path_leaf_key(&path);
+		if (btrfs_comp_keys_type(&key, found_key)) {
+			res = 1;
+			break;
+		}
+
+		extent = btrfs_path_item_ptr(&path,
+					     struct btrfs_file_extent_item);
+		if (add_extent_map(cache, found_key->offset, &path, extent)) {
+			res = -1;
+			break;
+		}
+	} while (!(res = btrfs_next_slot(&path)));
+
+	btrfs_free_path(&path);
+
+	if (res < 0) {
+		free_extent_maps(cache);
+		return NULL;
 	}
 
-	return size;
+	cache->root = root->objectid;
+	cache->inr = inr;
 
-err:
-	if (dlen > orig_size)
-		free(dbuf);
-	return -1ULL;
+	return cache;
 }
 
-u64 btrfs_read_extent_reg(struct btrfs_path *path,
-			  struct btrfs_file_extent_item *extent, u64 offset,
-			  u64 size, char *out)
+/*
+ * The buffers compressed extents are read and decompressed into are kept
+ * across extents and only replaced when a larger one is needed.
+ */
+static char *grow_buf(char **buf, u64 *buf_len, u64 len)
 {
-	u64 physical, clen, dlen, orig_size = size;
-	u32 res;
-	char *cbuf, *dbuf;
+	if (len > *buf_len) {
+		free(*buf);
+		*buf = malloc_cache_aligned(len);
+		*buf_len = *buf ? len : 0;
+	}
 
-	clen = extent->disk_num_bytes;
-	dlen = extent->num_bytes;
+	return *buf;
+}
 
-	if (offset > dlen)
-		return -1ULL;
+static u64 read_compressed(struct btrfs_extent_cache *cache,
+			   struct btrfs_extent_map *em, u64 offset, u64 size,
+			   char *out)
+{
+	char *cbuf, *dbuf;
+	u32 res;
 
-	if (size > dlen - offset)
-		size = dlen - offset;
+	if (em->inline_data) {
+		cbuf = em->inline_data;
+	} else {
+		cbuf = grow_buf(&cache->cbuf, &cache->cbuf_len, em->disk_len);
+		if (!cbuf)
+			return -1ULL;
 
-	/* sparse extent */
-	if (extent->disk_bytenr == 0) {
-		memset(out, 0, size);
-		return size;
+		if (!btrfs_devread(em->physical, em->disk_len, cbuf))
+			return -1ULL;
 	}
 
-	physical = btrfs_map_logical_to_physical(extent->disk_bytenr);
-	if (physical == -1ULL)
-		return -1ULL;
-
-	if (extent->compression == BTRFS_COMPRESS_NONE) {
-		physical += extent->offset + offset;
-		if (!btrfs_devread(physical, size, out))
+	/* Decompress straight to the destination if all of it is wanted */
+	if (!em->offset && !offset && size == em->ram_bytes) {
+		dbuf = out;
+	} else {
+		dbuf = grow_buf(&cache->dbuf, &cache->dbuf_len, em->ram_bytes);
+		if (!dbuf)
 			return -1ULL;
-
-		return size;
 	}
 
-	cbuf = malloc_cache_aligned(dlen > size ? clen + dlen : clen);
-	if (!cbuf)
+	res = btrfs_decompress(em->compression, cbuf, em->disk_len, dbuf,
+			       em->ram_bytes);
+	if (res == -1 || em->offset + offset + size > res)
 		return -1ULL;
 
-	if (dlen > orig_size)
-		dbuf = cbuf + clen;
-	else
-		dbuf = out;
+	if (dbuf != out)
+		memcpy(out, dbuf + em->offset + offset, size);
+
+	return size;
+}
+
+static bool is_plain_extent(struct btrfs_extent_map *em)
+{
+	return !em->inline_data && em->physical &&
+	       em->compression == BTRFS_COMPRESS_NONE;
+}
 
-	if (!btrfs_devread(physical, clen, cbuf))
-		goto err;
+/*
+ * Read @size bytes of file data at @offset from the extents in @cache.
+ * Extents following each other both in the file and on the device are read
+ * with a single device read. Returns the number of bytes read or -1ULL.
+ */
+u64 btrfs_read_extents(struct btrfs_extent_cache *cache, u64 offset, u64 size,
+		       char *out)
+{
+	struct btrfs_extent_map *em = cache->maps;
+	struct btrfs_extent_map *end = em + cache->count;
+	struct btrfs_extent_map *next;
+	u64 len, rd_all = 0;
 
-	res = btrfs_decompress(extent->compression, cbuf, clen, dbuf, dlen);
-	if (res == -1)
-		goto err;
+	while (size) {
+		while (em < end && offset >= em->start + em->len)
+			em++;
 
-	if (dlen > orig_size)
-		memcpy(out, dbuf + offset, size);
-	else
-		memmove(out, dbuf + offset, size);
+		if (em == end || offset < em->start) {
+			/* holes have no extent with the NO_HOLES feature */
+			len = em == end ? size : min(size, em->start - offset);
+			memset(out, 0, len);
+		} else if (is_plain_extent(em)) {
+			len = em->start + em->len - offset;
+			for (next = em + 1; next < end && len < size; next++) {
+				if (!is_plain_extent(next) ||
+				    next->start != next[-1].start + next[-1].len ||
+				    next->physical !=
+				    next[-1].physical + next[-1].len)
+					break;
+				len += next->len;
+			}
+			len = min3(len, size, (u64)INT_MAX);
 
-	free(cbuf);
-	return res;
+			if (!btrfs_devread(em->physical + offset - em->start,
+					   len, out))
+				return -1ULL;
+		} else {
+			len = min(size, em->start + em->len - offset);
+			if (!em->physical && !em->inline_data)
+				memset(out, 0, len);
+			else if (em->compression != BTRFS_COMPRESS_NONE)
+				len = read_compressed(cache, em,
+						      offset - em->start, len,
+						      out);
+			else
+				memcpy(out, em->inline_data + offset - em->start,
+				       len);
+
+			if (len == -1ULL)
+				return -1ULL;
+		}
+
+		offset += len;
+		out += len;
+		size -= len;
+		rd_all += len;
+	}
+
+	return rd_all;
+}
+
+void btrfs_extent_cache_exit(void)
+{
+	struct btrfs_extent_cache *cache = &btrfs_info.extent_cache;
 
-err:
-	free(cbuf);
-	return -1ULL;
+	free_extent_maps(cache);
+	free(cache->cbuf);
+	free(cache->dbuf);
+	memset(cache, 0, sizeof(*cache));
 }
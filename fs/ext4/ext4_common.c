@@ -332,6 +332,7 @@ int ext4fs_set_block_bmap(long int blockno, unsigned char *buffer, int index)
 			return -1;
 
 		*ptr = *ptr | operand;
+		get_fs()->blk_bmaps_dirty[index] = 1;
 		return 0;
 	} else {
 		if (remainder == 0) {
@@ -346,6 +347,7 @@ int ext4fs_set_block_bmap(long int blockno, unsigned char *buffer, int index)
 			return -1;
 
 		*ptr = *ptr | operand;
+		get_fs()->blk_bmaps_dirty[index] = 1;
 		return 0;
 	}
 }
@@ -378,6 +380,7 @@ void ext4fs_reset_block_bmap(long int blockno, unsigned char *buffer, int index)
 		if (status)
 			*ptr = *ptr & ~(operand);
 	}
+	get_fs()->blk_bmaps_dirty[index] = 1;
 }
 
 int ext4fs_set_inode_bmap(int inode_no, unsigned char *buffer, int index)
@@ -401,6 +404,7 @@ int ext4fs_set_inode_bmap(int inode_no, unsigned char *buffer, int index)
 		return -1;
 
 	*ptr = *ptr | operand;
+	get_fs()->inode_bmaps_dirty[index] = 1;
 
 	return 0;
 }
@@ -424,6 +428,7 @@ void ext4fs_reset_inode_bmap(int inode_no, unsigned char *buffer, int index)
 	status = *ptr & operand;
 	if (status)
 		*ptr = *ptr & ~(operand);
+	get_fs()->inode_bmaps_dirty[index] = 1;
 }
 
 static inline uint32_t ext4_chksum(uint32_t crc, const void *address,
@@ -990,19 +995,31 @@ int ext4fs_filename_unlink(char *filename)
 	return -1;
 }
 
+/* Keep a copy in the journal of a bitmap block, as it is on the disk */
+static int ext4fs_log_bitmap(uint64_t blknr)
+{
+	struct ext_filesystem *fs = get_fs();
+	char *buf;
+	int ret = -1;
+
+	buf = malloc(fs->blksz);
+	if (!buf)
+		return -ENOMEM;
+	if (ext4fs_devread(blknr * fs->sect_perblk, 0, fs->blksz, buf))
+		ret = ext4fs_log_journal(buf, blknr);
+	free(buf);
+
+	return ret;
+}
+
 uint32_t ext4fs_get_new_blk_no(void)
 {
 	short i;
-	short status;
 	int remainder;
 	unsigned int bg_idx;
 	static int prev_bg_bitmap_index = -1;
 	unsigned int blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
-		goto fail;
 
 	if (fs->first_pass_bbmap == 0) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
@@ -1013,7 +1030,7 @@ uint32_t ext4fs_get_new_blk_no(void)
 				uint64_t b_bitmap_blk =
 					ext4fs_bg_get_block_id(bgd, fs);
 				if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-					memcpy(fs->blk_bmaps[i], zero_buffer,
+					memset(fs->blk_bmaps[i], '\0',
 					       fs->blksz);
 					put_ext4(b_bitmap_blk * fs->blksz,
 						 fs->blk_bmaps[i], fs->blksz);
@@ -1025,27 +1042,21 @@ uint32_t ext4fs_get_new_blk_no(void)
 				if (fs->curr_blkno == -1)
 					/* block bitmap is completely filled */
 					continue;
+				fs->blk_bmaps_dirty[i] = 1;
 				fs->curr_blkno = fs->curr_blkno +
 						(i * fs->blksz * 8);
 				fs->first_pass_bbmap++;
 				ext4fs_bg_free_blocks_dec(bgd, fs);
 				ext4fs_sb_free_blocks_dec(fs->sb);
-				status = ext4fs_devread(b_bitmap_blk *
-							fs->sect_perblk,
-							0, fs->blksz,
-							journal_buffer);
-				if (status == 0)
-					goto fail;
-				if (ext4fs_log_journal(journal_buffer,
-						       b_bitmap_blk))
-					goto fail;
-				goto success;
+				if (ext4fs_log_bitmap(b_bitmap_blk))
+					return -1;
+				return fs->curr_blkno;
 			} else {
 				debug("no space left on block group %d\n", i);
 			}
 		}
 
-		goto fail;
+		return -1;
 	} else {
 		fs->curr_blkno++;
 restart:
@@ -1062,7 +1073,7 @@ restart:
 		 * Optimize the block allocation
 		 */
 		if (bg_idx >= fs->no_blkgrp)
-			goto fail;
+			return -1;
 
 		struct ext2_block_group *bgd = NULL;
 		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
@@ -1077,9 +1088,9 @@ restart:
 		uint16_t bg_flags = ext4fs_bg_get_flags(bgd);
 		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
 		if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-			memcpy(fs->blk_bmaps[bg_idx], zero_buffer, fs->blksz);
+			memset(fs->blk_bmaps[bg_idx], '\0', fs->blksz);
 			put_ext4(b_bitmap_blk * fs->blksz,
-				 zero_buffer, fs->blksz);
+				 fs->blk_bmaps[bg_idx], fs->blksz);
 			bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
 			ext4fs_bg_set_flags(bgd, bg_flags);
 		}
@@ -1094,43 +1105,25 @@ restart:
 
 		/* journal backup */
 		if (prev_bg_bitmap_index != bg_idx) {
-			status = ext4fs_devread(b_bitmap_blk * fs->sect_perblk,
-						0, fs->blksz, journal_buffer);
-			if (status == 0)
-				goto fail;
-			if (ext4fs_log_journal(journal_buffer, b_bitmap_blk))
-				goto fail;
+			if (ext4fs_log_bitmap(b_bitmap_blk))
+				return -1;
 
 			prev_bg_bitmap_index = bg_idx;
 		}
 		ext4fs_bg_free_blocks_dec(bgd, fs);
 		ext4fs_sb_free_blocks_dec(fs->sb);
-		goto success;
-	}
-success:
-	free(journal_buffer);
-	free(zero_buffer);
 
-	return fs->curr_blkno;
-fail:
-	free(journal_buffer);
-	free(zero_buffer);
-
-	return -1;
+		return fs->curr_blkno;
+	}
 }
 
 int ext4fs_get_new_inode_no(void)
 {
 	short i;
-	short status;
 	unsigned int ibmap_idx;
 	static int prev_inode_bitmap_index = -1;
 	unsigned int inodes_per_grp = le32_to_cpu(ext4fs_root->sblock.inodes_per_group);
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
-		goto fail;
 	int has_gdt_chksum = le32_to_cpu(fs->sb->feature_ro_compat) &
 		EXT4_FEATURE_RO_COMPAT_GDT_CSUM ? 1 : 0;
 
@@ -1148,18 +1141,19 @@ int ext4fs_get_new_inode_no(void)
 					ext4fs_bg_itable_unused_set(bgd, fs,
 								free_inodes);
 				if (bg_flags & EXT4_BG_INODE_UNINIT) {
+					memset(fs->inode_bmaps[i], '\0',
+					       fs->blksz);
 					put_ext4(i_bitmap_blk * fs->blksz,
-						 zero_buffer, fs->blksz);
+						 fs->inode_bmaps[i], fs->blksz);
 					bg_flags &= ~EXT4_BG_INODE_UNINIT;
 					ext4fs_bg_set_flags(bgd, bg_flags);
-					memcpy(fs->inode_bmaps[i],
-					       zero_buffer, fs->blksz);
 				}
 				fs->curr_inode_no =
 				    _get_new_inode_no(fs->inode_bmaps[i]);
 				if (fs->curr_inode_no == -1)
 					/* inode bitmap is completely filled */
 					continue;
+				fs->inode_bmaps_dirty[i] = 1;
 				fs->curr_inode_no = fs->curr_inode_no +
 							(i * inodes_per_grp);
 				fs->first_pass_ibmap++;
@@ -1167,20 +1161,13 @@ int ext4fs_get_new_inode_no(void)
 				if (has_gdt_chksum)
 					ext4fs_bg_itable_unused_dec(bgd, fs);
 				ext4fs_sb_free_inodes_dec(fs->sb);
-				status = ext4fs_devread(i_bitmap_blk *
-							fs->sect_perblk,
-							0, fs->blksz,
-							journal_buffer);
-				if (status == 0)
-					goto fail;
-				if (ext4fs_log_journal(journal_buffer,
-						       i_bitmap_blk))
-					goto fail;
-				goto success;
+				if (ext4fs_log_bitmap(i_bitmap_blk))
+					return -1;
+				return fs->curr_inode_no;
 			} else
 				debug("no inode left on block group %d\n", i);
 		}
-		goto fail;
+		return -1;
 	} else {
 restart:
 		fs->curr_inode_no++;
@@ -1192,12 +1179,11 @@ restart:
 		uint64_t i_bitmap_blk = ext4fs_bg_get_inode_id(bgd, fs);
 
 		if (bg_flags & EXT4_BG_INODE_UNINIT) {
+			memset(fs->inode_bmaps[ibmap_idx], '\0', fs->blksz);
 			put_ext4(i_bitmap_blk * fs->blksz,
-				 zero_buffer, fs->blksz);
+				 fs->inode_bmaps[ibmap_idx], fs->blksz);
 			bg_flags &= ~EXT4_BG_INODE_UNINIT;
 			ext4fs_bg_set_flags(bgd, bg_flags);
-			memcpy(fs->inode_bmaps[ibmap_idx], zero_buffer,
-				fs->blksz);
 		}
 
 		if (ext4fs_set_inode_bmap(fs->curr_inode_no,
@@ -1210,33 +1196,17 @@ restart:
 
 		/* journal backup */
 		if (prev_inode_bitmap_index != ibmap_idx) {
-			status = ext4fs_devread(i_bitmap_blk * fs->sect_perblk,
-						0, fs->blksz, journal_buffer);
-			if (status == 0)
-				goto fail;
-			if (ext4fs_log_journal(journal_buffer,
-						le32_to_cpu(bgd->inode_id)))
-				goto fail;
+			if (ext4fs_log_bitmap(i_bitmap_blk))
+				return -1;
 			prev_inode_bitmap_index = ibmap_idx;
 		}
 		ext4fs_bg_free_inodes_dec(bgd, fs);
 		if (has_gdt_chksum)
 			bgd->bg_itable_unused = bgd->free_inodes;
 		ext4fs_sb_free_inodes_dec(fs->sb);
-		goto success;
-	}
-
-success:
-	free(journal_buffer);
-	free(zero_buffer);
-
-	return fs->curr_inode_no;
-fail:
-	free(journal_buffer);
-	free(zero_buffer);
-
-	return -1;
 
+		return fs->curr_inode_no;
+	}
 }
 
 
@@ -1556,16 +1526,187 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 	*total_no_of_block += no_blks_reqd;
 }
 
+static void ext4fs_set_extent(struct ext4_extent *extent, uint32_t fileblock,
+			      uint64_t blknr, uint32_t len)
+{
+	extent->ee_block = cpu_to_le32(fileblock);
+	extent->ee_len = cpu_to_le16(len);
+	extent->ee_start_hi = cpu_to_le16(blknr >> 32);
+	extent->ee_start_lo = cpu_to_le32(blknr & 0xffffffff);
+}
+
+static void ext4fs_set_extent_header(struct ext4_extent_header *eh,
+				     int entries, int max, int depth)
+{
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_entries = cpu_to_le16(entries);
+	eh->eh_max = cpu_to_le16(max);
+	eh->eh_depth = cpu_to_le16(depth);
+	eh->eh_generation = 0;
+}
+
+/* Append an extent to the array at *extentsp, growing it as needed */
+static int ext4fs_add_extent(struct ext4_extent **extentsp, int *count,
+			     int *max, uint32_t fileblock, uint64_t blknr,
+			     uint32_t len)
+{
+	struct ext4_extent *extents;
+
+	if (*count == *max) {
+		extents = realloc(*extentsp, (*max + 64) * sizeof(*extents));
+		if (!extents)
+			return -ENOMEM;
+		*extentsp = extents;
+		*max += 64;
+	}
+	ext4fs_set_extent(&(*extentsp)[(*count)++], fileblock, blknr, len);
+
+	return 0;
+}
+
+/**
+ * ext4fs_allocate_extents() - Allocate the blocks of a new file as extents
+ *
+ * The allocator hands out free blocks in increasing order, so they mostly
+ * follow each other and a few extents cover the whole file. Up to four of
+ * them fit in the inode. Beyond that, the extents go in leaf blocks, and
+ * index blocks are added one level at a time until the top level fits in the
+ * inode.
+ *
+ * @file_inode:			Inode of the file, which gets the extent tree
+ * @total_remaining_blocks:	Number of data blocks to allocate
+ * @total_no_of_block:		Incremented by the number of tree blocks used
+ * @return 0 if OK, -ENOSPC if there are not enough free blocks, -ENOMEM if
+ *	out of memory
+ */
+int ext4fs_allocate_extents(struct ext2_inode *file_inode,
+			    unsigned int total_remaining_blocks,
+			    unsigned int *total_no_of_block)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent_header *eh =
+		(struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	int per_block = (fs->blksz - sizeof(*eh)) / sizeof(struct ext4_extent);
+	struct ext4_extent *extents = NULL;
+	struct ext4_extent_header *node;
+	struct ext4_extent_idx *idx;
+	uint32_t fileblock = 0;
+	uint64_t start = 0;
+	uint32_t len = 0;
+	uint32_t blknr;
+	int count = 0;
+	int depth = 0;
+	int max = 0;
+	int ret = 0;
+	int nblocks;
+	int i, n;
+
+	for (; total_remaining_blocks; total_remaining_blocks--) {
+		blknr = ext4fs_get_new_blk_no();
+		if (blknr == -1) {
+			printf("no block left to assign\n");
+			ret = -ENOSPC;
+			goto out;
+		}
+		if (len && blknr == start + len &&
+		    len < EXT4_EXT_INIT_MAX_LEN) {
+			len++;
+			continue;
+		}
+		if (len) {
+			ret = ext4fs_add_extent(&extents, &count, &max,
+						fileblock, start, len);
+			if (ret)
+				goto out;
+			fileblock += len;
+		}
+		start = blknr;
+		len = 1;
+	}
+	if (len) {
+		ret = ext4fs_add_extent(&extents, &count, &max, fileblock,
+					start, len);
+		if (ret)
+			goto out;
+	}
+	debug("%d extent(s)\n", count);
+
+	node = zalloc(fs->blksz);
+	if (!node) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/*
+	 * Write out one level of the tree at a time, from the leaves up. The
+	 * index entry for each block replaces, in the array, the first entry
+	 * the block holds: both are the same size and it was already written.
+	 */
+	while (count > EXT4_EXT_ROOT_ENTRIES) {
+		if (depth == EXT4_EXT_MAX_DEPTH - 1) {
+			printf("file too fragmented\n");
+			ret = -ENOSPC;
+			break;
+		}
+		nblocks = DIV_ROUND_UP(count, per_block);
+		for (i = 0; i < nblocks; i++) {
+			n = min(per_block, count - i * per_block);
+			blknr = ext4fs_get_new_blk_no();
+			if (blknr == -1) {
+				printf("no block left to assign\n");
+				ret = -ENOSPC;
+				break;
+			}
+			(*total_no_of_block)++;
+			memset(node, '\0', fs->blksz);
+			ext4fs_set_extent_header(node, n, per_block, depth);
+			memcpy(node + 1, &extents[i * per_block],
+			       n * sizeof(*extents));
+			put_ext4((uint64_t)blknr * fs->blksz, node, fs->blksz);
+
+			idx = (struct ext4_extent_idx *)&extents[i];
+			idx->ei_block = extents[i * per_block].ee_block;
+			idx->ei_leaf_lo = cpu_to_le32(blknr);
+			idx->ei_leaf_hi = 0;
+			idx->ei_unused = 0;
+		}
+		if (ret)
+			break;
+		count = nblocks;
+		depth++;
+	}
+	free(node);
+	if (ret)
+		goto out;
+
+	ext4fs_set_extent_header(eh, count, EXT4_EXT_ROOT_ENTRIES, depth);
+	memcpy(eh + 1, extents, count * sizeof(*extents));
+	file_inode->flags = cpu_to_le32(le32_to_cpu(file_inode->flags) |
+					EXT4_EXTENTS_FL);
+out:
+	free(extents);
+
+	return ret;
+}
+
 #endif
 
+/*
+ * Walk down the extent tree to the leaf covering fileblock. The node read at
+ * each level goes in its own entry of cache[], up to ncache levels, so that
+ * looking up the next extent usually needs no read at all. If next is not
+ * NULL, it is lowered to the first logical block beyond the leaf.
+ */
 static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, struct ext_block_cache *cache,
+	(struct ext2_data *data, struct ext_block_cache *cache, int ncache,
 		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+		uint32_t fileblock, int log2_blksz, uint32_t *next)
 {
 	struct ext4_extent_idx *index;
+	struct ext_block_cache *c;
 	unsigned long long block;
 	int blksz = EXT2_BLOCK_SIZE(data);
+	int level = 0;
 	int i;
 
 	while (1) {
@@ -1589,13 +1730,16 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 		 */
 		if (i > 0)
 			i--;
+		if (next && i + 1 < le16_to_cpu(ext_block->eh_entries))
+			*next = min(*next, le32_to_cpu(index[i + 1].ei_block));
 
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 		block <<= log2_blksz;
-		if (!ext_cache_read(cache, (lbaint_t)block, blksz))
+		c = &cache[min(level++, ncache - 1)];
+		if (!ext_cache_read(c, (lbaint_t)block, blksz))
 			return NULL;
-		ext_block = (struct ext4_extent_header *)cache->buf;
+		ext_block = (struct ext4_extent_header *)c->buf;
 	}
 }
 
@@ -1675,6 +1819,73 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+/**
+ * ext4fs_get_extent_run() - Find the blocks holding part of a file
+ *
+ * @inode:	Inode of the file, which must use extents
+ * @fileblock:	First logical block wanted
+ * @cache:	Cache for the extent tree, one entry per level
+ * @ncache:	Number of entries in @cache
+ * @blknr:	Returns the block holding @fileblock, or 0 if it is in a hole
+ *		or an unwritten extent, both of which read as zeroes
+ * @count:	Returns the number of blocks from @fileblock which follow each
+ *		other on the disk (or are all in the same hole)
+ * @return 0 if OK, -EINVAL if the extent tree is invalid
+ */
+int ext4fs_get_extent_run(struct ext2_inode *inode, uint32_t fileblock,
+			  struct ext_block_cache *cache, int ncache,
+			  uint64_t *blknr, uint32_t *count)
+{
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	uint32_t next = UINT_MAX;
+	int i;
+
+	ext_block = ext4fs_get_extent_block(ext4fs_root, cache, ncache,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock, log2_blksz, &next);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		uint32_t start = le32_to_cpu(extent[i].ee_block);
+		uint32_t len = le16_to_cpu(extent[i].ee_len);
+		bool unwritten = false;
+
+		if (len > EXT4_EXT_INIT_MAX_LEN) {
+			len -= EXT4_EXT_INIT_MAX_LEN;
+			unwritten = true;
+		}
+		if (start > fileblock) {
+			/* Sparse file */
+			next = start;
+			break;
+		} else if (fileblock < start + len) {
+			*count = start + len - fileblock;
+			*blknr = 0;
+			if (!unwritten) {
+				*blknr = le16_to_cpu(extent[i].ee_start_hi);
+				*blknr = (*blknr << 32) +
+					le32_to_cpu(extent[i].ee_start_lo);
+				*blknr += fileblock - start;
+			}
+			return 0;
+		}
+	}
+
+	/* A hole, up to the next extent */
+	*count = next - fileblock;
+	*blknr = 0;
+
+	return 0;
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache)
 {
@@ -1705,10 +1916,10 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			ext_cache_init(c);
 		}
 		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, c,
+			ext4fs_get_extent_block(ext4fs_root, c, 1,
 						(struct ext4_extent_header *)
 						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
+						fileblock, log2_blksz, NULL);
 		if (!ext_block) {
 			printf("invalid extent block\n");
 			if (!cache)
@@ -78,22 +78,28 @@ static void ext4fs_update(void)
 	put_ext4((uint64_t)(SUPERBLOCK_SIZE),
 		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 
-	/* update block bitmaps */
+	/* update the block bitmaps which changed */
 	for (i = 0; i < fs->no_blkgrp; i++) {
 		bgd = ext4fs_get_group_descriptor(fs, i);
 		bgd->bg_checksum = cpu_to_le16(ext4fs_checksum_update(i));
+		if (!fs->blk_bmaps_dirty[i])
+			continue;
 		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
 		put_ext4(b_bitmap_blk * fs->blksz,
 			 fs->blk_bmaps[i], fs->blksz);
 	}
 
-	/* update inode bitmaps */
+	/* update the inode bitmaps which changed */
 	for (i = 0; i < fs->no_blkgrp; i++) {
+		if (!fs->inode_bmaps_dirty[i])
+			continue;
 		bgd = ext4fs_get_group_descriptor(fs, i);
 		uint64_t i_bitmap_blk = ext4fs_bg_get_inode_id(bgd, fs);
 		put_ext4(i_bitmap_blk * fs->blksz,
 			 fs->inode_bmaps[i], fs->blksz);
 	}
+	memset(fs->blk_bmaps_dirty, '\0', fs->no_blkgrp);
+	memset(fs->inode_bmaps_dirty, '\0', fs->no_blkgrp);
 
 	/* update the block group descriptor table */
 	put_ext4((uint64_t)((uint64_t)fs->gdtable_blkno * (uint64_t)fs->blksz),
@@ -435,14 +441,113 @@ fail:
 	free(journal_buffer);
 }
 
+/* Give back a block, keeping a copy of its bitmap in the journal */
+static int release_block(uint64_t blknr, char *journal_buffer,
+			 int *prev_bg_bmap_idx)
+{
+	uint32_t blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd;
+	uint64_t group = blknr;
+	int bg_idx;
+
+	if (!do_div(group, blk_per_grp) && fs->blksz == 1024)
+		group--;
+	bg_idx = group;
+	ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
+	debug("EXT4 Block releasing %llu: %d\n", blknr, bg_idx);
+
+	/* get  block group descriptor table */
+	bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+	ext4fs_bg_free_blocks_inc(bgd, fs);
+	ext4fs_sb_free_blocks_inc(fs->sb);
+	/* journal backup */
+	if (*prev_bg_bmap_idx != bg_idx) {
+		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
+
+		if (!ext4fs_devread(b_bitmap_blk * fs->sect_perblk, 0,
+				    fs->blksz, journal_buffer))
+			return -EIO;
+		if (ext4fs_log_journal(journal_buffer, b_bitmap_blk))
+			return -ENOMEM;
+		*prev_bg_bmap_idx = bg_idx;
+	}
+
+	return 0;
+}
+
+/*
+ * Give back the blocks of an extent tree node, along with all the blocks its
+ * entries point to
+ */
+static int release_extents(struct ext4_extent_header *eh, int level,
+			   char *journal_buffer, int *prev_bg_bmap_idx)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent_idx *idx;
+	struct ext4_extent *extent;
+	uint64_t blknr;
+	uint32_t len;
+	char *buf;
+	int ret = 0;
+	int i;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC ||
+	    level > EXT4_EXT_MAX_DEPTH) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	if (!eh->eh_depth) {
+		extent = (struct ext4_extent *)(eh + 1);
+		for (i = 0; i < le16_to_cpu(eh->eh_entries); i++) {
+			blknr = le16_to_cpu(extent[i].ee_start_hi);
+			blknr = (blknr << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			len = le16_to_cpu(extent[i].ee_len);
+			if (len > EXT4_EXT_INIT_MAX_LEN)
+				len -= EXT4_EXT_INIT_MAX_LEN;
+			for (; len; len--, blknr++) {
+				ret = release_block(blknr, journal_buffer,
+						    prev_bg_bmap_idx);
+				if (ret)
+					return ret;
+			}
+		}
+
+		return 0;
+	}
+
+	buf = malloc(fs->blksz);
+	if (!buf)
+		return -ENOMEM;
+	idx = (struct ext4_extent_idx *)(eh + 1);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++) {
+		blknr = le16_to_cpu(idx[i].ei_leaf_hi);
+		blknr = (blknr << 32) + le32_to_cpu(idx[i].ei_leaf_lo);
+		ret = -EIO;
+		if (!ext4fs_devread(blknr * fs->sect_perblk, 0, fs->blksz, buf))
+			break;
+		ret = release_extents((struct ext4_extent_header *)buf,
+				      level + 1, journal_buffer,
+				      prev_bg_bmap_idx);
+		if (!ret)
+			ret = release_block(blknr, journal_buffer,
+					    prev_bg_bmap_idx);
+		if (ret)
+			break;
+	}
+	free(buf);
+
+	return ret;
+}
+
 static int ext4fs_delete_file(int inodeno)
 {
 	struct ext2_inode inode;
 	short status;
 	int i;
-	int remainder;
 	long int blknr;
-	int bg_idx;
 	int ibmap_idx;
 	char *read_buffer = NULL;
 	char *start_block_address = NULL;
@@ -452,7 +557,6 @@ static int ext4fs_delete_file(int inodeno)
 	unsigned int inodes_per_block;
 	uint32_t blkno;
 	unsigned int blkoff;
-	uint32_t blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	uint32_t inode_per_grp = le32_to_cpu(ext4fs_root->sblock.inodes_per_group);
 	struct ext2_inode *inode_buffer = NULL;
 	struct ext2_block_group *bgd = NULL;
@@ -479,11 +583,13 @@ static int ext4fs_delete_file(int inodeno)
 	}
 
 	if (le32_to_cpu(inode.flags) & EXT4_EXTENTS_FL) {
-		/* FIXME delete extent index blocks, i.e. eh_depth >= 1 */
-		struct ext4_extent_header *eh =
-			(struct ext4_extent_header *)
-				inode.b.blocks.dir_blocks;
-		debug("del: dep=%d entries=%d\n", eh->eh_depth, eh->eh_entries);
+		/* release the extent tree along with the data blocks */
+		if (no_blocks &&
+		    release_extents((struct ext4_extent_header *)
+				    inode.b.blocks.dir_blocks, 0,
+				    journal_buffer, &prev_bg_bmap_idx))
+			goto fail;
+		no_blocks = 0;
 	} else {
 		delete_single_indirect_block(&inode);
 		delete_double_indirect_block(&inode);
@@ -497,32 +603,8 @@ static int ext4fs_delete_file(int inodeno)
 			continue;
 		if (blknr < 0)
 			goto fail;
-		bg_idx = blknr / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = blknr % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-					bg_idx);
-		debug("EXT4 Block releasing %ld: %d\n", blknr, bg_idx);
-
-		/* get  block group descriptor table */
-		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
-		ext4fs_bg_free_blocks_inc(bgd, fs);
-		ext4fs_sb_free_blocks_inc(fs->sb);
-		/* journal backup */
-		if (prev_bg_bmap_idx != bg_idx) {
-			uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
-			status = ext4fs_devread(b_bitmap_blk * fs->sect_perblk,
-						0, fs->blksz,
-						journal_buffer);
-			if (status == 0)
-				goto fail;
-			if (ext4fs_log_journal(journal_buffer, b_bitmap_blk))
-				goto fail;
-			prev_bg_bmap_idx = bg_idx;
-		}
+		if (release_block(blknr, journal_buffer, &prev_bg_bmap_idx))
+			goto fail;
 	}
 
 	/* release inode */
@@ -634,6 +716,9 @@ int ext4fs_init(void)
 	fs->blk_bmaps = zalloc(fs->no_blkgrp * sizeof(char *));
 	if (!fs->blk_bmaps)
 		goto fail;
+	fs->blk_bmaps_dirty = zalloc(fs->no_blkgrp);
+	if (!fs->blk_bmaps_dirty)
+		goto fail;
 	for (i = 0; i < fs->no_blkgrp; i++) {
 		fs->blk_bmaps[i] = zalloc(fs->blksz);
 		if (!fs->blk_bmaps[i])
@@ -654,6 +739,9 @@ int ext4fs_init(void)
 	fs->inode_bmaps = zalloc(fs->no_blkgrp * sizeof(unsigned char *));
 	if (!fs->inode_bmaps)
 		goto fail;
+	fs->inode_bmaps_dirty = zalloc(fs->no_blkgrp);
+	if (!fs->inode_bmaps_dirty)
+		goto fail;
 	for (i = 0; i < fs->no_blkgrp; i++) {
 		fs->inode_bmaps[i] = zalloc(fs->blksz);
 		if (!fs->inode_bmaps[i])
@@ -746,6 +834,10 @@ void ext4fs_deinit(void)
 		free(fs->inode_bmaps);
 		fs->inode_bmaps = NULL;
 	}
+	free(fs->blk_bmaps_dirty);
+	fs->blk_bmaps_dirty = NULL;
+	free(fs->inode_bmaps_dirty);
+	fs->inode_bmaps_dirty = NULL;
 
 
 	free(fs->gdtable);
@@ -762,22 +854,25 @@ void ext4fs_deinit(void)
 
 /*
  * Write data to filesystem blocks. Uses same optimization for
- * contigous sectors as ext4fs_read_file
+ * contigous sectors as ext4fs_read_file: extent-mapped files are looked up
+ * a whole extent at a time and each run of adjacent blocks is written at once
  */
 static int ext4fs_write_file(struct ext2_inode *file_inode,
 			     int pos, unsigned int len, const char *buf)
 {
-	int i;
+	int i, j;
 	int blockcnt;
 	uint32_t filesize = le32_to_cpu(file_inode->size);
 	struct ext_filesystem *fs = get_fs();
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(ext4fs_root) - log2blksz;
-	int previous_block_number = -1;
-	int delayed_start = 0;
-	int delayed_extent = 0;
-	int delayed_next = 0;
+	bool extents = le32_to_cpu(file_inode->flags) & EXT4_EXTENTS_FL;
+	struct ext_block_cache cache[EXT4_EXT_MAX_DEPTH];
+	uint64_t delayed_start = 0;
+	uint64_t delayed_next = 0;
+	uint32_t delayed_extent = 0;
 	const char *delayed_buf = NULL;
+	int ret = -1;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len > filesize)
@@ -785,61 +880,57 @@ static int ext4fs_write_file(struct ext2_inode *file_inode,
 
 	blockcnt = ((len + pos) + fs->blksz - 1) / fs->blksz;
 
-	for (i = pos / fs->blksz; i < blockcnt; i++) {
-		long int blknr;
-		int blockend = fs->blksz;
-		int skipfirst = 0;
-		blknr = read_allocated_block(file_inode, i, NULL);
-		if (blknr <= 0)
-			return -1;
-
-		blknr = blknr << log2_fs_blocksize;
-
-		if (blknr) {
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					put_ext4((uint64_t)
-						 ((uint64_t)delayed_start << log2blksz),
-						 delayed_buf,
-						 (uint32_t) delayed_extent);
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_buf = buf;
-					delayed_next = blknr +
-					    (blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_buf = buf;
-				delayed_next = blknr +
-				    (blockend >> log2blksz);
-			}
+	for (j = 0; j < EXT4_EXT_MAX_DEPTH; j++)
+		ext_cache_init(&cache[j]);
+
+	for (i = pos / fs->blksz; i < blockcnt; i += j) {
+		uint64_t blknr;
+		uint32_t count;
+
+		if (extents) {
+			if (ext4fs_get_extent_run(file_inode, i, cache,
+						  EXT4_EXT_MAX_DEPTH, &blknr,
+						  &count))
+				goto out;
 		} else {
-			if (previous_block_number != -1) {
-				/* spill */
-				put_ext4((uint64_t) ((uint64_t)delayed_start <<
-						     log2blksz),
-					 delayed_buf,
-					 (uint32_t) delayed_extent);
-				previous_block_number = -1;
-			}
+			long int blk = read_allocated_block(file_inode, i,
+							    NULL);
+
+			if (blk < 0)
+				goto out;
+			blknr = blk;
+			count = 1;
+		}
+		if (!blknr)
+			goto out;
+		j = min_t(uint32_t, count, blockcnt - i);
+
+		blknr <<= log2_fs_blocksize;
+		if (delayed_extent && delayed_next == blknr) {
+			delayed_extent += j * fs->blksz;
+		} else {
+			/* spill */
+			if (delayed_extent)
+				put_ext4(delayed_start << log2blksz,
+					 delayed_buf, delayed_extent);
+			delayed_start = blknr;
+			delayed_extent = j * fs->blksz;
+			delayed_buf = buf;
 		}
-		buf += fs->blksz - skipfirst;
+		delayed_next = blknr + ((uint64_t)j << log2_fs_blocksize);
+		buf += j * fs->blksz;
 	}
-	if (previous_block_number != -1) {
+	if (delayed_extent) {
 		/* spill */
-		put_ext4((uint64_t) ((uint64_t)delayed_start << log2blksz),
-			 delayed_buf, (uint32_t) delayed_extent);
-		previous_block_number = -1;
+		put_ext4(delayed_start << log2blksz, delayed_buf,
+			 delayed_extent);
 	}
+	ret = len;
+out:
+	for (j = 0; j < EXT4_EXT_MAX_DEPTH; j++)
+		ext_cache_fini(&cache[j]);
 
-	return len;
+	return ret;
 }
 
 int ext4fs_write(const char *fname, const char *buffer,
@@ -958,8 +1049,15 @@ int ext4fs_write(const char *fname, const char *buffer,
 	file_inode->nlinks = cpu_to_le16(1);
 
 	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	if ((le32_to_cpu(fs->sb->feature_incompat) &
+	     EXT4_FEATURE_INCOMPAT_EXTENTS) && !store_link_in_inode) {
+		if (ext4fs_allocate_extents(file_inode, blocks_remaining,
+					    &blks_reqd_for_file))
+			goto fail;
+	} else {
+		ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				       &blks_reqd_for_file);
+	}
 	file_inode->blockcnt = cpu_to_le32((blks_reqd_for_file * fs->blksz) >>
 					   LOG2_SECTOR_SIZE);
 
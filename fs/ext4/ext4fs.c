@@ -44,6 +44,30 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/*
+ * Find the blocks holding fileblock and those which follow it on the disk.
+ * Extent-mapped files are handled a whole extent at a time; for the others
+ * this goes one block at a time, with the caller joining adjacent blocks.
+ */
+static int ext4fs_get_run(struct ext2fs_node *node, uint32_t fileblock,
+			  struct ext_block_cache *cache, uint64_t *blknr,
+			  uint32_t *count)
+{
+	long int blk;
+
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL)
+		return ext4fs_get_extent_run(&node->inode, fileblock, cache,
+					     EXT4_EXT_MAX_DEPTH, blknr, count);
+
+	blk = read_allocated_block(&node->inode, fileblock, cache);
+	if (blk < 0)
+		return -EINVAL;
+	*blknr = blk;
+	*count = 1;
+
+	return 0;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -53,134 +77,97 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
-	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
+	struct ext_block_cache cache[EXT4_EXT_MAX_DEPTH];
 	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
+	int delayed_extent = 0;
+	int delayed_skipfirst = 0;
 	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
-	struct ext_block_cache cache;
+	char *end_buf;
+	uint32_t first, blockcnt, i;
+	int ret = -1;
+	int j;
 
-	ext_cache_init(&cache);
+	for (j = 0; j < EXT4_EXT_MAX_DEPTH; j++)
+		ext_cache_init(&cache[j]);
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
 		len = (filesize - pos);
+	end_buf = buf + len;
 
-	if (blocksize <= 0 || len <= 0) {
-		ext_cache_fini(&cache);
-		return -1;
-	}
+	if (blocksize <= 0 || len <= 0)
+		goto out;
 
+	first = lldiv(pos, blocksize);
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
-		if (blknr < 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-
-		blknr = blknr << log2_fs_blocksize;
+	for (i = first; i < blockcnt;) {
+		int skipfirst = i == first ? pos - (loff_t)blocksize * i : 0;
+		uint64_t blknr;
+		uint32_t count;
+		int bytes;
+
+		if (ext4fs_get_run(node, i, &cache[0], &blknr, &count))
+			goto out;
+		/* Keep each read within what ext4fs_devread() can take */
+		count = min(count, blockcnt - i);
+		count = min(count, (uint32_t)(INT_MAX >>
+					      (log2_fs_blocksize + log2blksz)));
+		bytes = min((loff_t)count * blocksize - skipfirst,
+			    (loff_t)(end_buf - buf));
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
-		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
 		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
+			lbaint_t sector = blknr << log2_fs_blocksize;
+
+			if (delayed_buf && sector == delayed_next &&
+			    delayed_extent <= INT_MAX - bytes) {
+				delayed_extent += bytes;
 			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
+				/* spill */
+				if (delayed_buf &&
+				    !ext4fs_devread(delayed_start,
+						    delayed_skipfirst,
+						    delayed_extent,
+						    delayed_buf))
+					goto out;
+				delayed_start = sector;
+				delayed_extent = bytes;
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
 			}
+			delayed_next = sector +
+				((lbaint_t)count << log2_fs_blocksize);
 		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
-				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
-			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
-			memset(buf, 0, n);
-		}
-		buf += blocksize - skipfirst;
-	}
-	if (previous_block_number != -1) {
-		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
-			return -1;
+			/* spill */
+			if (delayed_buf &&
+			    !ext4fs_devread(delayed_start, delayed_skipfirst,
+					    delayed_extent, delayed_buf))
+				goto out;
+			delayed_buf = NULL;
+			/* Holes read as zeroes */
+			memset(buf, 0, bytes);
 		}
-		previous_block_number = -1;
+		buf += bytes;
+		i += count;
 	}
+	/* spill */
+	if (delayed_buf &&
+	    !ext4fs_devread(delayed_start, delayed_skipfirst, delayed_extent,
+			    delayed_buf))
+		goto out;
 
 	*actread  = len;
-	ext_cache_fini(&cache);
-	return 0;
+	ret = 0;
+out:
+	for (j = 0; j < EXT4_EXT_MAX_DEPTH; j++)
+		ext_cache_fini(&cache[j]);
+
+	return ret;
 }
 
 int ext4fs_ls(const char *dirname)
@@ -11,6 +11,7 @@
 #include <common.h>
 #include <blk.h>
 #include <config.h>
+#include <div64.h>
 #include <exports.h>
 #include <fat.h>
 #include <fs.h>
@@ -147,16 +148,94 @@ static void get_name(dir_entry *dirent, char *s_name)
 }
 
 static int flush_dirty_fat_buffer(fsdata *mydata);
+static int flush_fat_window(fsdata *mydata, int idx);
 
 #if !CONFIG_IS_ENABLED(FAT_WRITE)
-/* Stub for read only operation */
+/* Stubs for read only operation */
 int flush_dirty_fat_buffer(fsdata *mydata)
 {
 	(void)(mydata);
 	return 0;
 }
+
+int flush_fat_window(fsdata *mydata, int idx)
+{
+	return 0;
+}
 #endif
 
+/*
+ * Allocate the FAT buffer with as many windows as possible, and mark them
+ * all as empty. Return 0 on success, -1 if not even one window fits.
+ */
+static int alloc_fat_buffer(fsdata *mydata, int windows)
+{
+	int i;
+
+	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE * windows);
+	if (!mydata->fatbuf && windows > 1) {
+		debug("FAT buffer falls back to one window\n");
+		windows = 1;
+		mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
+	}
+	if (!mydata->fatbuf)
+		return -1;
+
+	mydata->fatbufs = windows;
+	for (i = 0; i < windows; i++) {
+		mydata->fatbufnum[i] = -1;
+		mydata->fatbuf_used[i] = 0;
+	}
+	mydata->fatbuf_clock = 0;
+	memset(mydata->fat_dirty, '\0', sizeof(mydata->fat_dirty));
+
+	return 0;
+}
+
+/*
+ * Return the index of the window of the FAT buffer which holds FAT window
+ * 'bufnum', reading it in place of the least recently used window if
+ * needed. On failure -1 is returned.
+ */
+static int get_fat_window(fsdata *mydata, __u32 bufnum)
+{
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i, idx = 0;
+
+	for (i = 0; i < mydata->fatbufs; i++) {
+		if (mydata->fatbufnum[i] == bufnum) {
+			idx = i;
+			goto found;
+		}
+		if (mydata->fatbuf_used[i] < mydata->fatbuf_used[idx])
+			idx = i;
+	}
+
+	/* Write back the window being replaced */
+	if (flush_fat_window(mydata, idx) < 0)
+		return -1;
+	mydata->fatbufnum[idx] = -1;
+
+	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	if (disk_read(startblock, getsize,
+		      mydata->fatbuf + idx * FATBUFSIZE) < 0) {
+		debug("Error reading FAT blocks\n");
+		return -1;
+	}
+	mydata->fatbufnum[idx] = bufnum;
+
+found:
+	mydata->fatbuf_used[idx] = ++mydata->fatbuf_clock;
+
+	return idx;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -166,6 +245,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 bufnum;
 	__u32 offset, off8;
 	__u32 ret = 0x00;
+	__u8 *fatbuf;
+	int idx;
 
 	if (CHECK_CLUST(entry, mydata->fatsize)) {
 		printf("Error: Invalid FAT entry: 0x%08x\n", entry);
@@ -194,42 +275,24 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Find the block of FAT entries in the cache, or read it in */
+	idx = get_fat_window(mydata, bufnum);
+	if (idx < 0)
+		return ret;
+	fatbuf = mydata->fatbuf + idx * FATBUFSIZE;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *)fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *)fatbuf)[offset]);
 		break;
 	case 12:
 		off8 = (offset * 3) / 2;
 		/* fatbut + off8 may be unaligned, read in byte granularity */
-		ret = mydata->fatbuf[off8] + (mydata->fatbuf[off8 + 1] << 8);
+		ret = fatbuf[off8] + (fatbuf[off8 + 1] << 8);
 
 		if (offset & 0x1)
 			ret >>= 4;
@@ -306,6 +369,80 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/**
+ * struct fat_extent - run of consecutive clusters
+ *
+ * @clust:	first cluster of the run
+ * @count:	number of clusters in the run
+ */
+struct fat_extent {
+	__u32 clust;
+	__u32 count;
+};
+
+/**
+ * get_extents() - map part of a cluster chain
+ *
+ * Follow the cluster chain starting at 'clust' past its first 'skip' clusters
+ * and turn the next 'nclust' clusters into a list of extents, so that the data
+ * can then be read with one request per extent.
+ *
+ * @mydata:	file system description
+ * @clust:	first cluster of the chain
+ * @skip:	number of clusters to skip
+ * @nclust:	number of clusters to map, at least one
+ * @extentsp:	returns the list of extents, which must be freed by the caller
+ * Return:	number of extents, -1 on error
+ */
+static int get_extents(fsdata *mydata, __u32 clust, __u32 skip, __u32 nclust,
+		       struct fat_extent **extentsp)
+{
+	struct fat_extent *extents = NULL, *tmp;
+	int count = 0, max = 0;
+
+	while (skip--) {
+		clust = get_fatent(mydata, clust);
+		if (CHECK_CLUST(clust, mydata->fatsize))
+			goto invalid;
+	}
+
+	do {
+		if (count == max) {
+			max = max ? max * 2 : 16;
+			tmp = realloc(extents, max * sizeof(*extents));
+			if (!tmp) {
+				debug("Error: allocating extents\n");
+				free(extents);
+				return -1;
+			}
+			extents = tmp;
+		}
+
+		extents[count].clust = clust;
+		extents[count].count = 1;
+		while (--nclust) {
+			clust = get_fatent(mydata, clust);
+			if (CHECK_CLUST(clust, mydata->fatsize))
+				goto invalid;
+			if (clust != extents[count].clust + extents[count].count)
+				break;
+			extents[count].count++;
+		}
+		count++;
+	} while (nclust);
+
+	*extentsp = extents;
+
+	return count;
+
+invalid:
+	debug("curclust: 0x%x\n", clust);
+	printf("Invalid FAT entry\n");
+	free(extents);
+
+	return -1;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -313,6 +450,9 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
  * into 'buffer'. Update the number of bytes read in *gotsize or return -1 on
  * fatal errors.
  *
+ * The clusters to read are mapped first, and each run of consecutive clusters
+ * is then read with a single request.
+ *
  * @mydata:	file system description
  * @dentprt:	directory entry pointer
  * @pos:	position from where to read
@@ -326,9 +466,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	struct fat_extent *extents;
+	__u32 skip, clust, count;
 	loff_t actsize;
+	int i, nextents, ret = -1;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -343,101 +484,68 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
-
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
-	}
+	/* Map the clusters from the one at pos */
+	skip = lldiv(pos, bytesperclust);
+	nextents = get_extents(mydata, START(dentptr), skip,
+			       lldiv(filesize + bytesperclust - 1,
+				     bytesperclust) - skip,
+			       &extents);
+	if (nextents < 0)
+		return -1;
+	debug("%d extent(s)\n", nextents);
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
+	actsize = (loff_t)skip * bytesperclust;
 	filesize -= actsize;
 	pos -= actsize;
 
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		__u8 *tmp_buffer;
+	for (i = 0; i < nextents; i++) {
+		clust = extents[i].clust;
+		count = extents[i].count;
 
-		actsize = min(filesize, (loff_t)bytesperclust);
-		tmp_buffer = malloc_cache_aligned(actsize);
-		if (!tmp_buffer) {
-			debug("Error: allocating buffer\n");
-			return -1;
-		}
+		/* align to beginning of next cluster if any */
+		if (pos) {
+			__u8 *tmp_buffer;
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
-			printf("Error reading cluster\n");
-			free(tmp_buffer);
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
-		free(tmp_buffer);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
+			actsize = min(filesize, (loff_t)bytesperclust);
+			tmp_buffer = malloc_cache_aligned(actsize);
+			if (!tmp_buffer) {
+				debug("Error: allocating buffer\n");
+				goto out;
+			}
 
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
+			if (get_cluster(mydata, clust, tmp_buffer,
+					actsize) != 0) {
+				printf("Error reading cluster\n");
+				free(tmp_buffer);
+				goto out;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
+			filesize -= actsize;
+			actsize -= pos;
+			memcpy(buffer, tmp_buffer + pos, actsize);
+			free(tmp_buffer);
+			*gotsize += actsize;
+			buffer += actsize;
+			pos = 0;
+			clust++;
+			if (!--count)
+				continue;
 		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		actsize = min(filesize, (loff_t)count * bytesperclust);
+		if (get_cluster(mydata, clust, buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
-			return -1;
+			goto out;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+	}
+	ret = 0;
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+out:
+	free(extents);
+
+	return ret;
 }
 
 /*
@@ -626,10 +734,8 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	mydata->free_clust = 3;
+	if (alloc_fat_buffer(mydata, FATBUFWINDOWS) < 0) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -1195,6 +1301,50 @@ out_free_itr:
 	return ret;
 }
 
+int fat_extents(const char *filename)
+{
+	struct fat_extent *extents;
+	unsigned int bytesperclust;
+	fsdata fsdata, *mydata = &fsdata;
+	fat_itr *itr;
+	loff_t size;
+	int i, ret;
+
+	itr = malloc_cache_aligned(sizeof(fat_itr));
+	if (!itr)
+		return -ENOMEM;
+	ret = fat_itr_root(itr, &fsdata);
+	if (ret)
+		goto out_free_itr;
+
+	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	if (ret)
+		goto out_free_both;
+
+	size = FAT2CPU32(itr->dent->size);
+	if (!size)
+		goto out_free_both;
+	bytesperclust = mydata->clust_size * mydata->sect_size;
+	ret = get_extents(mydata, START(itr->dent), 0,
+			  lldiv(size + bytesperclust - 1, bytesperclust),
+			  &extents);
+	if (ret < 0) {
+		ret = -EIO;
+		goto out_free_both;
+	}
+	printf("   cluster     sector   clusters\n");
+	for (i = 0; i < ret; i++)
+		printf("%10u %10u %10u\n", extents[i].clust,
+		       clust_to_sect(mydata, extents[i].clust),
+		       extents[i].count);
+	free(extents);
+out_free_both:
+	free(fsdata.fatbuf);
+out_free_itr:
+	free(itr);
+	return ret;
+}
+
 int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 		     loff_t maxsize, loff_t *actread)
 {
@@ -112,42 +112,89 @@ static void set_name(dir_entry *dirent, const char *filename)
 }
 
 /*
- * Write fat buffer into block device
+ * The dirty bitmap has one bit per sector of the fat buffer, 'sect' being
+ * the sector within window 'idx'
  */
-static int flush_dirty_fat_buffer(fsdata *mydata)
+static void mark_fat_dirty(fsdata *mydata, int idx, int sect)
+{
+	sect += idx * FATBUFBLOCKS;
+	mydata->fat_dirty[sect / 8] |= 1 << (sect % 8);
+}
+
+static void clear_fat_dirty(fsdata *mydata, int idx, int sect)
+{
+	sect += idx * FATBUFBLOCKS;
+	mydata->fat_dirty[sect / 8] &= ~(1 << (sect % 8));
+}
+
+static bool fat_dirty(fsdata *mydata, int idx, int sect)
+{
+	sect += idx * FATBUFBLOCKS;
+	return mydata->fat_dirty[sect / 8] & (1 << (sect % 8));
+}
+
+/*
+ * Write the modified sectors of window 'idx' of the fat buffer into every
+ * FAT on the block device, one request per run of consecutive dirty sectors
+ */
+static int flush_fat_window(fsdata *mydata, int idx)
 {
 	int getsize = FATBUFBLOCKS;
 	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u32 startblock = mydata->fatbufnum[idx] * FATBUFBLOCKS;
+	__u8 *fatbuf = mydata->fatbuf + idx * FATBUFSIZE;
+	int first, last, fat;
 
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
-
-	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
+	if (mydata->fatbufnum[idx] == -1)
 		return 0;
 
+	debug("debug: evicting %d\n", mydata->fatbufnum[idx]);
+
 	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
 	if (startblock + getsize > fatlength)
 		getsize = fatlength - startblock;
 
 	startblock += mydata->fat_sect;
 
-	/* Write FAT buf */
-	if (disk_write(startblock, getsize, bufptr) < 0) {
-		debug("error: writing FAT blocks\n");
-		return -1;
+	for (first = 0; first < getsize; first = last) {
+		if (!fat_dirty(mydata, idx, first)) {
+			last = first + 1;
+			continue;
+		}
+		clear_fat_dirty(mydata, idx, first);
+		for (last = first + 1; last < getsize; last++) {
+			if (!fat_dirty(mydata, idx, last))
+				break;
+			clear_fat_dirty(mydata, idx, last);
+		}
+
+		/* Write FAT buf, then update the corresponding FAT copies */
+		for (fat = 0; fat < mydata->fats; fat++) {
+			if (disk_write(startblock + fat * fatlength + first,
+				       last - first,
+				       fatbuf + first * mydata->sect_size) < 0) {
+				debug("error: writing FAT %d blocks\n", fat);
+				return -1;
+			}
+		}
 	}
 
-	if (mydata->fats == 2) {
-		/* Update corresponding second FAT blocks */
-		startblock += mydata->fatlength;
-		if (disk_write(startblock, getsize, bufptr) < 0) {
-			debug("error: writing second FAT blocks\n");
+	return 0;
+}
+
+/*
+ * Write back every window of the fat buffer. The FAT is only written here
+ * and when a window is replaced, so the changes made by a whole operation
+ * reach the disk together.
+ */
+static int flush_dirty_fat_buffer(fsdata *mydata)
+{
+	int idx;
+
+	for (idx = 0; idx < mydata->fatbufs; idx++) {
+		if (flush_fat_window(mydata, idx) < 0)
 			return -1;
-		}
 	}
-	mydata->fat_dirty = 0;
 
 	return 0;
 }
@@ -277,6 +324,8 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
 	__u32 bufnum, offset, off16;
 	__u16 val1, val2;
+	__u8 *fatbuf;
+	int idx;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -296,73 +345,60 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		return -1;
 	}
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
-
-	/* Mark as dirty */
-	mydata->fat_dirty = 1;
+	/* Find the block of FAT entries in the cache, or read it in */
+	idx = get_fat_window(mydata, bufnum);
+	if (idx < 0)
+		return -1;
+	fatbuf = mydata->fatbuf + idx * FATBUFSIZE;
 
-	/* Set the actual entry */
+	/* Set the actual entry, and mark its sector(s) as dirty */
 	switch (mydata->fatsize) {
 	case 32:
-		((__u32 *) mydata->fatbuf)[offset] = cpu_to_le32(entry_value);
+		((__u32 *)fatbuf)[offset] = cpu_to_le32(entry_value);
+		mark_fat_dirty(mydata, idx, offset * 4 / mydata->sect_size);
 		break;
 	case 16:
-		((__u16 *) mydata->fatbuf)[offset] = cpu_to_le16(entry_value);
+		((__u16 *)fatbuf)[offset] = cpu_to_le16(entry_value);
+		mark_fat_dirty(mydata, idx, offset * 2 / mydata->sect_size);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
+		mark_fat_dirty(mydata, idx, off16 * 2 / mydata->sect_size);
 
 		switch (offset & 0x3) {
 		case 0:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff;
-			((__u16 *)mydata->fatbuf)[off16] |= val1;
+			((__u16 *)fatbuf)[off16] &= ~0xfff;
+			((__u16 *)fatbuf)[off16] |= val1;
 			break;
 		case 1:
 			val1 = cpu_to_le16(entry_value) & 0xf;
 			val2 = (cpu_to_le16(entry_value) >> 4) & 0xff;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xf000;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 12);
+			((__u16 *)fatbuf)[off16] &= ~0xf000;
+			((__u16 *)fatbuf)[off16] |= (val1 << 12);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xff;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xff;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
+			mark_fat_dirty(mydata, idx,
+				       (off16 + 1) * 2 / mydata->sect_size);
 			break;
 		case 2:
 			val1 = cpu_to_le16(entry_value) & 0xff;
 			val2 = (cpu_to_le16(entry_value) >> 8) & 0xf;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xff00;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 8);
+			((__u16 *)fatbuf)[off16] &= ~0xff00;
+			((__u16 *)fatbuf)[off16] |= (val1 << 8);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xf;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xf;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
+			mark_fat_dirty(mydata, idx,
+				       (off16 + 1) * 2 / mydata->sect_size);
 			break;
 		case 3:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff0;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 4);
+			((__u16 *)fatbuf)[off16] &= ~0xfff0;
+			((__u16 *)fatbuf)[off16] |= (val1 << 4);
 			break;
 		default:
 			break;
@@ -384,6 +420,10 @@ static __u32 determine_fatent(fsdata *mydata, __u32 entry)
 {
 	__u32 next_fat, next_entry = entry + 1;
 
+	/* Clusters below free_clust are known to be in use */
+	if (next_entry < mydata->free_clust)
+		next_entry = mydata->free_clust;
+
 	while (1) {
 		next_fat = get_fatent(mydata, next_entry);
 		if (next_fat == 0) {
@@ -393,6 +433,8 @@ static __u32 determine_fatent(fsdata *mydata, __u32 entry)
 		}
 		next_entry++;
 	}
+	if (next_entry == mydata->free_clust)
+		mydata->free_clust = next_entry + 1;
 	debug("FAT%d: entry: %08x, entry_value: %04x\n",
 	       mydata->fatsize, entry, next_entry);
 
@@ -621,11 +663,11 @@ get_set_cluster(fsdata *mydata, __u32 clustnum, loff_t pos, __u8 *buffer,
 }
 
 /*
- * Find the first empty cluster
+ * Find the first empty cluster, which the caller is going to use
  */
 static int find_empty_cluster(fsdata *mydata)
 {
-	__u32 fat_val, entry = 3;
+	__u32 fat_val, entry = mydata->free_clust;
 
 	while (1) {
 		fat_val = get_fatent(mydata, entry);
@@ -633,6 +675,7 @@ static int find_empty_cluster(fsdata *mydata)
 			break;
 		entry++;
 	}
+	mydata->free_clust = entry + 1;
 
 	return entry;
 }
@@ -658,9 +701,6 @@ static int new_dir_table(fat_itr *itr)
 	itr->clust = dir_newclust;
 	itr->next_clust = dir_newclust;
 
-	if (flush_dirty_fat_buffer(mydata) < 0)
-		return -1;
-
 	memset(itr->block, 0x00, bytesperclust);
 
 	itr->dent = (dir_entry *)itr->block;
@@ -684,13 +724,11 @@ static int clear_fatent(fsdata *mydata, __u32 entry)
 		else
 			break;
 
+		if (entry < mydata->free_clust)
+			mydata->free_clust = entry;
 		entry = fat_val;
 	}
 
-	/* Flush fat buffer */
-	if (flush_dirty_fat_buffer(mydata) < 0)
-		return -1;
-
 	return 0;
 }
 
@@ -1252,13 +1290,11 @@ static int fat_dir_entries(fat_itr *itr)
 	fsdata = *dirs->fsdata;
 
 	/* allocate local fat buffer */
-	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (!fsdata.fatbuf) {
+	if (alloc_fat_buffer(mydata, 1) < 0) {
 		debug("Error: allocating memory\n");
 		count = -ENOMEM;
 		goto exit;
 	}
-	fsdata.fatbufnum = -1;
 	dirs->fsdata = &fsdata;
 
 	for (count = 0; fat_itr_next(dirs); count++)
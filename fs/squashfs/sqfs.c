@@ -13,6 +13,7 @@
 #include <linux/types.h>
 #include <linux/byteorder/little_endian.h>
 #include <linux/byteorder/generic.h>
+#include <linux/list.h>
 #include <memalign.h>
 #include <stdlib.h>
 #include <string.h>
@@ -80,113 +81,467 @@ static int sqfs_count_tokens(const char *filename)
  * table start) must be specified. It also calculates the offset from which to
  * start reading the buffer.
  */
-static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
+static int sqfs_calc_n_blks(u64 start, u64 end, u64 *offset)
 {
 	u64 start_, table_size;
 
-	table_size = le64_to_cpu(end) - le64_to_cpu(start);
-	start_ = le64_to_cpu(start) / ctxt.cur_dev->blksz;
-	*offset = le64_to_cpu(start) - (start_ * ctxt.cur_dev->blksz);
+	table_size = end - start;
+	start_ = start / ctxt.cur_dev->blksz;
+	*offset = start - (start_ * ctxt.cur_dev->blksz);
 
 	return DIV_ROUND_UP(table_size + *offset, ctxt.cur_dev->blksz);
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Inode and directory tables are stored as a series of metadata blocks, and
+ * given the compressed size of this table, we can calculate how much metadata
+ * blocks are needed to store the result of the decompression, since a
+ * decompressed metadata block should have a size of 8KiB. Counting stops
+ * after 'max_count' blocks, unless it is 0.
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static int sqfs_count_metablks(void *table, u32 offset, int table_size,
+			       int max_count)
 {
-	u64 start, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
+	int count = 0, cur_size = 0, ret;
+	u32 data_size;
+	bool comp;
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+	do {
+		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
+					  &data_size);
+		if (ret)
+			return -EINVAL;
+		cur_size += data_size + SQFS_HEADER_SIZE;
+		count++;
+	} while (cur_size < table_size && count != max_count);
+
+	/* The last block must not run past the end of the table */
+	if (cur_size > table_size)
 		return -EINVAL;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  sblk->export_table_start,
-				  &table_offset);
+	return count;
+}
 
-	/* Allocate a proper sized buffer to store the fragment index table */
-	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table)
-		return -ENOMEM;
+/*
+ * Storing the metadata blocks header's positions will be useful while looking
+ * for an entry in the directory table, using the reference (index and offset)
+ * given by its inode.
+ */
+static int sqfs_get_metablk_pos(u32 *pos_list, void *table, u32 offset,
+				int metablks_count)
+{
+	u32 data_size, cur_size = 0;
+	int j, ret = 0;
+	bool comp;
 
-	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		free(table);
+	if (!metablks_count)
 		return -EINVAL;
+
+	for (j = 0; j < metablks_count; j++) {
+		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
+					  &data_size);
+		if (ret)
+			return -EINVAL;
+
+		cur_size += data_size + SQFS_HEADER_SIZE;
+		pos_list[j] = cur_size;
 	}
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+	return ret;
+}
 
-	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
-	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+/*
+ * Reads the metadata blocks found between the on-disk offsets 'start' and
+ * 'end' and decompresses them into a new buffer, one every
+ * SQFS_METADATA_BLOCK_SIZE bytes, or only the first 'max_count' of them if
+ * it is not 0. The end of each block, relative to 'start', is stored in a new
+ * 'pos_list'. Returns the number of metadata blocks.
+ */
+static int sqfs_read_metadata(u64 start, u64 end, int max_count,
+			      unsigned char **table, u32 **pos_list)
+{
+	u64 n_blks, table_offset, table_size;
+	int j, ret, metablks_count = -1;
+	unsigned char *src_table, *mtb;
+	unsigned long dest_len = 0;
+	bool compressed;
+	u32 src_len;
 
-	start = start_block / ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
-				  sblk->fragment_table_start, &table_offset);
+	table_size = end - start;
+	n_blks = sqfs_calc_n_blks(start, end, &table_offset);
 
-	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
+	/* Allocate a proper sized buffer (mtb) to store the on-disk table */
+	mtb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!mtb)
+		return -ENOMEM;
+
+	if (sqfs_disk_read(start / ctxt.cur_dev->blksz, n_blks, mtb) < 0)
+		goto free_mtb;
+
+	/* Parse table (metadata block) header */
+	ret = sqfs_read_metablock(mtb, table_offset, &compressed, &src_len);
+	if (ret)
+		goto free_mtb;
+
+	/* Calculate total size to store the whole decompressed table */
+	metablks_count = sqfs_count_metablks(mtb, table_offset, table_size,
+					     max_count);
+	if (metablks_count < 1)
+		goto free_mtb;
+
+	*table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
+	*pos_list = malloc(metablks_count * sizeof(u32));
+	if (!*table || !*pos_list)
+		goto free_table;
+
+	ret = sqfs_get_metablk_pos(*pos_list, mtb, table_offset,
+				   metablks_count);
+	if (ret)
 		goto free_table;
+
+	src_table = mtb + table_offset + SQFS_HEADER_SIZE;
+
+	/* Extract compressed table */
+	for (j = 0; j < metablks_count; j++) {
+		sqfs_read_metablock(mtb, table_offset, &compressed, &src_len);
+		if (compressed) {
+			dest_len = SQFS_METADATA_BLOCK_SIZE;
+			ret = sqfs_decompress(&ctxt, *table +
+					      (j * SQFS_METADATA_BLOCK_SIZE),
+					      &dest_len, src_table, src_len);
+			if (ret)
+				goto free_table;
+
+			/* Only the last block of a table can be short */
+			if (dest_len < SQFS_METADATA_BLOCK_SIZE)
+				break;
+		} else {
+			memcpy(*table + (j * SQFS_METADATA_BLOCK_SIZE),
+			       src_table, src_len);
+		}
+
+		/*
+		 * Offsets to the metadata buffer 'mtb' and to the
+		 * decompression source, respectively.
+		 */
+		table_offset += src_len + SQFS_HEADER_SIZE;
+		src_table += src_len + SQFS_HEADER_SIZE;
 	}
 
-	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
-		ret = -EINVAL;
-		goto free_buffer;
+	goto free_mtb;
+
+free_table:
+	metablks_count = -1;
+	free(*table);
+	free(*pos_list);
+free_mtb:
+	free(mtb);
+
+	return metablks_count;
+}
+
+/*
+ * Decompressed metadata is kept from one call to the next: the inode and
+ * directory tables, which every sqfs_opendir() needs in full, the fragment
+ * index, and the single metadata blocks of fragment entries which were looked
+ * up. Entries are found by the on-disk offset of their first metadata block,
+ * and the least recently used ones are dropped to stay within
+ * CONFIG_SQUASHFS_CACHE_SIZE KiB.
+ *
+ * The filesystem is closed after each command, so the cache outlives
+ * sqfs_close(): sqfs_probe() keeps it as long as it finds the same
+ * superblock on the same partition. Loading several files from a partition
+ * then only decompresses its metadata once.
+ *
+ * Callers are handed the cached tables themselves, so an entry which is
+ * dropped while in use is only freed once its last user releases it.
+ */
+struct sqfs_cache_entry {
+	struct list_head list;
+	u64 start;		/* on-disk offset of the first block */
+	u64 end;		/* on-disk offset past the last block */
+	int count;		/* number of metadata blocks, 0 if raw */
+	int refs;		/* users of 'data', see sqfs_put_metadata() */
+	size_t size;		/* bytes in 'data' */
+	unsigned char *data;
+	u32 *pos_list;
+};
+
+static struct {
+	struct list_head entries;	/* most recently used first */
+	struct list_head dropped;	/* dropped, but still in use */
+	size_t size;
+	struct blk_desc *dev;
+	lbaint_t part_start;
+	struct squashfs_super_block sblk;
+} sqfs_cache = {
+	.entries = LIST_HEAD_INIT(sqfs_cache.entries),
+	.dropped = LIST_HEAD_INIT(sqfs_cache.dropped),
+};
+
+static void sqfs_cache_free(struct sqfs_cache_entry *entry)
+{
+	free(entry->data);
+	free(entry->pos_list);
+	free(entry);
+}
+
+static void sqfs_cache_drop(struct sqfs_cache_entry *entry)
+{
+	list_del(&entry->list);
+	sqfs_cache.size -= entry->size;
+	if (entry->refs)
+		list_add(&entry->list, &sqfs_cache.dropped);
+	else
+		sqfs_cache_free(entry);
+}
+
+static void sqfs_cache_flush(void)
+{
+	struct sqfs_cache_entry *entry, *n;
+
+	list_for_each_entry_safe(entry, n, &sqfs_cache.entries, list)
+		sqfs_cache_drop(entry);
+	sqfs_cache.dev = NULL;
+}
+
+/* Drop the cache unless it belongs to the filesystem which was just probed */
+static void sqfs_cache_check(void)
+{
+	if (sqfs_cache.dev == ctxt.cur_dev &&
+	    sqfs_cache.part_start == ctxt.cur_part_info.start &&
+	    !memcmp(&sqfs_cache.sblk, ctxt.sblk, sizeof(sqfs_cache.sblk)))
+		return;
+
+	sqfs_cache_flush();
+	sqfs_cache.dev = ctxt.cur_dev;
+	sqfs_cache.part_start = ctxt.cur_part_info.start;
+	memcpy(&sqfs_cache.sblk, ctxt.sblk, sizeof(sqfs_cache.sblk));
+}
+
+static struct sqfs_cache_entry *sqfs_cache_find(u64 start)
+{
+	struct sqfs_cache_entry *entry;
+
+	list_for_each_entry(entry, &sqfs_cache.entries, list) {
+		if (entry->start == start) {
+			list_move(&entry->list, &sqfs_cache.entries);
+			return entry;
+		}
 	}
 
-	/* Every metadata block starts with a 16-bit header */
-	header = get_unaligned_le16(metadata_buffer + table_offset);
-	metadata = metadata_buffer + table_offset + SQFS_HEADER_SIZE;
+	return NULL;
+}
 
-	if (!metadata || !header) {
-		ret = -ENOMEM;
-		goto free_buffer;
+/*
+ * Adds data to the cache, which then owns it. Returns NULL if it does not fit,
+ * which is always the case with a zero sized cache, and the caller keeps it.
+ */
+static struct sqfs_cache_entry *sqfs_cache_add(u64 start, u64 end, int count,
+					       size_t size, unsigned char *data,
+					       u32 *pos_list)
+{
+	struct sqfs_cache_entry *entry;
+
+	size += count * sizeof(u32);
+	if (size > CONFIG_SQUASHFS_CACHE_SIZE * 1024)
+		return NULL;
+
+	entry = malloc(sizeof(*entry));
+	if (!entry)
+		return NULL;
+
+	while (sqfs_cache.size + size > CONFIG_SQUASHFS_CACHE_SIZE * 1024)
+		sqfs_cache_drop(list_last_entry(&sqfs_cache.entries,
+						struct sqfs_cache_entry, list));
+
+	entry->start = start;
+	entry->end = end;
+	entry->count = count;
+	entry->refs = 0;
+	entry->size = size;
+	entry->data = data;
+	entry->pos_list = pos_list;
+	list_add(&entry->list, &sqfs_cache.entries);
+	sqfs_cache.size += size;
+
+	return entry;
+}
+
+/*
+ * Gets the decompressed metadata blocks found between the on-disk offsets
+ * 'start' and 'end', or only the first 'max_count' of them, as
+ * sqfs_read_metadata() does. '*table' and '*pos_list' are shared with the
+ * cache and must not be changed; the caller releases them with
+ * sqfs_put_metadata().
+ */
+static int sqfs_get_metadata(u64 start, u64 end, int max_count,
+			     unsigned char **table, u32 **pos_list)
+{
+	struct sqfs_cache_entry *entry;
+	unsigned char *data;
+	u32 *pos;
+	int count;
+
+	/* An entry holding fewer blocks than asked for is read again */
+	entry = sqfs_cache_find(start);
+	if (entry && (max_count ? entry->count < max_count : entry->end < end)) {
+		sqfs_cache_drop(entry);
+		entry = NULL;
+	}
+	if (!entry) {
+		count = sqfs_read_metadata(start, end, max_count, &data, &pos);
+		if (count < 1)
+			return count;
+
+		entry = sqfs_cache_add(start, start + pos[count - 1], count,
+				       count * SQFS_METADATA_BLOCK_SIZE, data,
+				       pos);
+		if (!entry) {
+			/* Too big for the cache, the caller owns it */
+			*table = data;
+			if (pos_list)
+				*pos_list = pos;
+			else
+				free(pos);
+			return count;
+		}
 	}
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
-		ret = -ENOMEM;
-		goto free_buffer;
+	entry->refs++;
+	*table = entry->data;
+	if (pos_list)
+		*pos_list = entry->pos_list;
+
+	return entry->count;
+}
+
+static struct sqfs_cache_entry *sqfs_cache_find_data(struct list_head *head,
+						     unsigned char *data)
+{
+	struct sqfs_cache_entry *entry;
+
+	list_for_each_entry(entry, head, list) {
+		if (entry->data == data)
+			return entry;
 	}
 
-	if (SQFS_COMPRESSED_METADATA(header)) {
-		src_len = SQFS_METADATA_SIZE(header);
-		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
-				      src_len);
-		if (ret) {
-			ret = -EINVAL;
-			goto free_entries;
-		}
-	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
+	return NULL;
+}
+
+/*
+ * Releases the metadata got from sqfs_get_metadata(). 'pos_list' may be NULL
+ * if it was not asked for.
+ */
+static void sqfs_put_metadata(unsigned char *table, u32 *pos_list)
+{
+	struct sqfs_cache_entry *entry;
+
+	if (!table)
+		return;
+
+	entry = sqfs_cache_find_data(&sqfs_cache.entries, table);
+	if (entry) {
+		entry->refs--;
+		return;
+	}
+
+	entry = sqfs_cache_find_data(&sqfs_cache.dropped, table);
+	if (!entry) {
+		free(table);
+		free(pos_list);
+		return;
+	}
+
+	if (!--entry->refs) {
+		list_del(&entry->list);
+		sqfs_cache_free(entry);
+	}
+}
+
+/*
+ * Gets the fragment table's index, which lists the metadata blocks holding
+ * the fragment block entries. Returns NULL on error; otherwise the index
+ * stays valid until the next call.
+ */
+static unsigned char *sqfs_get_frag_index(void)
+{
+	static unsigned char *index;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start, n_blks, table_offset, table_size;
+	struct sqfs_cache_entry *entry;
+	unsigned char *table;
+
+	start = get_unaligned_le64(&sblk->fragment_table_start);
+	table_size = DIV_ROUND_UP(get_unaligned_le32(&sblk->fragments),
+				  SQFS_MAX_ENTRIES) * sizeof(u64);
+	entry = sqfs_cache_find(start);
+	if (entry)
+		return entry->data;
+
+	n_blks = sqfs_calc_n_blks(start, start + table_size, &table_offset);
+
+	/* Allocate a proper sized buffer to store the fragment index table */
+	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!table)
+		return NULL;
+
+	if (sqfs_disk_read(start / ctxt.cur_dev->blksz, n_blks, table) < 0) {
+		free(table);
+		return NULL;
 	}
+	memmove(table, table + table_offset, table_size);
+
+	free(index);
+	index = NULL;
+	if (sqfs_cache_add(start, start + table_size, 0, table_size, table,
+			   NULL))
+		return table;
+	index = table;
+
+	return index;
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_fragment_block_entry *entries;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start_block, end;
+	unsigned char *index;
+	int block, offset, ret;
+
+	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+		return -EINVAL;
+
+	index = sqfs_get_frag_index();
+	if (!index)
+		return -EINVAL;
+
+	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+
+	/*
+	 * Get the start offset of the metadata block that contains the right
+	 * fragment block entry
+	 */
+	start_block = get_unaligned_le64(index + block * sizeof(u64));
+	end = min_t(u64, get_unaligned_le64(&sblk->fragment_table_start),
+		    start_block + SQFS_HEADER_SIZE + SQFS_METADATA_BLOCK_SIZE);
+
+	/* Only decompress that block, not the rest of the table after it */
+	ret = sqfs_get_metadata(start_block, end, 1,
+				(unsigned char **)&entries, NULL);
+	if (ret < 1)
+		return -EINVAL;
 
 	*e = entries[offset];
 	ret = SQFS_COMPRESSED_BLOCK(e->size);
-
-free_entries:
-	free(entries);
-free_buffer:
-	free(metadata_buffer);
-free_table:
-	free(table);
+	sqfs_put_metadata((unsigned char *)entries, NULL);
 
 	return ret;
 }
@@ -577,236 +932,30 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 	return 0;
 }
 
-/*
- * Inode and directory tables are stored as a series of metadata blocks, and
- * given the compressed size of this table, we can calculate how much metadata
- * blocks are needed to store the result of the decompression, since a
- * decompressed metadata block should have a size of 8KiB.
- */
-static int sqfs_count_metablks(void *table, u32 offset, int table_size)
-{
-	int count = 0, cur_size = 0, ret;
-	u32 data_size;
-	bool comp;
-
-	do {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		count++;
-	} while (cur_size < table_size);
-
-	return count;
-}
-
-/*
- * Storing the metadata blocks header's positions will be useful while looking
- * for an entry in the directory table, using the reference (index and offset)
- * given by its inode.
- */
-static int sqfs_get_metablk_pos(u32 *pos_list, void *table, u32 offset,
-				int metablks_count)
-{
-	u32 data_size, cur_size = 0;
-	int j, ret = 0;
-	bool comp;
-
-	if (!metablks_count)
-		return -EINVAL;
-
-	for (j = 0; j < metablks_count; j++) {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		pos_list[j] = cur_size;
-	}
-
-	return ret;
-}
-
 static int sqfs_read_inode_table(unsigned char **inode_table)
 {
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	u64 start, n_blks, table_offset, table_size;
-	int j, ret = 0, metablks_count;
-	unsigned char *src_table, *itb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
-
-	table_size = get_unaligned_le64(&sblk->directory_table_start) -
-		get_unaligned_le64(&sblk->inode_table_start);
-	start = get_unaligned_le64(&sblk->inode_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->inode_table_start,
-				  sblk->directory_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (itb) to store the inode table */
-	itb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!itb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, itb) < 0) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Parse inode table (metadata block) header */
-	ret = sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-	if (ret) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
+	int metablks_count;
+	u64 start, end;
 
-	/* Calculate size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(itb, table_offset, table_size);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	*inode_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*inode_table) {
-		ret = -ENOMEM;
-		goto free_itb;
-	}
-
-	src_table = itb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Inode table */
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *inode_table +
-					      dest_offset, &dest_len,
-					      src_table, src_len);
-			if (ret) {
-				free(*inode_table);
-				goto free_itb;
-			}
-
-			dest_offset += dest_len;
-		} else {
-			memcpy(*inode_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
-
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'itb' and to the decompression source, respectively.
-		 */
-
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
-	}
-
-free_itb:
-	free(itb);
+	start = get_unaligned_le64(&sblk->inode_table_start);
+	end = get_unaligned_le64(&sblk->directory_table_start);
+	metablks_count = sqfs_get_metadata(start, end, 0, inode_table, NULL);
+	if (metablks_count < 1)
+		return -EINVAL;
 
-	return ret;
+	return 0;
 }
 
 static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
 {
-	u64 start, n_blks, table_offset, table_size;
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	int j, ret = 0, metablks_count = -1;
-	unsigned char *src_table, *dtb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
-
-	/* DIRECTORY TABLE */
-	table_size = get_unaligned_le64(&sblk->fragment_table_start) -
-		get_unaligned_le64(&sblk->directory_table_start);
-	start = get_unaligned_le64(&sblk->directory_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->directory_table_start,
-				  sblk->fragment_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (dtb) to store the directory table */
-	dtb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!dtb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, dtb) < 0)
-		goto free_dtb;
-
-	/* Parse directory table (metadata block) header */
-	ret = sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-	if (ret)
-		goto free_dtb;
-
-	/* Calculate total size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(dtb, table_offset, table_size);
-	if (metablks_count < 1)
-		goto free_dtb;
-
-	*dir_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*dir_table)
-		goto free_dtb;
-
-	*pos_list = malloc(metablks_count * sizeof(u32));
-	if (!*pos_list) {
-		free(*dir_table);
-		goto free_dtb;
-	}
-
-	ret = sqfs_get_metablk_pos(*pos_list, dtb, table_offset,
-				   metablks_count);
-	if (ret) {
-		metablks_count = -1;
-		free(*dir_table);
-		free(*pos_list);
-		goto free_dtb;
-	}
-
-	src_table = dtb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Directory table */
-	dest_offset = 0;
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *dir_table +
-					      (j * SQFS_METADATA_BLOCK_SIZE),
-					      &dest_len, src_table, src_len);
-			if (ret) {
-				metablks_count = -1;
-				free(*dir_table);
-				goto free_dtb;
-			}
+	u64 start, end;
 
-			if (dest_len < SQFS_METADATA_BLOCK_SIZE) {
-				dest_offset += dest_len;
-				break;
-			}
+	start = get_unaligned_le64(&sblk->directory_table_start);
+	end = get_unaligned_le64(&sblk->fragment_table_start);
 
-			dest_offset += dest_len;
-		} else {
-			memcpy(*dir_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
-
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'dtb' and to the decompression source, respectively.
-		 */
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
-	}
-
-free_dtb:
-	free(dtb);
-
-	return metablks_count;
+	return sqfs_get_metadata(start, end, 0, dir_table, pos_list);
 }
 
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
@@ -826,17 +975,23 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 		return -EINVAL;
 
 	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1)
-		return -EINVAL;
+	if (metablks_count < 1) {
+		ret = -EINVAL;
+		goto put_tables;
+	}
 
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
-	if (token_count < 0)
-		return -EINVAL;
+	if (token_count < 0) {
+		ret = -EINVAL;
+		goto put_tables;
+	}
 
 	path = strdup(filename);
-	if (!path)
-		return -ENOMEM;
+	if (!path) {
+		ret = -ENOMEM;
+		goto put_tables;
+	}
 
 	token_list = malloc(token_count * sizeof(char *));
 	if (!token_list) {
@@ -854,6 +1009,7 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	 */
 	dirs->inode_table = inode_table;
 	dirs->dir_table = dir_table;
+	dirs->pos_list = pos_list;
 	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
 			      metablks_count);
 	if (ret)
@@ -879,9 +1035,14 @@ free_tokens:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
 free_path:
 	free(path);
+put_tables:
+	/* Otherwise they are released by sqfs_closedir() */
+	if (ret) {
+		sqfs_put_metadata(inode_table, NULL);
+		sqfs_put_metadata(dir_table, pos_list);
+	}
 
 	return ret;
 }
@@ -1028,6 +1189,8 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 		return -EINVAL;
 	}
 
+	sqfs_cache_check();
+
 	return 0;
 }
 
@@ -1158,7 +1321,7 @@ static int sqfs_get_regfile_info(struct squashfs_reg_inode *reg,
 				       fentry);
 		if (ret < 0)
 			return -EINVAL;
-		finfo->comp = true;
+		finfo->comp = ret;
 		if (fentry->size < 1 || fentry->start == 0x7FFFFFFF)
 			return -EINVAL;
 	} else {
@@ -1196,7 +1359,7 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 				       fentry);
 		if (ret < 0)
 			return -EINVAL;
-		finfo->comp = true;
+		finfo->comp = ret;
 		if (fentry->size < 1 || fentry->start == 0x7FFFFFFF)
 			return -EINVAL;
 	} else {
@@ -1210,6 +1373,20 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 	return datablk_count;
 }
 
+/*
+ * Copies the tail of a file from its fragment. The tail follows the '*actread'
+ * bytes read from the data blocks, up to 'size'.
+ */
+static void sqfs_copy_tail(void *buf, const void *tail, loff_t size,
+			   loff_t *actread)
+{
+	if (*actread >= size)
+		return;
+
+	memcpy(buf + *actread, tail, size - *actread);
+	*actread = size;
+}
+
 int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	      loff_t *actread)
 {
@@ -1421,20 +1598,15 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 			goto free_fragment;
 		}
 
-		for (j = offset + *actread; j < finfo.size; j++) {
-			memcpy(buf + j, &fragment_block[finfo.offset + j], 1);
-			(*actread)++;
-		}
-
+		sqfs_copy_tail(buf + offset, fragment_block + finfo.offset,
+			       finfo.size, actread);
 		free(fragment_block);
 
 	} else if (finfo.frag && !finfo.comp) {
 		fragment_block = (void *)fragment + table_offset;
 
-		for (j = offset + *actread; j < finfo.size; j++) {
-			memcpy(buf + j, &fragment_block[finfo.offset + j], 1);
-			(*actread)++;
-		}
+		sqfs_copy_tail(buf + offset, fragment_block + finfo.offset,
+			       finfo.size, actread);
 	}
 
 free_fragment:
@@ -1552,7 +1724,7 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 	struct squashfs_dir_stream *sqfs_dirs;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
+	sqfs_put_metadata(sqfs_dirs->inode_table, NULL);
+	sqfs_put_metadata(sqfs_dirs->dir_table, sqfs_dirs->pos_list);
 	free(sqfs_dirs->dir_header);
 }
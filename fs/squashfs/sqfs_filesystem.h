@@ -273,11 +273,13 @@ struct squashfs_dir_stream {
 	struct squashfs_dir_inode i_dir;
 	struct squashfs_ldir_inode i_ldir;
 	/*
-	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * References to the tables' beginnings, and the positions of the
+	 * directory table's metadata blocks. They are assigned in
+	 * sqfs_opendir() and released in sqfs_closedir().
 	 */
 	unsigned char *inode_table;
 	unsigned char *dir_table;
+	u32 *pos_list;
 };
 
 struct squashfs_file_info {
@@ -2231,6 +2231,11 @@ static struct ubifs_info *alloc_ubifs_info(struct ubi_volume_desc *ubi)
 		INIT_LIST_HEAD(&c->orph_list);
 		INIT_LIST_HEAD(&c->orph_new);
 		c->no_chk_data_crc = 1;
+#ifdef __UBOOT__
+		/* Set up c->bu at mount time for ubifs_read() to use */
+		if (IS_ENABLED(CONFIG_UBIFS_BULK_READ))
+			c->bulk_read = 1;
+#endif
 
 		c->highest_inum = UBIFS_FIRST_INO;
 		c->lhead_lnum = c->ltail_lnum = UBIFS_LOG_LNUM;
@@ -2874,6 +2874,72 @@ void ubifs_tnc_close(struct ubifs_info *c)
 	destroy_old_idx(c);
 }
 
+/* Counts TNC lookups, see get_seconds() in ubifs.h */
+unsigned long ubifs_tnc_clock;
+
+/*
+ * Free the clean subtrees below @znode which were last used before @cutoff.
+ * Returns the last use of the least recently used clean znode left below
+ * @znode, or %ULONG_MAX if there is none.
+ */
+static unsigned long trim_older(struct ubifs_info *c,
+				struct ubifs_znode *znode, unsigned long cutoff)
+{
+	unsigned long oldest = ULONG_MAX;
+	long freed;
+	int n;
+
+	for (n = 0; n < znode->child_cnt; n++) {
+		struct ubifs_znode *child = znode->zbranch[n].znode;
+
+		if (!child)
+			continue;
+
+		/* A dirty znode may have dirty children, only look below it */
+		if (!ubifs_zn_dirty(child)) {
+			if (child->time < cutoff) {
+				freed = ubifs_destroy_tnc_subtree(child);
+				znode->zbranch[n].znode = NULL;
+				atomic_long_sub(freed, &c->clean_zn_cnt);
+				atomic_long_sub(freed, &ubifs_clean_zn_cnt);
+				continue;
+			}
+			oldest = min(oldest, child->time);
+		}
+		if (child->level)
+			oldest = min(oldest, trim_older(c, child, cutoff));
+	}
+
+	return oldest;
+}
+
+/**
+ * ubifs_tnc_trim - drop least recently used znodes when there are too many.
+ * @c: UBIFS file-system description object
+ * @max: maximum number of clean znodes to keep cached
+ *
+ * A lookup marks every znode on its path as used, so the subtree of a stale
+ * znode mostly holds stale znodes as well. This function frees the clean
+ * subtrees last used in the older half of the time since the least recently
+ * used one, and repeats that until no more than @max clean znodes are cached.
+ * They are read back from the index the next time a lookup walks through them.
+ */
+void ubifs_tnc_trim(struct ubifs_info *c, long max)
+{
+	struct ubifs_znode *root = c->zroot.znode;
+	unsigned long oldest;
+
+	if (!root || root->level == 0 ||
+	    atomic_long_read(&c->clean_zn_cnt) <= max)
+		return;
+
+	oldest = trim_older(c, root, 0);
+	while (oldest != ULONG_MAX &&
+	       atomic_long_read(&c->clean_zn_cnt) > max)
+		oldest = trim_older(c, root,
+				    oldest + (ubifs_tnc_clock - oldest) / 2 + 1);
+}
+
 /**
  * left_znode - get the znode to the left.
  * @c: UBIFS file-system description object
@@ -671,23 +671,13 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+static int unpack_block(struct inode *inode, void *addr, unsigned int block,
+			struct ubifs_data_node *dn)
 {
 	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -718,6 +708,73 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return unpack_block(inode, addr, block, dn);
+}
+
+/*
+ * Read up to @max whole blocks of @inode, starting at @block, into @addr.
+ * The data nodes are looked up in one TNC walk and, as they sit next to each
+ * other in a LEB, read with a single flash read. Holes between them are
+ * zeroed. Returns the number of blocks filled in, 0 if nothing could be
+ * bulk-read, or a negative error code.
+ */
+static int read_bulk(struct ubifs_info *c, struct inode *inode,
+		     struct bu_info *bu, void *addr, unsigned int block,
+		     unsigned int max)
+{
+	unsigned int b, next = block;
+	void *buf;
+	int err, i;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+	if (!bu->cnt)
+		return 0;
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err == -EAGAIN)
+		return 0;
+	if (err)
+		return err;
+
+	buf = bu->buf;
+	for (i = 0; i < bu->cnt; i++) {
+		b = key_block(c, &bu->zbranch[i].key);
+		if (b - block >= max)
+			break;
+
+		memset(addr + (next - block) * UBIFS_BLOCK_SIZE, 0,
+		       (b - next) * UBIFS_BLOCK_SIZE);
+		err = unpack_block(inode, addr + (b - block) * UBIFS_BLOCK_SIZE,
+				   b, buf);
+		if (err)
+			return err;
+
+		next = b + 1;
+		buf += ALIGN(bu->zbranch[i].len, 8);
+	}
+
+	return next - block;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -840,6 +897,8 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	int i;
 	int count;
 	int last_block_size = 0;
+	int n;
+	struct bu_info *bu = c->bu.buf ? &c->bu : NULL;
 
 	*actread = 0;
 
@@ -887,21 +946,32 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	page.addr = buf;
 	page.index = offset / PAGE_SIZE;
 	page.inode = inode;
-	for (i = 0; i < count; i++) {
+	if (bu)
+		bu->buf_len = c->max_bu_buf_len;
+	for (i = 0; i < count; i += n) {
 		/*
 		 * Make sure to not read beyond the requested size
 		 */
 		if (((i + 1) == count) && (size < inode->i_size))
 			last_block_size = size - (i * PAGE_SIZE);
 
-		err = do_readpage(c, inode, &page, last_block_size);
+		n = 0;
+		/* The last block may be partial, leave it to do_readpage() */
+		if (bu && (i + 1) < count)
+			n = read_bulk(c, inode, bu, page.addr, page.index,
+				      count - 1 - i);
+		if (n < 0) {
+			err = n;
+		} else if (!n) {
+			n = 1;
+			err = do_readpage(c, inode, &page, last_block_size);
+		}
 		if (err)
 			break;
 
-		page.addr += PAGE_SIZE;
-		page.index++;
+		page.addr += n * PAGE_SIZE;
+		page.index += n;
 	}
-
 	if (err) {
 		printf("Error reading file '%s'\n", filename);
 		*actread = i * PAGE_SIZE;
@@ -913,6 +983,8 @@ put_inode:
 	ubifs_iput(inode);
 
 out:
+	if (CONFIG_UBIFS_TNC_CACHE_ZNODES)
+		ubifs_tnc_trim(c, CONFIG_UBIFS_TNC_CACHE_ZNODES);
 	ubi_close_volume(c->ubi);
 	return err;
 }
@@ -68,7 +68,6 @@ void iput(struct inode *inode);
 
 /* linux/include/time.h */
 #define NSEC_PER_SEC	1000000000L
-#define get_seconds()	0
 #define CURRENT_TIME_SEC	((struct timespec) { get_seconds(), 0 })
 
 struct timespec {
@@ -453,9 +452,12 @@ struct file {
 };
 
 /*
- * get_seconds() not really needed in the read-only implmentation
+ * There is no wall clock in the read-only implementation. get_seconds()
+ * counts TNC lookups instead, so that znode->time orders znodes by their last
+ * use for ubifs_tnc_trim().
  */
-#define get_seconds()		0
+extern unsigned long ubifs_tnc_clock;
+#define get_seconds()		(++ubifs_tnc_clock)
 
 /* 4k page size */
 #define PAGE_CACHE_SHIFT	12
@@ -1353,7 +1355,7 @@ struct ubifs_zbranch {
  * @parent: parent znode or NULL if it is the root
  * @cnext: next znode to commit
  * @flags: znode flags (%DIRTY_ZNODE, %COW_ZNODE or %OBSOLETE_ZNODE)
- * @time: last access time (seconds)
+ * @time: last access time (seconds, or lookup count in U-Boot)
  * @level: level of the entry in the TNC tree
  * @child_cnt: count of child znodes
  * @iip: index in parent's zbranch array
@@ -2205,6 +2207,7 @@ struct ubifs_dent_node *ubifs_tnc_next_ent(struct ubifs_info *c,
 					   union ubifs_key *key,
 					   const struct qstr *nm);
 void ubifs_tnc_close(struct ubifs_info *c);
+void ubifs_tnc_trim(struct ubifs_info *c, long max);
 int ubifs_tnc_has_node(struct ubifs_info *c, union ubifs_key *key, int level,
 		       int lnum, int offs, int is_idx);
 int ubifs_dirty_idx_node(struct ubifs_info *c, union ubifs_key *key, int level,
@@ -139,6 +139,12 @@ struct ahci_ioports {
 	struct ahci_sg		*cmd_tbl_sg;
 	ulong	cmd_tbl;
 	u32	rx_fis;
+	void	*ncq_tbl;	/* command tables, one per queued command */
+	u32	ncq_depth;	/* commands queued at once, 0 without NCQ */
+	u32	xfer_cmds;	/* read/write requests handled */
+	u32	max_queued;	/* most commands seen queued at once */
+	u64	xfer_bytes;	/* bytes read and written */
+	u64	xfer_us;	/* time spent reading and writing */
 };
 
 /**
@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -152,6 +153,30 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_readahead() - decide whether a missed read should be extended
+ *
+ * This is called after blkcache_read() misses. If the device is being read
+ * sequentially, the read can be extended past the blocks requested so that
+ * the following reads are served from the cache. The caller reads
+ * @blkcnt plus the returned number of blocks into the buffer returned in
+ * @bufp, passes that buffer to blkcache_fill() and copies the first @blkcnt
+ * blocks to its own buffer.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks requested
+ * @param blksz - size in bytes of each block
+ * @param lba - number of blocks on the device
+ * @param bufp - returns the buffer to read into
+ *
+ * @return - number of extra blocks to read, 0 to do a normal read
+ */
+lbaint_t blkcache_readahead(int iftype, int dev,
+			    lbaint_t start, lbaint_t blkcnt,
+			    unsigned long blksz, lbaint_t lba, void **bufp);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -169,15 +194,30 @@ void blkcache_invalidate(int iftype, int dev);
  */
 void blkcache_configure(unsigned blocks, unsigned entries);
 
+/**
+ * blkcache_configure_size() - configure block cache and its memory budget
+ *
+ * @param blocks - blocks per entry, rounded down to a power of two
+ * @param entries - maximum entries in cache
+ * @param max_bytes - maximum memory used for cached data
+ */
+void blkcache_configure_size(unsigned blocks, unsigned entries,
+			     ulong max_bytes);
+
 /*
  * statistics of the block cache
  */
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned evictions;
+	unsigned readaheads;
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned ways; /* entries per set */
+	ulong bytes; /* memory used by cached data */
+	ulong max_bytes;
 };
 
 /**
@@ -200,6 +240,14 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline lbaint_t blkcache_readahead(int iftype, int dev,
+					  lbaint_t start, lbaint_t blkcnt,
+					  unsigned long blksz, lbaint_t lba,
+					  void **bufp)
+{
+	return 0;
+}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
@@ -207,6 +255,59 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+/**
+ * struct blk_sg - one buffer of a block request
+ *
+ * @buf:	Data buffer
+ * @blkcnt:	Number of blocks transferred to or from @buf
+ */
+struct blk_sg {
+	void *buf;
+	lbaint_t blkcnt;
+};
+
+/**
+ * struct blk_req - an asynchronous block request
+ *
+ * The caller fills in the fields up to @priv, submits the request with
+ * blk_submit() and must leave it alone until @done is set. The blocks of
+ * the request are contiguous on the device, starting at @start, and are
+ * transferred to or from the buffers in @sg in order.
+ *
+ * @op:		Operation to carry out
+ * @start:	First block on the device
+ * @sg:		List of buffers
+ * @sg_count:	Number of entries in @sg
+ * @tag:	Value for the caller's use, not touched by the block layer
+ * @complete:	Called once the request is finished, or NULL. This may be
+ *		called from within blk_submit() or blk_poll()
+ * @priv:	Pointer for the caller's use
+ * @result:	Number of blocks transferred, or -ve error number, valid once
+ *		@done is set
+ * @done:	Set once the request is finished, just before @complete
+ * @node:	For use by the driver while the request is in flight
+ * @drv_data:	For use by the driver while the request is in flight
+ */
+struct blk_req {
+	enum blk_req_op op;
+	lbaint_t start;
+	struct blk_sg *sg;
+	int sg_count;
+	ulong tag;
+	void (*complete)(struct blk_req *req);
+	void *priv;
+
+	long result;
+	bool done;
+	struct list_head node;
+	u64 drv_data;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -265,6 +366,31 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start an asynchronous request (optional)
+	 *
+	 * The driver queues the request and returns without waiting for it.
+	 * It finishes the request with blk_req_finish() from its poll()
+	 * method, or straight away if it cannot queue it. Drivers without
+	 * this method have their requests carried out synchronously with
+	 * read() and write().
+	 *
+	 * @dev:	Device to submit to
+	 * @req:	Request to start
+	 * @return 0 if OK, -ve on error (the request is then not started)
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - make progress on submitted requests (optional)
+	 *
+	 * This must not wait for requests which are still in progress.
+	 *
+	 * @dev:	Device to poll
+	 * @return number of requests finished, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -282,6 +408,58 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_submit() - submit an asynchronous request to a block device
+ *
+ * Devices whose driver cannot queue requests carry out the request before
+ * this returns, so callers must be prepared for @req to be finished (and
+ * its completion callback to have run) on return.
+ *
+ * @dev:	Block device
+ * @req:	Request to submit, see struct blk_req
+ * @return 0 if the request was submitted, -ve on error. Errors during the
+ * transfer are reported in @req->result instead
+ */
+int blk_submit(struct udevice *dev, struct blk_req *req);
+
+/**
+ * blk_poll() - make progress on requests submitted to a block device
+ *
+ * @dev:	Block device
+ * @return number of requests finished, or -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - wait for a submitted request to finish
+ *
+ * @dev:	Block device the request was submitted to
+ * @req:	Request to wait for
+ * @timeout_ms:	Time to wait in milliseconds
+ * @return number of blocks transferred, -ETIMEDOUT if @req did not finish
+ * in time, or other -ve error number
+ */
+long blk_wait(struct udevice *dev, struct blk_req *req, ulong timeout_ms);
+
+/**
+ * blk_req_blkcnt() - get the number of blocks of a request
+ *
+ * @req:	Request to check
+ * @return the total number of blocks in the buffers of @req
+ */
+lbaint_t blk_req_blkcnt(const struct blk_req *req);
+
+/**
+ * blk_req_finish() - mark a request as finished
+ *
+ * This is called by drivers when a request has been carried out. It sets
+ * the result and calls the completion callback of the request.
+ *
+ * @req:	Request which is finished
+ * @result:	Number of blocks transferred, or -ve error number
+ */
+void blk_req_finish(struct blk_req *req, long result);
+
 /**
  * blk_find_device() - Find a block device
  *
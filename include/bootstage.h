@@ -205,6 +205,12 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_FSP_M,
 	BOOTSTAGE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_FIT_READ,
+	BOOTSTAGE_ID_ACCUM_FIT_HASH,
+	BOOTSTAGE_ID_ACCUM_UBI_FASTMAP,
+	BOOTSTAGE_ID_ACCUM_UBI_POOL,
+	BOOTSTAGE_ID_ACCUM_UBI_SCAN,
+	BOOTSTAGE_ID_ACCUM_DM_SCAN_FDT,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -110,6 +110,44 @@ int device_ofdata_to_platdata(struct udevice *dev);
  */
 int device_probe(struct udevice *dev);
 
+/**
+ * device_probe_start() - Start probing a device, without waiting for it
+ *
+ * This is the same as device_probe() except for devices whose driver starts
+ * probing and then has to wait for the hardware (see the probe_poll() method
+ * of struct driver). Those are left in the probe queue with
+ * DM_FLAG_PROBE_PENDING set, and finish probing when the queue is polled or
+ * when device_probe() is next called on them.
+ *
+ * @dev: Pointer to device to probe
+ * @return 0 if OK or still probing, -ve on error
+ */
+int device_probe_start(struct udevice *dev);
+
+/**
+ * device_probe_poll() - Check on a device which is still probing
+ *
+ * This calls the driver's probe_poll() method and finishes probing the device
+ * if it is done.
+ *
+ * @dev: Pointer to device to check
+ * @return -EINPROGRESS if it is still probing, 0 if it is now probed, other
+ *	-ve value if probing failed. Returns 0 if the device is not probing but
+ *	already active, else -ENODEV
+ */
+int device_probe_poll(struct udevice *dev);
+
+/**
+ * device_probe_cancel() - Stop probing a device
+ *
+ * This calls the driver's remove() method on a device which is still probing
+ * and leaves it inactive. It does nothing if the device is not probing.
+ *
+ * @dev: Pointer to device to stop probing
+ * @return 0 if OK, -ve error from the remove() method
+ */
+int device_probe_cancel(struct udevice *dev);
+
 /**
  * device_remove() - Remove a device, de-activating it
  *
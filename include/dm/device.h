@@ -73,6 +73,12 @@ struct driver_info;
  */
 #define DM_FLAG_REMOVE_WITH_PD_ON	(1 << 13)
 
+/*
+ * Device has started probing and is waiting for its driver's probe_poll()
+ * method to report that it is done. DM_FLAG_ACTIVATED is also set
+ */
+#define DM_FLAG_PROBE_PENDING		(1 << 14)
+
 /*
  * One or multiple of these flags are passed to device_remove() so that
  * a selective device removal as specified by the remove-stage and the
@@ -177,9 +183,20 @@ static inline int dev_of_offset(const struct udevice *dev)
 	return ofnode_to_offset(dev->node);
 }
 
+/**
+ * dev_set_ofnode() - Set the device tree node of a device
+ *
+ * This must be used instead of writing to @dev->node once the device is
+ * bound, so that the device can still be found by its node.
+ *
+ * @dev:	Device to update
+ * @node:	New node of the device
+ */
+void dev_set_ofnode(struct udevice *dev, ofnode node);
+
 static inline void dev_set_of_offset(struct udevice *dev, int of_offset)
 {
-	dev->node = offset_to_ofnode(of_offset);
+	dev_set_ofnode(dev, offset_to_ofnode(of_offset));
 }
 
 static inline bool dev_has_of_node(struct udevice *dev)
@@ -221,7 +238,13 @@ struct udevice_id {
  * @of_match: List of compatible strings to match, and any identifying data
  * for each.
  * @bind: Called to bind a device to its driver
- * @probe: Called to probe a device, i.e. activate it
+ * @probe: Called to probe a device, i.e. activate it. If the driver has a
+ * probe_poll() method this may return -EINPROGRESS after starting up the
+ * hardware, rather than waiting for it
+ * @probe_poll: Called until it stops returning -EINPROGRESS once probe() has
+ * returned -EINPROGRESS. It must not wait for the hardware but return 0 when
+ * the device is ready, or another error code if it will never be. The remove()
+ * method may be called before this has finished
  * @remove: Called to remove a device, i.e. de-activate it
  * @unbind: Called to unbind a device from its driver
  * @ofdata_to_platdata: Called before probe to decode device tree data
@@ -257,6 +280,7 @@ struct driver {
 	const struct udevice_id *of_match;
 	int (*bind)(struct udevice *dev);
 	int (*probe)(struct udevice *dev);
+	int (*probe_poll)(struct udevice *dev);
 	int (*remove)(struct udevice *dev);
 	int (*unbind)(struct udevice *dev);
 	int (*ofdata_to_platdata)(struct udevice *dev);
@@ -12,6 +12,8 @@
 #include <dm/ofnode.h>
 #include <dm/uclass-id.h>
 
+struct udevice_id;
+
 /**
  * lists_driver_lookup_name() - Return u_boot_driver corresponding to name
  *
@@ -32,6 +34,20 @@ struct driver *lists_driver_lookup_name(const char *name);
  */
 struct uclass_driver *lists_uclass_lookup(enum uclass_id id);
 
+/**
+ * lists_driver_lookup_compat() - Return the driver for a compatible string
+ *
+ * This finds the first driver which lists @compat in its of_match table,
+ * which is the driver lists_bind_fdt() binds to a node with that
+ * compatible string.
+ *
+ * @compat: Compatible string to look up
+ * @idp: Returns the matching entry in the driver's of_match table
+ * @return pointer to driver, or NULL if not found
+ */
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **idp);
+
 /**
  * lists_bind_drivers() - search for and bind all drivers to parent
  *
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Deferred and background probing of devices
+ */
+
+#ifndef _DM_PROBE_QUEUE_H
+#define _DM_PROBE_QUEUE_H
+
+#include <dm/uclass-id.h>
+#include <linux/errno.h>
+
+struct udevice;
+
+/* Maximum number of devices being probed in the background at once */
+#define DM_PROBE_QUEUE_LEN	16
+
+#if CONFIG_IS_ENABLED(DM_PROBE_QUEUE)
+/**
+ * dm_probe_deferred() - Check whether a uclass is probed on first use
+ *
+ * Board code normally probes some devices up front so that they are ready
+ * when needed. The uclasses named in the "u-boot,defer-probe" string list of
+ * the /config node, or in CONFIG_DM_DEFER_PROBE_UCLASSES if there is no such
+ * property, are left alone instead and their devices are probed the first
+ * time something uses them.
+ *
+ * @id: Uclass ID to check
+ * @return true if devices in this uclass should not be probed up front
+ */
+bool dm_probe_deferred(enum uclass_id id);
+
+/**
+ * dm_probe_uclass() - Start probing all devices in a uclass
+ *
+ * Nothing is done if the uclass is probed on first use. Devices whose driver
+ * has a probe_poll() method are left in the probe queue once they have
+ * started probing, so this does not wait for slow hardware.
+ *
+ * @id: Uclass ID to probe
+ * @return 0 if OK, -ve on error
+ */
+int dm_probe_uclass(enum uclass_id id);
+
+/**
+ * dm_probe_queue_add() - Add a device to the probe queue
+ *
+ * This is called by device_probe_start() for a device whose driver has
+ * started probing but has to wait for the hardware.
+ *
+ * @dev: Device to add, with DM_FLAG_PROBE_PENDING set
+ * @return 0 if OK, -ENOSPC if the queue is full, -EPERM before relocation
+ */
+int dm_probe_queue_add(struct udevice *dev);
+
+/**
+ * dm_probe_queue_del() - Remove a device from the probe queue
+ *
+ * @dev: Device to remove. Nothing happens if it is not in the queue
+ */
+void dm_probe_queue_del(struct udevice *dev);
+
+/**
+ * dm_probe_queue_poll() - Poll each device in the probe queue once
+ *
+ * Devices which have finished probing, or failed to, are removed from the
+ * queue. This is also called while waiting for a device to finish probing, so
+ * that all queued devices move on together.
+ *
+ * @return number of devices still in the queue
+ */
+int dm_probe_queue_poll(void);
+
+/**
+ * dm_probe_queue_flush() - Wait for all devices in the probe queue
+ *
+ * @return 0 if all of them probed, else the error from the last one to fail
+ */
+int dm_probe_queue_flush(void);
+#else
+static inline bool dm_probe_deferred(enum uclass_id id)
+{
+	return false;
+}
+
+int dm_probe_uclass(enum uclass_id id);
+
+static inline int dm_probe_queue_add(struct udevice *dev)
+{
+	return -ENOSYS;
+}
+
+static inline void dm_probe_queue_del(struct udevice *dev)
+{
+}
+
+static inline int dm_probe_queue_poll(void)
+{
+	return 0;
+}
+
+static inline int dm_probe_queue_flush(void)
+{
+	return 0;
+}
+#endif
+
+#endif
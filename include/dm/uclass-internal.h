@@ -10,6 +10,40 @@
 #define _DM_UCLASS_INTERNAL_H
 
 #include <dm/ofnode.h>
+#include <dm/uclass.h>
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/**
+ * uclass_index_add() - add a device to one of its uclass's lookup indexes
+ *
+ * When a key of a device changes after it is bound, the device must be
+ * removed from the index with uclass_index_del() before the change and
+ * added back with this function afterwards. Devices which are not bound
+ * to their uclass are ignored.
+ *
+ * @dev:	Device to add
+ * @type:	Index to add the device to, using its current key
+ */
+void uclass_index_add(struct udevice *dev, enum uclass_index_type type);
+
+/**
+ * uclass_index_del() - remove a device from one of its uclass's lookup indexes
+ *
+ * @dev:	Device to remove
+ * @type:	Index to remove the device from, using its current key
+ */
+void uclass_index_del(struct udevice *dev, enum uclass_index_type type);
+#else
+static inline void uclass_index_add(struct udevice *dev,
+				    enum uclass_index_type type)
+{
+}
+
+static inline void uclass_index_del(struct udevice *dev,
+				    enum uclass_index_type type)
+{
+}
+#endif
 
 /**
  * uclass_find_next_free_req_seq() - Get the next free req_seq number
@@ -14,6 +14,47 @@
 #include <linker_lists.h>
 #include <linux/list.h>
 
+/* Keys by which the devices of a uclass are indexed */
+enum uclass_index_type {
+	UCLASS_INDEX_NAME,
+	UCLASS_INDEX_OFNODE,
+	UCLASS_INDEX_SEQ,
+
+	UCLASS_INDEX_COUNT,
+};
+
+/**
+ * struct uclass_index_table - a hash table of the devices in a uclass
+ *
+ * This uses linear probing. Devices with the same key are all present.
+ *
+ * @ent:	Entries, each a device or NULL if free
+ * @size:	Number of entries, a power of two, or 0 if not allocated
+ * @count:	Number of devices in the table
+ * @lookups:	Number of lookups done in the table
+ * @probes:	Number of entries checked by those lookups
+ */
+struct uclass_index_table {
+	struct udevice **ent;
+	uint size;
+	uint count;
+	ulong lookups;
+	ulong probes;
+};
+
+/**
+ * struct uclass_index - lookup indexes of the devices in a uclass
+ *
+ * The tables are kept up to date as devices are bound and unbound, probed
+ * and removed, and renamed or moved to another ofnode (with
+ * device_set_name() and dev_set_ofnode()).
+ *
+ * @table:	One table for each enum uclass_index_type
+ */
+struct uclass_index {
+	struct uclass_index_table table[UCLASS_INDEX_COUNT];
+};
+
 /**
  * struct uclass - a U-Boot drive class, collecting together similar drivers
  *
@@ -30,12 +71,18 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @index: Lookup indexes of the devices, or NULL if the devices are looked
+ * up by walking @dev_head (before relocation, or if the indexes are
+ * disabled)
  */
 struct uclass {
 	void *priv;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct uclass_index *index;
+#endif
 };
 
 struct driver;
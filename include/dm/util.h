@@ -39,6 +39,9 @@ static inline void dm_dump_devres(void)
 }
 #endif
 
+/* Dump out lookup statistics of the uclass indexes */
+void dm_dump_stats(void);
+
 /* Dump out a list of drivers */
 void dm_dump_drivers(void);
 
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Environment stored as an append-only log
+ *
+ * The environment area starts with a header, followed by records which are
+ * appended one after the other into the erased (0xff) space behind it:
+ *
+ *	struct env_log_hdr
+ *	struct env_log_rec + data	full environment, "name=value\0...\0"
+ *	struct env_log_rec + data	changes made by a saveenv
+ *	...
+ *	0xff...
+ *
+ * The data of the first record is the whole environment. The data of each
+ * following record lists the variables which changed, as "name=value" for a
+ * variable which was set and just "name" for one which was deleted, in the
+ * same '\0' separated format. Records start on 4-byte boundaries. All fields
+ * are little endian.
+ *
+ * When the area is full the environment is written again as a single record,
+ * into the redundant area if there is one, with the next generation number.
+ */
+
+#ifndef _ENV_LOG_H_
+#define _ENV_LOG_H_
+
+#include "compiler.h"
+
+#define ENV_LOG_MAGIC	0x474c5645	/* "EVLG" */
+#define ENV_LOG_ALIGN	4
+/* Length of a record which has not been written */
+#define ENV_LOG_END	0xffffffff
+
+/**
+ * struct env_log_hdr - Header at the start of an environment log area
+ *
+ * @magic: ENV_LOG_MAGIC
+ * @gen: Generation, incremented each time the log is rewritten. The area
+ *	with the newer generation holds the environment
+ * @crc: crc32 of @magic and @gen
+ */
+struct env_log_hdr {
+	uint32_t magic;
+	uint32_t gen;
+	uint32_t crc;
+};
+
+/**
+ * struct env_log_rec - Header of a record in an environment log
+ *
+ * @len: Length of the data following the header, ENV_LOG_END at the end of
+ *	the log
+ * @crc: crc32 of the data
+ */
+struct env_log_rec {
+	uint32_t len;
+	uint32_t crc;
+};
+
+/* Space taken up by a record with @len bytes of data */
+#define ENV_LOG_REC_SIZE(len) \
+	(sizeof(struct env_log_rec) + \
+	 (((len) + ENV_LOG_ALIGN - 1) & ~(ENV_LOG_ALIGN - 1)))
+
+#endif
@@ -33,6 +33,11 @@ struct disk_partition;
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_EXT_MAX_DEPTH		5
+/* Number of extents or index entries held in the inode */
+#define EXT4_EXT_ROOT_ENTRIES		4
+/* Extents longer than this are unwritten: they read as zeroes */
+#define EXT4_EXT_INIT_MAX_LEN		(1 << 15)
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_RO_COMPAT_METADATA_CSUM 0x0400
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
@@ -108,11 +113,15 @@ struct ext_filesystem {
 
 	/* Block Bitmap Related */
 	unsigned char **blk_bmaps;
+	/* Set for each block bitmap which has to be written back */
+	unsigned char *blk_bmaps_dirty;
 	long int curr_blkno;
 	uint16_t first_pass_bbmap;
 
 	/* Inode Bitmap Related */
 	unsigned char **inode_bmaps;
+	/* Set for each inode bitmap which has to be written back */
+	unsigned char *inode_bmaps_dirty;
 	int curr_inode_no;
 	uint16_t first_pass_ibmap;
 
@@ -160,6 +169,9 @@ int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, struct disk_partition *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache);
+int ext4fs_get_extent_run(struct ext2_inode *inode, uint32_t fileblock,
+			  struct ext_block_cache *cache, int ncache,
+			  uint64_t *blknr, uint32_t *count);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 struct disk_partition *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
@@ -11,6 +11,7 @@
 
 #include <asm/byteorder.h>
 #include <fs.h>
+#include <linux/kernel.h>
 
 struct disk_partition;
 
@@ -25,7 +26,16 @@ struct disk_partition;
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
+#if defined(CONFIG_FS_FAT) && !defined(CONFIG_SPL_BUILD)
+#define FATBUFBLOCKS	CONFIG_FS_FAT_BUFFER_BLOCKS
+#define FATBUFWINDOWS	CONFIG_FS_FAT_BUFFER_WINDOWS
+#else
 #define FATBUFBLOCKS	6
+#define FATBUFWINDOWS	1
+#endif
+#if FATBUFBLOCKS < 3 || FATBUFBLOCKS % 3
+#error FATBUFBLOCKS must be a multiple of 3 to hold whole FAT12 entries
+#endif
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
@@ -163,20 +173,27 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* FAT buffer, 'fatbufs' windows of FATBUFSIZE */
+	int	fatbufs;	/* Number of windows in fatbuf */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
+	__u8	fat_dirty[DIV_ROUND_UP(FATBUFWINDOWS * FATBUFBLOCKS, 8)];
+				/* Bit set for each modified sector of fatbuf */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	fatbufnum[FATBUFWINDOWS];
+				/* FAT window held by each window, or -1 */
+	__u32	fatbuf_used[FATBUFWINDOWS];
+				/* When each window was last used */
+	__u32	fatbuf_clock;	/* Counts uses of windows */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	__u32	free_clust;	/* No cluster below this one is free */
 } fsdata;
 
 static inline u32 clust_to_sect(fsdata *fsdata, u32 clust)
@@ -192,6 +209,18 @@ static inline u32 sect_to_clust(fsdata *fsdata, int sect)
 int file_fat_detectfs(void);
 int fat_exists(const char *filename);
 int fat_size(const char *filename, loff_t *size);
+
+/**
+ * fat_extents() - list the runs of consecutive clusters of a file
+ *
+ * This prints the first cluster, first sector and length of each run, which
+ * tells how fragmented a file is and so how many requests it takes to read.
+ *
+ * @filename:	name of the file
+ * Return:	number of runs, or -ve on error
+ */
+int fat_extents(const char *filename);
+
 int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 		     loff_t maxsize, loff_t *actread);
 int file_fat_read(const char *filename, void *buffer, int maxsize);
@@ -116,6 +116,18 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 int hash_block(const char *algo_name, const void *data, unsigned int len,
 	       uint8_t *output, int *output_size);
 
+/**
+ * hash_bench() - Measure the throughput of each supported hash algorithm
+ *
+ * Each algorithm is run repeatedly over a buffer of the given size for a
+ * short while and the resulting rate is printed.
+ *
+ * @size:	Size of the buffer to hash in bytes
+ * @return 0 if ok, -ENOMEM if the buffer cannot be allocated, -EINTR if
+ * interrupted with Ctrl-C
+ */
+int hash_bench(ulong size);
+
 #endif /* !USE_HOSTCC */
 
 /**
@@ -925,6 +925,26 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * image_decomp_parallel() - decompress an image using all available CPUs
+ *
+ * This only handles images which are made of independently compressed
+ * pieces with a known uncompressed size, such as LZ4 frames with independent
+ * blocks, zstd streams with several frames and BGZF gzip files.
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @load_buf:	Place to decompress to
+ * @image_buf:	Address to decompress from
+ * @image_len:	Number of bytes in @image_buf to decompress
+ * @unc_len:	Available space for decompression
+ * @out_len:	Returns the number of uncompressed bytes written, on success
+ * @return 0 if OK, -ENOSYS if the image was not decompressed, in which case
+ *	the serial decompressor must be used (and reports any error in the
+ *	data)
+ */
+int image_decomp_parallel(int comp, void *load_buf, const void *image_buf,
+			  ulong image_len, ulong unc_len, ulong *out_len);
+
 /**
  * Set up properties in the FDT
  *
@@ -1124,6 +1144,96 @@ int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
 int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *data, size_t size);
 int fit_image_verify(const void *fit, int noffset);
+
+/* Hash nodes of one image which can be checked while it is loaded */
+#define FIT_MAX_STREAM_HASHES	4
+
+/**
+ * struct fit_hash_stream - state of the hashes of an image being loaded
+ *
+ * @count:	Number of hash nodes being calculated
+ * @size:	Number of bytes hashed so far
+ * @total:	Size of the image data
+ * @hash:	State of each hash node
+ */
+struct fit_hash_stream {
+	int count;
+	size_t size;
+	size_t total;
+	struct {
+		int noffset;
+		bool ignore;
+		struct hash_algo *algo;
+		void *ctx;
+		uint8_t value[FIT_MAX_HASH_LEN];
+		int value_len;
+	} hash[FIT_MAX_STREAM_HASHES];
+};
+
+/**
+ * fit_image_hash_start() - start calculating the hashes of an image
+ *
+ * This sets up a progressive hash for each hash node of an image, so that
+ * its data can be hashed piece by piece as it is read from storage, while
+ * it is still in the cache, rather than in a second pass once it has all
+ * been loaded. Feed the data to fit_image_hash_update() in order, then call
+ * fit_image_hash_finish() and pass @st to fit_image_verify_streamed().
+ *
+ * Only a loader which verifies the image as part of the same load can use
+ * this, as SPL's FIT loader does. Images loaded by U-Boot's 'load' and
+ * 'tftpboot' commands stay writable until 'bootm' verifies them, so a hash
+ * taken while they arrive cannot stand in for that check; bootm still hashes
+ * them once loaded.
+ *
+ * @st:		Stream state to set up
+ * @fit:	FIT image
+ * @image_noffset: Offset of the image node
+ * @size:	Size of the image data
+ * @return 0 if OK, -ENOSYS if an algorithm cannot be hashed progressively
+ * or the image has too many hash nodes, other -ve value on error. The
+ * caller should then hash the image with fit_image_verify_with_data().
+ */
+int fit_image_hash_start(struct fit_hash_stream *st, const void *fit,
+			 int image_noffset, size_t size);
+
+/**
+ * fit_image_hash_update() - hash the next piece of image data
+ *
+ * @st:		Stream state
+ * @data:	Data to add
+ * @size:	Number of bytes
+ * @return 0 if OK, -ve on error
+ */
+int fit_image_hash_update(struct fit_hash_stream *st, const void *data,
+			  size_t size);
+
+/**
+ * fit_image_hash_finish() - finish the hashes of an image
+ *
+ * This must be called once all the data has been given to
+ * fit_image_hash_update(), even if it failed, to release the hash state.
+ *
+ * @st:		Stream state
+ * @return 0 if OK, -ve on error
+ */
+int fit_image_hash_finish(struct fit_hash_stream *st);
+
+/**
+ * fit_image_verify_streamed() - verify an image whose hashes are calculated
+ *
+ * This is fit_image_verify_with_data() using the hash values calculated by
+ * fit_image_hash_finish(). Signatures on the image are checked over @data.
+ *
+ * @fit:	FIT image
+ * @image_noffset: Offset of the image node
+ * @data:	Image data
+ * @size:	Size of the image data
+ * @st:		Finished stream state, or NULL to hash @data here
+ * @return 1 if the image is valid, 0 otherwise
+ */
+int fit_image_verify_streamed(const void *fit, int image_noffset,
+			      const void *data, size_t size,
+			      struct fit_hash_stream *st);
 int fit_config_verify(const void *fit, int conf_noffset);
 int fit_all_image_verify(const void *fit);
 int fit_config_decrypt(const void *fit, int conf_noffset);
@@ -21,4 +21,20 @@
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * ulz4_decompress_block() - Decompress a single LZ4 block
+ *
+ * This decodes the contents of one compressed block from an LZ4 frame, which
+ * must not refer to data from earlier blocks.
+ *
+ * @src: Compressed block data, without the block header
+ * @srcn: Length of compressed block data
+ * @dst: Destination for uncompressed data
+ * @dstn: Size of destination buffer
+ * @return number of bytes written to @dst, or -EPROTO if the compressed data
+ *	causes an error in the decompression algorithm or overruns @dst
+ */
+int ulz4_decompress_block(const void *src, size_t srcn, void *dst,
+			  size_t dstn);
+
 #endif
@@ -145,7 +145,10 @@ enum eth_recv_flags {
  *	 called if supplied
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
- *	     called when no error was returned from recv - optional
+ *	     called when no error was returned from recv. Until then the stack
+ *	     owns the buffer and may copy data (such as TFTP and NFS file
+ *	     contents) straight out of it, so a driver must not hand the buffer
+ *	     back to its hardware before this is called - optional
  * stop: Stop the hardware from looking for packets - may be called even if
  *	 state == PASSIVE
  * mcast: Join or leave a multicast group (for TFTP) - optional
@@ -355,4 +355,32 @@ int os_read_file(const char *name, void **bufp, int *sizep);
  */
 void *os_find_text_base(void);
 
+/**
+ * os_thread_start() - Start a host thread running a function
+ *
+ * This is used to emulate secondary CPUs. The thread finishes when @func
+ * returns.
+ *
+ * @idx:	Thread slot to use (0 to 63), which must not be running
+ * @func:	Function to run in the new thread
+ * @arg:	Argument for @func
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_start(int idx, void (*func)(void *arg), void *arg);
+
+/**
+ * os_thread_join() - Wait for a thread started by os_thread_start() to finish
+ *
+ * @idx:	Thread slot passed to os_thread_start()
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_join(int idx);
+
+/**
+ * os_thread_is_secondary() - Check if running in a thread from os_thread_start()
+ *
+ * @return true if so, false if running in the main sandbox thread
+ */
+bool os_thread_is_secondary(void);
+
 #endif
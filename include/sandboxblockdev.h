@@ -6,14 +6,50 @@
 #ifndef __SANDBOX_BLOCK_DEV__
 #define __SANDBOX_BLOCK_DEV__
 
+#include <linux/list.h>
+
+struct udevice;
+
+/**
+ * struct host_block_dev - a block device backed by a host file
+ *
+ * @filename:	Name of the host file
+ * @fd:		Host file descriptor
+ * @queue:	Asynchronous requests in flight, in order of completion
+ * @latency_us:	Time taken by each asynchronous request before its transfer
+ *		starts. Requests wait for this at the same time
+ * @block_ns:	Time taken to transfer each block. Transfers are done one
+ *		after the other
+ * @busy_until:	Time in microseconds at which the last transfer ends
+ */
 struct host_block_dev {
 #ifndef CONFIG_BLK
 	struct blk_desc blk_dev;
 #endif
 	char *filename;
 	int fd;
+#ifdef CONFIG_BLK
+	struct list_head queue;
+	ulong latency_us;
+	ulong block_ns;
+	u64 busy_until;
+#endif
 };
 
 int host_dev_bind(int dev, char *filename);
 
+/**
+ * sandbox_host_set_latency() - set the timing of asynchronous requests
+ *
+ * A request submitted with blk_submit() finishes @latency_us after it is
+ * submitted, or when the transfer before it has ended, whichever is later,
+ * plus @block_ns for each block transferred.
+ *
+ * @dev:	Host block device
+ * @latency_us:	Access time of each request in microseconds
+ * @block_ns:	Transfer time of each block in nanoseconds
+ */
+void sandbox_host_set_latency(struct udevice *dev, ulong latency_us,
+			      ulong block_ns);
+
 #endif
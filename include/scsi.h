@@ -194,6 +194,13 @@ struct scsi_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*bus_reset)(struct udevice *dev);
+
+	/**
+	 * show_stats() - print transfer statistics of the bus (optional)
+	 *
+	 * @dev:	SCSI bus
+	 */
+	void (*show_stats)(struct udevice *dev);
 };
 
 #define scsi_get_ops(dev)        ((struct scsi_ops *)(dev)->driver->ops)
@@ -217,6 +224,14 @@ int scsi_exec(struct udevice *dev, struct scsi_cmd *cmd);
  */
 int scsi_bus_reset(struct udevice *dev);
 
+/**
+ * scsi_show_stats() - print transfer statistics of a bus
+ *
+ * @dev:	SCSI bus
+ * @return 0 if OK, -ENOSYS if the bus keeps no statistics
+ */
+int scsi_show_stats(struct udevice *dev);
+
 /**
  * scsi_scan() - Scan all SCSI controllers for available devices
  *
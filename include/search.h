@@ -47,6 +47,18 @@ struct hsearch_data {
 	struct env_entry_node *table;
 	unsigned int size;
 	unsigned int filled;
+	/* Number of slots holding deleted entries, which slow down searches */
+	unsigned int deleted;
+	/* Non-zero while callbacks run, as the table must not move under them */
+	unsigned int frozen;
+	/*
+	 * Entries for hexport_r(), allocated for @size entries when first
+	 * needed. The first @sorted_len are sorted by key, those added since
+	 * follow up to @sorted_count. NULL if not kept up to date
+	 */
+	struct env_entry **sorted;
+	unsigned int sorted_len;
+	unsigned int sorted_count;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -58,7 +70,10 @@ struct hsearch_data {
 			 enum env_op, int flag);
 };
 
-/* Create a new hash table which will contain at most "nel" elements.  */
+/*
+ * Create a new hash table with room for "nel" elements. It grows when it
+ * fills up.
+ */
 int hcreate_r(size_t nel, struct hsearch_data *htab);
 
 /* Destroy current internal hash table.  */
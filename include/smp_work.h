@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running work items on secondary CPUs
+ */
+
+#ifndef __SMP_WORK_H
+#define __SMP_WORK_H
+
+#include <linux/types.h>
+
+/**
+ * struct smp_work - A unit of work which may run on any CPU
+ *
+ * Work functions may run on a secondary CPU. They must not use malloc(),
+ * the console or driver model, and should only touch memory handed to them
+ * through @arg. Any scratch memory must be allocated before calling
+ * smp_work_run().
+ *
+ * @func:	Function to call
+ * @arg:	Argument to pass to @func
+ * @ret:	Return value of @func, valid after smp_work_run() returns
+ */
+struct smp_work {
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+};
+
+#if CONFIG_IS_ENABLED(SMP_WORK)
+/**
+ * smp_work_cpus() - Get the number of CPUs which can run work items
+ *
+ * @return number of CPUs, including the boot CPU
+ */
+int smp_work_cpus(void);
+
+/**
+ * smp_work_run() - Run work items across all available CPUs
+ *
+ * Items are handed out in order to the boot CPU and any secondary CPUs
+ * which could be started, each taking the next item when it has finished
+ * the previous one. This returns once all items have completed.
+ *
+ * @work:	Work items to run
+ * @count:	Number of items
+ * @return 0 if all items returned 0, else the return value of the first
+ *	item (in array order) which failed
+ */
+int smp_work_run(struct smp_work *work, int count);
+
+/**
+ * smp_work_is_secondary() - Check if running on a secondary CPU
+ *
+ * @return true if called from a work item running on a secondary CPU
+ */
+bool smp_work_is_secondary(void);
+#else
+static inline int smp_work_cpus(void)
+{
+	return 1;
+}
+
+static inline int smp_work_run(struct smp_work *work, int count)
+{
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		work[i].ret = work[i].func(work[i].arg);
+		if (work[i].ret && !ret)
+			ret = work[i].ret;
+	}
+
+	return ret;
+}
+
+static inline bool smp_work_is_secondary(void)
+{
+	return false;
+}
+#endif
+
+/* Architecture hooks, used by lib/smp_work.c */
+
+/**
+ * arch_smp_work_cpus() - Get the number of secondary CPUs which can be used
+ *
+ * @return number of secondary CPUs, 0 if none
+ */
+int arch_smp_work_cpus(void);
+
+/**
+ * arch_smp_work_start() - Start a secondary CPU running a function
+ *
+ * @idx:	Secondary CPU index, 0 to arch_smp_work_cpus() - 1
+ * @entry:	Function to run; the CPU is stopped again when it returns
+ * @arg:	Argument for @entry
+ * @return 0 if OK, -ve on error (the caller carries on without this CPU)
+ */
+int arch_smp_work_start(int idx, void (*entry)(void *arg), void *arg);
+
+/**
+ * arch_smp_work_wait() - Wait for a secondary CPU to finish
+ *
+ * This must not return before the CPU has returned from the function passed
+ * to arch_smp_work_start(), however long that takes, since the function
+ * uses memory on the caller's stack. Once this returns, all memory writes
+ * made by the CPU are visible to the caller and, if 0 is returned, the CPU
+ * may be started again.
+ *
+ * @idx:	Secondary CPU index passed to arch_smp_work_start()
+ * @return 0 if OK, -ETIMEDOUT if the CPU finished but did not stop
+ */
+int arch_smp_work_wait(int idx);
+
+/**
+ * arch_smp_work_is_secondary() - Check if running on a secondary CPU
+ *
+ * @return true if the caller is running on a CPU started by
+ *	arch_smp_work_start()
+ */
+bool arch_smp_work_is_secondary(void);
+
+#endif /* __SMP_WORK_H */
@@ -93,6 +93,23 @@ uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 void crc32_wd_buf(const uint8_t *input, uint ilen, uint8_t *output,
 		  uint chunk_sz);
 
+/**
+ * crc32_le_slice8() - Calculate a bit-reflected CRC using slice-by-8 tables
+ *
+ * This is the table-driven engine shared by crc32_no_comp() and
+ * crc32c_cal(). It handles eight bytes per step, so needs seven tables in
+ * addition to the usual byte-at-a-time one. No one's complement is applied.
+ *
+ * @crc: Previous crc value
+ * @p: Data bytes to checksum
+ * @len: Number of bytes to process
+ * @tab0: 256-entry byte-at-a-time table for the polynomial, in CPU order
+ * @tab: Tables giving the CRC of each byte value followed by 1..7 zero bytes
+ * @return updated crc value
+ */
+uint32_t crc32_le_slice8(uint32_t crc, const uint8_t *p, size_t len,
+			 const uint32_t *tab0, const uint32_t (*tab)[256]);
+
 /* lib/crc32c.c */
 
 /**
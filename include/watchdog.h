@@ -41,7 +41,11 @@ int init_func_watchdog_reset(void);
 	#else
 		extern void hw_watchdog_reset(void);
 
-		#define WATCHDOG_RESET hw_watchdog_reset
+		#if CONFIG_IS_ENABLED(SMP_WORK)
+			#define WATCHDOG_RESET smp_work_watchdog_reset
+		#else
+			#define WATCHDOG_RESET hw_watchdog_reset
+		#endif
 	#endif /* __ASSEMBLY__ */
 #else
 	/*
@@ -58,7 +62,11 @@ int init_func_watchdog_reset(void);
 			#else
 				extern void watchdog_reset(void);
 
-				#define WATCHDOG_RESET watchdog_reset
+				#if CONFIG_IS_ENABLED(SMP_WORK)
+					#define WATCHDOG_RESET smp_work_watchdog_reset
+				#else
+					#define WATCHDOG_RESET watchdog_reset
+				#endif
 			#endif
 		#endif
 	#else
@@ -81,6 +89,13 @@ int init_func_watchdog_reset(void);
 	void hw_watchdog_init(void);
 #endif
 
+#if (defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)) && !defined(__ASSEMBLY__)
+	#if CONFIG_IS_ENABLED(SMP_WORK)
+		/* Reset the watchdog, unless running on a secondary CPU */
+		void smp_work_watchdog_reset(void);
+	#endif
+#endif
+
 #if defined(CONFIG_MPC85xx) && !defined(__ASSEMBLY__)
 	void init_85xx_watchdog(void);
 #endif
@@ -26,6 +26,21 @@
 #ifdef USE_HOSTCC
 #define __efi_runtime
 #define __efi_runtime_data
+#define CRC32_SLICE8	1
+#define CRC32_ARMV8	0
+#else
+#define CRC32_SLICE8	CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#define CRC32_ARMV8	IS_ENABLED(CONFIG_CRC32_ARMV8)
+#endif
+
+#if CRC32_ARMV8
+#include <asm/armv8/crc32.h>
+#endif
+
+/* The slice-by-8 tables are kept in CPU byte order for little-endian only */
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+#undef CRC32_SLICE8
+#define CRC32_SLICE8	0
 #endif
 
 #define tole(x) cpu_to_le32(x)
@@ -34,6 +49,9 @@
 
 static int __efi_runtime_data crc_table_empty = 1;
 static uint32_t __efi_runtime_data crc_table[256];
+#if CRC32_SLICE8
+static uint32_t __efi_runtime_data crc_table_slice[7][256];
+#endif
 static void __efi_runtime make_crc_table OF((void));
 
 /*
@@ -81,6 +99,17 @@ static void __efi_runtime make_crc_table(void)
       c = c & 1 ? poly ^ (c >> 1) : c >> 1;
     crc_table[n] = tole(c);
   }
+#if CRC32_SLICE8
+  for (n = 0; n < 256; n++)
+  {
+    c = crc_table[n];
+    for (k = 0; k < 7; k++)
+    {
+      c = (c >> 8) ^ crc_table[c & 0xff];
+      crc_table_slice[k][n] = c;
+    }
+  }
+#endif
   crc_table_empty = 0;
 }
 #else
@@ -154,6 +183,9 @@ tole(0xbad03605L), tole(0xcdd70693L), tole(0x54de5729L), tole(0x23d967bfL),
 tole(0xb3667a2eL), tole(0xc4614ab8L), tole(0x5d681b02L), tole(0x2a6f2b94L),
 tole(0xb40bbe37L), tole(0xc30c8ea1L), tole(0x5a05df1bL), tole(0x2d02ef8dL)
 };
+#if CRC32_SLICE8
+#include "crc32_table.h"
+#endif
 #endif
 
 #if 0
@@ -178,18 +210,46 @@ const uint32_t * ZEXPORT get_crc_table()
 
 /* ========================================================================= */
 
-/* No ones complement version. JFFS2 (and other things ?)
- * don't use ones compliment in their CRC calculations.
- */
-uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+uint32_t __efi_runtime crc32_le_slice8(uint32_t crc, const uint8_t *p,
+				       size_t len, const uint32_t *tab0,
+				       const uint32_t (*tab)[256])
+{
+	uint32_t a, b;
+
+	/* Bring the pointer to an 8-byte boundary one byte at a time */
+	while (len && ((uintptr_t)p & 7)) {
+		crc = tab0[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	/*
+	 * Fold in eight bytes per step: byte i of the group is looked up in
+	 * the table which accounts for the 7 - i bytes following it
+	 */
+	for (; len >= 8; len -= 8, p += 8) {
+		a = crc ^ le32_to_cpu(*(const uint32_t *)p);
+		b = le32_to_cpu(*(const uint32_t *)(p + 4));
+		crc = tab[6][a & 0xff] ^ tab[5][(a >> 8) & 0xff] ^
+		      tab[4][(a >> 16) & 0xff] ^ tab[3][a >> 24] ^
+		      tab[2][b & 0xff] ^ tab[1][(b >> 8) & 0xff] ^
+		      tab[0][(b >> 16) & 0xff] ^ tab0[b >> 24];
+	}
+
+	while (len--)
+		crc = tab0[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if !CRC32_SLICE8
+/* Table-driven version handling four bytes per loop */
+static uint32_t __efi_runtime crc32_word(uint32_t crc, const Bytef *buf,
+					 uInt len)
 {
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
     size_t rem_len;
-#ifdef CONFIG_DYNAMIC_CRC_TABLE
-    if (crc_table_empty)
-      make_crc_table();
-#endif
+
     crc = cpu_to_le32(crc);
     /* Align it */
     if (((long)b) & 3 && len) {
@@ -221,8 +281,30 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 
     return le32_to_cpu(crc);
 }
+#endif
 #undef DO_CRC
 
+/* No ones complement version. JFFS2 (and other things ?)
+ * don't use ones compliment in their CRC calculations.
+ */
+uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+{
+#ifdef CONFIG_DYNAMIC_CRC_TABLE
+    if (crc_table_empty)
+      make_crc_table();
+#endif
+#if CRC32_ARMV8
+    if (crc32_armv8_available())
+      return crc32_armv8_le(crc, buf, len);
+#endif
+#if CRC32_SLICE8
+    return crc32_le_slice8(crc, buf, len, crc_table,
+			   (const uint32_t (*)[256])crc_table_slice);
+#else
+    return crc32_word(crc, buf, len);
+#endif
+}
+
 uint32_t __efi_runtime crc32(uint32_t crc, const Bytef *p, uInt len)
 {
      return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
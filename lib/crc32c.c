@@ -12,10 +12,40 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <u-boot/crc.h>
+#if IS_ENABLED(CONFIG_CRC32_ARMV8)
+#include <asm/armv8/crc32.h>
+#endif
+
+/* Bit-reflected CRC32C (Castagnoli) polynomial */
+#define CRC32C_POLY_LE	0x82F63B78
+
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+/*
+ * Slice-by-8 tables for the most recent table set up by crc32c_init(), which
+ * in practice is the only one
+ */
+static uint32_t crc32c_slice[7][256];
+static const uint32_t *crc32c_slice_base;
+#define CRC32C_SLICE8	1
+#else
+#define CRC32C_SLICE8	0
+#endif
 
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
 {
+#if IS_ENABLED(CONFIG_CRC32_ARMV8)
+	/* Entry 128 of a table holds the polynomial itself */
+	if (crc32c_table[128] == CRC32C_POLY_LE && crc32_armv8_available())
+		return crc32c_armv8_le(crc, (const uint8_t *)data, length);
+#endif
+#if CRC32C_SLICE8
+	if (crc32c_table == crc32c_slice_base)
+		return crc32_le_slice8(crc, (const uint8_t *)data, length,
+				       crc32c_table,
+				       (const uint32_t (*)[256])crc32c_slice);
+#endif
 	while (length--)
 		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
 
@@ -35,4 +65,15 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 
 		crc32c_table[i] = v;
 	}
+
+#if CRC32C_SLICE8
+	for (i = 0; i < 256; i++) {
+		v = crc32c_table[i];
+		for (j = 0; j < 7; j++) {
+			v = (v >> 8) ^ crc32c_table[v & 0xff];
+			crc32c_slice[j][i] = v;
+		}
+	}
+	crc32c_slice_base = crc32c_table;
+#endif
 }
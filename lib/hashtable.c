@@ -45,6 +45,13 @@
 #define USED_FREE 0
 #define USED_DELETED -1
 
+/* Only hexport_r() needs the entries sorted by key */
+#if defined(CONFIG_SPL_BUILD) && !defined(CONFIG_SPL_SAVEENV)
+#define HTAB_SORTED	0
+#else
+#define HTAB_SORTED	1
+#endif
+
 #include <env_callback.h>
 #include <env_flags.h>
 #include <search.h>
@@ -69,6 +76,7 @@ struct env_entry_node {
 
 static void _hdelete(const char *key, struct hsearch_data *htab,
 		     struct env_entry *ep, int idx);
+static void hsort_drop(struct hsearch_data *htab);
 
 /*
  * hcreate()
@@ -122,6 +130,7 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 	htab->size = nel;
 	htab->filled = 0;
+	htab->deleted = 0;
 
 	/* allocate memory and zero out */
 	htab->table = (struct env_entry_node *)calloc(htab->size + 1,
@@ -165,11 +174,142 @@ void hdestroy_r(struct hsearch_data *htab)
 		}
 	}
 	free(htab->table);
+	hsort_drop(htab);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
 }
 
+/*
+ * First hash function: FNV-1a over the whole key, as variables often only
+ * differ at the end of their names. Then simply take the modulus but prevent
+ * zero.
+ */
+static unsigned int hhash(const char *key, unsigned int size)
+{
+	unsigned int hval = 2166136261U;
+
+	while (*key) {
+		hval ^= (unsigned char)*key++;
+		hval *= 16777619U;
+	}
+
+	hval %= size;
+	if (hval == 0)
+		++hval;
+
+	return hval;
+}
+
+/*
+ * Second hash function, as suggested in [Knuth]: step back by this much to
+ * find the next index to try. Because SIZE is prime this guarantees to step
+ * through all available indices.
+ */
+static unsigned int hnext(unsigned int idx, unsigned int hval,
+			  unsigned int size)
+{
+	unsigned int hval2 = 1 + hval % (size - 2);
+
+	if (idx <= hval2)
+		return size + idx - hval2;
+
+	return idx - hval2;
+}
+
+/*
+ * Move all entries to a new table with room for "nel" of them. This also
+ * gets rid of the deleted entries.
+ */
+static int hresize(struct hsearch_data *htab, size_t nel)
+{
+	struct hsearch_data new = { };
+	unsigned int hval, idx, i;
+
+	if (!hcreate_r(nel, &new))
+		return 0;
+
+	debug("hresize: %d entries, %d deleted, size %d => %d\n",
+	      htab->filled, htab->deleted, htab->size, new.size);
+	for (i = 1; i <= htab->size; ++i) {
+		if (htab->table[i].used <= 0)
+			continue;
+
+		hval = hhash(htab->table[i].entry.key, new.size);
+		for (idx = hval; new.table[idx].used != USED_FREE;)
+			idx = hnext(idx, hval, new.size);
+		new.table[idx].used = hval;
+		new.table[idx].entry = htab->table[i].entry;
+	}
+	free(htab->table);
+
+	/* The entries have moved */
+	hsort_drop(htab);
+	htab->table = new.table;
+	htab->size = new.size;
+	htab->deleted = 0;
+
+	return 1;
+}
+
+/*
+ * hsort()
+ */
+
+/*
+ * hexport_r() lists the entries sorted by key. To avoid sorting all of them
+ * every time, the sorted list is kept from one export to the next. Entries
+ * created since are added at its end and sorted into place by the next
+ * export, and deleted ones are taken out. The list is dropped when the table
+ * is resized, and built again by the next export.
+ */
+
+static void hsort_drop(struct hsearch_data *htab)
+{
+	free(htab->sorted);
+	htab->sorted = NULL;
+	htab->sorted_len = 0;
+	htab->sorted_count = 0;
+}
+
+static void hsort_add(struct hsearch_data *htab, struct env_entry *ep)
+{
+	/* There is room for every entry the table can hold */
+	if (HTAB_SORTED && htab->sorted)
+		htab->sorted[htab->sorted_count++] = ep;
+}
+
+static void hsort_del(struct hsearch_data *htab, struct env_entry *ep)
+{
+	struct env_entry **list = htab->sorted;
+	unsigned int lo = 0, hi = htab->sorted_len, mid, i;
+
+	if (!HTAB_SORTED || !list)
+		return;
+
+	/* Bisect the sorted part, else look through those added since */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(list[mid]->key, ep->key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < htab->sorted_len && list[lo] == ep) {
+		i = lo;
+		htab->sorted_len--;
+	} else {
+		for (i = htab->sorted_len; i < htab->sorted_count; i++) {
+			if (list[i] == ep)
+				break;
+		}
+		if (i == htab->sorted_count)
+			return;
+	}
+	memmove(&list[i], &list[i + 1],
+		(--htab->sorted_count - i) * sizeof(*list));
+}
+
 /*
  * hsearch()
  */
@@ -228,12 +368,19 @@ int hmatch_r(const char *match, int last_idx, struct env_entry **retval,
 }
 
 static int
-do_callback(const struct env_entry *e, const char *name, const char *value,
-	    enum env_op op, int flags)
+do_callback(struct hsearch_data *htab, const struct env_entry *e,
+	    const char *name, const char *value, enum env_op op, int flags)
 {
 #ifndef CONFIG_SPL_BUILD
-	if (e->callback)
-		return e->callback(name, value, op, flags);
+	int ret;
+
+	if (e->callback) {
+		htab->frozen++;
+		ret = e->callback(name, value, op, flags);
+		htab->frozen--;
+
+		return ret;
+	}
 #endif
 	return 0;
 }
@@ -263,7 +410,7 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 			}
 
 			/* If there is a callback, call it */
-			if (do_callback(&htab->table[idx].entry, item.key,
+			if (do_callback(htab, &htab->table[idx].entry, item.key,
 					item.data, env_op_overwrite, flag)) {
 				debug("callback() rejected setting variable "
 					"%s, skipping it!\n", item.key);
@@ -292,27 +439,24 @@ int hsearch_r(struct env_entry item, enum env_action action,
 	      struct env_entry **retval, struct hsearch_data *htab, int flag)
 {
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
-
 	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
+	 * Keep a quarter of the table free so that searches stay short,
+	 * growing it or just dropping the deleted entries. This moves the
+	 * entries, so it cannot be done while a callback may refer to one.
 	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+	if (action == ENV_ENTER && !htab->frozen &&
+	    (htab->filled + htab->deleted + 1) * 4 > htab->size * 3) {
+		if (htab->filled * 2 < htab->size)
+			hresize(htab, htab->size);
+		else
+			hresize(htab, (htab->filled + 1) * 2);
+	}
+
+	hval = hhash(item.key, htab->size);
 
 	/* The first index tried. */
 	idx = hval;
@@ -322,8 +466,6 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		 * Further action might be required according to the
 		 * action value.
 		 */
-		unsigned hval2;
-
 		if (htab->table[idx].used == USED_DELETED
 		    && !first_deleted)
 			first_deleted = idx;
@@ -333,21 +475,8 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		if (ret != -1)
 			return ret;
 
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
 		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
+			idx = hnext(idx, hval, htab->size);
 
 			/*
 			 * If we visited all entries leave the loop
@@ -385,8 +514,10 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		 * Create new entry;
 		 * create copies of item.key and item.data
 		 */
-		if (first_deleted)
+		if (first_deleted) {
 			idx = first_deleted;
+			--htab->deleted;
+		}
 
 		htab->table[idx].used = hval;
 		htab->table[idx].entry.key = strdup(item.key);
@@ -417,8 +548,8 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		}
 
 		/* If there is a callback, call it */
-		if (do_callback(&htab->table[idx].entry, item.key, item.data,
-				env_op_create, flag)) {
+		if (do_callback(htab, &htab->table[idx].entry, item.key,
+				item.data, env_op_create, flag)) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
 			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
@@ -429,6 +560,7 @@ int hsearch_r(struct env_entry item, enum env_action action,
 
 		/* return new entry */
 		*retval = &htab->table[idx].entry;
+		hsort_add(htab, *retval);
 		return 1;
 	}
 
@@ -453,12 +585,14 @@ static void _hdelete(const char *key, struct hsearch_data *htab,
 {
 	/* free used entry */
 	debug("hdelete: DELETING key \"%s\"\n", key);
+	hsort_del(htab, ep);
 	free((void *)ep->key);
 	free(ep->data);
 	ep->flags = 0;
 	htab->table[idx].used = USED_DELETED;
 
 	--htab->filled;
+	++htab->deleted;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
@@ -486,7 +620,7 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* If there is a callback, call it */
-	if (do_callback(&htab->table[idx].entry, key, NULL,
+	if (do_callback(htab, &htab->table[idx].entry, key, NULL,
 			env_op_delete, flag)) {
 		debug("callback() rejected deleting variable "
 			"%s, skipping it!\n", key);
@@ -550,6 +684,53 @@ static int cmpkey(const void *p1, const void *p2)
 	return (strcmp(e1->key, e2->key));
 }
 
+/* Bring the sorted list of entries up to date */
+static int hsort(struct hsearch_data *htab)
+{
+	struct env_entry **list = htab->sorted, **added;
+	unsigned int i, j, k, n;
+
+	if (!list) {
+		list = malloc(htab->size * sizeof(*list));
+		if (!list)
+			return -ENOMEM;
+
+		for (i = 1, n = 0; i <= htab->size; ++i) {
+			if (htab->table[i].used > 0)
+				list[n++] = &htab->table[i].entry;
+		}
+		htab->sorted = list;
+		htab->sorted_len = 0;
+		htab->sorted_count = n;
+	}
+
+	/* Sort the entries added since last time and merge them in */
+	n = htab->sorted_count - htab->sorted_len;
+	if (!n)
+		return 0;
+	qsort(list + htab->sorted_len, n, sizeof(*list), cmpkey);
+
+	added = htab->sorted_len ? malloc(n * sizeof(*list)) : NULL;
+	if (added) {
+		memcpy(added, list + htab->sorted_len, n * sizeof(*list));
+		i = htab->sorted_len;
+		j = n;
+		k = htab->sorted_count;
+		while (j) {
+			if (i && strcmp(list[i - 1]->key, added[j - 1]->key) > 0)
+				list[--k] = list[--i];
+			else
+				list[--k] = added[--j];
+		}
+		free(added);
+	} else if (htab->sorted_len) {
+		qsort(list, htab->sorted_count, sizeof(*list), cmpkey);
+	}
+	htab->sorted_len = htab->sorted_count;
+
+	return 0;
+}
+
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -585,6 +766,11 @@ static int match_entry(struct env_entry *ep, int flag, int argc,
 	int arg;
 	void *priv = NULL;
 
+	if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+		return 0;
+	if (!argc)
+		return 1;
+
 	for (arg = 0; arg < argc; ++arg) {
 #ifdef CONFIG_REGEX
 		struct slre slre;
@@ -612,7 +798,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char *const argv[])
 {
-	struct env_entry *list[htab->size];
+	struct env_entry **list;
 	char *res, *p;
 	size_t totlen;
 	int i, n;
@@ -625,63 +811,59 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, size = %lu\n",
 	      htab, htab->size, htab->filled, (ulong)size);
+	/* Get the list sorted by keys */
+	if (hsort(htab)) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+	list = htab->sorted;
+
 	/*
 	 * Pass 1:
-	 * search used entries,
-	 * save addresses and compute total length
+	 * pick the entries to export, in a list of their own if not all
+	 * of them are, and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
-
-			if ((argc > 0) && (found == 0))
-				continue;
+	if (argc > 0 || (flag & H_HIDE_DOT)) {
+		list = malloc(htab->sorted_count * sizeof(*list));
+		if (!list) {
+			__set_errno(ENOMEM);
+			return (-1);
+		}
+	}
+	for (i = 0, n = 0, totlen = 0; i < htab->sorted_count; ++i) {
+		struct env_entry *ep = htab->sorted[i];
 
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
+		if (!match_entry(ep, flag, argc, argv))
+			continue;
 
-			list[n++] = ep;
+		list[n++] = ep;
 
-			totlen += strlen(ep->key);
+		totlen += strlen(ep->key);
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
-#ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
-	for (i = 0; i < n; ++i) {
-		printf("\t%3d: %p ==> %-10s => %s\n",
-		       i, list[i], list[i]->key, list[i]->data);
-	}
-#endif
-
-	/* Sort list by keys */
-	qsort(list, n, sizeof(struct env_entry *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
 			printf("Env export buffer too small: %lu, but need %lu\n",
 			       (ulong)size, (ulong)totlen + 1);
 			__set_errno(ENOMEM);
-			return (-1);
+			res = NULL;
+			goto out;
 		}
 	} else {
 		size = totlen + 1;
@@ -697,7 +879,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		*resp = res = calloc(1, size);
 		if (res == NULL) {
 			__set_errno(ENOMEM);
-			return (-1);
+			goto out;
 		}
 	}
 	/*
@@ -723,7 +905,11 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	}
 	*p = '\0';		/* terminate result */
 
-	return size;
+out:
+	if (list != htab->sorted)
+		free(list);
+
+	return res ? size : -1;
 }
 #endif
 
@@ -853,7 +1039,8 @@ int himport_r(struct hsearch_data *htab,
 	 * environment size), so we clip it to a reasonable value.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
-	 * be overwritten in the board config file if needed.
+	 * be overwritten in the board config file if needed. The table
+	 * grows when it fills up anyway.
 	 */
 
 	if (!htab->table) {
@@ -24,6 +24,9 @@
 #endif /* USE_HOSTCC */
 #include <watchdog.h>
 #include <u-boot/sha1.h>
+#if defined(CONFIG_SHA_ARMV8_CE) && !defined(USE_HOSTCC)
+#include <asm/armv8/sha_ce.h>
+#endif
 
 const uint8_t sha1_der_prefix[SHA1_DER_LEN] = {
 	0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e,
@@ -219,6 +222,33 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 	ctx->state[4] += E;
 }
 
+/*
+ * Process whole 64-byte blocks, using the ARMv8 crypto extension when the
+ * CPU reports it and the C implementation otherwise
+ */
+static void sha1_process_blocks(sha1_context *ctx, const unsigned char *data,
+				unsigned int blocks)
+{
+#if defined(CONFIG_SHA_ARMV8_CE) && !defined(USE_HOSTCC)
+	if (sha1_ce_available()) {
+		uint32_t state[5];
+		int i;
+
+		/* sha1_context keeps the state in unsigned longs */
+		for (i = 0; i < 5; i++)
+			state[i] = ctx->state[i];
+		sha1_ce_transform(state, data, blocks);
+		for (i = 0; i < 5; i++)
+			ctx->state[i] = state[i];
+		return;
+	}
+#endif
+	while (blocks--) {
+		sha1_process(ctx, data);
+		data += 64;
+	}
+}
+
 /*
  * SHA-1 process buffer
  */
@@ -242,16 +272,16 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
 
 	if (left && ilen >= fill) {
 		memcpy ((void *) (ctx->buffer + left), (void *) input, fill);
-		sha1_process (ctx, ctx->buffer);
+		sha1_process_blocks(ctx, ctx->buffer, 1);
 		input += fill;
 		ilen -= fill;
 		left = 0;
 	}
 
-	while (ilen >= 64) {
-		sha1_process (ctx, input);
-		input += 64;
-		ilen -= 64;
+	if (ilen >= 64) {
+		sha1_process_blocks(ctx, input, ilen / 64);
+		input += ilen & ~0x3f;
+		ilen &= 0x3f;
 	}
 
 	if (ilen > 0) {
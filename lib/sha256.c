@@ -13,6 +13,9 @@
 #endif /* USE_HOSTCC */
 #include <watchdog.h>
 #include <u-boot/sha256.h>
+#if defined(CONFIG_SHA_ARMV8_CE) && !defined(USE_HOSTCC)
+#include <asm/armv8/sha_ce.h>
+#endif
 
 const uint8_t sha256_der_prefix[SHA256_DER_LEN] = {
 	0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86,
@@ -186,6 +189,25 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	ctx->state[7] += H;
 }
 
+/*
+ * Process whole 64-byte blocks, using the ARMv8 crypto extension when the
+ * CPU reports it and the C implementation otherwise
+ */
+static void sha256_process_blocks(sha256_context *ctx, const uint8_t *data,
+				  uint32_t blocks)
+{
+#if defined(CONFIG_SHA_ARMV8_CE) && !defined(USE_HOSTCC)
+	if (sha256_ce_available()) {
+		sha256_ce_transform(ctx->state, data, blocks);
+		return;
+	}
+#endif
+	while (blocks--) {
+		sha256_process(ctx, data);
+		data += 64;
+	}
+}
+
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 {
 	uint32_t left, fill;
@@ -204,16 +226,16 @@ void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 
 	if (left && length >= fill) {
 		memcpy((void *) (ctx->buffer + left), (void *) input, fill);
-		sha256_process(ctx, ctx->buffer);
+		sha256_process_blocks(ctx, ctx->buffer, 1);
 		length -= fill;
 		input += fill;
 		left = 0;
 	}
 
-	while (length >= 64) {
-		sha256_process(ctx, input);
-		length -= 64;
-		input += 64;
+	if (length >= 64) {
+		sha256_process_blocks(ctx, input, length / 64);
+		input += length & ~0x3f;
+		length &= 0x3f;
 	}
 
 	if (length)
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Simple dispatcher for running work items on secondary CPUs
+ *
+ * The boot CPU starts as many secondary CPUs as the architecture provides
+ * and then joins in. All CPUs take items from a shared index until none
+ * are left, so uneven items still balance reasonably well.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <smp_work.h>
+#include <watchdog.h>
+#include <linux/kernel.h>
+
+struct smp_work_queue {
+	struct smp_work *work;
+	int count;
+	int next;
+};
+
+/* Set while smp_work_run() is active, to run nested calls serially */
+static bool smp_work_busy;
+
+__weak int arch_smp_work_cpus(void)
+{
+	return 0;
+}
+
+__weak int arch_smp_work_start(int idx, void (*entry)(void *arg), void *arg)
+{
+	return -ENOSYS;
+}
+
+__weak int arch_smp_work_wait(int idx)
+{
+	return 0;
+}
+
+__weak bool arch_smp_work_is_secondary(void)
+{
+	return false;
+}
+
+int smp_work_cpus(void)
+{
+	return 1 + min(arch_smp_work_cpus(), CONFIG_SMP_WORK_MAX_CPUS - 1);
+}
+
+bool smp_work_is_secondary(void)
+{
+	return smp_work_busy && arch_smp_work_is_secondary();
+}
+
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+void smp_work_watchdog_reset(void)
+{
+	/* Work items may reset the watchdog, but only the boot CPU can */
+	if (smp_work_is_secondary())
+		return;
+#ifdef CONFIG_HW_WATCHDOG
+	hw_watchdog_reset();
+#else
+	watchdog_reset();
+#endif
+}
+#endif
+
+static void smp_work_loop(void *arg)
+{
+	struct smp_work_queue *queue = arg;
+	struct smp_work *work;
+	int i;
+
+	for (;;) {
+		i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_ACQ_REL);
+		if (i >= queue->count)
+			break;
+		work = &queue->work[i];
+		work->ret = work->func(work->arg);
+		WATCHDOG_RESET();
+	}
+}
+
+int smp_work_run(struct smp_work *work, int count)
+{
+	struct smp_work_queue queue = {
+		.work = work,
+		.count = count,
+		.next = 0,
+	};
+	bool nested = smp_work_busy;
+	int started = 0;
+	int cpus, i;
+
+	if (nested)
+		cpus = 0;
+	else
+		cpus = min(smp_work_cpus() - 1, count - 1);
+
+	smp_work_busy = true;
+	for (i = 0; i < cpus; i++) {
+		if (arch_smp_work_start(i, smp_work_loop, &queue)) {
+			log_debug("Cannot start secondary CPU %d\n", i);
+			break;
+		}
+		started++;
+	}
+	smp_work_loop(&queue);
+
+	/* The secondary CPUs use @queue until this returns */
+	for (i = 0; i < started; i++) {
+		if (arch_smp_work_wait(i))
+			log_err("Secondary CPU %d did not stop\n", i);
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (!nested)
+		smp_work_busy = false;
+	log_debug("%d items on %d CPUs\n", count, started + 1);
+
+	for (i = 0; i < count; i++) {
+		if (work[i].ret)
+			return work[i].ret;
+	}
+
+	return 0;
+}
@@ -12,6 +12,7 @@
 #include <log.h>
 #include <net.h>
 #include <dm/device-internal.h>
+#include <dm/probe-queue.h>
 #include <dm/uclass-internal.h>
 #include <net/pcap.h>
 #include "eth_internal.h"
@@ -406,6 +407,11 @@ int eth_initialize(void)
 
 	eth_common_init();
 
+	if (dm_probe_deferred(UCLASS_ETH)) {
+		printf("probed on first use\n");
+		return 0;
+	}
+
 	/*
 	 * Devices need to write the hwaddr even if not started so that Linux
 	 * will have access to the hwaddr that u-boot stored for the device.
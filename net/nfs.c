@@ -28,6 +28,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <env.h>
 #include <flash.h>
 #include <image.h>
 #include <log.h>
@@ -37,6 +38,7 @@
 #include "nfs.h"
 #include "bootp.h"
 #include <time.h>
+#include <linux/log2.h>
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
 #define NFS_RETRY_COUNT 30
@@ -49,12 +51,42 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* Bytes of file data per "loading" hash */
+#define NFS_HASH_BYTES	((NFS_READ_SIZE / 2) * 10)
+
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/*
+ * READ requests are pipelined: up to nfs_read_window of them are in flight,
+ * each covering nfs_rsize bytes of the file. Replies are matched to their
+ * request by RPC id and stored at the request's offset, so the order in which
+ * they arrive does not matter.
+ */
+struct nfs_read_slot {
+	unsigned long id;	/* RPC id of the request, 0 if the slot is free */
+	uint offset;		/* File offset asked for */
+	uint len;		/* Number of bytes asked for */
+};
+
+static struct nfs_read_slot nfs_read_slots[NFS_READ_WINDOW_MAX];
+static int nfs_read_window;	/* Number of requests to keep in flight */
+static int nfs_read_depth;	/* Window in use: 1 until the first reply */
+static uint nfs_rsize;		/* Bytes per READ request */
+static uint nfs_read_next;	/* Offset of the next new request */
+static uint nfs_read_eof;	/* Size of the file, once known */
+static ulong nfs_read_bytes;	/* Bytes of file data received */
+static ulong nfs_read_hashes;	/* Hashes printed so far */
+static ulong nfs_read_start;	/* Time the first READ was sent */
+
+static struct {
+	ulong requests;
+	ulong resent;
+	ulong out_of_order;
+	ulong short_reads;
+} nfs_read_stats;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -82,6 +114,11 @@ static char nfs_path_buff[2048];
 #define NFSV3_FLAG 1 << 1
 static char supported_nfs_versions = NFSV2_FLAG | NFSV3_FLAG;
 
+void nfs_reset_versions(void)
+{
+	supported_nfs_versions = NFSV2_FLAG | NFSV3_FLAG;
+}
+
 static inline int store_block(uchar *src, unsigned offset, unsigned len)
 {
 	ulong newsize = offset + len;
@@ -175,7 +212,8 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static unsigned long rpc_req(int rpc_prog, int rpc_proc, uint32_t *data,
+			     int datalen)
 {
 	struct rpc_t rpc_pkt;
 	unsigned long id;
@@ -220,6 +258,8 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 
 	net_send_udp_packet(net_server_ethaddr, nfs_server_ip, sport,
 			    nfs_our_port, pktlen);
+
+	return id;
 }
 
 /**************************************************************************
@@ -361,7 +401,7 @@ static void nfs_lookup_req(char *fname)
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static unsigned long nfs_read_req(uint offset, uint readlen)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -388,7 +428,144 @@ static void nfs_read_req(int offset, int readlen)
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	nfs_read_stats.requests++;
+
+	return rpc_req(PROG_NFS, NFS_READ, data, len);
+}
+
+/* Largest READ which is worth asking for, given what the stack can receive */
+static uint nfs_max_rsize(void)
+{
+	uint max = NFS_READ_SIZE;
+
+#ifdef CONFIG_IP_DEFRAG
+	/* The whole reply must fit in a reassembled datagram */
+	max = rounddown_pow_of_two(CONFIG_NET_MAXDEFRAG - IP_UDP_HDR_SIZE -
+				   NFS_READ_REPLY_HDR_SIZE);
+#endif
+	if (supported_nfs_versions & NFSV2_FLAG)
+		max = min(max, (uint)NFS2_MAXDATA);
+
+	return max;
+}
+
+static void nfs_read_init(void)
+{
+	uint max = nfs_max_rsize();
+
+	nfs_rsize = env_get_ulong("nfsrsize", 10, max);
+	nfs_rsize = clamp(nfs_rsize & ~3, 4U, max);
+	nfs_read_window = env_get_ulong("nfswindowsize", 10,
+					CONFIG_NFS_READ_WINDOW);
+	nfs_read_window = clamp(nfs_read_window, 1, NFS_READ_WINDOW_MAX);
+	/* Only the first reply tells a file from a directory or symlink */
+	nfs_read_depth = 1;
+	nfs_read_next = 0;
+	nfs_read_eof = UINT_MAX;
+	nfs_read_bytes = 0;
+	nfs_read_hashes = 0;
+	nfs_read_start = get_timer(0);
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+	memset(&nfs_read_stats, '\0', sizeof(nfs_read_stats));
+}
+
+/* Start new requests in the free slots, up to the end of the file */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	for (i = 0; i < nfs_read_depth && nfs_read_next < nfs_read_eof; i++) {
+		slot = &nfs_read_slots[i];
+		if (slot->id)
+			continue;
+		slot->offset = nfs_read_next;
+		slot->len = nfs_rsize;
+		slot->id = nfs_read_req(slot->offset, slot->len);
+		nfs_read_next += nfs_rsize;
+	}
+}
+
+/* Send all outstanding requests again, after a timeout */
+static void nfs_read_resend(void)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	for (i = 0; i < nfs_read_depth; i++) {
+		slot = &nfs_read_slots[i];
+		if (!slot->id)
+			continue;
+		slot->id = nfs_read_req(slot->offset, slot->len);
+		nfs_read_stats.resent++;
+	}
+	nfs_read_fill();
+}
+
+static struct nfs_read_slot *nfs_read_find(unsigned long id)
+{
+	unsigned long oldest = ULONG_MAX;
+	struct nfs_read_slot *found = NULL;
+	int i;
+
+	for (i = 0; i < nfs_read_depth; i++) {
+		if (!nfs_read_slots[i].id)
+			continue;
+		if (nfs_read_slots[i].id == id)
+			found = &nfs_read_slots[i];
+		oldest = min(oldest, nfs_read_slots[i].id);
+	}
+	if (found && found->id != oldest)
+		nfs_read_stats.out_of_order++;
+
+	return found;
+}
+
+/*
+ * The transfer is complete when the end of the file is known and everything
+ * before it has arrived. Requests beyond the end are forgotten: their replies
+ * are dropped.
+ */
+static bool nfs_read_done(void)
+{
+	int i;
+
+	if (nfs_read_eof == UINT_MAX)
+		return false;
+	for (i = 0; i < nfs_read_depth; i++) {
+		if (nfs_read_slots[i].id &&
+		    nfs_read_slots[i].offset < nfs_read_eof)
+			return false;
+	}
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+
+	return true;
+}
+
+static void nfs_read_progress(uint rlen)
+{
+	nfs_read_bytes += rlen;
+	while (nfs_read_hashes < DIV_ROUND_UP(nfs_read_bytes, NFS_HASH_BYTES)) {
+		if (nfs_read_hashes && !(nfs_read_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_read_hashes++;
+	}
+}
+
+static void nfs_read_complete(void)
+{
+	ulong time = get_timer(nfs_read_start);
+
+	if (time > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(nfs_read_bytes / time * 1000, "/s");
+	}
+	debug("%lu requests of %u bytes, window %d, ",
+	      nfs_read_stats.requests, nfs_rsize, nfs_read_window);
+	debug("%lu out of order, %lu short, %lu resent\n",
+	      nfs_read_stats.out_of_order, nfs_read_stats.short_reads,
+	      nfs_read_stats.resent);
 }
 
 /**************************************************************************
@@ -421,7 +598,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -666,17 +843,26 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
+	struct nfs_read_slot *slot;
 	struct rpc_t rpc_pkt;
-	int rlen;
-	uchar *data_ptr;
+	bool eof = false;
+	uint rlen;
+	uint data_off;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	if (len < offsetof(struct rpc_t, u.reply.data[1]))
+		return -NFS_RPC_DROP;
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	/*
+	 * Only the headers are copied, to align them. The file data is stored
+	 * straight from the received packet.
+	 */
+	memcpy(&rpc_pkt.u.data[0], pkt,
+	       min_t(uint, len, NFS_READ_REPLY_HDR_SIZE));
+
+	slot = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!slot)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -690,34 +876,49 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		data_off = offsetof(struct rpc_t, u.reply.data[19]);
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset];
 		/* Skip unused values :
-			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		data_off = offsetof(struct rpc_t,
+				    u.reply.data[4 + nfsv3_data_offset]);
 	}
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+	if (rlen > slot->len || data_off + rlen > len)
+		return -9999;
+
+	if (rlen && store_block(pkt + data_off, slot->offset, rlen))
+		return -9999;
+
+	nfs_read_progress(rlen);
+
+	if (rlen < slot->len && !eof &&
+	    !(supported_nfs_versions & NFSV2_FLAG) && rlen) {
+		/*
+		 * An NFSv3 server may return less than asked for. Ask for the
+		 * rest, and no more than this from now on.
+		 */
+		nfs_read_stats.short_reads++;
+		nfs_rsize = min(nfs_rsize, rlen);
+		slot->offset += rlen;
+		slot->len -= rlen;
+		slot->id = nfs_read_req(slot->offset, slot->len);
+		return rlen;
+	}
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	/* NFSv2 has no EOF flag: a short read is the end of the file */
+	if (eof || rlen < slot->len)
+		nfs_read_eof = min(nfs_read_eof, slot->offset + rlen);
+	slot->id = 0;
 
 	return rlen;
 }
@@ -747,7 +948,8 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	/* READ replies are stored without copying the whole packet */
+	if (len > sizeof(struct rpc_t) && nfs_state != STATE_READ_REQ)
 		return;
 
 	if (dest != nfs_our_port)
@@ -814,8 +1016,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			nfs_read_init();
 			nfs_send();
 		}
 		break;
@@ -843,18 +1044,23 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0) {
+			nfs_timeout_count = 0;
+			if (nfs_read_done()) {
+				nfs_read_complete();
+				nfs_download_state = NETLOOP_SUCCESS;
+				nfs_state = STATE_UMOUNT_REQ;
+				nfs_send();
+				break;
+			}
+			nfs_read_depth = nfs_read_window;
+			nfs_read_fill();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
-				debug("NFS READ error (%d)\n", rlen);
+			debug("NFS READ error (%d)\n", rlen);
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		}
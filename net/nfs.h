@@ -44,6 +44,11 @@
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
 #define NFS_MAX_ATTRS	26
 
+#define NFS2_MAXDATA	8192	/* largest NFSv2 READ (RFC 1094) */
+
+/* Largest number of READ requests in flight */
+#define NFS_READ_WINDOW_MAX	64
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
@@ -79,8 +84,19 @@ struct rpc_t {
 		} reply;
 	} u;
 };
+
+/* RPC and NFS headers in front of the data in a READ reply, at most */
+#define NFS_READ_REPLY_HDR_SIZE \
+	offsetof(struct rpc_t, u.reply.data[NFS_MAX_ATTRS])
+
 void nfs_start(void);	/* Begin NFS */
 
+/*
+ * Offer NFSv2 again. Once a server has turned it down, later transfers go
+ * straight to NFSv3.
+ */
+void nfs_reset_versions(void);
+
 
 /**********************************************************************/
 
@@ -34,6 +34,13 @@ DECLARE_GLOBAL_DATA_PTR;
 #endif
 /* Number of "loading" hashes per line (for checking the image size) */
 #define HASHES_PER_LINE	65
+/*
+ * Number of blocks past the last contiguous one which can be stored out of
+ * order. Blocks further ahead are dropped and will be retransmitted.
+ */
+#define TFTP_REORDER_BLOCKS	1024
+/* Shortest time without data before a stalled window is ACKed again (ms) */
+#define TFTP_WINDOW_TIMEOUT_MIN	20
 
 /*
  *	TFTP operations.
@@ -103,6 +110,27 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* Last data block received, in or out of sequence */
+static ushort	tftp_last_rx;
+/* Time the last data block was received */
+static ulong	tftp_rx_time;
+/* Longest interval seen between data blocks in this transfer (ms) */
+static ulong	tftp_rx_gap;
+/* Window size to request in the next RRQ, adapted to observed loss */
+static ushort	tftp_window_size_adapt;
+/* Blocks received ahead of tftp_cur_block, indexed by absolute block number */
+static uchar	tftp_reorder_map[TFTP_REORDER_BLOCKS / 8];
+/* Absolute number of the final (short) block if received out of order */
+static ulong	tftp_final_block;
+
+/* Per-transfer receive statistics */
+static struct tftp_stats {
+	ulong blocks;		/* data blocks accepted */
+	ulong out_of_order;	/* blocks stored ahead of a gap */
+	ulong duplicates;	/* blocks received more than once */
+	ulong naks;		/* early ACKs sent to request a retransmit */
+	ulong timeouts;		/* timeouts while waiting for data */
+} tftp_stats;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -216,6 +244,8 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_final_block = 0;
+	memset(tftp_reorder_map, 0, sizeof(tftp_reorder_map));
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -246,6 +276,7 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 
 static void tftp_send(void);
 static void tftp_timeout_handler(void);
+static void tftp_window_timeout_handler(void);
 
 /**********************************************************************/
 
@@ -308,6 +339,139 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/* Absolute number of the last block received in order */
+static ulong tftp_abs_block(void)
+{
+	return tftp_block_wrap * TFTP_SEQUENCE_SIZE + tftp_cur_block;
+}
+
+/* Check if a block is at or before the last one received in sequence */
+static bool tftp_block_is_old(ushort block)
+{
+	ushort delta = block - (ushort)tftp_cur_block;
+
+	return !delta || delta >= TFTP_SEQUENCE_SIZE / 2;
+}
+
+/**
+ * Store a data block which did not arrive in sequence
+ *
+ * Blocks ahead of the next expected one are written straight to their place
+ * in the load area and recorded in tftp_reorder_map, so that they are not
+ * needed again once the gap before them has been filled.
+ *
+ * @param block	Block number from the packet
+ * @param src	Block data
+ * @param len	Number of bytes in the block
+ * @return 0 if the block was stored or ignored, non-zero on store error
+ */
+static int tftp_store_ahead(ushort block, uchar *src, unsigned int len)
+{
+	ushort delta = block - (ushort)tftp_cur_block;
+	ulong abs = tftp_abs_block() + delta;
+	int bit = abs % TFTP_REORDER_BLOCKS;
+	int rc;
+
+	if (tftp_block_is_old(block)) {
+		tftp_stats.duplicates++;
+		return 0;
+	}
+	if (delta > TFTP_REORDER_BLOCKS ||
+	    (tftp_final_block && abs > tftp_final_block))
+		return 0;
+	if (tftp_reorder_map[bit / 8] & (1 << (bit % 8))) {
+		tftp_stats.duplicates++;
+		return 0;
+	}
+
+	rc = store_block(tftp_cur_block + delta - 1, src, len);
+	if (rc)
+		return rc;
+	tftp_reorder_map[bit / 8] |= 1 << (bit % 8);
+	tftp_stats.out_of_order++;
+	if (len < tftp_block_size)
+		tftp_final_block = abs;
+
+	return 0;
+}
+
+/**
+ * Advance over blocks already stored by tftp_store_ahead()
+ *
+ * @return true if the final block of the file has now been reached
+ */
+static bool tftp_reorder_advance(void)
+{
+	int bit = (tftp_abs_block() + 1) % TFTP_REORDER_BLOCKS;
+
+	while (tftp_reorder_map[bit / 8] & (1 << (bit % 8))) {
+		tftp_reorder_map[bit / 8] &= ~(1 << (bit % 8));
+		tftp_cur_block++;
+		tftp_cur_block %= TFTP_SEQUENCE_SIZE;
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+		tftp_stats.blocks++;
+		if (tftp_abs_block() == tftp_final_block)
+			return true;
+		bit = (tftp_abs_block() + 1) % TFTP_REORDER_BLOCKS;
+	}
+
+	return false;
+}
+
+/*
+ * Pick the window size for the next request from what this one saw. Every
+ * retransmit request restarts a whole window, so once there is more than one
+ * loss per window on average the window is too large for the link and is
+ * halved. It is doubled again (up to tftpwindowsize) after a loss-free
+ * transfer. Timeouts are not counted: they mostly come from losing the last
+ * block of a window, which a smaller window makes more likely, not less.
+ */
+static void tftp_adapt_window(void)
+{
+	ulong window = tftp_windowsize;
+
+	if (tftp_stats.naks * window > tftp_stats.blocks)
+		tftp_window_size_adapt = max(tftp_window_size_adapt / 2, 1);
+	else if (!tftp_stats.naks && !tftp_stats.timeouts)
+		tftp_window_size_adapt = min(tftp_window_size_adapt * 2,
+					     (int)tftp_window_size_option);
+}
+
+/*
+ * Restart the receive timeout after a data block. Within a window the server
+ * does not send anything further if the last blocks of the window are lost,
+ * so a stall is ACKed again once no data has arrived for a few times the
+ * longest interval seen so far, rather than waiting for the full timeout.
+ */
+static void tftp_data_received(void)
+{
+	ulong gap = get_timer(tftp_rx_time);
+
+	if (gap > tftp_rx_gap)
+		tftp_rx_gap = gap;
+	tftp_rx_time = get_timer(0);
+
+	/* A timeout below 4 * TFTP_WINDOW_TIMEOUT_MIN lowers the minimum too */
+	if (tftp_windowsize > 1)
+		net_set_timeout_handler(clamp(tftp_rx_gap * 4,
+					      min((ulong)TFTP_WINDOW_TIMEOUT_MIN,
+						  timeout_ms / 4),
+					      timeout_ms / 4),
+					tftp_window_timeout_handler);
+	else
+		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+}
+
+static void tftp_show_stats(void)
+{
+	debug("\n\t %lu blocks (%lu out of order, %lu duplicate), ",
+	      tftp_stats.blocks, tftp_stats.out_of_order,
+	      tftp_stats.duplicates);
+	debug("%lu retransmit requests, %lu timeouts, window %u",
+	      tftp_stats.naks, tftp_stats.timeouts, tftp_windowsize);
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -326,6 +490,10 @@ static void tftp_complete(void)
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
 	}
+	if (!tftp_put_active) {
+		tftp_show_stats();
+		tftp_adapt_window();
+	}
 	puts("\ndone\n");
 	net_set_state(NETLOOP_SUCCESS);
 }
@@ -377,9 +545,9 @@ static void tftp_send(void)
 		 * Implemented only for tftp get.
 		 * Don't bother sending if it's 1
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_adapt > 1)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_window_size_adapt, 0);
 		len = pkt - xp;
 		break;
 
@@ -603,23 +771,57 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			debug("Received unexpected block: %d, expected: %d\n",
 			      ntohs(*(__be16 *)pkt),
 			      (ushort)(tftp_cur_block + 1));
+			/*
+			 * With a window, an old block means the server has
+			 * sent a window again, usually because our ACK was
+			 * lost. ACK the last block received in sequence on the
+			 * first block of that window only: ACKing each of them
+			 * would make the server send one more window each time.
+			 */
+			if (tftp_windowsize > 1 &&
+			    tftp_block_is_old(ntohs(*(__be16 *)pkt))) {
+				tftp_stats.duplicates++;
+				if ((ushort)(tftp_last_rx -
+					     ntohs(*(__be16 *)pkt)) <
+				    TFTP_SEQUENCE_SIZE / 2)
+					tftp_send();
+				tftp_last_rx = ntohs(*(__be16 *)pkt);
+				break;
+			}
+			if (tftp_state == STATE_DATA &&
+			    tftp_store_ahead(ntohs(*(__be16 *)pkt), pkt + 2,
+					     len)) {
+				eth_halt();
+				net_set_state(NETLOOP_FAIL);
+				break;
+			}
 			/*
 			 * If one packet is dropped most likely
 			 * all other buffers in the window
 			 * that will arrive will cause a sending NACK.
 			 * This just overwellms the server, let's just send one.
+			 * Only send another when the block number goes back,
+			 * as the server has then restarted the window and lost
+			 * the missing block again.
 			 */
-			if (tftp_last_nack != tftp_cur_block) {
+			if (tftp_last_nack != tftp_cur_block ||
+			    (ushort)(ntohs(*(__be16 *)pkt) - tftp_last_rx) >=
+			    TFTP_SEQUENCE_SIZE / 2) {
 				tftp_send();
+				tftp_stats.naks++;
 				tftp_last_nack = tftp_cur_block;
 				tftp_next_ack = (ushort)(tftp_cur_block +
 							 tftp_windowsize);
 			}
+			tftp_last_rx = ntohs(*(__be16 *)pkt);
+			if (tftp_state == STATE_DATA)
+				tftp_data_received();
 			break;
 		}
 
 		tftp_cur_block++;
 		tftp_cur_block %= TFTP_SEQUENCE_SIZE;
+		tftp_last_rx = tftp_cur_block;
 
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge any options!\n");
@@ -648,8 +850,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		update_block_number();
 		tftp_prev_block = tftp_cur_block;
+		tftp_stats.blocks++;
 		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		tftp_data_received();
 
 		if (store_block(tftp_cur_block - 1, pkt + 2, len)) {
 			eth_halt();
@@ -657,19 +860,26 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			break;
 		}
 
-		if (len < tftp_block_size) {
+		/*
+		 * A short block ends the transfer, either this one or one
+		 * which was already stored out of order past a filled gap.
+		 */
+		if (len < tftp_block_size || tftp_reorder_advance()) {
 			tftp_send();
 			tftp_complete();
 			break;
 		}
 
 		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	Acknowledge the highest block received in sequence,
+		 *	which will prompt the remote for the next window. After
+		 *	a gap has been filled this may be past tftp_next_ack.
 		 */
-		if (tftp_cur_block == tftp_next_ack) {
+		if ((ushort)(tftp_cur_block - tftp_next_ack) <
+		    TFTP_SEQUENCE_SIZE / 2) {
 			tftp_send();
-			tftp_next_ack += tftp_windowsize;
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
 		}
 		break;
 
@@ -702,15 +912,35 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 static void tftp_timeout_handler(void)
 {
 	if (++timeout_count > timeout_count_max) {
+		/* Ask for a smaller window when starting again */
+		tftp_window_size_adapt = max(tftp_window_size_adapt / 2, 1);
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
+		if (tftp_state == STATE_DATA)
+			tftp_stats.timeouts++;
+		tftp_rx_time = get_timer(0);
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
 }
 
+/*
+ * Data stopped arriving part way through a window, most likely because its
+ * last blocks were lost. ACK what we have so that the server starts the
+ * window again, then fall back to the normal timeout.
+ */
+static void tftp_window_timeout_handler(void)
+{
+	tftp_stats.naks++;
+	tftp_last_nack = tftp_cur_block;
+	tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+	tftp_rx_time = get_timer(0);
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	tftp_send();
+}
+
 /* Initialize tftp_load_addr and tftp_load_size from image_load_addr and lmb */
 static int tftp_init_load_addr(void)
 {
@@ -769,8 +999,12 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
+	if (!tftp_window_size_adapt ||
+	    tftp_window_size_adapt > tftp_window_size_option)
+		tftp_window_size_adapt = tftp_window_size_option;
+
 	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
-	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
+	      tftp_block_size_option, tftp_window_size_adapt, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -868,6 +1102,9 @@ void tftp_start(enum proto_t protocol)
 	tftp_cur_block = 0;
 	tftp_windowsize = 1;
 	tftp_last_nack = 0;
+	tftp_rx_time = get_timer(0);
+	tftp_rx_gap = 0;
+	memset(&tftp_stats, 0, sizeof(tftp_stats));
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
@@ -121,6 +121,199 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+#ifdef CONFIG_IMAGE_DECOMP_PARALLEL
+/* plain[] repeated up to 150000 bytes: lz4 -B4 -BI -12 (three blocks) */
+static const char lz4_blocks[] =
+	"\x04\x22\x4d\x18\x60\x40\x82\x08\x02\x00\x00\xff\x19\x49\x20\x61"
+	"\x6d\x20\x61\x20\x68\x69\x67\x68\x6c\x79\x20\x63\x6f\x6d\x70\x72"
+	"\x65\x73\x73\x61\x62\x6c\x65\x20\x62\x69\x74\x20\x6f\x66\x20\x74"
+	"\x65\x78\x74\x2e\x0a\x28\x00\x3d\xf0\x25\x54\x68\x65\x72\x65\x20"
+	"\x61\x72\x65\x20\x6d\x61\x6e\x79\x20\x6c\x69\x6b\x65\x20\x6d\x65"
+	"\x2c\x20\x62\x75\x74\x20\x74\x68\x69\x73\x20\x6f\x6e\x65\x20\x69"
+	"\x73\x20\x6d\x69\x6e\x65\x2e\x0a\x49\x66\x20\x49\x20\x77\x32\x00"
+	"\x00\x2d\x00\xa1\x73\x68\x6f\x72\x74\x65\x72\x2c\x20\x74\x45\x00"
+	"\xf4\x0b\x77\x6f\x75\x6c\x64\x6e\x27\x74\x20\x62\x65\x20\x6d\x75"
+	"\x63\x68\x20\x73\x65\x6e\x73\x65\x20\x69\x6e\x0a\x7f\x00\x50\x69"
+	"\x6e\x67\x20\x6d\x12\x00\x00\x32\x00\xf0\x11\x20\x66\x69\x72\x73"
+	"\x74\x20\x70\x6c\x61\x63\x65\x2e\x20\x41\x74\x20\x6c\x65\x61\x73"
+	"\x74\x20\x77\x69\x74\x68\x20\x6c\x7a\x6f\x2c\x63\x00\xf5\x14\x77"
+	"\x61\x79\x2c\x0a\x77\x68\x69\x63\x68\x20\x61\x70\x70\x65\x61\x72"
+	"\x73\x20\x74\x6f\x20\x62\x65\x68\x61\x76\x65\x20\x70\x6f\x6f\x72"
+	"\x6c\x79\x4e\x00\x30\x61\x63\x65\xd7\x00\x01\x95\x00\x01\xdd\x00"
+	"\x20\x0a\x6d\xf2\x00\x5f\x67\x65\x73\x2e\x0a\x5e\x01\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x89\x50\x20\x61"
+	"\x6d\x20\x61\x0b\x02\x00\x00\xf0\x47\x20\x68\x69\x67\x68\x6c\x79"
+	"\x20\x63\x6f\x6d\x70\x72\x65\x73\x73\x61\x62\x6c\x65\x20\x62\x69"
+	"\x74\x20\x6f\x66\x20\x74\x65\x78\x74\x2e\x0a\x54\x68\x65\x72\x65"
+	"\x20\x61\x72\x65\x20\x6d\x61\x6e\x79\x20\x6c\x69\x6b\x65\x20\x6d"
+	"\x65\x2c\x20\x62\x75\x74\x20\x74\x68\x69\x73\x20\x6f\x6e\x65\x20"
+	"\x69\x73\x20\x6d\x69\x6e\x65\x2e\x0a\x49\x66\x20\x49\x20\x77\x32"
+	"\x00\x00\x2d\x00\xa1\x73\x68\x6f\x72\x74\x65\x72\x2c\x20\x74\x45"
+	"\x00\xf4\x0b\x77\x6f\x75\x6c\x64\x6e\x27\x74\x20\x62\x65\x20\x6d"
+	"\x75\x63\x68\x20\x73\x65\x6e\x73\x65\x20\x69\x6e\x0a\x7f\x00\x50"
+	"\x69\x6e\x67\x20\x6d\x12\x00\x00\x32\x00\xf0\x11\x20\x66\x69\x72"
+	"\x73\x74\x20\x70\x6c\x61\x63\x65\x2e\x20\x41\x74\x20\x6c\x65\x61"
+	"\x73\x74\x20\x77\x69\x74\x68\x20\x6c\x7a\x6f\x2c\x63\x00\xf5\x14"
+	"\x77\x61\x79\x2c\x0a\x77\x68\x69\x63\x68\x20\x61\x70\x70\x65\x61"
+	"\x72\x73\x20\x74\x6f\x20\x62\x65\x68\x61\x76\x65\x20\x70\x6f\x6f"
+	"\x72\x6c\x79\x4e\x00\x30\x61\x63\x65\xd7\x00\x01\x95\x00\x01\xdd"
+	"\x00\x20\x0a\x6d\xf2\x00\xbf\x67\x65\x73\x2e\x0a\x49\x20\x61\x6d"
+	"\x20\x61\x0e\x01\x0f\x0f\x28\x00\x3c\x0f\x5e\x01\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x68\x50\x66\x20\x49"
+	"\x20\x77\x51\x01\x00\x00\xf0\x04\x65\x72\x65\x20\x61\x6e\x79\x20"
+	"\x73\x68\x6f\x72\x74\x65\x72\x2c\x20\x74\x68\x13\x00\xf0\x18\x77"
+	"\x6f\x75\x6c\x64\x6e\x27\x74\x20\x62\x65\x20\x6d\x75\x63\x68\x20"
+	"\x73\x65\x6e\x73\x65\x20\x69\x6e\x0a\x63\x6f\x6d\x70\x72\x65\x73"
+	"\x73\x69\x6e\x67\x20\x6d\x12\x00\x00\x32\x00\xf0\x11\x20\x66\x69"
+	"\x72\x73\x74\x20\x70\x6c\x61\x63\x65\x2e\x20\x41\x74\x20\x6c\x65"
+	"\x61\x73\x74\x20\x77\x69\x74\x68\x20\x6c\x7a\x6f\x2c\x63\x00\xf5"
+	"\x14\x77\x61\x79\x2c\x0a\x77\x68\x69\x63\x68\x20\x61\x70\x70\x65"
+	"\x61\x72\x73\x20\x74\x6f\x20\x62\x65\x68\x61\x76\x65\x20\x70\x6f"
+	"\x6f\x72\x6c\x79\x4e\x00\x62\x61\x63\x65\x20\x6f\x66\x95\x00\xf4"
+	"\x0f\x20\x74\x65\x78\x74\x0a\x6d\x65\x73\x73\x61\x67\x65\x73\x2e"
+	"\x0a\x49\x20\x61\x6d\x20\x61\x20\x68\x69\x67\x68\x6c\x79\x20\x8f"
+	"\x00\x80\x61\x62\x6c\x65\x20\x62\x69\x74\x37\x00\x00\x31\x00\x0f"
+	"\x28\x00\x3f\x21\x54\x68\x2c\x01\x40\x72\x65\x20\x6d\x31\x01\xff"
+	"\x16\x6c\x69\x6b\x65\x20\x6d\x65\x2c\x20\x62\x75\x74\x20\x74\x68"
+	"\x69\x73\x20\x6f\x6e\x65\x20\x69\x73\x20\x6d\x69\x6e\x65\x2e\x0a"
+	"\x49\x66\x20\x49\x20\x77\x5e\x01\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xc2\x50\x77\x6f\x75\x6c\x64\x00\x00\x00\x00";
+static const unsigned long lz4_blocks_size = 1403;
+
+/* plain[] repeated up to 30000 bytes, as three zstd frames of 10000 bytes */
+static const char zstd_frames[] =
+	"\x28\xb5\x2f\xfd\x60\x10\x26\xcd\x05\x00\x82\xce\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xaf\xd6\x6e\xf9\xcd\x8a\x5b\xc9\x2d"
+	"\x5f\xdd\xd5\xea\x68\x9a\x6f\x78\x01\x87\xb0\xe6\x3d\xeb\x00\x7e"
+	"\xe1\x53\xea\xe8\x1e\x13\x4e\x88\x24\xdc\xad\x66\x5d\xbe\x7b\xd6"
+	"\xa5\xd6\xdb\x18\x0e\xde\xfc\x65\x31\x47\x97\xcd\x87\xe9\xc3\xab"
+	"\x22\x09\x0b\x7d\x9d\x3c\xef\x32\x7c\x66\xa4\xea\x21\xd3\xde\xe1"
+	"\xc8\x94\xb2\x94\xd3\x2d\x4d\x04\x08\x00\xaf\x25\x6c\xb9\x83\x4d"
+	"\x04\x8c\x8d\xa2\xa2\x28\x46\x81\x11\x8e\x84\xfb\x54\x55\x0b\xd1"
+	"\x0b\x55\x65\x28\xb5\x2f\xfd\x60\x10\x26\xc5\x05\x00\x32\xce\x25"
+	"\x17\x80\x6d\x0e\x00\x10\x12\x93\xa0\xe5\x3f\xd1\x9e\x20\xf2\xc4"
+	"\x30\xe6\x6f\x74\x95\x0d\xd7\x03\xc9\x72\x1c\xb4\x16\xde\xa5\x06"
+	"\xb9\xb0\xf2\x96\xcc\x9a\x7e\x73\xd6\x54\xeb\x75\x0e\x0b\x67\x3e"
+	"\x93\xcb\x52\x43\xe6\x3f\xf4\xdf\x95\xa1\x38\x6f\x1e\xfe\x3a\xd0"
+	"\xd2\x52\x4b\x2a\xa3\x19\xba\x00\x06\xfd\x82\xaa\x67\xc0\x46\x5f"
+	"\xef\x73\x4a\xad\x38\x1f\x41\x69\x3d\xe7\x1a\xff\x41\xf5\xc3\x6e"
+	"\xad\x0f\xdf\x34\x68\x85\xa4\x82\x00\x41\x42\x48\x6a\x68\xc1\x4d"
+	"\xcb\x6a\x13\xf2\x2a\x7e\x79\x09\x0f\x47\x70\x35\x5e\x7d\xa9\xf8"
+	"\x6a\xdd\xd2\x67\x5e\x5a\xaa\xfe\x35\xcc\x21\x40\x4b\x5f\xdb\xd5"
+	"\x0a\x71\x98\x7f\x78\x83\x16\x09\x00\xaf\x25\x6c\xb9\x46\x42\x68"
+	"\xa6\x19\x5c\xf5\xd2\xcc\x02\x50\xbf\x14\xb2\x54\x85\x97\xc4\x48"
+	"\x89\xa3\x22\x44\x01\x28\xb5\x2f\xfd\x60\x10\x26\xed\x05\x00\xf2"
+	"\x4d\x25\x17\x80\x6d\x0e\x00\x10\x12\x93\xa0\xe5\x3f\xd1\x9e\x20"
+	"\xf2\xc4\x30\xe6\x6f\x74\x95\x0d\xd7\x03\xfa\x05\x55\xcf\x00\xc5"
+	"\xf9\x08\x4a\xeb\x39\xd7\xf8\x0f\xaa\x1f\x76\x6b\x7d\xf8\xa6\x41"
+	"\x2b\x24\x15\x04\x08\x12\x42\x82\x9b\x96\xd5\x26\xe4\x55\xfc\xf2"
+	"\x12\x1e\x8e\xe0\x6a\xbc\xfa\x52\xf1\xd5\xba\xa5\xcf\xbc\xb4\x04"
+	"\x5a\xfa\xda\xae\x56\x88\xc3\xfc\xc3\x1b\xb4\x64\x39\x0e\x5a\x0b"
+	"\xef\xfb\x9c\x52\x4b\x0d\x72\x61\xe5\x2d\x99\x35\xfd\xe6\xac\xa9"
+	"\xd6\xeb\x1c\x16\xce\x7c\x26\x97\xa5\x86\xcc\x7f\xe8\xbf\x2b\x63"
+	"\x49\x65\x34\x43\x17\xc0\xb0\xd1\xd7\x8a\xf3\xe6\xe1\xaf\x03\x55"
+	"\xff\x1a\xe6\x10\x4b\x4b\x05\x0c\x00\xaf\x25\x6c\xf1\xb0\x94\x03"
+	"\x23\xb6\x1c\xd8\x04\xc0\xd8\x28\x8b\xa2\x5e\xcd\x08\x45\x81\x11"
+	"\x8e\x84\xfb\x55\x5b\xcd\x2c\x00\x05\x4b\x54\x7a";
+static const unsigned long zstd_frames_size = 588;
+
+/* The same data as three BGZF gzip members and an empty EOF member */
+static const char bgzf_members[] =
+	"\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00"
+	"\x14\x01\xed\xd0\x31\x72\x84\x30\x0c\x05\xd0\x9e\x53\xfc\x2e\x0d"
+	"\xb3\x77\x48\x49\x9f\x0b\x08\x22\xb0\x27\xc6\x66\x6c\x11\x42\x4e"
+	"\x1f\xc1\xcc\x96\xe9\xb6\xfc\x85\x07\xdb\x23\x7d\xa3\x37\x40\x56"
+	"\x08\x42\x5c\x42\x3a\x31\x95\x75\xab\xda\x9a\x8c\x49\x31\x46\x43"
+	"\x99\x61\xfa\x63\x8f\x6e\x78\x71\xdd\x47\xd0\xaa\x10\x5f\xab\xe4"
+	"\x13\x29\x7e\xf9\x4e\x7b\x8c\xbb\xc1\x42\x6c\x28\x59\xe1\x9f\x35"
+	"\x66\xf5\xd4\x19\x03\x8e\xbb\xc3\x8b\x5b\x28\xd5\xb4\xf6\x5e\x78"
+	"\x5d\x1d\x65\x4f\x9f\xf9\xcd\x30\x7a\xc4\x3e\x05\x34\xcd\xcd\x9b"
+	"\x73\xf7\x7c\x3e\xe6\xc5\xc3\xfd\xe6\xea\xc0\x1c\x6b\x33\x6c\x49"
+	"\x26\x7d\xe0\xdd\x90\x54\xfc\x7c\x44\x0b\x48\xbf\xa5\xbf\x9e\x38"
+	"\xe4\xec\xbb\x23\x44\x0f\x93\x6d\x53\xa9\x0d\x56\x3c\x3f\xc8\xb7"
+	"\x62\x2b\xa5\xfa\x6c\xcf\x34\x8f\xb9\xc6\xba\x7f\xea\x1e\xae\x5b"
+	"\xaf\x89\x17\x6d\xaf\x57\xa3\x2e\x75\xa9\x4b\x5d\xea\x52\x97\xba"
+	"\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\x52\x97\xba\xd4\xa5\x2e\x75\xa9"
+	"\x4b\x5d\xea\x52\x97\xba\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\x52\x97"
+	"\xba\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\xfe\xa7\xfb\x07\x3c\xb5\x78"
+	"\x40\x10\x27\x00\x00\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06"
+	"\x00\x42\x43\x02\x00\x13\x01\xed\xd0\x3d\x6e\xc4\x20\x10\x05\xe0"
+	"\xde\xa7\x78\x5d\x1a\x6b\xef\x90\x72\xfb\x5c\x60\xec\x8c\x0d\x0a"
+	"\x7f\x02\x1c\xe2\x3d\x7d\xc6\x2b\x25\x27\x88\x52\xbd\x02\x09\x46"
+	"\xcc\x83\xf9\xd2\x4b\xc7\xa2\x88\xc7\xea\xd0\x34\x35\x85\x4f\xd3"
+	"\x9a\x63\xa9\xda\x9a\x4f\x3b\xe2\x55\x41\x77\x8a\xcd\xd7\xd6\x51"
+	"\x82\xac\x7a\xc3\x6b\x47\x50\xb1\xf3\xf0\xdd\x21\x3c\xf2\x0c\x49"
+	"\xe7\x90\x73\x9e\x86\xf3\x16\x26\xa5\xa8\xd4\x86\x9e\x2d\xdf\xc9"
+	"\xa7\xa2\xe4\x5c\xc3\xf9\x9b\x66\x31\xc8\x1b\x9a\xcb\xb5\xa3\xeb"
+	"\x57\x9f\xa2\x3d\x29\xbb\xb6\xdb\x74\x87\x44\x08\x9c\xdf\x9d\x75"
+	"\xfc\x7c\x47\x96\xa0\x58\x7c\xbf\xda\xae\x86\xbf\xbf\xf7\xe6\xb4"
+	"\x2a\xc4\x56\xb4\x69\x10\xfc\x87\xed\x74\xc6\x72\xd8\x17\x9d\x6f"
+	"\xc8\xc9\x38\x1a\xa2\x4f\x6a\xa9\x1b\xee\x18\xcf\x0e\xbb\xfc\x1c"
+	"\x44\xeb\x7c\x4d\x67\xa5\x91\x8f\xf0\x9e\xa8\x4b\x5d\xea\x52\x97"
+	"\xba\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\x52\x97\xba\xd4\xa5\x2e\x75"
+	"\xa9\x4b\x5d\xea\x52\x97\xba\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\x52"
+	"\x97\xba\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\x52\x97\xba\xff\xa4\xfb"
+	"\x0d\x34\x6b\xd3\x0e\x10\x27\x00\x00\x1f\x8b\x08\x04\x00\x00\x00"
+	"\x00\x00\xff\x06\x00\x42\x43\x02\x00\x17\x01\xed\xd0\x31\x72\x84"
+	"\x30\x0c\x05\xd0\x9e\x53\xfc\x2e\x0d\xb3\x77\x48\xb9\x7d\x2e\x20"
+	"\x88\xc0\x9e\x18\x9b\xb1\x45\x08\x7b\xfa\x08\x66\xb6\x4d\x52\xa4"
+	"\xfc\x85\x07\xdb\x23\x7d\xa3\x17\xd2\x81\xb1\x2c\x6b\xd5\xd6\x64"
+	"\x48\x8a\x21\x1a\xca\x04\xd3\x2f\xbb\x75\x77\xc8\x02\x41\x88\x73"
+	"\xf8\xb1\xee\x2d\x68\x55\x88\xaf\x45\xf2\x81\x14\x3f\x7c\xa7\x3d"
+	"\x86\xcd\x60\x21\x36\x94\xac\xf0\xcf\x12\xb3\x7a\xea\x84\x3b\xf6"
+	"\xab\xc3\x8b\x5b\x28\xd5\xb4\xf6\x5e\x78\x5e\xed\x65\x4b\xef\xf9"
+	"\xc5\x30\x78\xc4\x36\x06\x34\xcd\xcd\x9b\x73\xf7\x7c\x3e\xe6\xd9"
+	"\xc3\xfd\xe6\xec\xc0\x14\x6b\x33\xac\x49\x46\xbd\xe1\xd5\x90\x54"
+	"\xfc\xbc\x47\x0b\x48\x8f\xd2\x9f\x4f\xec\x72\xf4\xdd\x1e\xa2\x87"
+	"\xc9\xba\xaa\xd4\x06\x2b\x9e\x1f\xe4\x53\xb1\x96\x52\x7d\xb6\x67"
+	"\x9a\xc7\x9c\x63\x5d\x3f\x75\x0d\xd7\x2d\xe7\xc4\xb3\xb6\xbf\x6b"
+	"\xfc\x77\x1d\x75\xa9\x4b\x5d\xea\x52\x97\xba\xd4\xa5\x2e\x75\xa9"
+	"\x4b\x5d\xea\x52\x97\xba\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\x52\x97"
+	"\xba\xd4\xa5\x2e\x75\xa9\x4b\x5d\xea\x52\x97\xba\xd4\xa5\x2e\x75"
+	"\xa9\x4b\x5d\xea\x52\xf7\x77\xdd\x6f\x93\x52\x99\x89\x10\x27\x00"
+	"\x00\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02"
+	"\x00\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+static const unsigned long bgzf_members_size = 861;
+#endif
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -536,6 +729,77 @@ static int compression_test_bootm_none(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+#ifdef CONFIG_IMAGE_DECOMP_PARALLEL
+static int run_parallel_test(struct unit_test_state *uts, int comp,
+			     const char *data, ulong data_len, ulong plain_len)
+{
+	ulong plain_size = sizeof(plain) - 1;
+	ulong size, load_end;
+	char *expected, *buf;
+	ulong i;
+
+	expected = malloc(plain_len);
+	buf = malloc(plain_len + 1);
+	ut_assertnonnull(expected);
+	ut_assertnonnull(buf);
+	for (i = 0; i < plain_len; i++)
+		expected[i] = plain[i % plain_size];
+
+	memset(buf, '\0', plain_len + 1);
+	ut_assertok(image_decomp_parallel(comp, buf, data, data_len,
+					  plain_len + 1, &size));
+	ut_asserteq(plain_len, size);
+	ut_assertok(memcmp(expected, buf, plain_len));
+	ut_asserteq(0, buf[plain_len]);
+
+	/* Too little space is left for the serial decompressor to report */
+	ut_asserteq(-ENOSYS, image_decomp_parallel(comp, buf, data, data_len,
+						   plain_len - 1, &size));
+
+	/* image_decomp() must produce the same output */
+	memset(buf, '\0', plain_len + 1);
+	ut_assertok(image_decomp(comp, 0, 1, IH_TYPE_KERNEL, buf, (void *)data,
+				 data_len, plain_len + 1, &load_end));
+	ut_asserteq(plain_len, load_end);
+	ut_assertok(memcmp(expected, buf, plain_len));
+
+	free(buf);
+	free(expected);
+
+	return 0;
+}
+
+static int compression_test_parallel_gzip(struct unit_test_state *uts)
+{
+	return run_parallel_test(uts, IH_COMP_GZIP, bgzf_members,
+				 bgzf_members_size, 30000);
+}
+COMPRESSION_TEST(compression_test_parallel_gzip, 0);
+
+static int compression_test_parallel_lz4(struct unit_test_state *uts)
+{
+	char buf[TEST_BUFFER_SIZE];
+	ulong size;
+
+	/* A single block cannot be split */
+	ut_asserteq(-ENOSYS, image_decomp_parallel(IH_COMP_LZ4, buf,
+						   lz4_compressed,
+						   lz4_compressed_size,
+						   sizeof(buf), &size));
+
+	return run_parallel_test(uts, IH_COMP_LZ4, lz4_blocks, lz4_blocks_size,
+				 150000);
+}
+COMPRESSION_TEST(compression_test_parallel_lz4, 0);
+
+static int compression_test_parallel_zstd(struct unit_test_state *uts)
+{
+	return run_parallel_test(uts, IH_COMP_ZSTD, zstd_frames,
+				 zstd_frames_size, 30000);
+}
+COMPRESSION_TEST(compression_test_parallel_zstd, 0);
+#endif
+
 int do_ut_compression(struct cmd_tbl *cmdtp, int flag, int argc,
 		      char *const argv[])
 {
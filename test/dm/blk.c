@@ -5,7 +5,10 @@
 
 #include <common.h>
 #include <dm.h>
+#include <os.h>
 #include <part.h>
+#include <sandboxblockdev.h>
+#include <time.h>
 #include <usb.h>
 #include <asm/state.h>
 #include <dm/test.h>
@@ -164,3 +167,240 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+/* Test the set-associative block cache */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	char data[16 * 512], buf[8 * 512];
+	void *ra_buf;
+	int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i / 512 + i;
+
+	/* Two sets of four entries, each of eight 512-byte blocks */
+	blkcache_configure_size(8, 8, 8 * 8 * 512);
+	blkcache_fill(IF_TYPE_HOST, 9, 0, 4, 512, data);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 0, 4, 512, buf));
+	ut_asserteq_mem(data, buf, 4 * 512);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 1, 2, 512, buf));
+	ut_asserteq_mem(data + 512, buf, 2 * 512);
+
+	/* Only part of the blocks are present, or on another device */
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 2, 4, 512, buf));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 8, 0, 4, 512, buf));
+
+	/* Reads may span entries */
+	blkcache_fill(IF_TYPE_HOST, 9, 4, 8, 512, data + 4 * 512);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 6, 6, 512, buf));
+	ut_asserteq_mem(data + 6 * 512, buf, 6 * 512);
+
+	blkcache_stats(&stats);
+	ut_asserteq(3, stats.hits);
+	ut_asserteq(2, stats.misses);
+	ut_asserteq(0, stats.evictions);
+	ut_asserteq(2, stats.entries);
+	ut_asserteq(2 * 8 * 512, stats.bytes);
+
+	/* Filling more entries than fit evicts the least recently used */
+	for (i = 0; i < 20; i++)
+		blkcache_fill(IF_TYPE_HOST, 9, 64 + i * 8, 1, 512, data);
+	blkcache_stats(&stats);
+	ut_asserteq(8, stats.entries);
+	ut_asserteq(14, stats.evictions);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 64 + 19 * 8, 1, 512,
+				     buf));
+
+	/*
+	 * The memory budget limits the entries too. The least recently used
+	 * entries go first, whichever set they are in
+	 */
+	blkcache_configure_size(8, 8, 3 * 8 * 512);
+	for (i = 0; i < 20; i++)
+		blkcache_fill(IF_TYPE_HOST, 9, i * 8, 1, 512, data);
+	blkcache_stats(&stats);
+	ut_asserteq(3, stats.entries);
+	ut_asserteq(3 * 8 * 512, stats.bytes);
+	ut_asserteq(17, stats.evictions);
+	for (i = 17; i < 20; i++)
+		ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, i * 8, 1, 512,
+					     buf));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 16 * 8, 1, 512, buf));
+
+	/* An entry with larger blocks evicts as many others as it needs */
+	blkcache_fill(IF_TYPE_HOST, 9, 0, 1, 1024, data);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 0, 1, 1024, buf));
+	ut_asserteq_mem(data, buf, 1024);
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.entries);
+	ut_asserteq(3 * 8 * 512, stats.bytes);
+	ut_asserteq(2, stats.evictions);
+
+	blkcache_invalidate(IF_TYPE_HOST, 9);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.entries);
+	ut_asserteq(0, stats.bytes);
+
+	/* Sequential reads are extended to the end of a read-ahead window */
+	blkcache_configure_size(8, 8, 8 * 8 * 512);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 0, 1, 512, buf));
+	ut_asserteq(0, blkcache_readahead(IF_TYPE_HOST, 9, 0, 1, 512, 16,
+					  &ra_buf));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 1, 1, 512, buf));
+	ut_asserteq(14, blkcache_readahead(IF_TYPE_HOST, 9, 1, 1, 512, 16,
+					   &ra_buf));
+	memcpy(ra_buf, data + 512, 15 * 512);
+	blkcache_fill(IF_TYPE_HOST, 9, 1, 15, 512, ra_buf);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 2, 8, 512, buf));
+	ut_asserteq_mem(data + 2 * 512, buf, 8 * 512);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.readaheads);
+
+	blkcache_configure_size(8, 256, CONFIG_BLOCK_CACHE_SIZE);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+#endif
+
+#define ASYNC_FILE	"blk_async.img"
+#define ASYNC_BLOCKS	32
+
+static u8 async_byte(int offset)
+{
+	return offset / 512 * 3 + offset;
+}
+
+static void async_complete(struct blk_req *req)
+{
+	int *order = req->priv;
+
+	/* Record the order in which requests finish, by tag */
+	*order = *order * 10 + req->tag;
+}
+
+/* Test asynchronous requests on a device which queues them */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	u8 data[ASYNC_BLOCKS * 512], buf[8 * 512];
+	struct blk_req req[3];
+	struct blk_sg sg[4];
+	struct udevice *dev;
+	int order = 0;
+	int fd, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = async_byte(i);
+	fd = os_open(ASYNC_FILE, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(data), os_write(fd, data, sizeof(data)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(0, ASYNC_FILE));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+
+	/* Requests take a second, but wait for it at the same time */
+	sandbox_host_set_latency(dev, 1000000, 1000);
+	memset(req, '\0', sizeof(req));
+	memset(buf, '\0', sizeof(buf));
+	for (i = 0; i < 3; i++) {
+		req[i].op = BLK_REQ_READ;
+		req[i].sg = &sg[i];
+		req[i].sg_count = 1;
+		req[i].tag = i + 1;
+		req[i].complete = async_complete;
+		req[i].priv = &order;
+		sg[i].buf = buf + i * 2 * 512;
+		sg[i].blkcnt = 2;
+	}
+	req[0].start = 4;
+	req[1].start = 20;
+	req[2].start = 8;
+	/* The last request is split over two buffers */
+	req[2].sg_count = 2;
+	sg[3].buf = buf + 6 * 512;
+	sg[3].blkcnt = 2;
+	for (i = 0; i < 3; i++)
+		ut_assertok(blk_submit(dev, &req[i]));
+
+	ut_asserteq(0, blk_poll(dev));
+	ut_asserteq(false, req[0].done);
+	timer_test_add_offset(1001);
+	ut_asserteq(3, blk_poll(dev));
+	ut_asserteq(123, order);
+	ut_asserteq(2, req[0].result);
+	ut_asserteq(2, req[1].result);
+	ut_asserteq(4, req[2].result);
+	ut_asserteq_mem(data + 4 * 512, buf, 2 * 512);
+	ut_asserteq_mem(data + 20 * 512, buf + 2 * 512, 2 * 512);
+	ut_asserteq_mem(data + 8 * 512, buf + 4 * 512, 4 * 512);
+
+	/* Write some blocks and read them back */
+	sandbox_host_set_latency(dev, 0, 0);
+	memset(buf, 0xa5, 512);
+	req[0].op = BLK_REQ_WRITE;
+	req[0].start = 31;
+	req[0].sg_count = 1;
+	sg[0].blkcnt = 1;
+	ut_assertok(blk_submit(dev, &req[0]));
+	ut_asserteq(1, blk_wait(dev, &req[0], 1000));
+	memset(buf, '\0', 512);
+	req[0].op = BLK_REQ_READ;
+	ut_assertok(blk_submit(dev, &req[0]));
+	ut_asserteq(1, blk_wait(dev, &req[0], 1000));
+	memset(data, 0xa5, 512);
+	ut_asserteq_mem(data, buf, 512);
+
+	/* Requests beyond the end of the device are refused */
+	req[0].start = ASYNC_BLOCKS;
+	ut_asserteq(-EINVAL, blk_submit(dev, &req[0]));
+
+	/* Removing the device finishes any request still in flight */
+	sandbox_host_set_latency(dev, 1000000, 0);
+	req[0].start = 0;
+	ut_assertok(blk_submit(dev, &req[0]));
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_asserteq(true, req[0].done);
+	ut_asserteq(-ENODEV, req[0].result);
+	ut_assertok(os_unlink(ASYNC_FILE));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test asynchronous requests on a device which cannot queue them */
+static int dm_test_blk_async_sync(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct blk_req req;
+	struct blk_sg sg[2];
+	char buf[1024];
+	int order = 0;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	memset(buf, '\0', sizeof(buf));
+	memset(&req, '\0', sizeof(req));
+	req.op = BLK_REQ_READ;
+	req.sg = sg;
+	req.sg_count = 2;
+	req.tag = 7;
+	req.complete = async_complete;
+	req.priv = &order;
+	sg[0].buf = buf;
+	sg[0].blkcnt = 1;
+	sg[1].buf = buf + 512;
+	sg[1].blkcnt = 1;
+
+	/* The request is finished before blk_submit() returns */
+	ut_assertok(blk_submit(dev_desc->bdev, &req));
+	ut_asserteq(true, req.done);
+	ut_asserteq(7, order);
+	ut_asserteq(2, req.result);
+	ut_assertok(strcmp(buf, "this is a test"));
+	ut_asserteq(0, blk_poll(dev_desc->bdev));
+	ut_asserteq(2, blk_wait(dev_desc->bdev, &req, 0));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async_sync, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -12,6 +12,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
@@ -906,3 +907,142 @@ static int dm_test_inactive_child(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_inactive_child, UT_TESTF_SCAN_PDATA);
+
+/* Check that driver lookups find the first matching driver in the list */
+static int dm_test_lists_lookup(struct unit_test_state *uts)
+{
+	struct driver *drv = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct uclass_driver *uclass =
+		ll_entry_start(struct uclass_driver, uclass);
+	const int n_uc = ll_entry_count(struct uclass_driver, uclass);
+	struct uclass_driver *uc, *found;
+	const struct udevice_id *of_id, *id;
+	struct driver *entry, *first;
+
+	for (entry = drv; entry != drv + n_ents; entry++) {
+		first = lists_driver_lookup_name(entry->name);
+		ut_assertnonnull(first);
+		ut_assert(first <= entry);
+		ut_asserteq_str(entry->name, first->name);
+
+		for (of_id = entry->of_match; of_id && of_id->compatible;
+		     of_id++) {
+			first = lists_driver_lookup_compat(of_id->compatible,
+							   &id);
+			ut_assertnonnull(first);
+			ut_assert(first <= entry);
+			ut_asserteq_str(of_id->compatible, id->compatible);
+			if (first == entry)
+				ut_asserteq_ptr(of_id, id);
+		}
+	}
+	ut_assertnull(lists_driver_lookup_name("no-such-driver"));
+	ut_assertnull(lists_driver_lookup_compat("no-such,compat", &id));
+
+	for (uc = uclass; uc != uclass + n_uc; uc++) {
+		found = lists_uclass_lookup(uc->id);
+		ut_assertnonnull(found);
+		ut_asserteq(uc->id, found->id);
+		ut_assert(found <= uc);
+	}
+	ut_asserteq_str("test", lists_uclass_lookup(UCLASS_TEST)->name);
+
+	return 0;
+}
+DM_TEST(dm_test_lists_lookup, 0);
+
+/* Check that devices are found after their keys change */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *parent, *dev1, *dev2, *dev;
+	char name[20];
+	ofnode node;
+	int i, seq;
+
+	/* Skip the behaviour in test_post_probe() */
+	dms->skip_post_probe = 1;
+	ut_assertok(uclass_first_device_err(UCLASS_TEST, &parent));
+
+	/* Devices with the same name are found in the order they are bound */
+	ut_assertok(device_bind_ofnode(parent, DM_GET_DRIVER(test_drv), "idx",
+				       0, ofnode_null(), &dev1));
+	ut_assertok(device_bind_ofnode(parent, DM_GET_DRIVER(test_drv), "idx",
+				       0, ofnode_null(), &dev2));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "idx", &dev));
+	ut_asserteq_ptr(dev1, dev);
+
+	ut_assertok(device_set_name(dev1, "idx-renamed"));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "idx-renamed",
+					       &dev));
+	ut_asserteq_ptr(dev1, dev);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "idx", &dev));
+	ut_asserteq_ptr(dev2, dev);
+
+	node = ofnode_path("/some-bus");
+	ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST, node,
+							  &dev));
+	dev_set_ofnode(dev2, node);
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node, &dev));
+	ut_asserteq_ptr(dev2, dev);
+
+	/* Sequence numbers are only found while the device is probed */
+	ut_assertok(device_probe(dev2));
+	seq = dev2->seq;
+	ut_assert(seq >= 0);
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, seq, false, &dev));
+	ut_asserteq_ptr(dev2, dev);
+	ut_assertok(device_remove(dev2, DM_REMOVE_NORMAL));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, seq,
+						       false, &dev));
+
+	ut_assertok(device_unbind(dev2));
+	ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST, node,
+							  &dev));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "idx-renamed",
+					       &dev));
+
+	/* Enough devices for the tables to grow */
+	for (i = 0; i < 40; i++) {
+		snprintf(name, sizeof(name), "idx%d", i);
+		ut_assertok(device_bind_ofnode(parent,
+					       DM_GET_DRIVER(test_drv), "idx",
+					       0, ofnode_null(), &dev));
+		ut_assertok(device_set_name(dev, name));
+	}
+	for (i = 0; i < 40; i++) {
+		snprintf(name, sizeof(name), "idx%d", i);
+		ut_assertok(uclass_find_device_by_name(UCLASS_TEST, name,
+						       &dev));
+		ut_asserteq_str(name, dev->name);
+	}
+
+	/* Renaming the only device in a uclass keeps its other keys */
+	node = ofnode_path("/some-bus");
+	ut_assertok(device_bind_ofnode(dm_root(), DM_GET_DRIVER(fdt_dummy_drv),
+				       "idx-dummy", NULL, node, &dev1));
+	ut_assertok(device_probe(dev1));
+	ut_assertok(device_set_name(dev1, "idx-dummy-renamed"));
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST_DUMMY, node,
+						 &dev));
+	ut_asserteq_ptr(dev1, dev);
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_DUMMY, dev1->seq,
+					      false, &dev));
+	ut_asserteq_ptr(dev1, dev);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST_DUMMY,
+					       "idx-dummy-renamed", &dev));
+	ut_asserteq_ptr(dev1, dev);
+
+	/* The uclass can be used again once its last device is unbound */
+	ut_assertok(device_remove(dev1, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev1));
+	ut_assertok(device_bind_ofnode(dm_root(), DM_GET_DRIVER(fdt_dummy_drv),
+				       "idx-dummy", NULL, node, &dev1));
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST_DUMMY, node,
+						 &dev));
+	ut_asserteq_ptr(dev1, dev);
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, UT_TESTF_SCAN_PDATA);
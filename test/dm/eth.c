@@ -431,3 +431,57 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, UT_TESTF_SCAN_FDT);
+
+static int sb_count_arp_reply(struct udevice *dev, void *packet,
+			      unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct arp_hdr *arp = packet + ETHER_HDR_SIZE;
+	int *count = priv->priv;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP &&
+	    ntohs(arp->ar_op) == ARPOP_REPLY)
+		(*count)++;
+
+	return 0;
+}
+
+/* Check that RX buffers are handed back in order, while others are queued */
+static int dm_test_eth_rx_ring(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	struct udevice *dev;
+	int count = 0;
+	int i, j;
+
+	sandbox_eth_set_tx_handler(0, sb_count_arp_reply);
+	sandbox_eth_set_priv(0, &count);
+	env_set("ethact", "eth@10002000");
+	net_init();
+	ut_assertok(eth_init());
+	dev = eth_get_dev();
+	priv = dev_get_priv(dev);
+	net_ip = string_to_ip("1.1.2.2");
+	priv->fake_host_ipaddr = string_to_ip("1.1.2.4");
+
+	/* Wrap around the ring several times, with varying fill levels */
+	for (i = 0; i < PKTBUFSRX * 3; i++) {
+		for (j = 0; j <= i % PKTBUFSRX; j++)
+			ut_assertok(sandbox_eth_recv_arp_req(dev));
+		if (j == PKTBUFSRX)
+			ut_asserteq(-EOVERFLOW, sandbox_eth_recv_arp_req(dev));
+		ut_asserteq(j, priv->recv_packets);
+		ut_assertok(eth_rx());
+		ut_asserteq(0, priv->recv_packets);
+	}
+	ut_asserteq(PKTBUFSRX * (PKTBUFSRX + 1) / 2 * 3, count);
+
+	eth_halt();
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+
+	return 0;
+}
+
+DM_TEST(dm_test_eth_rx_ring, UT_TESTF_SCAN_FDT);
@@ -0,0 +1,350 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the NFS client, against a fake NFSv2/NFSv3 server
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <env.h>
+#include <image.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/eth.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include "../../net/nfs.h"
+
+#define SB_NFS_PROG_PORTMAP	100000
+#define SB_NFS_PROG_NFS		100003
+#define SB_NFS_PROG_MOUNT	100005
+#define SB_NFS_PORT		2049
+#define SB_NFS_MOUNT_PORT	635
+
+#define SB_NFS_PROG_MISMATCH	2
+#define SB_NFS3_LOOKUP		3
+#define SB_NFS_READ		6
+#define SB_NFS_FATTR_WORDS	17
+#define SB_NFS3_FATTR_WORDS	21
+#define SB_NFS_FHSIZE		32
+
+#define SB_NFS_FILE_SIZE	10001
+#define SB_NFS_LOAD_ADDR	0x1000000
+
+/**
+ * struct sb_nfs_server - State of the fake NFS server
+ *
+ * @held: Reply to a READ which is sent after the reply to the next one
+ * @held_len: Length of @held, 0 if there is none
+ * @drop_offset: Offset of a READ whose first reply is lost, -1 for none
+ * @short_offset: Offset of a READ which is first answered with half the
+ *	data asked for, without EOF (NFSv3 only), -1 for none
+ * @v3: Refuse NFSv2, so that the client moves to NFSv3
+ * @reads: Number of READ requests seen
+ * @rsize: Size asked for by the last READ
+ * @vers: NFS version of the last READ
+ * @swapped: Number of READ replies sent out of order
+ * @shorts: Number of short READ replies sent
+ */
+struct sb_nfs_server {
+	uchar held[PKTSIZE_ALIGN];
+	int held_len;
+	int drop_offset;
+	int short_offset;
+	bool v3;
+	int reads;
+	uint rsize;
+	int vers;
+	int swapped;
+	int shorts;
+};
+
+static u8 sb_nfs_file_byte(uint offset)
+{
+	return offset * 7 + (offset >> 8);
+}
+
+/* Skip the credential and verifier of an RPC call */
+static u32 *sb_nfs_skip_auth(u32 *p)
+{
+	int i;
+
+	for (i = 0; i < 2; i++)
+		p += 2 + ntohl(p[1]) / sizeof(u32);
+
+	return p;
+}
+
+/* Queue a received packet as the server's reply, if there is room */
+static void sb_nfs_inject(struct udevice *dev, const void *pkt, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int slot;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+	slot = (priv->recv_packet_first + priv->recv_packets) % PKTBUFSRX;
+	memcpy(priv->recv_packet_buffer[slot], pkt, len);
+	priv->recv_packet_length[slot] = len;
+	priv->recv_packets++;
+}
+
+/*
+ * Build the reply to the RPC call in @packet, in @reply. Returns its length,
+ * or 0 if the call is not for the server
+ */
+static int sb_nfs_reply(struct sb_nfs_server *srv, struct udevice *dev,
+			void *packet, uchar *reply, bool *hold)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ip_udp_hdr *ipr = (void *)reply + ETHER_HDR_SIZE;
+	u32 *call = (void *)ip + IP_UDP_HDR_SIZE;
+	u32 *data = (void *)ipr + IP_UDP_HDR_SIZE;
+	u32 *args = sb_nfs_skip_auth(call + 6);
+	u32 *p = data + 6;
+	uint prog = ntohl(call[3]);
+	uint vers = ntohl(call[4]);
+	uint proc = ntohl(call[5]);
+	uint offset, count, i;
+	bool eof;
+	u8 *bytes;
+	int len;
+
+	*hold = false;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	/* RPC reply header: accepted, no verifier */
+	memset(data, '\0', 6 * sizeof(u32));
+	data[0] = call[0];
+	data[1] = htonl(1);
+
+	switch (prog) {
+	case SB_NFS_PROG_PORTMAP:
+		*p++ = htonl(ntohl(args[0]) == SB_NFS_PROG_MOUNT ?
+			     SB_NFS_MOUNT_PORT : SB_NFS_PORT);
+		break;
+	case SB_NFS_PROG_MOUNT:
+		if (proc == 1) {
+			*p++ = 0;
+			memset(p, 0x55, SB_NFS_FHSIZE);
+			p += SB_NFS_FHSIZE / sizeof(u32);
+		}
+		break;
+	case SB_NFS_PROG_NFS:
+		if (vers == 2 && srv->v3) {
+			/* Accepted, but only NFSv3 is supported */
+			data[5] = htonl(SB_NFS_PROG_MISMATCH);
+			*p++ = htonl(3);
+			*p++ = htonl(3);
+			break;
+		}
+		/* Status, then a file handle (LOOKUP) and the attributes */
+		*p++ = 0;
+		if (vers == 3 && proc == SB_NFS3_LOOKUP) {
+			*p++ = htonl(SB_NFS_FHSIZE);
+			memset(p, 0xaa, SB_NFS_FHSIZE);
+			p += SB_NFS_FHSIZE / sizeof(u32);
+			*p++ = 0;	/* no object attributes */
+			*p++ = 0;	/* no directory attributes */
+			break;
+		}
+		if (vers == 3) {
+			*p++ = htonl(1);	/* attributes follow */
+			memset(p, '\0', SB_NFS3_FATTR_WORDS * sizeof(u32));
+			p[0] = htonl(1);	/* NF3REG */
+			p[6] = htonl(SB_NFS_FILE_SIZE);
+			p += SB_NFS3_FATTR_WORDS;
+		} else {
+			if (proc != SB_NFS_READ) {
+				memset(p, 0xaa, SB_NFS_FHSIZE);
+				p += SB_NFS_FHSIZE / sizeof(u32);
+			}
+			memset(p, '\0', SB_NFS_FATTR_WORDS * sizeof(u32));
+			p[0] = htonl(1);	/* NFREG */
+			p[4] = htonl(SB_NFS_FILE_SIZE);
+			p += SB_NFS_FATTR_WORDS;
+		}
+		if (proc != SB_NFS_READ)
+			break;
+
+		/* NFSv3 has a handle length and a 64-bit offset */
+		if (vers == 3)
+			args += 2;
+		offset = ntohl(args[SB_NFS_FHSIZE / sizeof(u32)]);
+		count = ntohl(args[SB_NFS_FHSIZE / sizeof(u32) + 1]);
+		srv->rsize = count;
+		srv->vers = vers;
+		if (offset >= SB_NFS_FILE_SIZE)
+			count = 0;
+		else
+			count = min(count, SB_NFS_FILE_SIZE - offset);
+		eof = offset + count >= SB_NFS_FILE_SIZE;
+		if (vers == 3 && offset == srv->short_offset) {
+			srv->short_offset = -1;
+			srv->shorts++;
+			count /= 2;
+			eof = false;
+		}
+		*p++ = htonl(count);
+		if (vers == 3) {
+			*p++ = htonl(eof);
+			*p++ = htonl(count);
+		}
+		bytes = (u8 *)p;
+		for (i = 0; i < count; i++)
+			bytes[i] = sb_nfs_file_byte(offset + i);
+		p += DIV_ROUND_UP(count, sizeof(u32));
+
+		srv->reads++;
+		if (offset == srv->drop_offset) {
+			srv->drop_offset = -1;
+			sandbox_eth_skip_timeout();
+			return 0;
+		}
+		/*
+		 * Hold back a reply while the client has others to handle, so
+		 * that it sends another request to release this one
+		 */
+		*hold = !srv->held_len && priv->recv_packets > 1 &&
+			offset + count < SB_NFS_FILE_SIZE;
+		break;
+	default:
+		return 0;
+	}
+
+	len = (uchar *)p - (uchar *)data;
+	memcpy(reply, eth->et_src, ARP_HLEN);
+	memcpy(reply + ARP_HLEN, priv->fake_host_hwaddr, ARP_HLEN);
+	((struct ethernet_hdr *)reply)->et_protlen = htons(PROT_IP);
+	net_set_udp_header((uchar *)ipr, net_ip, ntohs(ip->udp_src),
+			   ntohs(ip->udp_dst), len);
+	net_copy_ip(&ipr->ip_src, &ip->ip_dst);
+	ipr->ip_sum = 0;
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+
+	return ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+}
+
+static int sb_nfs_handler(struct udevice *dev, void *packet, unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_nfs_server *srv = priv->priv;
+	uchar reply[PKTSIZE_ALIGN];
+	bool hold;
+	int rlen;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	rlen = sb_nfs_reply(srv, dev, packet, reply, &hold);
+	if (hold) {
+		memcpy(srv->held, reply, rlen);
+		srv->held_len = rlen;
+		return 0;
+	}
+	if (rlen)
+		sb_nfs_inject(dev, reply, rlen);
+	if (srv->held_len) {
+		sb_nfs_inject(dev, srv->held, srv->held_len);
+		srv->held_len = 0;
+		srv->swapped++;
+	}
+
+	return 0;
+}
+
+static int sb_nfs_load(struct unit_test_state *uts, struct sb_nfs_server *srv)
+{
+	u8 *buf;
+	int ret, i;
+
+	sandbox_eth_set_tx_handler(0, sb_nfs_handler);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	env_set("nfsrsize", "1024");
+	env_set("nfswindowsize", "3");
+	net_server_ip = string_to_ip("1.1.2.4");
+	image_load_addr = SB_NFS_LOAD_ADDR;
+	buf = map_sysmem(SB_NFS_LOAD_ADDR, SB_NFS_FILE_SIZE);
+	memset(buf, '\0', SB_NFS_FILE_SIZE);
+	copy_filename(net_boot_file_name, "/export/file",
+		      sizeof(net_boot_file_name));
+
+	ret = net_loop(NFS);
+
+	/* Leave nothing behind for later tests, whatever the outcome */
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	env_set("nfsrsize", NULL);
+	env_set("nfswindowsize", NULL);
+
+	ut_asserteq(SB_NFS_FILE_SIZE, ret);
+	ut_asserteq(SB_NFS_FILE_SIZE, net_boot_file_size);
+	for (i = 0; i < SB_NFS_FILE_SIZE; i++)
+		ut_asserteq(sb_nfs_file_byte(i), buf[i]);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+/* Check that pipelined READ replies are stored where they belong */
+static int dm_test_nfs_read_window(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = { .drop_offset = -1, .short_offset = -1 };
+
+	ut_assertok(sb_nfs_load(uts, &srv));
+	ut_asserteq(2, srv.vers);
+	ut_assert(srv.swapped > 0);
+	/* One request per 1KB, plus those beyond the end of the file */
+	ut_assert(srv.reads >= DIV_ROUND_UP(SB_NFS_FILE_SIZE, 1024));
+	ut_assert(srv.reads <= DIV_ROUND_UP(SB_NFS_FILE_SIZE, 1024) + 3);
+
+	return 0;
+}
+
+DM_TEST(dm_test_nfs_read_window, UT_TESTF_SCAN_FDT);
+
+/* Check that a READ reply lost in the middle of a window is asked for again */
+static int dm_test_nfs_read_lost(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = { .drop_offset = 4096, .short_offset = -1 };
+
+	ut_assertok(sb_nfs_load(uts, &srv));
+	ut_asserteq(2, srv.vers);
+	ut_asserteq(-1, srv.drop_offset);
+	/* Only the lost request is sent again, with at most a window more */
+	ut_assert(srv.reads > DIV_ROUND_UP(SB_NFS_FILE_SIZE, 1024));
+	ut_assert(srv.reads <= DIV_ROUND_UP(SB_NFS_FILE_SIZE, 1024) + 4);
+
+	return 0;
+}
+
+DM_TEST(dm_test_nfs_read_lost, UT_TESTF_SCAN_FDT);
+
+/*
+ * Check that the rest of a short NFSv3 READ is asked for, and that smaller
+ * requests are used from then on
+ */
+static int dm_test_nfs_v3_short_read(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = {
+		.drop_offset = -1, .short_offset = 2048, .v3 = true
+	};
+	int ret;
+
+	ret = sb_nfs_load(uts, &srv);
+	/* The client stays with NFSv3 once it has moved to it */
+	nfs_reset_versions();
+	ut_assertok(ret);
+	ut_asserteq(3, srv.vers);
+	ut_asserteq(1, srv.shorts);
+	ut_asserteq(-1, srv.short_offset);
+	ut_asserteq(512, srv.rsize);
+
+	return 0;
+}
+
+DM_TEST(dm_test_nfs_v3_short_read, UT_TESTF_SCAN_FDT);
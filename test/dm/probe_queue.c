@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for deferred and background probing of devices
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <dm/device-internal.h>
+#include <dm/probe-queue.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <dm/uclass-internal.h>
+#include <test/ut.h>
+
+/**
+ * struct pq_test_plat - Behaviour of a test device while probing
+ *
+ * @polls: Number of times probe_poll() is called before it is done, 0 to
+ *	probe straight away
+ * @err: Value returned by probe_poll() when it is done
+ */
+struct pq_test_plat {
+	int polls;
+	int err;
+};
+
+static int pq_test_removed;
+
+static int pq_test_probe(struct udevice *dev)
+{
+	struct pq_test_plat *plat = dev_get_platdata(dev);
+	int *polls = dev_get_priv(dev);
+
+	*polls = plat->polls;
+
+	return *polls ? -EINPROGRESS : 0;
+}
+
+static int pq_test_probe_poll(struct udevice *dev)
+{
+	struct pq_test_plat *plat = dev_get_platdata(dev);
+	int *polls = dev_get_priv(dev);
+
+	if (--*polls)
+		return -EINPROGRESS;
+
+	return plat->err;
+}
+
+static int pq_test_remove(struct udevice *dev)
+{
+	pq_test_removed++;
+
+	return 0;
+}
+
+U_BOOT_DRIVER(probe_queue_test) = {
+	.name	= "probe_queue_test",
+	.id	= UCLASS_TEST_DUMMY,
+	.probe	= pq_test_probe,
+	.probe_poll	= pq_test_probe_poll,
+	.remove	= pq_test_remove,
+	.priv_auto_alloc_size	= sizeof(int),
+};
+
+static int pq_test_bind(struct unit_test_state *uts, const char *name,
+			struct pq_test_plat *plat, struct udevice **devp)
+{
+	ut_assertok(device_bind(dm_root(), DM_GET_DRIVER(probe_queue_test),
+				name, plat, -1, devp));
+
+	return 0;
+}
+
+/* Test that devices in the probe queue finish probing together */
+static int dm_test_probe_queue(struct unit_test_state *uts)
+{
+	struct pq_test_plat plat_a = { .polls = 3 };
+	struct pq_test_plat plat_b = { .polls = 5 };
+	struct pq_test_plat plat_c = { .polls = 2, .err = -ETIMEDOUT };
+	struct pq_test_plat plat_d = { .polls = 2 };
+	struct pq_test_plat plat_e = { .polls = 0 };
+	struct udevice *a, *b, *c, *d, *e;
+	int *polls;
+
+	ut_assertok(pq_test_bind(uts, "slow-a", &plat_a, &a));
+	ut_assertok(pq_test_bind(uts, "slow-b", &plat_b, &b));
+	ut_assertok(pq_test_bind(uts, "slow-c", &plat_c, &c));
+	ut_assertok(pq_test_bind(uts, "slow-d", &plat_d, &d));
+	ut_assertok(pq_test_bind(uts, "fast-e", &plat_e, &e));
+
+	ut_assertok(device_probe_start(a));
+	ut_assertok(device_probe_start(b));
+	ut_assertok(device_probe_start(c));
+	ut_assert(device_active(a));
+	ut_assert(a->flags & DM_FLAG_PROBE_PENDING);
+
+	/* Starting again does nothing */
+	ut_assertok(device_probe_start(a));
+	polls = dev_get_priv(a);
+	ut_asserteq(3, *polls);
+
+	ut_asserteq(3, dm_probe_queue_poll());
+
+	/* The failed device is dropped from the queue */
+	ut_asserteq(2, dm_probe_queue_poll());
+	ut_assert(!device_active(c));
+	ut_assertnull(dev_get_priv(c));
+
+	ut_asserteq(1, dm_probe_queue_poll());
+	ut_assert(device_active(a));
+	ut_assert(!(a->flags & DM_FLAG_PROBE_PENDING));
+
+	/* Waiting for a device polls it until it is done */
+	ut_assertok(device_probe(b));
+	ut_assert(!(b->flags & DM_FLAG_PROBE_PENDING));
+	ut_asserteq(0, dm_probe_queue_poll());
+
+	/* A device which fails to probe in the background can be retried */
+	plat_c.err = 0;
+	ut_assertok(device_probe(c));
+	ut_assert(device_active(c));
+
+	/* Removing a device which is probing stops it */
+	pq_test_removed = 0;
+	ut_assertok(device_probe_start(d));
+	ut_assertok(device_remove(d, DM_REMOVE_NORMAL));
+	ut_asserteq(1, pq_test_removed);
+	ut_assert(!device_active(d));
+	ut_asserteq(0, dm_probe_queue_poll());
+
+	/* Drivers may still probe straight away */
+	ut_assertok(device_probe_start(e));
+	ut_assert(device_active(e));
+	ut_assert(!(e->flags & DM_FLAG_PROBE_PENDING));
+
+	/* Flushing the queue waits for everything in it */
+	ut_assertok(device_probe_start(d));
+	ut_asserteq(1, dm_probe_queue_poll());
+	ut_assertok(dm_probe_queue_flush());
+	ut_assert(device_active(d));
+	ut_asserteq(0, dm_probe_queue_poll());
+
+	return 0;
+}
+
+DM_TEST(dm_test_probe_queue, 0);
+
+/* Test that uclasses can be left to probe on first use */
+static int dm_test_probe_deferred(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+
+	/* test.dts lists "fdt-dummy" in u-boot,defer-probe */
+	ut_assert(dm_probe_deferred(UCLASS_TEST_DUMMY));
+	ut_assert(!dm_probe_deferred(UCLASS_TEST_FDT));
+
+	ut_assertok(dm_probe_uclass(UCLASS_TEST_DUMMY));
+	ut_assertok(uclass_find_first_device(UCLASS_TEST_DUMMY, &dev));
+	ut_assertnonnull(dev);
+	ut_assert(!device_active(dev));
+
+	dm_probe_uclass(UCLASS_TEST_FDT);
+	ut_assertok(uclass_find_first_device(UCLASS_TEST_FDT, &dev));
+	ut_assertnonnull(dev);
+	ut_assert(device_active(dev));
+
+	return 0;
+}
+
+DM_TEST(dm_test_probe_deferred, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the TFTP client, against a fake server which loses packets
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <env.h>
+#include <image.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/eth.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define SB_TFTP_PORT		69
+#define SB_TFTP_RRQ		1
+#define SB_TFTP_DATA		3
+#define SB_TFTP_ACK		4
+#define SB_TFTP_OACK		6
+
+#define SB_TFTP_BLOCK_SIZE	512
+#define SB_TFTP_WINDOW		2
+#define SB_TFTP_FILE_SIZE	(16 * SB_TFTP_BLOCK_SIZE + 100)
+#define SB_TFTP_BLOCKS		DIV_ROUND_UP(SB_TFTP_FILE_SIZE, \
+					     SB_TFTP_BLOCK_SIZE)
+#define SB_TFTP_LOAD_ADDR	0x1000000
+
+/**
+ * struct sb_tftp_server - State of the fake TFTP server
+ *
+ * @window: Window size agreed with the client
+ * @drop: Bitmap of the blocks which are lost the first time they are sent
+ * @drop_ack: ACK which is lost the first time it is received, 0 for none
+ * @last_ack: Last ACK received
+ * @sent: Number of data blocks sent
+ * @reack_queued: The ACK lost through @drop_ack was sent again while the
+ *	window sent in its place was still being received
+ */
+struct sb_tftp_server {
+	int window;
+	ulong drop;
+	int drop_ack;
+	int last_ack;
+	int sent;
+	bool reack_queued;
+};
+
+static u8 sb_tftp_file_byte(uint offset)
+{
+	return offset * 13 + (offset >> 9);
+}
+
+/* Send a packet with @len bytes of TFTP data from @data to the client */
+static void sb_tftp_send(struct udevice *dev, void *request, const void *data,
+			 int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = request;
+	struct ip_udp_hdr *ip = request + ETHER_HDR_SIZE;
+	struct ip_udp_hdr *ipr;
+	uchar *reply;
+	int slot;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+	slot = (priv->recv_packet_first + priv->recv_packets) % PKTBUFSRX;
+	reply = priv->recv_packet_buffer[slot];
+	ipr = (void *)reply + ETHER_HDR_SIZE;
+
+	memcpy(reply, eth->et_src, ARP_HLEN);
+	memcpy(reply + ARP_HLEN, priv->fake_host_hwaddr, ARP_HLEN);
+	((struct ethernet_hdr *)reply)->et_protlen = htons(PROT_IP);
+	memcpy((uchar *)ipr + IP_UDP_HDR_SIZE, data, len);
+	net_set_udp_header((uchar *)ipr, net_ip, ntohs(ip->udp_src),
+			   SB_TFTP_PORT, len);
+	net_copy_ip(&ipr->ip_src, &ip->ip_dst);
+	ipr->ip_sum = 0;
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+
+	priv->recv_packet_length[slot] = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	priv->recv_packets++;
+}
+
+/* Send the window of blocks following @ack, less those which are lost */
+static void sb_tftp_send_window(struct udevice *dev, void *request,
+				struct sb_tftp_server *srv, int ack)
+{
+	uchar data[4 + SB_TFTP_BLOCK_SIZE];
+	uint offset, len, i;
+	int block;
+
+	for (block = ack + 1;
+	     block <= min(ack + srv->window, SB_TFTP_BLOCKS); block++) {
+		srv->sent++;
+		if (srv->drop & BIT(block)) {
+			srv->drop &= ~BIT(block);
+			continue;
+		}
+		offset = (block - 1) * SB_TFTP_BLOCK_SIZE;
+		len = min_t(uint, SB_TFTP_BLOCK_SIZE, SB_TFTP_FILE_SIZE - offset);
+		*(__be16 *)data = htons(SB_TFTP_DATA);
+		*(__be16 *)(data + 2) = htons(block);
+		for (i = 0; i < len; i++)
+			data[4 + i] = sb_tftp_file_byte(offset + i);
+		sb_tftp_send(dev, request, data, 4 + len);
+	}
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	char *req = (void *)ip + IP_UDP_HDR_SIZE;
+	char *end = (void *)ip + ntohs(ip->ip_len);
+	char oack[32], *p;
+	int ack;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	switch (ntohs(*(__be16 *)req)) {
+	case SB_TFTP_RRQ:
+		/* Agree to the window size asked for, up to our own */
+		srv->window = 1;
+		for (p = req + 2; p < end; p += strlen(p) + 1) {
+			if (!strcmp(p, "windowsize") && p + 11 < end)
+				srv->window = min((int)simple_strtoul(p + 11,
+								      NULL, 10),
+						  SB_TFTP_WINDOW);
+		}
+		*(__be16 *)oack = htons(SB_TFTP_OACK);
+		len = 2 + sprintf(oack + 2, "windowsize%c%d", 0, srv->window);
+		sb_tftp_send(dev, packet, oack, len + 1);
+		break;
+	case SB_TFTP_ACK:
+		ack = ntohs(*(__be16 *)(req + 2));
+		if (ack == srv->drop_ack) {
+			/* Time out and send the last window again */
+			srv->drop_ack = -ack;
+			sb_tftp_send_window(dev, packet, srv, srv->last_ack);
+			break;
+		}
+		if (ack == -srv->drop_ack) {
+			srv->reack_queued = priv->recv_packets > 1;
+			srv->drop_ack = 0;
+		}
+		srv->last_ack = ack;
+		sb_tftp_send_window(dev, packet, srv, ack);
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_tftp_load(struct unit_test_state *uts,
+			struct sb_tftp_server *srv)
+{
+	u8 *buf;
+	int i;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	env_set("tftpwindowsize", simple_itoa(SB_TFTP_WINDOW));
+	net_server_ip = string_to_ip("1.1.2.4");
+	image_load_addr = SB_TFTP_LOAD_ADDR;
+	buf = map_sysmem(SB_TFTP_LOAD_ADDR, SB_TFTP_FILE_SIZE);
+	memset(buf, '\0', SB_TFTP_FILE_SIZE);
+	copy_filename(net_boot_file_name, "file", sizeof(net_boot_file_name));
+
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPGET));
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_boot_file_size);
+	for (i = 0; i < SB_TFTP_FILE_SIZE; i++)
+		ut_asserteq(sb_tftp_file_byte(i), buf[i]);
+	unmap_sysmem(buf);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	env_set("tftpwindowsize", NULL);
+
+	return 0;
+}
+
+/* Check that lost blocks are asked for again, and nothing else */
+static int dm_test_tftp_lost_block(struct unit_test_state *uts)
+{
+	/* The first block of a window, then the last one of another */
+	struct sb_tftp_server srv = { .drop = BIT(5) | BIT(10) };
+
+	ut_assertok(sb_tftp_load(uts, &srv));
+	ut_asserteq(SB_TFTP_WINDOW, srv.window);
+	ut_asserteq(0, srv.drop);
+	/* Each loss costs at most one window sent again */
+	ut_assert(srv.sent <= SB_TFTP_BLOCKS + 2 * SB_TFTP_WINDOW);
+
+	return 0;
+}
+
+DM_TEST(dm_test_tftp_lost_block, UT_TESTF_SCAN_FDT);
+
+/* Check that a window sent again after a lost ACK is ACKed straight away */
+static int dm_test_tftp_lost_ack(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv = { .drop_ack = 6 };
+
+	ut_assertok(sb_tftp_load(uts, &srv));
+	ut_asserteq(SB_TFTP_WINDOW, srv.window);
+	ut_asserteq(0, srv.drop_ack);
+	ut_assert(srv.reack_queued);
+	ut_assert(srv.sent <= SB_TFTP_BLOCKS + SB_TFTP_WINDOW);
+
+	return 0;
+}
+
+DM_TEST(dm_test_tftp_lost_ack, UT_TESTF_SCAN_FDT);
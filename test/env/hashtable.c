@@ -9,11 +9,13 @@
 #include <log.h>
 #include <search.h>
 #include <stdio.h>
+#include <time.h>
 #include <test/env.h>
 #include <test/ut.h>
 
 #define SIZE 32
 #define ITERATIONS 10000
+#define BENCH_SIZE 10000
 
 static int htab_fill(struct unit_test_state *uts,
 		     struct hsearch_data *htab, size_t size)
@@ -86,6 +88,29 @@ static int htab_create_delete(struct unit_test_state *uts,
 	return 0;
 }
 
+/* Check that the hash table exports "count" entries sorted by key */
+static int htab_check_export(struct unit_test_state *uts,
+			     struct hsearch_data *htab, size_t count)
+{
+	char *res = NULL;
+	char *p, *next, *prev = NULL;
+	size_t n = 0;
+
+	ut_assert(hexport_r(htab, '\0', 0, &res, 0, 0, NULL) > 0);
+	for (p = res; *p; p = next) {
+		next = p + strlen(p) + 1;
+		*strchr(p, '=') = '\0';
+		if (prev)
+			ut_assert(strcmp(prev, p) < 0);
+		prev = p;
+		n++;
+	}
+	free(res);
+	ut_asserteq(count, n);
+
+	return 0;
+}
+
 /* Completely fill up the hash table */
 static int env_test_htab_fill(struct unit_test_state *uts)
 {
@@ -124,3 +149,60 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 }
 
 ENV_TEST(env_test_htab_deletes, 0);
+
+/*
+ * Grow the hash table well beyond its initial size, as scripts setting many
+ * variables do, and time inserting, looking up and exporting the entries
+ */
+static int env_test_htab_bench(struct unit_test_state *uts)
+{
+	ulong insert, lookup, export, reexport, start;
+	struct hsearch_data htab;
+	struct env_entry item;
+	struct env_entry *ritem;
+	char key[20];
+	size_t i;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, hcreate_r(SIZE, &htab));
+
+	start = timer_get_us();
+	ut_assertok(htab_fill(uts, &htab, BENCH_SIZE));
+	insert = timer_get_us() - start;
+	ut_asserteq(BENCH_SIZE, htab.filled);
+	ut_assert(htab.size > BENCH_SIZE);
+
+	start = timer_get_us();
+	ut_assertok(htab_check_fill(uts, &htab, BENCH_SIZE));
+	lookup = timer_get_us() - start;
+
+	/* The first export sorts all of the entries */
+	start = timer_get_us();
+	ut_assertok(htab_check_export(uts, &htab, BENCH_SIZE));
+	export = timer_get_us() - start;
+
+	/* Later ones only sort those which changed */
+	for (i = 0; i < BENCH_SIZE; i += 100) {
+		sprintf(key, "%d", (int)i);
+		ut_asserteq(1, hdelete_r(key, &htab, 0));
+	}
+	for (i = 0; i < BENCH_SIZE; i += 100) {
+		sprintf(key, "%d", (int)i);
+		item.callback = NULL;
+		item.data = key;
+		item.flags = 0;
+		item.key = key;
+		ut_asserteq(1, hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	}
+	start = timer_get_us();
+	ut_assertok(htab_check_export(uts, &htab, BENCH_SIZE));
+	reexport = timer_get_us() - start;
+
+	printf("%d entries: insert %lu us, lookup %lu us, export %lu us, re-export %lu us\n",
+	       BENCH_SIZE, insert, lookup, export, reexport);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+
+ENV_TEST(env_test_htab_bench, 0);
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the environment log in SPI flash
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <env.h>
+#include <env_internal.h>
+#include <env_log.h>
+#include <malloc.h>
+#include <os.h>
+#include <search.h>
+#include <spi_flash.h>
+#include <test/env.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+#define SF_SIZE		0x200000
+#define SF_VAL_LEN	1000
+
+/**
+ * struct sf_log - What the log in flash looks like
+ *
+ * @gen: Generation from the header
+ * @count: Number of valid records
+ * @end: Offset of the end of the valid records
+ * @last: Data of the last valid record
+ * @last_len: Length of @last
+ */
+struct sf_log {
+	u32 gen;
+	int count;
+	u32 end;
+	char last[CONFIG_ENV_SIZE];
+	u32 last_len;
+};
+
+/* Read the log from flash and walk its records */
+static int sf_log_read(struct unit_test_state *uts, struct sf_log *log)
+{
+	const struct env_log_hdr *hdr;
+	const struct env_log_rec *rec;
+	struct udevice *dev;
+	char *buf;
+	u32 len;
+
+	/* The environment removes the device when it is done with it */
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	buf = malloc(CONFIG_ENV_SIZE);
+	ut_assertnonnull(buf);
+	ut_assertok(spi_flash_read_dm(dev, CONFIG_ENV_OFFSET, CONFIG_ENV_SIZE,
+				      buf));
+
+	hdr = (const struct env_log_hdr *)buf;
+	ut_asserteq(ENV_LOG_MAGIC, le32_to_cpu(hdr->magic));
+	log->gen = le32_to_cpu(hdr->gen);
+	log->count = 0;
+	log->last_len = 0;
+	for (log->end = sizeof(*hdr);
+	     log->end + sizeof(*rec) <= CONFIG_ENV_SIZE;
+	     log->end += ENV_LOG_REC_SIZE(len)) {
+		rec = (const struct env_log_rec *)(buf + log->end);
+		len = le32_to_cpu(rec->len);
+		if (len > CONFIG_ENV_SIZE - log->end - sizeof(*rec) ||
+		    le32_to_cpu(rec->crc) != crc32(0, (const u8 *)(rec + 1),
+						   len))
+			break;
+		memcpy(log->last, rec + 1, len);
+		log->last_len = len;
+		log->count++;
+	}
+	free(buf);
+
+	return 0;
+}
+
+static struct env_driver *sf_env_driver(void)
+{
+	struct env_driver *drv = ll_entry_start(struct env_driver, env_driver);
+	const int n_ents = ll_entry_count(struct env_driver, env_driver);
+	struct env_driver *entry;
+
+	for (entry = drv; entry != drv + n_ents; entry++) {
+		if (entry->location == ENVL_SPI_FLASH)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Test appending to, replaying and rewriting the log */
+static int env_test_sf_log(struct unit_test_state *uts)
+{
+	static struct sf_log log, prev;
+	struct env_driver *drv;
+	struct env_log_rec rec;
+	struct udevice *dev;
+	char *env = NULL;
+	char val[SF_VAL_LEN + 1];
+	ssize_t env_len;
+	char *buf;
+	int i;
+
+	drv = sf_env_driver();
+	ut_assertnonnull(drv);
+	env_len = hexport_r(&env_htab, '\0', 0, &env, 0, 0, NULL);
+	ut_assert(env_len > 0);
+
+	/* Start with erased flash, loading it leaves nothing to append to */
+	buf = malloc(SF_SIZE);
+	ut_assertnonnull(buf);
+	memset(buf, 0xff, SF_SIZE);
+	ut_assertok(os_write_file("spi.bin", buf, SF_SIZE));
+	free(buf);
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	ut_asserteq(-ENOMSG, drv->load());
+	ut_assert(himport_r(&env_htab, env, env_len, '\0', 0, 0, 0, NULL));
+
+	/* The first save writes the whole environment */
+	ut_assertok(env_set("sftest", "1"));
+	ut_assertok(drv->save());
+	ut_assertok(sf_log_read(uts, &prev));
+	ut_asserteq(1, prev.count);
+
+	/* Changes are appended as a record of their own */
+	ut_assertok(env_set("sftest", "2"));
+	ut_assertok(env_set("sftest2", "x"));
+	ut_assertok(drv->save());
+	ut_assertok(sf_log_read(uts, &log));
+	ut_asserteq(prev.gen, log.gen);
+	ut_asserteq(2, log.count);
+	ut_asserteq(sizeof("sftest=2\0sftest2=x\0"), log.last_len);
+	ut_assertok(memcmp("sftest=2\0sftest2=x\0", log.last, log.last_len));
+
+	/* Nothing is written if nothing changed */
+	prev = log;
+	ut_assertok(drv->save());
+	ut_assertok(sf_log_read(uts, &log));
+	ut_asserteq(prev.end, log.end);
+
+	/* A deleted variable is recorded by its name */
+	ut_assertok(env_set("sftest2", NULL));
+	ut_assertok(drv->save());
+	ut_assertok(sf_log_read(uts, &log));
+	ut_asserteq(3, log.count);
+	ut_asserteq(sizeof("sftest2\0"), log.last_len);
+	ut_assertok(memcmp("sftest2\0", log.last, log.last_len));
+
+	/* Loading replays the records */
+	ut_assertok(env_set("sftest", "3"));
+	ut_assertok(env_set("sftest2", "y"));
+	ut_assertok(drv->load());
+	ut_asserteq_str("2", env_get("sftest"));
+	ut_assertnull(env_get("sftest2"));
+
+	/* A record cut short is ignored and the log is rewritten */
+	rec.len = cpu_to_le32(16);
+	rec.crc = cpu_to_le32(0x12345678);
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	ut_assertok(spi_flash_write_dm(dev, CONFIG_ENV_OFFSET + log.end,
+				       sizeof(rec), &rec));
+	ut_assertok(spi_flash_write_dm(dev, CONFIG_ENV_OFFSET + log.end +
+				       sizeof(rec), 8, "sftest=9"));
+	prev = log;
+	ut_assertok(drv->load());
+	ut_asserteq_str("2", env_get("sftest"));
+	ut_assertok(sf_log_read(uts, &log));
+	ut_asserteq(prev.end, log.end);
+	ut_assertok(drv->save());
+	ut_assertok(sf_log_read(uts, &log));
+	ut_asserteq(prev.gen + 1, log.gen);
+	ut_asserteq(1, log.count);
+
+	/* A full log is rewritten with the next generation */
+	prev = log;
+	val[SF_VAL_LEN] = '\0';
+	for (i = 0; log.gen == prev.gen; i++) {
+		ut_assert(i < CONFIG_ENV_SIZE / SF_VAL_LEN + 2);
+		memset(val, 'a' + i % 26, SF_VAL_LEN);
+		ut_assertok(env_set("sftest", val));
+		ut_assertok(drv->save());
+		ut_assertok(sf_log_read(uts, &log));
+		if (log.gen == prev.gen)
+			ut_asserteq(i + 2, log.count);
+	}
+	ut_assert(i > 2);
+	ut_asserteq(prev.gen + 1, log.gen);
+	ut_asserteq(1, log.count);
+	ut_assertok(env_set("sftest", "4"));
+	ut_assertok(drv->load());
+	ut_asserteq_str(val, env_get("sftest"));
+
+	/* Put back the environment the test started with */
+	ut_assert(himport_r(&env_htab, env, env_len, '\0', 0, 0, 0, NULL));
+	free(env);
+
+	return 0;
+}
+ENV_TEST(env_test_sf_log, 0);
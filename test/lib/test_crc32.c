@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the CRC32 and CRC32C implementations
+ *
+ * The table-driven and instruction-based implementations take different
+ * paths depending on the alignment and length of the buffer, so all of them
+ * are compared against a bit-at-a-time reference on random buffers.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <rand.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+#if IS_ENABLED(CONFIG_CRC32_ARMV8)
+#include <asm/armv8/crc32.h>
+#endif
+
+#define CRC32_POLY_LE	0xedb88320
+#define CRC32C_POLY_LE	0x82f63b78
+
+#define TEST_BUF_SIZE	4096
+#define TEST_RUNS	300
+
+/* Bit-at-a-time reference, without one's complement */
+static uint32_t crc_ref(uint32_t crc, const uint8_t *p, size_t len,
+			uint32_t poly)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+	}
+
+	return crc;
+}
+
+/**
+ * lib_crc32_vectors() - check the standard check values
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_crc32_vectors(struct unit_test_state *uts)
+{
+	const uint8_t *check = (const uint8_t *)"123456789";
+#ifdef CONFIG_CRC32C
+	uint32_t table[256];
+
+	crc32c_init(table, CRC32C_POLY_LE);
+	ut_asserteq(0xe3069283, ~crc32c_cal(~0, (const char *)check, 9, table));
+#endif
+	ut_asserteq(0xcbf43926, crc32(0, check, 9));
+	ut_asserteq(0xcbf43926, ~crc32_no_comp(~0, check, 9));
+	ut_asserteq(0, crc32(0, check, 0));
+
+	return 0;
+}
+
+LIB_TEST(lib_crc32_vectors, 0);
+
+/**
+ * lib_crc32_random() - compare all CRC32 variants on random buffers
+ *
+ * Each run uses a random start offset and length so that the head, body
+ * and tail loops of every implementation are exercised.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_crc32_random(struct unit_test_state *uts)
+{
+	uint32_t *table, *copy;
+	uint32_t ref, crc;
+	size_t off, len, split;
+	uint8_t *buf;
+	int i;
+
+	buf = malloc(TEST_BUF_SIZE + 8);
+	table = malloc(256 * sizeof(*table));
+	copy = malloc(256 * sizeof(*copy));
+	ut_assertnonnull(buf);
+	ut_assertnonnull(table);
+	ut_assertnonnull(copy);
+
+	srand(0x3141);
+	for (i = 0; i < TEST_BUF_SIZE + 8; i++)
+		buf[i] = rand();
+
+	for (i = 0; i < TEST_RUNS; i++) {
+		off = rand() % 8;
+		len = rand() % (TEST_BUF_SIZE + 1);
+		split = len ? rand() % len : 0;
+
+		/* CRC32: dispatched, complemented, chunked and split */
+		ref = crc_ref(~0, buf + off, len, CRC32_POLY_LE);
+		ut_asserteq(ref, crc32_no_comp(~0, buf + off, len));
+		ut_asserteq(~ref, crc32(0, buf + off, len));
+		ut_asserteq(~ref, crc32_wd(0, buf + off, len, 61));
+		crc = crc32(0, buf + off, split);
+		ut_asserteq(~ref, crc32(crc, buf + off + split, len - split));
+
+#ifdef CONFIG_CRC32C
+		/* Slice-by-8 engine with freshly built tables */
+		crc32c_init(table, CRC32_POLY_LE);
+		ut_asserteq(ref, crc32c_cal(~0, (const char *)buf + off, len,
+					    table));
+#endif
+#if IS_ENABLED(CONFIG_CRC32_ARMV8)
+		if (crc32_armv8_available())
+			ut_asserteq(ref, crc32_armv8_le(~0, buf + off, len));
+#endif
+
+#ifdef CONFIG_CRC32C
+		/* CRC32C: slice-by-8 tables and the plain byte table */
+		ref = crc_ref(~0, buf + off, len, CRC32C_POLY_LE);
+		crc32c_init(table, CRC32C_POLY_LE);
+		memcpy(copy, table, 256 * sizeof(*table));
+		ut_asserteq(ref, crc32c_cal(~0, (const char *)buf + off, len,
+					    table));
+		ut_asserteq(ref, crc32c_cal(~0, (const char *)buf + off, len,
+					    copy));
+#if IS_ENABLED(CONFIG_CRC32_ARMV8)
+		if (crc32_armv8_available())
+			ut_asserteq(ref, crc32c_armv8_le(~0, buf + off, len));
+#endif
+#endif
+	}
+
+	free(copy);
+	free(table);
+	free(buf);
+
+	return 0;
+}
+
+LIB_TEST(lib_crc32_random, 0);
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for hashing FIT images while they are loaded
+ *
+ * The data is fed to fit_image_hash_update() in pieces which do not line up
+ * with the block size of any algorithm, nor with CHUNKSZ, and the result
+ * must be the same as hashing it in one go.
+ */
+
+#include <common.h>
+#include <image.h>
+#include <malloc.h>
+#include <rand.h>
+#include <linux/libfdt.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_DATA_SIZE	(CHUNKSZ + 4465)
+#define TEST_FIT_SIZE	4096
+
+static const char *const test_algos[] = { "sha256", "sha1", "crc32" };
+
+/* Piece sizes, used in turn until all the data is hashed */
+static const size_t test_pieces[] = { 1, 63, 65, 127, 4096, CHUNKSZ + 3 };
+
+/* Create a FIT with an image whose hash nodes hold the hashes of @data */
+static int test_fit_create(struct unit_test_state *uts, void *fit,
+			   const void *data, int *image_noffsetp)
+{
+	u8 value[FIT_MAX_HASH_LEN];
+	int images, image, node;
+	char name[16];
+	int value_len;
+	int i;
+
+	ut_assertok(fdt_create_empty_tree(fit, TEST_FIT_SIZE));
+	images = fdt_add_subnode(fit, 0, FIT_IMAGES_PATH + 1);
+	ut_assert(images >= 0);
+	image = fdt_add_subnode(fit, images, "kernel");
+	ut_assert(image >= 0);
+
+	for (i = 0; i < ARRAY_SIZE(test_algos); i++) {
+		snprintf(name, sizeof(name), "%s-%d", FIT_HASH_NODENAME, i + 1);
+		node = fdt_add_subnode(fit, image, name);
+		ut_assert(node >= 0);
+		ut_assertok(calculate_hash(data, TEST_DATA_SIZE,
+					   test_algos[i], value, &value_len));
+		ut_assertok(fdt_setprop_string(fit, node, FIT_ALGO_PROP,
+					       test_algos[i]));
+		ut_assertok(fdt_setprop(fit, node, FIT_VALUE_PROP, value,
+					value_len));
+	}
+	*image_noffsetp = image;
+
+	return 0;
+}
+
+/* Hash @data piece by piece, then verify the image with the result */
+static int test_fit_stream(struct unit_test_state *uts, const void *fit,
+			   int image, const u8 *data,
+			   struct fit_hash_stream *st)
+{
+	size_t pos, len;
+	int i;
+
+	ut_assertok(fit_image_hash_start(st, fit, image, TEST_DATA_SIZE));
+	ut_asserteq(ARRAY_SIZE(test_algos), st->count);
+	for (pos = 0, i = 0; pos < TEST_DATA_SIZE; pos += len, i++) {
+		len = min(test_pieces[i % ARRAY_SIZE(test_pieces)],
+			  TEST_DATA_SIZE - pos);
+		ut_assertok(fit_image_hash_update(st, data + pos, len));
+	}
+	ut_assertok(fit_image_hash_finish(st));
+
+	return 0;
+}
+
+static int lib_test_fit_hash_stream(struct unit_test_state *uts)
+{
+	struct fit_hash_stream st;
+	u8 value[FIT_MAX_HASH_LEN];
+	u8 *data;
+	char *algo;
+	void *fit;
+	int image, value_len;
+	int i;
+
+	data = malloc(TEST_DATA_SIZE);
+	ut_assertnonnull(data);
+	fit = malloc(TEST_FIT_SIZE);
+	ut_assertnonnull(fit);
+	for (i = 0; i < TEST_DATA_SIZE; i++)
+		data[i] = rand();
+	ut_assertok(test_fit_create(uts, fit, data, &image));
+
+	/* Hashed in pieces, the values match the one-shot hashes */
+	ut_asserteq(1, fit_image_verify_with_data(fit, image, data,
+						  TEST_DATA_SIZE));
+	ut_assertok(test_fit_stream(uts, fit, image, data, &st));
+	for (i = 0; i < st.count; i++) {
+		ut_assertok(fit_image_hash_get_algo(fit, st.hash[i].noffset,
+						    &algo));
+		ut_assertok(calculate_hash(data, TEST_DATA_SIZE, algo, value,
+					   &value_len));
+		ut_asserteq(value_len, st.hash[i].value_len);
+		ut_asserteq_mem(value, st.hash[i].value, value_len);
+	}
+	ut_asserteq(1, fit_image_verify_streamed(fit, image, data,
+						 TEST_DATA_SIZE, &st));
+
+	/* A piece which was corrupted while it was read is caught */
+	data[CHUNKSZ + 100] ^= 0x10;
+	ut_assertok(test_fit_stream(uts, fit, image, data, &st));
+	data[CHUNKSZ + 100] ^= 0x10;
+	ut_asserteq(0, fit_image_verify_streamed(fit, image, data,
+						 TEST_DATA_SIZE, &st));
+
+	/* Stopping short of the image size is an error */
+	ut_assertok(fit_image_hash_start(&st, fit, image, TEST_DATA_SIZE));
+	ut_assertok(fit_image_hash_update(&st, data, TEST_DATA_SIZE - 1));
+	ut_asserteq(-EIO, fit_image_hash_finish(&st));
+
+	free(fit);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_fit_hash_stream, 0);
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the secondary-CPU work dispatcher
+ */
+
+#include <common.h>
+#include <smp_work.h>
+#include <time.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_ITEMS	32
+#define TEST_WAIT_MS	2000
+
+struct test_item {
+	int *started;
+	int cpus;
+	bool secondary;
+	bool done;
+	int ret;
+};
+
+static int test_item_func(void *arg)
+{
+	struct test_item *item = arg;
+
+	item->secondary = smp_work_is_secondary();
+	item->done = true;
+
+	return item->ret;
+}
+
+/* Wait until every CPU is running an item, to show they run concurrently */
+static int test_item_wait(void *arg)
+{
+	struct test_item *item = arg;
+	ulong start = get_timer(0);
+
+	__atomic_fetch_add(item->started, 1, __ATOMIC_ACQ_REL);
+	while (__atomic_load_n(item->started, __ATOMIC_ACQUIRE) < item->cpus) {
+		if (get_timer(start) > TEST_WAIT_MS)
+			return -ETIMEDOUT;
+	}
+
+	return test_item_func(arg);
+}
+
+static int lib_smp_work_run(struct unit_test_state *uts)
+{
+	struct test_item item[TEST_ITEMS];
+	struct smp_work work[TEST_ITEMS];
+	int started, secondary;
+	int i;
+
+	memset(item, '\0', sizeof(item));
+	for (i = 0; i < TEST_ITEMS; i++) {
+		work[i].func = test_item_func;
+		work[i].arg = &item[i];
+		item[i].ret = i == 5 || i == 9 ? -EIO - i : 0;
+	}
+	ut_asserteq(-EIO - 5, smp_work_run(work, TEST_ITEMS));
+	for (i = 0; i < TEST_ITEMS; i++) {
+		ut_assert(item[i].done);
+		ut_asserteq(item[i].ret, work[i].ret);
+	}
+	ut_assert(!smp_work_is_secondary());
+
+	/* Each CPU must pick up one of the first smp_work_cpus() items */
+	memset(item, '\0', sizeof(item));
+	for (i = 0; i < smp_work_cpus(); i++) {
+		work[i].func = test_item_wait;
+		item[i].started = &started;
+		item[i].cpus = smp_work_cpus();
+	}
+	started = 0;
+	ut_assertok(smp_work_run(work, smp_work_cpus()));
+	for (i = 0, secondary = 0; i < smp_work_cpus(); i++)
+		secondary += item[i].secondary;
+	ut_asserteq(smp_work_cpus() - 1, secondary);
+
+	return 0;
+}
+LIB_TEST(lib_smp_work_run, 0);
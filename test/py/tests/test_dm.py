@@ -33,3 +33,15 @@ def test_dm_static(u_boot_console):
     response = u_boot_console.run_command('dm drivers')
     for driver in drivers:
         assert driver in response
+
+@pytest.mark.buildconfigspec('cmd_dm')
+@pytest.mark.buildconfigspec('dm_uclass_index')
+def test_dm_stats(u_boot_console):
+    """Test that each uclass in `dm stats` is also listed in `dm uclass`."""
+    response = u_boot_console.run_command('dm stats')
+    lines = response[:-1].split('\n')
+    assert lines[-1].startswith('(total)')
+    uclasses = (line[:16].rstrip() for line in lines[2:-1])
+    response = u_boot_console.run_command('dm uclass')
+    for uclass in uclasses:
+        assert ': %s\n' % uclass in response
@@ -14,6 +14,8 @@ supported_fs_ext = ['fat16', 'fat32']
 supported_fs_mkdir = ['fat16', 'fat32']
 supported_fs_unlink = ['fat16', 'fat32']
 supported_fs_symlink = ['ext4']
+supported_fs_extents = ['ext4']
+supported_fs_fat = ['fat16', 'fat32']
 
 #
 # Filesystem test specific setup
@@ -50,6 +52,8 @@ def pytest_configure(config):
     global supported_fs_mkdir
     global supported_fs_unlink
     global supported_fs_symlink
+    global supported_fs_extents
+    global supported_fs_fat
 
     def intersect(listA, listB):
         return  [x for x in listA if x in listB]
@@ -62,6 +66,8 @@ def pytest_configure(config):
         supported_fs_mkdir =  intersect(supported_fs, supported_fs_mkdir)
         supported_fs_unlink =  intersect(supported_fs, supported_fs_unlink)
         supported_fs_symlink =  intersect(supported_fs, supported_fs_symlink)
+        supported_fs_extents =  intersect(supported_fs, supported_fs_extents)
+        supported_fs_fat =  intersect(supported_fs, supported_fs_fat)
 
 def pytest_generate_tests(metafunc):
     """Parametrize fixtures, fs_obj_xxx
@@ -90,6 +96,12 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_symlink' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_symlink', supported_fs_symlink,
             indirect=True, scope='module')
+    if 'fs_obj_extents' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_extents', supported_fs_extents,
+            indirect=True, scope='module')
+    if 'fs_obj_fat' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_fat', supported_fs_fat,
+            indirect=True, scope='module')
 
 #
 # Helper functions
@@ -131,13 +143,14 @@ def check_ubconfig(config, fs_type):
         pytest.skip('.config feature "%s_WRITE" not enabled'
         % fs_type.upper())
 
-def mk_fs(config, fs_type, size, id):
+def mk_fs(config, fs_type, size, id, extra_opt=''):
     """Create a file system volume.
 
     Args:
         fs_type: File system type.
         size: Size of file system in MiB.
         id: Prefix string of volume's file name.
+        extra_opt: Additional options for mkfs.
 
     Return:
         Nothing.
@@ -151,6 +164,7 @@ def mk_fs(config, fs_type, size, id):
         mkfs_opt = '-F 32'
     else:
         mkfs_opt = ''
+    mkfs_opt += ' ' + extra_opt
 
     if re.match('fat', fs_type):
         fs_lnxtype = 'vfat'
@@ -603,3 +617,136 @@ def fs_obj_symlink(request, u_boot_config):
         call('rmdir %s' % mount_dir, shell=True)
         if fs_img:
             call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for extent tree test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_extents(request, u_boot_config):
+    """Set up a file system to be used in extent tree test.
+
+    The volume is populated with debugfs, so it needs no mounting. Its free
+    space is fragmented into single blocks, which are the first ones handed
+    out, so that a file written by U-Boot needs a deep extent tree. The
+    punched file is itself sparse with a two level tree, and another file
+    ends in a preallocated, unwritten extent.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for extent tree test, i.e. a triplet of file system type,
+        volume file name and a list of MD5 hashes.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+
+    data_dir = u_boot_config.persistent_data_dir
+    small_file = data_dir + '/' + SMALL_FILE
+    holes_file = data_dir + '/holes.file'
+    prealloc_file = data_dir + '/prealloc.file'
+    script = data_dir + '/extents.debugfs'
+
+    try:
+        # 32MiB volume with 1KiB blocks, so that extent blocks fill quickly
+        fs_img = mk_fs(u_boot_config, fs_type, 0x2000000, '32MB', '-b 1024')
+
+        check_call('dd if=/dev/urandom of=%s bs=1M count=1'
+                   % small_file, shell=True)
+        check_call('dd if=/dev/urandom of=%s bs=1K count=2048'
+                   % holes_file, shell=True)
+        check_call('dd if=/dev/urandom of=%s bs=1K count=64'
+                   % prealloc_file, shell=True)
+        out = check_output('md5sum %s' % small_file, shell=True).decode()
+        md5val = [out.split()[0]]
+
+        # Free every other block of a 2048 block file, which leaves more
+        # single free blocks than the 1024 blocks of the small file. The
+        # 64KiB file is then given 128KiB of unwritten blocks.
+        with open(script, 'w') as f:
+            f.write('write %s %s\n' % (small_file, SMALL_FILE))
+            f.write('write %s prealloc\n' % prealloc_file)
+            f.write('fallocate prealloc 64 191\n')
+            f.write('sif prealloc size 0x30000\n')
+            f.write('write %s holes\n' % holes_file)
+            for i in range(0, 2048, 2):
+                f.write('punch holes %d %d\n' % (i, i))
+        check_call('debugfs -w -f %s %s > /dev/null'
+                   % (script, fs_img), shell=True)
+
+        # The punched blocks and the unwritten ones read as zeroes
+        with open(holes_file, 'r+b') as f:
+            data = bytearray(f.read())
+            for i in range(0, 2048, 2):
+                data[i * 1024:(i + 1) * 1024] = bytes(1024)
+            f.seek(0)
+            f.write(data)
+        with open(prealloc_file, 'ab') as f:
+            f.write(bytes(0x20000))
+
+        # Generate the md5sums of the whole holes file, of 1MiB from its
+        # middle and of the preallocated file
+        for cmd in ['md5sum %s' % holes_file,
+                    'dd if=%s bs=1K skip=513 count=1024 2> /dev/null | md5sum'
+                        % holes_file,
+                    'md5sum %s' % prealloc_file]:
+            out = check_output(cmd, shell=True).decode()
+            md5val.append(out.split()[0])
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_ubtype, fs_img, md5val]
+    finally:
+        call('rm -f %s %s %s %s' % (small_file, holes_file, prealloc_file,
+                                     script), shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for FAT specific test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_fat(request, u_boot_config):
+    """Set up a file system to be used in FAT specific test.
+
+    The volume is left empty, U-Boot writes all the files itself so that
+    it needs no mounting.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for FAT specific test, i.e. a triplet of file system type,
+        volume file name and a file of random data on the host.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+
+    data_file = u_boot_config.persistent_data_dir + '/fat.data'
+
+    try:
+        # 128MiB volume
+        fs_img = mk_fs(u_boot_config, fs_type, 0x8000000, '128MB')
+
+        check_call('dd if=/dev/urandom of=%s bs=1M count=4'
+                   % data_file, shell=True)
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_ubtype, fs_img, data_file]
+    finally:
+        call('rm -f %s' % data_file, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
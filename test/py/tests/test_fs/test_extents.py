@@ -0,0 +1,98 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:Extent Tree Test
+
+"""
+This test verifies reading and writing files mapped by an extent tree deeper
+than the inode alone holds, with holes in them and with unwritten extents.
+"""
+
+import pytest
+import re
+from subprocess import check_output
+from fstest_defs import *
+from fstest_helpers import assert_fs_integrity
+
+def extent_depth(fs_img, path):
+    """Get the depth of the extent tree of a file, as debugfs reports it."""
+    out = check_output('debugfs -R "ex %s" %s 2> /dev/null' % (path, fs_img),
+                       shell=True).decode()
+    m = re.search(r'^\s*\d+/\s*(\d+)', out, re.M)
+    return int(m.group(1)) if m else -1
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+@pytest.mark.requiredtool('debugfs')
+class TestFsExtents(object):
+    def test_fs_extents1(self, u_boot_console, fs_obj_extents):
+        """
+        Test Case 1 - write a file which needs more extents than a leaf holds
+        """
+        fs_type,fs_img,md5val = fs_obj_extents
+        with u_boot_console.log.section('Test Case 1 - write fragmented'):
+            # Test Case 1a - Check if command successfully returned
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, SMALL_FILE),
+                '%swrite host 0:0 %x /%s.w $filesize'
+                    % (fs_type, ADDR, SMALL_FILE)])
+            assert('1048576 bytes written' in ''.join(output))
+            assert(extent_depth(fs_img, '/%s.w' % SMALL_FILE) >= 2)
+
+            # Test Case 1b - Check md5 of file content
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /%s.w' % (fs_type, ADDR, SMALL_FILE),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[0] in ''.join(output))
+            assert_fs_integrity(fs_type, fs_img)
+
+            # Test Case 1c - Overwrite it, which frees the extent tree
+            output = u_boot_console.run_command_list([
+                '%swrite host 0:0 %x /%s.w 400'
+                    % (fs_type, ADDR, SMALL_FILE)])
+            assert('1024 bytes written' in ''.join(output))
+            assert_fs_integrity(fs_type, fs_img)
+
+    def test_fs_extents2(self, u_boot_console, fs_obj_extents):
+        """
+        Test Case 2 - read a sparse file mapped by a two level extent tree
+        """
+        fs_type,fs_img,md5val = fs_obj_extents
+        with u_boot_console.log.section('Test Case 2 - read sparse'):
+            assert(extent_depth(fs_img, '/holes') >= 2)
+
+            # Test Case 2a - Read the whole file, holes included
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'mw.b %x ff 200000' % ADDR,
+                '%sload host 0:0 %x /holes' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert('2097152 bytes read' in ''.join(output))
+            assert(md5val[1] in ''.join(output))
+
+            # Test Case 2b - Read from within a hole, across several leaves
+            output = u_boot_console.run_command_list([
+                'mw.b %x ff 100000' % ADDR,
+                '%sload host 0:0 %x /holes 100000 80400' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert('1048576 bytes read' in ''.join(output))
+            assert(md5val[2] in ''.join(output))
+
+    def test_fs_extents3(self, u_boot_console, fs_obj_extents):
+        """
+        Test Case 3 - read a file which ends in an unwritten extent
+        """
+        fs_type,fs_img,md5val = fs_obj_extents
+        with u_boot_console.log.section('Test Case 3 - read unwritten'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'mw.b %x ff 30000' % ADDR,
+                '%sload host 0:0 %x /prealloc' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert('196608 bytes read' in ''.join(output))
+            assert(md5val[3] in ''.join(output))
@@ -0,0 +1,110 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:FAT Specific Test
+
+"""
+This test verifies FAT specific behaviour: reading fragmented files,
+reporting their runs of consecutive clusters and writing files whose
+cluster chains span many windows of the FAT cache.
+"""
+
+import pytest
+import struct
+from fstest_defs import *
+
+# Where files are read back to, clear of the data at ADDR
+ADDR_READ = 0x03000000
+
+def fat_copies(fs_img):
+    """Get the contents of each copy of the FAT of a volume."""
+    with open(fs_img, 'rb') as f:
+        bs = f.read(512)
+        sect_size, reserved, fats = struct.unpack_from('<HxHB', bs, 11)
+        length = struct.unpack_from('<H', bs, 22)[0]
+        if not length:
+            length = struct.unpack_from('<I', bs, 36)[0]
+        f.seek(reserved * sect_size)
+        return [f.read(length * sect_size) for i in range(fats)]
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestFsFat(object):
+    def test_fs_fat1(self, u_boot_console, fs_obj_fat):
+        """
+        Test Case 1 - read a fragmented file and count its extents
+        """
+        fs_type,fs_img,data_file = fs_obj_fat
+        with u_boot_console.log.section('Test Case 1 - fragmented read'):
+            # Test Case 1a - A file written in one go is contiguous
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'host load hostfs - %x %s' % (ADDR, data_file),
+                '%swrite host 0:0 %x /contig 40000' % (fs_type, ADDR),
+                '%sinfo host 0:0 /contig' % fs_type])
+            assert('1 extent(s)' in ''.join(output))
+
+            # Test Case 1b - Appending after other files fragments it
+            cmds = ['%swrite host 0:0 %x /frag 10000' % (fs_type, ADDR)]
+            for i in range(1, 4):
+                cmds += [
+                    '%swrite host 0:0 %x /spacer%d 200' % (fs_type, ADDR, i),
+                    '%swrite host 0:0 %x /frag 10000 %x'
+                        % (fs_type, ADDR + i * 0x10000, i * 0x10000)]
+            cmds += ['%sinfo host 0:0 /frag' % fs_type,
+                     'printenv fileextents']
+            output = u_boot_console.run_command_list(cmds)
+            assert('fileextents=4' in ''.join(output))
+
+            # Test Case 1c - Read it all, then from within the second extent
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 40000' % ADDR_READ,
+                '%sload host 0:0 %x /frag' % (fs_type, ADDR_READ),
+                'cmp.b %x %x 40000' % (ADDR, ADDR_READ),
+                'mw.b %x 00 40000' % ADDR_READ,
+                '%sload host 0:0 %x /frag 20000 f000'
+                    % (fs_type, ADDR_READ),
+                'cmp.b %x %x 20000' % (ADDR + 0xf000, ADDR_READ)])
+            assert('262144 bytes read' in ''.join(output))
+            assert('131072 bytes read' in ''.join(output))
+            assert(''.join(output).count('were the same') == 2)
+
+    def test_fs_fat2(self, u_boot_console, fs_obj_fat):
+        """
+        Test Case 2 - write a file whose chain spans many FAT windows
+        """
+        fs_type,fs_img,data_file = fs_obj_fat
+        with u_boot_console.log.section('Test Case 2 - multi-window write'):
+            # Test Case 2a - 30MiB is more than four windows of FAT32
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'host load hostfs - %x %s' % (ADDR, data_file),
+                '%swrite host 0:0 %x /big 1e00000' % (fs_type, ADDR)])
+            assert('31457280 bytes written' in ''.join(output))
+
+            # Test Case 2b - Every FAT copy was written back
+            fats = fat_copies(fs_img)
+            assert(len(fats) == 2)
+            assert(fats[0] == fats[1])
+
+            # Test Case 2c - Read it back
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 1e00000' % ADDR_READ,
+                '%sload host 0:0 %x /big' % (fs_type, ADDR_READ),
+                'cmp.b %x %x 1e00000' % (ADDR, ADDR_READ),
+                '%sinfo host 0:0 /big' % fs_type,
+                'printenv fileextents'])
+            assert('31457280 bytes read' in ''.join(output))
+            assert('were the same' in ''.join(output))
+            assert('fileextents=1' in ''.join(output))
+
+            # Test Case 2d - Rewrite it shorter, which frees clusters
+            # across the whole FAT
+            output = u_boot_console.run_command_list([
+                '%swrite host 0:0 %x /big 1000000' % (fs_type, ADDR),
+                'mw.b %x 00 1000000' % ADDR_READ,
+                '%sload host 0:0 %x /big' % (fs_type, ADDR_READ),
+                'cmp.b %x %x 1000000' % (ADDR, ADDR_READ)])
+            assert('16777216 bytes written' in ''.join(output))
+            assert('were the same' in ''.join(output))
+            fats = fat_copies(fs_img)
+            assert(fats[0] == fats[1])
@@ -0,0 +1,56 @@
+# SPDX-License-Identifier: GPL-2.0
+#
+# Check that files are read right while the metadata cache fills up, and
+# once it holds their metadata.
+
+import hashlib
+import os
+import pytest
+from sqfs_common import *
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_squashfs')
+@pytest.mark.buildconfigspec('fs_squashfs')
+@pytest.mark.requiredtool('mksquashfs')
+def test_sqfs_cache(u_boot_console):
+    build_dir = u_boot_console.config.build_dir
+    command = "sqfsload host 0 $kernel_addr_r "
+
+    # Each tail is over half a block, so it gets a fragment block of its
+    # own, and the 600 fragment entries span two metadata blocks. The last
+    # file also has a full data block before its tail.
+    files = ["tail%03d" % i for i in range(600)]
+    sizes = [2100 + i for i in range(599)] + [4096 + 2100]
+    opt = Compression("gzip", files, sizes)
+    opt.add_opt("-always-use-fragments")
+    try:
+        opt.gen_image(build_dir)
+    except RuntimeError:
+        opt.clean_source(build_dir)
+        pytest.skip("mksquashfs failed")
+
+    src = os.path.join(build_dir, "sqfs_src/")
+    checked = [files[i] for i in (0, 1, 511, 512, 598, 599)]
+    md5 = {}
+    for f in checked:
+        with open(src + f, "rb") as fd:
+            md5[f] = hashlib.md5(fd.read()).hexdigest()
+
+    path = os.path.join(build_dir, "sqfs-" + opt.name)
+    u_boot_console.run_command("host bind 0 " + path)
+    try:
+        # The second time round, the metadata comes from the cache
+        for i in range(2):
+            output = u_boot_console.run_command("sqfsls host 0")
+            assert str(len(files) + 1) + " file(s), 0 dir(s)" in output
+            for f in checked:
+                output = u_boot_console.run_command(command + f)
+                assert str(os.path.getsize(src + f)) + " bytes read" in output
+                output = u_boot_console.run_command(
+                    "md5sum $kernel_addr_r $filesize")
+                assert md5[f] in output
+            output = u_boot_console.run_command(command + "sym")
+            assert str(sizes[0]) + " bytes read" in output
+    finally:
+        opt.cleanup(build_dir)
@@ -22,6 +22,7 @@
 #include <sys/mman.h>
 
 #include "compiler.h"
+#include <env_log.h>
 #include <u-boot/crc.h>
 #include <version.h>
 
@@ -29,7 +30,7 @@
 
 static void usage(const char *exec_name)
 {
-	fprintf(stderr, "%s [-h] [-r] [-b] [-p <byte>] -s <environment partition size> -o <output> <input file>\n"
+	fprintf(stderr, "%s [-h] [-r] [-b] [-l] [-p <byte>] -s <environment partition size> -o <output> <input file>\n"
 	       "\n"
 	       "This tool takes a key=value input file (same as would a `printenv' show) and generates the corresponding environment image, ready to be flashed.\n"
 	       "\n"
@@ -41,6 +42,8 @@ static void usage(const char *exec_name)
 	       "\tcolumn are treated as comments (also skipped).\n"
 	       "\t-r : the environment has multiple copies in flash\n"
 	       "\t-b : the target is big endian (default is little endian)\n"
+	       "\t-l : generate an append log, as used with CONFIG_ENV_SF_LOG;\n"
+	       "\t     -r and -b do not apply to it\n"
 	       "\t-p <byte> : fill the image with <byte> bytes instead of 0xff bytes\n"
 	       "\t-V : print version information and exit\n"
 	       "\n"
@@ -78,6 +81,8 @@ int main(int argc, char **argv)
 	unsigned int filesize = 0, envsize = 0, datasize = 0;
 	int bigendian = 0;
 	int redundant = 0;
+	int logfmt = 0;
+	unsigned int hdrsize;
 	unsigned char padbyte = 0xff;
 	int readbytes = 0;
 
@@ -93,7 +98,7 @@ int main(int argc, char **argv)
 	opterr = 0;
 
 	/* Parse the cmdline */
-	while ((option = getopt(argc, argv, ":s:o:rbp:hV")) != -1) {
+	while ((option = getopt(argc, argv, ":s:o:rblp:hV")) != -1) {
 		switch (option) {
 		case 's':
 			datasize = xstrtol(optarg);
@@ -111,6 +116,9 @@ int main(int argc, char **argv)
 		case 'b':
 			bigendian = 1;
 			break;
+		case 'l':
+			logfmt = 1;
+			break;
 		case 'p':
 			padbyte = xstrtol(optarg);
 			break;
@@ -148,10 +156,20 @@ int main(int argc, char **argv)
 
 	/*
 	 * envptr points to the beginning of the actual environment (after the
-	 * crc and possible `redundant' byte
+	 * crc and possible `redundant' byte, or after the log and first record
+	 * headers)
 	 */
-	envsize = datasize - (CRC_SIZE + redundant);
-	envptr = dataptr + CRC_SIZE + redundant;
+	if (logfmt)
+		hdrsize = sizeof(struct env_log_hdr) +
+			  sizeof(struct env_log_rec);
+	else
+		hdrsize = CRC_SIZE + redundant;
+	if (datasize <= hdrsize) {
+		fprintf(stderr, "The environment partition is too small.\n");
+		return EXIT_FAILURE;
+	}
+	envsize = datasize - hdrsize;
+	envptr = dataptr + hdrsize;
 
 	/* Pad the environment with the padding byte */
 	memset(envptr, padbyte, envsize);
@@ -254,13 +272,30 @@ int main(int argc, char **argv)
 		envptr[ep] = '\0';
 	}
 
-	/* Computes the CRC and put it at the beginning of the data */
-	crc = crc32(0, envptr, envsize);
-	targetendian_crc = bigendian ? cpu_to_be32(crc) : cpu_to_le32(crc);
+	if (logfmt) {
+		/* A log holding the whole environment as its first record */
+		struct env_log_hdr hdr;
+		struct env_log_rec rec;
 
-	memcpy(dataptr, &targetendian_crc, sizeof(targetendian_crc));
-	if (redundant)
-		dataptr[sizeof(targetendian_crc)] = 1;
+		rec.len = cpu_to_le32(ep + 1);
+		rec.crc = cpu_to_le32(crc32(0, envptr, ep + 1));
+		hdr.magic = cpu_to_le32(ENV_LOG_MAGIC);
+		hdr.gen = cpu_to_le32(1);
+		hdr.crc = cpu_to_le32(crc32(0, (unsigned char *)&hdr,
+					    offsetof(struct env_log_hdr, crc)));
+
+		memcpy(dataptr, &hdr, sizeof(hdr));
+		memcpy(dataptr + sizeof(hdr), &rec, sizeof(rec));
+	} else {
+		/* Computes the CRC and put it at the beginning of the data */
+		crc = crc32(0, envptr, envsize);
+		targetendian_crc = bigendian ? cpu_to_be32(crc) :
+					       cpu_to_le32(crc);
+
+		memcpy(dataptr, &targetendian_crc, sizeof(targetendian_crc));
+		if (redundant)
+			dataptr[sizeof(targetendian_crc)] = 1;
+	}
 
 	if (!bin_filename || strcmp(bin_filename, "-") == 0) {
 		bin_fd = STDOUT_FILENO;